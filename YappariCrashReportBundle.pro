@@ -1,5 +1,8 @@
 TEMPLATE = subdirs
 
 SUBDIRS = example/YappariCrashReportExample.pro \
+          handler/YappariCrashHandler.pro \
+          minidump/YappariMinidump.pro \
           test/YappariCrashReportTest.pro
 
+linux:SUBDIRS += test/YappariCrashReportBenchmark.pro
@@ -0,0 +1,125 @@
+
+# The capture and symbolization engine, only needs QtCore: the crash reports are written to the report
+# directory and handed to the callback (see setReportDirectory()). Include YappariCrashReport.pri instead
+# to show them in the crash report dialog.
+#
+# By default optimization is turned off so the stack traces are as accurate as possible.
+# Add "CONFIG += yappari_split_debug_info" before including this file to keep the optimization
+# instead: the debug information is moved to a separate file and the shipped binary is stripped.
+CONFIG (release, release|debug) {
+    !build_pass:message( 'Enabling YappariCrashReport and including debug symbols' )
+
+    yappari_split_debug_info {
+        !build_pass:message( 'YappariCrashReport: optimized build with split debug info' )
+
+        # <target>.debug keeps the debug info, the target is stripped and points to it with .gnu_debuglink
+        YAPPARI_SPLIT_DEBUG_INFO = objcopy --only-keep-debug $(TARGET) $(TARGET).debug && \
+                                   objcopy --strip-debug --strip-unneeded --add-gnu-debuglink=$(TARGET).debug $(TARGET)
+    }
+
+    DEFINES += YAPPARI_CRASH_REPORT
+
+VPATH += $$PWD/src
+    DEPENDPATH += $$PWD/src
+    INCLUDEPATH += $$PWD/src
+
+    HEADERS += \
+    $$PWD/src/YappariCrashReport.h \
+    $$PWD/src/CrashReport.h \
+    $$PWD/src/Symbolizer.h
+
+    SOURCES += \
+    $$PWD/src/YappariCrashReport.cpp \
+    $$PWD/src/CrashReport.cpp \
+    $$PWD/src/Symbolizer.cpp
+
+
+    win32-g++* {
+        yappari_split_debug_info {
+            QMAKE_CFLAGS_RELEASE += -g -fno-omit-frame-pointer
+            QMAKE_CXXFLAGS_RELEASE += -g -fno-omit-frame-pointer
+            QMAKE_LFLAGS_RELEASE =
+
+            # MinGW makefiles name the linked file $(DESTDIR_TARGET)
+            QMAKE_POST_LINK += objcopy --only-keep-debug $(DESTDIR_TARGET) $(DESTDIR_TARGET).debug && \
+                               objcopy --strip-debug --strip-unneeded --add-gnu-debuglink=$(DESTDIR_TARGET).debug $(DESTDIR_TARGET)
+        } else {
+            QMAKE_CFLAGS_RELEASE -= -O2
+            QMAKE_CXXFLAGS_RELEASE -= -O2
+
+            QMAKE_CFLAGS_RELEASE += -g -O0
+            QMAKE_CXXFLAGS_RELEASE += -g -O0
+            QMAKE_LFLAGS_RELEASE =
+        }
+
+        LIBS += -lDbghelp
+    }
+
+    unix {
+        HEADERS += $$PWD/src/AlternateStack.h $$PWD/src/Breadcrumbs.h $$PWD/src/CrashArena.h $$PWD/src/CrashSignature.h $$PWD/src/CrashSpool.h $$PWD/src/ReportStream.h $$PWD/src/Unwinder.h
+        SOURCES += $$PWD/src/AlternateStack.cpp $$PWD/src/Breadcrumbs.cpp $$PWD/src/CrashArena.cpp $$PWD/src/CrashSignature.cpp $$PWD/src/CrashSpool.cpp $$PWD/src/ReportStream.cpp $$PWD/src/Unwinder.cpp
+
+        # uploads the reports of the crash spool in the background, see setCrashUploader()
+        yappari_crash_uploader {
+            QT += network
+            DEFINES += YAPPARI_CRASH_UPLOADER
+
+            HEADERS += $$PWD/src/CrashUploader.h
+            SOURCES += $$PWD/src/CrashUploader.cpp
+        }
+    }
+
+    mac {
+        yappari_split_debug_info {
+            QMAKE_CFLAGS_RELEASE += -g -fno-pie -fno-omit-frame-pointer
+            QMAKE_CFLAGS_RELEASE_WITH_DEBUGINFO += -fno-pie -fno-omit-frame-pointer
+            QMAKE_CXXFLAGS_RELEASE += -g -fno-pie -fno-omit-frame-pointer
+            QMAKE_CXXFLAGS_RELEASE_WITH_DEBUGINFO += -fno-pie -fno-omit-frame-pointer
+
+            # atos finds the .dSYM bundle next to the binary by its UUID
+            QMAKE_POST_LINK += dsymutil $(TARGET) && strip -S $(TARGET)
+        } else {
+            QMAKE_CFLAGS_RELEASE -= -O2
+            QMAKE_CFLAGS_RELEASE_WITH_DEBUGINFO -= -O2
+            QMAKE_CXXFLAGS_RELEASE -= -O2
+            QMAKE_CXXFLAGS_RELEASE_WITH_DEBUGINFO -= -O2
+
+            QMAKE_CFLAGS_RELEASE += -g -fno-pie -fno-omit-frame-pointer -O0
+            QMAKE_CFLAGS_RELEASE_WITH_DEBUGINFO += -fno-pie -fno-omit-frame-pointer -O0
+            QMAKE_CXXFLAGS_RELEASE += -g -fno-pie -fno-omit-frame-pointer -O0
+            QMAKE_CXXFLAGS_RELEASE_WITH_DEBUGINFO += -fno-pie -fno-omit-frame-pointer -O0
+        }
+
+        QMAKE_LFLAGS_RELEASE += -Wl,-no_pie
+    }
+
+    linux {
+        HEADERS += $$PWD/src/ElfSymbolizer.h $$PWD/src/CrashHandlerProcess.h $$PWD/src/HangWatchdog.h $$PWD/src/Minidump.h $$PWD/src/ModuleMap.h $$PWD/src/Profiler.h $$PWD/src/StackTrace.h $$PWD/src/SymbolCache.h $$PWD/src/ThreadCapture.h $$PWD/src/ThrowCapture.h
+        SOURCES += $$PWD/src/ElfSymbolizer.cpp $$PWD/src/CrashHandlerProcess.cpp $$PWD/src/HangWatchdog.cpp $$PWD/src/Minidump.cpp $$PWD/src/ModuleMap.cpp $$PWD/src/Profiler.cpp $$PWD/src/StackTrace.cpp $$PWD/src/SymbolCache.cpp $$PWD/src/ThreadCapture.cpp $$PWD/src/ThrowCapture.cpp
+
+        LIBS += -ldl -lrt
+
+        # replaces __cxa_throw() to record the stack of every throw, see setThrowCapture()
+        yappari_throw_capture {
+            DEFINES += YAPPARI_THROW_CAPTURE
+        }
+
+        yappari_split_debug_info {
+            QMAKE_CFLAGS_RELEASE += -g -fno-omit-frame-pointer
+            QMAKE_CXXFLAGS_RELEASE += -g -fno-omit-frame-pointer
+            QMAKE_LFLAGS_RELEASE += -Wl,--build-id
+
+            QMAKE_POST_LINK += $$YAPPARI_SPLIT_DEBUG_INFO
+        } else {
+            QMAKE_CFLAGS_RELEASE -= -O2
+            QMAKE_CXXFLAGS_RELEASE -= -O2
+
+            QMAKE_CFLAGS_RELEASE += -g -O0
+            QMAKE_CXXFLAGS_RELEASE += -g -O0
+        }
+    }
+}
+
+CONFIG (debug, release|debug) {
+    message( 'NOTE: YappariCrashReport is only valid for release builds' )
+}
@@ -0,0 +1,16 @@
+message( "Building crash handler" )
+
+TARGET = YappariCrashHandler
+TEMPLATE = app
+
+mac:CONFIG -= app_bundle
+CONFIG += c++14
+
+QT += widgets
+
+if ( !include( ../YappariCrashReport.pri ) ) {
+    error( Could not find the YappariCrashReport.pri file. )
+}
+
+SOURCES += \
+    main.cpp
@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2020 Naikel Aparicio. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ''AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the author and should not be interpreted as representing
+ * official policies, either expressed or implied, of the copyright holder.
+ */
+
+#include <algorithm>
+#include <thread>
+
+#include "WorkStealingPool.h"
+
+
+WorkStealingPool::WorkStealingPool( unsigned inThreadCount ) :
+   mThreadCount( (inThreadCount > 0) ? inThreadCount : std::max( std::thread::hardware_concurrency(), 1u ) )
+{
+   for ( unsigned i = 0; i < mThreadCount; ++i )
+      mQueues.emplace_back( new Queue );
+}
+
+// Take a task from our own queue, or steal one from another thread
+bool  WorkStealingPool::_next( unsigned inThread, size_t &outTask )
+{
+   {
+      Queue &queue = *mQueues[inThread];
+      std::lock_guard<std::mutex>   lock( queue.mutex );
+
+      if ( !queue.tasks.empty() )
+      {
+         outTask = queue.tasks.back();
+         queue.tasks.pop_back();
+         return true;
+      }
+   }
+
+   // the oldest tasks of a victim are the ones it is furthest from reaching
+   for ( unsigned i = 1; i < mThreadCount; ++i )
+   {
+      Queue &victim = *mQueues[(inThread + i) % mThreadCount];
+      std::lock_guard<std::mutex>   lock( victim.mutex );
+
+      if ( !victim.tasks.empty() )
+      {
+         outTask = victim.tasks.front();
+         victim.tasks.pop_front();
+
+         std::lock_guard<std::mutex>   stolenLock( mStolenMutex );
+         ++mStolenCount;
+
+         return true;
+      }
+   }
+
+   // tasks are never added during a run, so empty queues mean we are done
+   return false;
+}
+
+void  WorkStealingPool::_work( unsigned inThread, const std::function<void( size_t )> &inTask )
+{
+   size_t   task = 0;
+
+   while ( _next( inThread, task ) )
+      inTask( task );
+}
+
+void  WorkStealingPool::run( size_t inTaskCount, const std::function<void( size_t )> &inTask )
+{
+   mStolenCount = 0;
+
+   // contiguous shares, in reverse so each thread starts with the first task of its share
+   for ( unsigned i = 0; i < mThreadCount; ++i )
+   {
+      const size_t   cBegin = inTaskCount * i / mThreadCount;
+      const size_t   cEnd = inTaskCount * (i + 1) / mThreadCount;
+
+      for ( size_t task = cEnd; task > cBegin; --task )
+         mQueues[i]->tasks.push_back( task - 1 );
+   }
+
+   std::vector<std::thread>   threads;
+
+   for ( unsigned i = 1; i < mThreadCount; ++i )
+      threads.emplace_back( &WorkStealingPool::_work, this, i, std::cref( inTask ) );
+
+   // the calling thread is worker 0
+   _work( 0, inTask );
+
+   for ( std::thread &thread : threads )
+      thread.join();
+}
@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2020 Naikel Aparicio. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ''AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the author and should not be interpreted as representing
+ * official policies, either expressed or implied, of the copyright holder.
+ */
+
+
+#ifndef WORKSTEALINGPOOL_H
+#define WORKSTEALINGPOOL_H
+
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+
+/// Run a batch of independent tasks on a fixed number of threads.
+///
+/// Every thread starts with its own share of the tasks and takes them from the back of its queue.
+/// A thread that runs out of work steals from the front of the other threads' queues, so a few
+/// slow tasks (a record with huge stacks, a module being indexed) don't leave the other threads idle.
+class WorkStealingPool
+{
+   public:
+      /// @param inThreadCount The number of threads, 0 for one per core
+      explicit WorkStealingPool( unsigned inThreadCount = 0 );
+
+      WorkStealingPool( const WorkStealingPool & ) = delete;
+      WorkStealingPool &operator=( const WorkStealingPool & ) = delete;
+
+      unsigned threadCount() const { return mThreadCount; }
+
+      /// Run inTask( 0 ) to inTask( inTaskCount - 1 ) and wait for all of them to finish
+      void run( size_t inTaskCount, const std::function<void( size_t )> &inTask );
+
+      /// The number of tasks that were stolen in the last run()
+      size_t stolenCount() const { return mStolenCount; }
+
+   private:
+      struct Queue
+      {
+         std::mutex           mutex;
+         std::deque<size_t>   tasks;
+      };
+
+      bool  _next( unsigned inThread, size_t &outTask );
+      void  _work( unsigned inThread, const std::function<void( size_t )> &inTask );
+
+      unsigned mThreadCount;
+      std::vector<std::unique_ptr<Queue>> mQueues;
+      size_t   mStolenCount = 0;
+      std::mutex  mStolenMutex;
+};
+
+#endif
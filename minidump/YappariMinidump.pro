@@ -0,0 +1,20 @@
+message( "Building minidump converter" )
+
+TARGET = YappariMinidump
+TEMPLATE = app
+
+CONFIG += console c++14
+mac:CONFIG -= app_bundle
+
+QT -= gui
+
+if ( !include( ../YappariCrashReportCore.pri ) ) {
+    error( Could not find the YappariCrashReportCore.pri file. )
+}
+
+HEADERS += \
+    WorkStealingPool.h
+
+SOURCES += \
+    main.cpp \
+    WorkStealingPool.cpp
@@ -0,0 +1,384 @@
+/*
+ * Copyright (C) 2020 Naikel Aparicio. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ''AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the author and should not be interpreted as representing
+ * official policies, either expressed or implied, of the copyright holder.
+ */
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTextStream>
+
+#if defined(YAPPARI_CRASH_REPORT) && defined(Q_OS_LINUX)
+#include "CrashArena.h"
+#include "CrashReport.h"
+#include "Minidump.h"
+#include "SymbolCache.h"
+#include "Symbolizer.h"
+#include "WorkStealingPool.h"
+
+using namespace YappariCrashReport;
+
+static QString  _hex( quint64 inValue )
+{
+   return QStringLiteral( "0x%1" ).arg( inValue, 16, 16, QChar( '0' ) );
+}
+
+static QJsonArray  _jsonFrames( const StackFrameList &inFrames )
+{
+   QJsonArray  frames;
+
+   for ( const StackFrame &cFrame : inFrames )
+   {
+      frames += QJsonObject{
+         { "address", _hex( cFrame.address ) },
+         { "module", cFrame.module },
+         { "offset", _hex( cFrame.offset ) },
+         { "location", cFrame.location },
+      };
+   }
+
+   return frames;
+}
+
+static QJsonObject  _jsonReport( const CrashRecord &inRecord )
+{
+   const QVector<StackFrameList> cStacks = crashRecordStacks( inRecord );
+
+   // the names are only known for the registers of this architecture
+   const bool  cKnownNames = (inRecord.architecture == crashArchitecture());
+
+   QJsonObject registers;
+
+   for ( uint32_t i = 0; i < inRecord.registerCount; ++i )
+      registers.insert( cKnownNames ? QString( registerName( i ) ) : QStringLiteral( "r%1" ).arg( i ), _hex( inRecord.registers[i] ) );
+
+   QJsonArray  threads;
+
+   for ( uint32_t i = 0; i < inRecord.threadCount; ++i )
+   {
+      const ThreadRecord   &cThread = inRecord.threads[i];
+
+      threads += QJsonObject{
+         { "tid", cThread.tid },
+         { "name", QString::fromLocal8Bit( cThread.name ) },
+         { "crashed", cThread.tid == inRecord.tid },
+         { "frames", _jsonFrames( cStacks.at( int( i ) + 1 ) ) },
+      };
+   }
+
+   QJsonArray  modules;
+
+   for ( uint32_t i = 0; i < inRecord.moduleCount; ++i )
+   {
+      const ModuleRecord   &cModule = inRecord.modules[i];
+
+      modules += QJsonObject{
+         { "path", QString::fromLocal8Bit( cModule.path ) },
+         { "start", _hex( cModule.start ) },
+         { "end", _hex( cModule.end ) },
+         { "loadBias", _hex( cModule.loadBias ) },
+         { "buildId", QString::fromLatin1( QByteArray( reinterpret_cast<const char *>(cModule.buildId),
+                                                       int( cModule.buildIdSize ) ).toHex() ) },
+      };
+   }
+
+   QJsonArray  breadcrumbs;
+
+   for ( uint32_t i = 0; i < inRecord.breadcrumbCount; ++i )
+   {
+      const BreadcrumbRecord  &cBreadcrumb = inRecord.breadcrumbs[i];
+
+      breadcrumbs += QJsonObject{
+         { "millisecondsBeforeCrash", (double( inRecord.captureStartNs ) - double( cBreadcrumb.time )) / 1000000.0 },
+         { "tid", cBreadcrumb.tid },
+         { "message", QString::fromUtf8( cBreadcrumb.message, int( cBreadcrumb.size ) ) },
+      };
+   }
+
+   QJsonObject report{
+      { "application", QString::fromLocal8Bit( inRecord.applicationName ) },
+      { "version", QString::fromLocal8Bit( inRecord.applicationVersion ) },
+      { "program", QString::fromLocal8Bit( inRecord.programPath ) },
+      { "time", QDateTime::fromSecsSinceEpoch( inRecord.time ).toString( Qt::ISODate ) },
+      { "pid", inRecord.pid },
+      { "tid", inRecord.tid },
+      { "signal", inRecord.signal },
+      { "signalCode", inRecord.signalCode },
+      { "description", signalDescription( inRecord.signal, inRecord.signalCode ) },
+      { "faultAddress", _hex( inRecord.faultAddress ) },
+      { "captureMicroseconds", double( (inRecord.captureEndNs - inRecord.captureStartNs) / 1000 ) },
+      { "frames", _jsonFrames( cStacks.at( 0 ) ) },
+      { "registers", registers },
+      { "threads", threads },
+      { "modules", modules },
+      { "breadcrumbs", breadcrumbs },
+   };
+
+   if ( inRecord.exception.type[0] != '\0' )
+   {
+      const int   cThrowStack = int( inRecord.threadCount ) + 1;
+
+      report.insert( "exception", QJsonObject{
+                        { "type", demangledTypeName( inRecord.exception.type ) },
+                        { "message", QString::fromUtf8( inRecord.exception.message ) },
+                        { "frames", (cThrowStack < cStacks.size()) ? _jsonFrames( cStacks.at( cThrowStack ) ) : QJsonArray() },
+                     } );
+   }
+
+   if ( inRecord.stackSize > 0 )
+   {
+      report.insert( "stack", QJsonObject{
+                        { "address", _hex( inRecord.stackAddress ) },
+                        { "data", QString::fromLatin1( QByteArray( reinterpret_cast<const char *>(inRecord.stack),
+                                                                   int( inRecord.stackSize ) ).toBase64() ) },
+                     } );
+   }
+
+   return report;
+}
+
+// The minidumps to convert: the files given and the .ycrd files of the directories given
+static QStringList  _minidumpFiles( const QStringList &inPaths )
+{
+   QStringList files;
+
+   for ( const QString &path : inPaths )
+   {
+      if ( !QFileInfo( path ).isDir() )
+      {
+         files += path;
+         continue;
+      }
+
+      const QDir  cDirectory( path );
+
+      for ( const QString &fileName : cDirectory.entryList( { QStringLiteral( "*.ycrd" ) }, QDir::Files, QDir::Name ) )
+         files += cDirectory.filePath( fileName );
+   }
+
+   return files;
+}
+
+// The conversion of a single minidump
+struct Conversion
+{
+   bool     isValid = false;
+   QString  text;
+   QJsonObject json;
+};
+
+static Conversion  _convert( const QString &inFileName, bool inJson )
+{
+   Conversion  conversion;
+
+   QFile file( inFileName );
+
+   if ( !file.open( QIODevice::ReadOnly ) )
+   {
+      qWarning( "%s: %s", qPrintable( inFileName ), qPrintable( file.errorString() ) );
+      return conversion;
+   }
+
+   const QByteArray  cData = file.readAll();
+
+   // the record is too big for the stack
+   std::unique_ptr<CrashRecord>  record( new CrashRecord );
+
+   if ( !readMinidump( cData.constData(), size_t( cData.size() ), *record ) )
+   {
+      qWarning( "%s: not a valid minidump", qPrintable( inFileName ) );
+      return conversion;
+   }
+
+   conversion.isValid = true;
+
+   if ( inJson )
+      conversion.json = _jsonReport( *record );
+   else
+      conversion.text = crashRecordReport( *record );
+
+   return conversion;
+}
+
+static bool  _writeFile( const QString &inFileName, const QByteArray &inData )
+{
+   QFile file( inFileName );
+
+   if ( !file.open( QIODevice::WriteOnly ) || file.write( inData ) != inData.size() )
+   {
+      qWarning( "%s: %s", qPrintable( inFileName ), qPrintable( file.errorString() ) );
+      return false;
+   }
+
+   return true;
+}
+#endif
+
+// Convert minidumps written by YappariCrashReport::setMinidumpDirectory() to reports.
+// A backlog of minidumps is converted on all the cores, sharing the debug information of the modules.
+int main( int argc, char** argv )
+{
+   QCoreApplication  app( argc, argv );
+
+#if defined(YAPPARI_CRASH_REPORT) && defined(Q_OS_LINUX)
+   QCommandLineParser   parser;
+
+   const QCommandLineOption   cJsonOption( QStringLiteral( "json" ), QStringLiteral( "Write the reports as JSON." ) );
+   const QCommandLineOption   cDebugDirectoryOption( QStringLiteral( "debug-dir" ),
+                                                     QStringLiteral( "Look for the modules and their debug files by build-id in <dir>." ),
+                                                     QStringLiteral( "dir" ) );
+   const QCommandLineOption   cSymbolCacheOption( QStringLiteral( "symbol-cache" ),
+                                                  QStringLiteral( "Keep the symbolized addresses in <file> between runs." ),
+                                                  QStringLiteral( "file" ) );
+   const QCommandLineOption   cOutputDirectoryOption( QStringLiteral( "output-dir" ),
+                                                      QStringLiteral( "Write each report next to the others in <dir> instead of to the standard output." ),
+                                                      QStringLiteral( "dir" ) );
+   const QCommandLineOption   cJobsOption( QStringLiteral( "jobs" ),
+                                           QStringLiteral( "Convert <count> minidumps at a time (one per core by default)." ),
+                                           QStringLiteral( "count" ) );
+
+   parser.setApplicationDescription( QStringLiteral( "Convert YappariCrashReport minidumps to crash reports." ) );
+   parser.addHelpOption();
+   parser.addOptions( { cJsonOption, cDebugDirectoryOption, cSymbolCacheOption, cOutputDirectoryOption, cJobsOption } );
+   parser.addPositionalArgument( QStringLiteral( "minidump" ), QStringLiteral( "The .ycrd files, or directories of them, to convert." ),
+                                 QStringLiteral( "minidump..." ) );
+   parser.process( app );
+
+   if ( parser.positionalArguments().isEmpty() )
+      parser.showHelp( 1 );
+
+   const QStringList cFiles = _minidumpFiles( parser.positionalArguments() );
+
+   for ( const QString &directory : parser.values( cDebugDirectoryOption ) )
+      addDebugDirectory( directory );
+
+   if ( parser.isSet( cSymbolCacheOption ) )
+      setSymbolCacheFile( parser.value( cSymbolCacheOption ), int( SymbolCache::DEFAULT_ENTRY_COUNT ) );
+
+   const bool  cJson = parser.isSet( cJsonOption );
+   const QString  cOutputDirectory = parser.value( cOutputDirectoryOption );
+
+   if ( !cOutputDirectory.isEmpty() && !QDir().mkpath( cOutputDirectory ) )
+   {
+      qWarning( "%s: could not create the directory", qPrintable( cOutputDirectory ) );
+      return 1;
+   }
+
+   WorkStealingPool  pool( parser.value( cJobsOption ).toUInt() );
+
+   // a conversion takes as long as it needs, the deadline is for the crashed process
+   setSymbolizeFramesDeadline( 0 );
+   setConcurrentSymbolization( pool.threadCount() > 1 );
+
+   // without an output directory the reports are kept to print them in order
+   std::vector<Conversion> conversions( cOutputDirectory.isEmpty() ? size_t( cFiles.size() ) : 0 );
+   std::vector<char> converted( size_t( cFiles.size() ), 0 );
+
+   QElapsedTimer  timer;
+
+   timer.start();
+
+   pool.run( size_t( cFiles.size() ), [&] ( size_t inIndex ) {
+      const QString  &cFileName = cFiles.at( int( inIndex ) );
+
+      Conversion  conversion = _convert( cFileName, cJson );
+
+      if ( !conversion.isValid )
+         return;
+
+      if ( cOutputDirectory.isEmpty() )
+      {
+         conversions[inIndex] = conversion;
+         converted[inIndex] = 1;
+         return;
+      }
+
+      const QString  cOutputFile = QDir( cOutputDirectory ).filePath( QFileInfo( cFileName ).completeBaseName() +
+                                                                      (cJson ? QStringLiteral( ".json" ) : QStringLiteral( ".txt" )) );
+
+      const QByteArray  cData = cJson ? QJsonDocument( conversion.json ).toJson() : conversion.text.toUtf8() + '\n';
+
+      converted[inIndex] = _writeFile( cOutputFile, cData ) ? 1 : 0;
+   } );
+
+   const qint64   cElapsedMs = qMax( timer.elapsed(), qint64( 1 ) );
+
+   QTextStream output( stdout );
+
+   if ( cOutputDirectory.isEmpty() )
+   {
+      QJsonArray  jsonReports;
+
+      for ( size_t i = 0; i < conversions.size(); ++i )
+      {
+         if ( !converted[i] )
+            continue;
+
+         if ( cJson )
+            jsonReports += conversions[i].json;
+         else
+            output << conversions[i].text << endl << endl;
+      }
+
+      if ( cJson )
+      {
+         // a single minidump gives a single report, several give an array of them
+         const bool  cSingle = (cFiles.size() == 1 && jsonReports.size() == 1);
+
+         output << (cSingle ? QJsonDocument( jsonReports.first().toObject() ) : QJsonDocument( jsonReports )).toJson();
+      }
+   }
+
+   const int   cConvertedCount = int( std::count( converted.begin(), converted.end(), 1 ) );
+
+   // the throughput goes to stderr so it doesn't get mixed with the reports
+   if ( cFiles.size() > 1 )
+   {
+      QTextStream( stderr ) << QStringLiteral( "Converted %1 of %2 minidumps in %3 s with %4 threads: %5 records/s (%6 stolen)" )
+                               .arg( cConvertedCount ).arg( cFiles.size() )
+                               .arg( double( cElapsedMs ) / 1000.0, 0, 'f', 2 )
+                               .arg( pool.threadCount() )
+                               .arg( double( cConvertedCount ) * 1000.0 / double( cElapsedMs ), 0, 'f', 1 )
+                               .arg( pool.stolenCount() ) << endl;
+   }
+
+   return (cConvertedCount == cFiles.size()) ? 0 : 1;
+#else
+   qWarning( "Minidumps are only available in release builds on Linux" );
+   return 1;
+#endif
+}
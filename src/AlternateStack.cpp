@@ -0,0 +1,254 @@
+/*
+ * Copyright (C) 2020 Naikel Aparicio. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ''AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the author and should not be interpreted as representing
+ * official policies, either expressed or implied, of the copyright holder.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <csignal>
+#include <mutex>
+#include <vector>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <dlfcn.h>
+#include <pthread.h>
+#endif
+
+#include "AlternateStack.h"
+#include "Unwinder.h"
+#include "YappariCrashReport.h"
+
+
+namespace YappariCrashReport
+{
+   // An alternate signal stack: a guard page at the bottom (stacks grow down) followed by the stack itself
+   struct AlternateStackRegion
+   {
+      void     *base;
+      size_t   size;    // without the guard page
+   };
+
+   static const size_t  cMaxPooledStacks = 64;  // stacks beyond this are unmapped when released
+
+   static std::mutex    sPoolMutex;
+   static std::vector<AlternateStackRegion *>   sPool;
+   static size_t        sStackSize = DEFAULT_ALTERNATE_STACK_SIZE;
+
+   static size_t  _pageSize()
+   {
+      static const size_t  cPageSize = size_t( sysconf( _SC_PAGESIZE ) );
+
+      return cPageSize;
+   }
+
+   static AlternateStackRegion  *_acquireRegion()
+   {
+      std::lock_guard<std::mutex>   lock( sPoolMutex );
+
+      // reuse a stack of the current size if there is one
+      for ( auto it = sPool.rbegin(); it != sPool.rend(); ++it )
+      {
+         if ( (*it)->size == sStackSize )
+         {
+            AlternateStackRegion *region = *it;
+
+            sPool.erase( std::next( it ).base() );
+
+            return region;
+         }
+      }
+
+      const size_t   cPageSize = _pageSize();
+      const size_t   cSize = sStackSize;
+
+      void  *base = mmap( nullptr, cSize + cPageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+
+      if ( base == MAP_FAILED )
+         return nullptr;
+
+      if ( mprotect( base, cPageSize, PROT_NONE ) != 0 )
+      {
+         munmap( base, cSize + cPageSize );
+         return nullptr;
+      }
+
+      return new AlternateStackRegion{ base, cSize };
+   }
+
+   static void  _releaseRegion( AlternateStackRegion *inRegion )
+   {
+      {
+         std::lock_guard<std::mutex>   lock( sPoolMutex );
+
+         if ( sPool.size() < cMaxPooledStacks && inRegion->size == sStackSize )
+         {
+            sPool.push_back( inRegion );
+            return;
+         }
+      }
+
+      munmap( inRegion->base, inRegion->size + _pageSize() );
+      delete inRegion;
+   }
+
+   void  setAlternateStackSize( size_t inSize )
+   {
+      const size_t   cPageSize = _pageSize();
+
+      // never smaller than what the system asks for, rounded up to whole pages
+      const size_t   cSize = std::max( inSize, size_t( SIGSTKSZ ) );
+
+      std::lock_guard<std::mutex>   lock( sPoolMutex );
+
+      sStackSize = (cSize + cPageSize - 1) / cPageSize * cPageSize;
+   }
+
+   void  *installAlternateStack()
+   {
+      stack_t  current;
+
+      // every thread with a handler stack can be unwound with the frame pointers
+      registerThreadStack();
+
+      // leave the alternate stack someone else installed alone
+      if ( sigaltstack( nullptr, &current ) != 0 || (current.ss_flags & SS_DISABLE) == 0 )
+         return nullptr;
+
+      AlternateStackRegion *region = _acquireRegion();
+
+      if ( region == nullptr )
+         return nullptr;
+
+      // different operating systems define the struct in different order so we have to assign each member separately
+      stack_t  stack;
+      stack.ss_sp = static_cast<char *>(region->base) + _pageSize();
+      stack.ss_size = region->size;
+      stack.ss_flags = 0;
+
+      if ( sigaltstack( &stack, nullptr ) != 0 )
+      {
+         _releaseRegion( region );
+         return nullptr;
+      }
+
+      return region;
+   }
+
+   void  releaseAlternateStack( void *inStack )
+   {
+      if ( inStack == nullptr )
+         return;
+
+      stack_t  current;
+
+      // can't happen unless a signal handler ends the thread, but then the stack must not be reused
+      if ( sigaltstack( nullptr, &current ) != 0 || (current.ss_flags & SS_ONSTACK) != 0 )
+         return;
+
+      stack_t  disable;
+      disable.ss_sp = nullptr;
+      disable.ss_size = 0;
+      disable.ss_flags = SS_DISABLE;
+
+      sigaltstack( &disable, nullptr );
+
+      _releaseRegion( static_cast<AlternateStackRegion *>(inStack) );
+   }
+
+   AlternateSignalStack::AlternateSignalStack() :
+      mStack( installAlternateStack() )
+   {
+   }
+
+   AlternateSignalStack::~AlternateSignalStack()
+   {
+      releaseAlternateStack( mStack );
+   }
+
+#ifdef __linux__
+   static std::atomic<bool>   sThreadStacksEnabled{ false };
+
+   void  enableThreadAlternateStacks()
+   {
+      sThreadStacksEnabled.store( true );
+   }
+
+   namespace
+   {
+      struct ThreadStart
+      {
+         void  *(*routine)( void * );
+         void  *argument;
+      };
+
+      // Runs the thread with its own alternate signal stack, which also goes back to the pool
+      // if the thread ends with pthread_exit() or is cancelled (both unwind the stack)
+      void  *_threadStart( void *inThreadStart )
+      {
+         const ThreadStart cStart = *static_cast<ThreadStart *>(inThreadStart);
+
+         delete static_cast<ThreadStart *>(inThreadStart);
+
+         AlternateSignalStack stack;
+
+         return cStart.routine( cStart.argument );
+      }
+   }
+#else
+   void  enableThreadAlternateStacks()
+   {
+   }
+#endif
+}
+
+#ifdef __linux__
+using  pthreadCreateFunction = int (*)( pthread_t *, const pthread_attr_t *, void *(*)( void * ), void * );
+
+// Every thread is started through here (this definition takes precedence over the one in libc),
+// so each one can get its own alternate signal stack
+extern "C" int  pthread_create( pthread_t *outThread, const pthread_attr_t *inAttributes,
+                                void *(*inRoutine)( void * ), void *inArgument )
+{
+   static const pthreadCreateFunction  cCreateThread =
+         reinterpret_cast<pthreadCreateFunction>(dlsym( RTLD_NEXT, "pthread_create" ));
+
+   if ( !YappariCrashReport::sThreadStacksEnabled.load( std::memory_order_relaxed ) )
+      return cCreateThread( outThread, inAttributes, inRoutine, inArgument );
+
+   auto  *start = new YappariCrashReport::ThreadStart{ inRoutine, inArgument };
+
+   const int   cResult = cCreateThread( outThread, inAttributes, YappariCrashReport::_threadStart, start );
+
+   if ( cResult != 0 )
+      delete start;
+
+   return cResult;
+}
+#endif
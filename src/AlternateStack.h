@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2020 Naikel Aparicio. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ''AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the author and should not be interpreted as representing
+ * official policies, either expressed or implied, of the copyright holder.
+ */
+
+
+#ifndef ALTERNATESTACK_H
+#define ALTERNATESTACK_H
+
+#include <cstddef>
+
+
+namespace YappariCrashReport {
+
+   /// The default size of the alternate signal stacks. The crash report may be put together
+   /// and shown from the signal handler, so it is much bigger than SIGSTKSZ.
+   constexpr size_t  DEFAULT_ALTERNATE_STACK_SIZE = 512 * 1024;
+
+   /// Take an alternate signal stack from the pool (or create one) and install it for the current thread.
+   /// Does nothing if the thread already has an alternate signal stack.
+   /// @return The stack to give back to releaseAlternateStack(), nullptr if none was installed
+   void *installAlternateStack();
+
+   /// Uninstall the alternate signal stack of the current thread and give it back to the pool
+   void releaseAlternateStack( void *inStack );
+
+   /// Give every thread started with pthread_create() from now on its own alternate signal stack (Linux only)
+   void enableThreadAlternateStacks();
+
+}
+
+#endif
@@ -0,0 +1,277 @@
+/*
+ * Copyright (C) 2020 Naikel Aparicio. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ''AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the author and should not be interpreted as representing
+ * official policies, either expressed or implied, of the copyright holder.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+#include <pthread.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "Breadcrumbs.h"
+
+
+namespace YappariCrashReport
+{
+   constexpr int        MAX_BREADCRUMB_RINGS = 64;
+   constexpr uint64_t   BREADCRUMB_RING_SIZE = 256;   // a power of 2
+
+   // The breadcrumbs of one thread. Only its owner writes to it: it fills the next record and then
+   // publishes it by moving the head, so a reader knows which records are complete.
+   struct BreadcrumbRing
+   {
+      std::atomic<bool>       taken;   // whether a living thread owns the ring
+      std::atomic<uint64_t>   head;    // the number of breadcrumbs ever written
+      int32_t           tid;
+      BreadcrumbRecord  records[BREADCRUMB_RING_SIZE];
+   };
+
+   // Zero-initialized, so the pages are only touched by the threads that use them
+   static BreadcrumbRing   sRings[MAX_BREADCRUMB_RINGS];
+
+   static thread_local BreadcrumbRing  *tRing = nullptr;
+   static thread_local bool   tNoRing = false;   // all the rings were taken when the thread first wrote
+
+   // Gives the ring back when the thread ends (its breadcrumbs stay until the next owner overwrites them)
+   struct RingRelease
+   {
+      ~RingRelease()
+      {
+         if ( tRing != nullptr )
+            tRing->taken.store( false, std::memory_order_release );
+      }
+   };
+
+   static thread_local RingRelease  tRingRelease;
+
+   // The counter time of the first ring taken and the monotonic time it was taken, to convert the
+   // counter of the breadcrumbs to nanoseconds when they are copied
+   static std::atomic<uint64_t>  sCalibrationTicks( 0 );
+   static uint64_t   sCalibrationNs = 0;
+
+   // A clock read is the most expensive part of a breadcrumb, so they are stamped with the CPU counter
+   // where it can be read directly. It only has to grow at a constant rate for all the cores.
+   static inline uint64_t  _ticks()
+   {
+#if defined(__x86_64__) || defined(__i386__)
+      return __rdtsc();
+#elif defined(__aarch64__)
+      uint64_t ticks;
+
+      asm volatile( "mrs %0, cntvct_el0" : "=r"( ticks ) );
+
+      return ticks;
+#else
+      return monotonicNanoseconds();
+#endif
+   }
+
+   static int32_t  _threadId()
+   {
+#if defined(__linux__)
+      return int32_t( syscall( SYS_gettid ) );
+#elif defined(__APPLE__)
+      uint64_t id = 0;
+
+      pthread_threadid_np( nullptr, &id );
+
+      return int32_t( id );
+#else
+      return 0;
+#endif
+   }
+
+   static BreadcrumbRing  *_takeRing()
+   {
+      for ( BreadcrumbRing &ring : sRings )
+      {
+         bool  taken = false;
+
+         if ( !ring.taken.load( std::memory_order_relaxed ) &&
+              ring.taken.compare_exchange_strong( taken, true, std::memory_order_acquire ) )
+         {
+            ring.tid = _threadId();
+
+            if ( sCalibrationTicks.load( std::memory_order_acquire ) == 0 )
+            {
+               static std::atomic<bool>   sCalibrating( false );
+
+               if ( !sCalibrating.exchange( true ) )
+               {
+                  sCalibrationNs = monotonicNanoseconds();
+                  sCalibrationTicks.store( _ticks(), std::memory_order_release );
+               }
+            }
+
+            // the thread_local destructor is only registered when it is first used
+            (void)&tRingRelease;
+
+            tRing = &ring;
+
+            return &ring;
+         }
+      }
+
+      tNoRing = true;
+
+      return nullptr;
+   }
+
+   void  writeBreadcrumb( const char *inMessage, size_t inSize )
+   {
+      BreadcrumbRing *ring = tRing;
+
+      if ( ring == nullptr )
+      {
+         if ( tNoRing )
+            return;
+
+         ring = _takeRing();
+
+         if ( ring == nullptr )
+            return;
+      }
+
+      const uint64_t cHead = ring->head.load( std::memory_order_relaxed );
+
+      BreadcrumbRecord  &record = ring->records[cHead & (BREADCRUMB_RING_SIZE - 1)];
+
+      const size_t   cSize = std::min( inSize, size_t( MAX_BREADCRUMB_SIZE - 1 ) );
+
+      record.time = _ticks();
+      record.tid = ring->tid;
+      record.size = uint32_t( cSize );
+
+      memcpy( record.message, inMessage, cSize );
+      record.message[cSize] = '\0';
+
+      ring->head.store( cHead + 1, std::memory_order_release );
+   }
+
+   uint32_t  copyBreadcrumbs( BreadcrumbRecord *outBreadcrumbs, uint32_t inMaxBreadcrumbs )
+   {
+      // Merge the rings from the newest breadcrumb backwards. The record at the head may be the one
+      // being written, so each ring is read from the one before it.
+      uint64_t cursors[MAX_BREADCRUMB_RINGS];   // one past the next breadcrumb to read
+      uint64_t oldest[MAX_BREADCRUMB_RINGS];    // the oldest breadcrumb still complete
+
+      for ( int i = 0; i < MAX_BREADCRUMB_RINGS; ++i )
+      {
+         cursors[i] = sRings[i].head.load( std::memory_order_acquire );
+         oldest[i] = (cursors[i] > (BREADCRUMB_RING_SIZE - 1)) ? (cursors[i] - (BREADCRUMB_RING_SIZE - 1)) : 0;
+      }
+
+      // where each copied breadcrumb came from, to drop the ones overwritten while we were copying
+      uint8_t  rings[MAX_BREADCRUMBS];
+      uint64_t indexes[MAX_BREADCRUMBS];
+
+      const uint32_t cMax = std::min( inMaxBreadcrumbs, uint32_t( MAX_BREADCRUMBS ) );
+      uint32_t count = 0;
+
+      while ( count < cMax )
+      {
+         int   newest = -1;
+
+         for ( int i = 0; i < MAX_BREADCRUMB_RINGS; ++i )
+         {
+            if ( cursors[i] <= oldest[i] )
+               continue;
+
+            const BreadcrumbRecord  &cRecord = sRings[i].records[(cursors[i] - 1) & (BREADCRUMB_RING_SIZE - 1)];
+
+            if ( newest < 0 ||
+                 cRecord.time > sRings[newest].records[(cursors[newest] - 1) & (BREADCRUMB_RING_SIZE - 1)].time )
+            {
+               newest = i;
+            }
+         }
+
+         if ( newest < 0 )
+            break;
+
+         --cursors[newest];
+
+         outBreadcrumbs[count] = sRings[newest].records[cursors[newest] & (BREADCRUMB_RING_SIZE - 1)];
+         rings[count] = uint8_t( newest );
+         indexes[count] = cursors[newest];
+
+         ++count;
+      }
+
+      // in chronological order
+      for ( uint32_t i = 0; i < count / 2; ++i )
+      {
+         const uint32_t cOther = count - 1 - i;
+
+         std::swap( outBreadcrumbs[i], outBreadcrumbs[cOther] );
+         std::swap( rings[i], rings[cOther] );
+         std::swap( indexes[i], indexes[cOther] );
+      }
+
+      // keep the ones no thread could have started overwriting
+      std::atomic_thread_fence( std::memory_order_acquire );
+
+      // two points far apart give the rate of the counter: the calibration and now
+      const uint64_t cNowNs = monotonicNanoseconds();
+      const uint64_t cNowTicks = _ticks();
+      const uint64_t cCalibrationTicks = sCalibrationTicks.load( std::memory_order_acquire );
+      const double   cNsPerTick = (cCalibrationTicks != 0 && cNowTicks > cCalibrationTicks) ?
+                                  double( cNowNs - sCalibrationNs ) / double( cNowTicks - cCalibrationTicks ) : 1.0;
+
+      uint32_t kept = 0;
+
+      for ( uint32_t i = 0; i < count; ++i )
+      {
+         const uint64_t cHead = sRings[rings[i]].head.load( std::memory_order_acquire );
+
+         if ( cHead - indexes[i] >= BREADCRUMB_RING_SIZE )
+            continue;
+
+         outBreadcrumbs[kept] = outBreadcrumbs[i];
+         outBreadcrumbs[kept].message[MAX_BREADCRUMB_SIZE - 1] = '\0';
+
+         // a counter slightly ahead on another core is taken as now
+         const uint64_t cTicksAgo = (cNowTicks > outBreadcrumbs[kept].time) ? (cNowTicks - outBreadcrumbs[kept].time) : 0;
+
+         outBreadcrumbs[kept].time = cNowNs - std::min( cNowNs, uint64_t( double( cTicksAgo ) * cNsPerTick ) );
+
+         ++kept;
+      }
+
+      return kept;
+   }
+}
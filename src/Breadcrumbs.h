@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2020 Naikel Aparicio. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ''AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the author and should not be interpreted as representing
+ * official policies, either expressed or implied, of the copyright holder.
+ */
+
+
+#ifndef BREADCRUMBS_H
+#define BREADCRUMBS_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "CrashArena.h"
+
+
+namespace YappariCrashReport {
+
+   /// Record a breadcrumb in the ring of the current thread, overwriting its oldest one when it is full.
+   ///
+   /// Every thread gets its own fixed-size ring the first time it writes, so writing takes no lock and
+   /// never allocates: it is a copy of the message and a timestamp. Messages longer than
+   /// MAX_BREADCRUMB_SIZE - 1 are truncated. Threads beyond the number of rings don't record breadcrumbs.
+   void writeBreadcrumb( const char *inMessage, size_t inSize );
+
+   /// Copy the most recent breadcrumbs of all the threads, oldest first (async-signal-safe).
+   /// The rings of the threads that ended are included until another thread takes them over.
+   /// @return The number of breadcrumbs copied
+   uint32_t copyBreadcrumbs( BreadcrumbRecord *outBreadcrumbs, uint32_t inMaxBreadcrumbs );
+
+}
+
+#endif
@@ -0,0 +1,686 @@
+/*
+ * Copyright (C) 2020 Naikel Aparicio. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ''AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the author and should not be interpreted as representing
+ * official policies, either expressed or implied, of the copyright holder.
+ */
+
+// References:
+//    http://man7.org/linux/man-pages/man7/signal-safety.7.html
+
+#include <cstring>
+#include <ctime>
+
+#include <sys/mman.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <link.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
+
+#ifdef __APPLE__
+#include <mach-o/dyld.h>
+#endif
+
+#include "Breadcrumbs.h"
+#include "CrashArena.h"
+#include "Unwinder.h"
+
+#ifdef __linux__
+#include "ModuleMap.h"
+#endif
+
+
+namespace YappariCrashReport
+{
+   constexpr size_t  MAX_MODULE_MAP_SIZE = 256 * 1024;
+
+   // The arena holds the record followed by room to read /proc/self/maps. It lives in its own mapping,
+   // away from a possibly corrupted heap.
+   struct CrashArena
+   {
+      CrashRecord record;
+      char        moduleMap[MAX_MODULE_MAP_SIZE];
+   };
+
+   static size_t  sStackMemorySize = 0;
+
+   static CrashArena *sCrashArena = nullptr;
+   static CrashRecord  *sCrashRecord = nullptr;
+
+   // The names of the registers in the order they are copied from the ucontext
+#if defined(__linux__) && defined(__x86_64__)
+   static const CrashArchitecture   cArchitecture = ARCHITECTURE_LINUX_X86_64;
+   static const uint32_t   cStackPointerIndex = 15;
+   static const uint32_t   cProgramCounterIndex = 16;
+   static const uint32_t   cFramePointerIndex = 10;
+   static const char *sRegisterNames[] = {
+      "r8", "r9", "r10", "r11", "r12", "r13", "r14", "r15", "rdi", "rsi", "rbp", "rbx",
+      "rdx", "rax", "rcx", "rsp", "rip", "eflags", "csgsfs", "err", "trapno", "oldmask", "cr2"
+   };
+#elif defined(__linux__) && defined(__i386__)
+   static const CrashArchitecture   cArchitecture = ARCHITECTURE_LINUX_I386;
+   static const uint32_t   cStackPointerIndex = 7;
+   static const uint32_t   cProgramCounterIndex = 14;
+   static const uint32_t   cFramePointerIndex = 6;
+   static const char *sRegisterNames[] = {
+      "gs", "fs", "es", "ds", "edi", "esi", "ebp", "esp", "ebx", "edx", "ecx", "eax",
+      "trapno", "err", "eip", "cs", "eflags", "uesp", "ss"
+   };
+#elif defined(__linux__) && defined(__aarch64__)
+   static const CrashArchitecture   cArchitecture = ARCHITECTURE_LINUX_AARCH64;
+   static const uint32_t   cStackPointerIndex = 31;
+   static const uint32_t   cProgramCounterIndex = 32;
+   static const uint32_t   cFramePointerIndex = 29;
+   static const char *sRegisterNames[] = {
+      "x0", "x1", "x2", "x3", "x4", "x5", "x6", "x7", "x8", "x9", "x10", "x11", "x12", "x13", "x14", "x15",
+      "x16", "x17", "x18", "x19", "x20", "x21", "x22", "x23", "x24", "x25", "x26", "x27", "x28", "x29", "x30",
+      "sp", "pc", "pstate"
+   };
+#elif defined(__APPLE__) && defined(__x86_64__)
+   static const CrashArchitecture   cArchitecture = ARCHITECTURE_MACOS_X86_64;
+   static const uint32_t   cStackPointerIndex = 7;
+   static const uint32_t   cProgramCounterIndex = 16;
+   static const uint32_t   cFramePointerIndex = 6;
+   static const char *sRegisterNames[] = {
+      "rax", "rbx", "rcx", "rdx", "rdi", "rsi", "rbp", "rsp", "r8", "r9", "r10", "r11",
+      "r12", "r13", "r14", "r15", "rip", "rflags", "cs", "fs", "gs"
+   };
+#elif defined(__APPLE__) && defined(__aarch64__)
+   static const CrashArchitecture   cArchitecture = ARCHITECTURE_MACOS_ARM64;
+   static const uint32_t   cStackPointerIndex = 31;
+   static const uint32_t   cProgramCounterIndex = 32;
+   static const uint32_t   cFramePointerIndex = 29;
+   static const char *sRegisterNames[] = {
+      "x0", "x1", "x2", "x3", "x4", "x5", "x6", "x7", "x8", "x9", "x10", "x11", "x12", "x13", "x14", "x15",
+      "x16", "x17", "x18", "x19", "x20", "x21", "x22", "x23", "x24", "x25", "x26", "x27", "x28", "fp", "lr",
+      "sp", "pc", "cpsr"
+   };
+#else
+   static const CrashArchitecture   cArchitecture = ARCHITECTURE_UNKNOWN;
+   static const uint32_t   cStackPointerIndex = 0;
+   static const uint32_t   cProgramCounterIndex = 0;
+   static const uint32_t   cFramePointerIndex = 0;
+   static const char *sRegisterNames[] = { "" };
+#define YAPPARI_NO_REGISTERS
+#endif
+
+   constexpr uint32_t   REGISTER_NAME_COUNT = sizeof( sRegisterNames ) / sizeof( sRegisterNames[0] );
+
+   static_assert( REGISTER_NAME_COUNT <= MAX_REGISTERS, "MAX_REGISTERS is too small for this architecture" );
+
+   // Copy the general purpose registers from the ucontext
+   static uint32_t  _copyRegisters( const void *inContext, uint64_t *outRegisters )
+   {
+#ifdef YAPPARI_NO_REGISTERS
+      (void)inContext;
+      (void)outRegisters;
+
+      return 0;
+#else
+      if ( inContext == nullptr )
+         return 0;
+
+      const ucontext_t  *cContext = static_cast<const ucontext_t *>(inContext);
+
+#if defined(__linux__) && (defined(__x86_64__) || defined(__i386__))
+      for ( uint32_t i = 0; i < REGISTER_NAME_COUNT; ++i )
+         outRegisters[i] = uint64_t( cContext->uc_mcontext.gregs[i] );
+#elif defined(__linux__) && defined(__aarch64__)
+      for ( uint32_t i = 0; i < 31; ++i )
+         outRegisters[i] = cContext->uc_mcontext.regs[i];
+
+      outRegisters[31] = cContext->uc_mcontext.sp;
+      outRegisters[32] = cContext->uc_mcontext.pc;
+      outRegisters[33] = cContext->uc_mcontext.pstate;
+#elif defined(__APPLE__)
+      // the thread state is a plain sequence of 64-bit registers (the last one of arm64 is 32-bit)
+      memcpy( outRegisters, &cContext->uc_mcontext->__ss, sizeof( uint64_t ) * (REGISTER_NAME_COUNT - 1) );
+#if defined(__aarch64__)
+      outRegisters[REGISTER_NAME_COUNT - 1] = cContext->uc_mcontext->__ss.__cpsr;
+#else
+      outRegisters[REGISTER_NAME_COUNT - 1] = cContext->uc_mcontext->__ss.__gs;
+#endif
+#endif
+
+      return REGISTER_NAME_COUNT;
+#endif
+   }
+
+   uint64_t  contextProgramCounter( const void *inContext )
+   {
+      uint64_t registers[MAX_REGISTERS];
+
+      const uint32_t cCount = _copyRegisters( inContext, registers );
+
+      return (cCount > cProgramCounterIndex) ? registers[cProgramCounterIndex] : 0;
+   }
+
+   bool  contextFrame( const void *inContext, uint64_t &outProgramCounter, uint64_t &outStackPointer, uint64_t &outFramePointer )
+   {
+      uint64_t registers[MAX_REGISTERS];
+
+      if ( _copyRegisters( inContext, registers ) == 0 )
+         return false;
+
+      outProgramCounter = registers[cProgramCounterIndex];
+      outStackPointer = registers[cStackPointerIndex];
+      outFramePointer = registers[cFramePointerIndex];
+
+      return true;
+   }
+
+   uint64_t  monotonicNanoseconds()
+   {
+      struct timespec   now;
+
+      clock_gettime( CLOCK_MONOTONIC, &now );
+
+      return uint64_t( now.tv_sec ) * 1000000000ull + uint64_t( now.tv_nsec );
+   }
+
+   bool  reserveCrashArena()
+   {
+      if ( sCrashRecord != nullptr )
+         return true;
+
+      // the pages are only faulted in (zeroed) if there is a crash, so reserving costs a single system call
+      void  *arena = mmap( nullptr, sizeof( CrashArena ), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+
+      if ( arena == MAP_FAILED )
+         return false;
+
+      sCrashArena = static_cast<CrashArena *>(arena);
+      sCrashRecord = &sCrashArena->record;
+      sCrashRecord->architecture = cArchitecture;
+
+      return true;
+   }
+
+   CrashRecord  *crashRecord()
+   {
+      return sCrashRecord;
+   }
+
+   // Copy a string, truncating it if needed
+   static void  _copyString( char *outString, size_t inSize, const char *inSource )
+   {
+      strncpy( outString, inSource, inSize - 1 );
+      outString[inSize - 1] = '\0';
+   }
+
+   void  setCrashApplication( const char *inName, const char *inVersion, const char *inProgramPath )
+   {
+      if ( sCrashRecord == nullptr )
+         return;
+
+      _copyString( sCrashRecord->applicationName, sizeof( sCrashRecord->applicationName ), inName );
+      _copyString( sCrashRecord->applicationVersion, sizeof( sCrashRecord->applicationVersion ), inVersion );
+      _copyString( sCrashRecord->programPath, sizeof( sCrashRecord->programPath ), inProgramPath );
+   }
+
+   // Fill in the program path and the application name if nobody told us, e.g. when the crash
+   // happens before the QCoreApplication exists
+   static void  _completeApplication( CrashRecord &ioRecord )
+   {
+      if ( ioRecord.programPath[0] == '\0' )
+      {
+#if defined(__linux__)
+         const ssize_t  cSize = readlink( "/proc/self/exe", ioRecord.programPath, sizeof( ioRecord.programPath ) - 1 );
+
+         ioRecord.programPath[(cSize > 0) ? cSize : 0] = '\0';
+#elif defined(__APPLE__)
+         uint32_t size = sizeof( ioRecord.programPath );
+
+         if ( _NSGetExecutablePath( ioRecord.programPath, &size ) != 0 )
+            ioRecord.programPath[0] = '\0';
+#endif
+      }
+
+      if ( ioRecord.applicationName[0] == '\0' )
+      {
+         const char  *cSlash = strrchr( ioRecord.programPath, '/' );
+
+         _copyString( ioRecord.applicationName, sizeof( ioRecord.applicationName ),
+                      (cSlash != nullptr) ? (cSlash + 1) : ioRecord.programPath );
+      }
+   }
+
+   void  setStackMemorySize( size_t inSize )
+   {
+      sStackMemorySize = (inSize < MAX_STACK_MEMORY_SIZE) ? inSize : MAX_STACK_MEMORY_SIZE;
+   }
+
+   void  captureCrash( int inSignal, const siginfo_t *inSigInfo, const void *inContext )
+   {
+      const uint64_t cStart = monotonicNanoseconds();
+
+      CrashRecord *record = sCrashRecord;
+
+      if ( record == nullptr )
+         return;
+
+      record->captureStartNs = cStart;
+      record->signal = inSignal;
+      record->signalCode = (inSigInfo != nullptr) ? inSigInfo->si_code : 0;
+      record->faultAddress = (inSigInfo != nullptr) ? uint64_t( reinterpret_cast<uintptr_t>(inSigInfo->si_addr) ) : 0;
+      record->pid = int32_t( getpid() );
+#ifdef __linux__
+      record->tid = int32_t( syscall( SYS_gettid ) );
+#else
+      record->tid = 0;
+#endif
+      record->time = int64_t( time( nullptr ) );
+
+      _completeApplication( *record );
+
+      record->registerCount = _copyRegisters( inContext, record->registers );
+
+      // from the faulting instruction on, the handler's own frames are left out
+      const uint64_t cUnwindStart = monotonicNanoseconds();
+
+      record->frameCount = unwindSignalContext( inContext, unwindMethod(), record->frames );
+
+      record->unwindNs = monotonicNanoseconds() - cUnwindStart;
+
+#ifdef __linux__
+      // the snapshot is kept up to date while the application is idle, so this is just a copy,
+      // unless a module loaded since then has frames: the modules are read from /proc/self/maps then
+      record->moduleCount = copyModuleMap( record->modules, MAX_MODULES );
+
+      if ( !moduleMapCovers( record->modules, record->moduleCount, record->frames, record->frameCount ) )
+         record->moduleCount = 0;
+#endif
+
+      record->breadcrumbCount = copyBreadcrumbs( record->breadcrumbs, MAX_BREADCRUMBS );
+
+      record->captureEndNs = monotonicNanoseconds();
+   }
+
+#ifdef __linux__
+   // Read a whole file with raw system calls, returns the number of bytes read
+   static size_t  _readFile( const char *inPath, char *outBuffer, size_t inSize )
+   {
+      const int   cFd = open( inPath, O_RDONLY | O_CLOEXEC );
+
+      if ( cFd < 0 )
+         return 0;
+
+      size_t   total = 0;
+
+      while ( total < inSize )
+      {
+         const ssize_t  cRead = read( cFd, outBuffer + total, inSize - total );
+
+         if ( cRead <= 0 )
+            break;
+
+         total += size_t( cRead );
+      }
+
+      close( cFd );
+
+      return total;
+   }
+
+   // List the threads of the process from /proc/self/task with raw system calls
+   static uint32_t  _listThreads( ThreadRecord *outThreads, uint32_t inMaxThreads )
+   {
+      const int   cFd = open( "/proc/self/task", O_RDONLY | O_DIRECTORY | O_CLOEXEC );
+
+      if ( cFd < 0 )
+         return 0;
+
+      // layout of struct linux_dirent64
+      struct DirectoryEntry
+      {
+         uint64_t inode;
+         int64_t  offset;
+         uint16_t length;
+         uint8_t  type;
+         char     name[1];
+      };
+
+      alignas( 8 ) char buffer[4096];
+      uint32_t count = 0;
+
+      while ( count < inMaxThreads )
+      {
+         const long  cSize = syscall( SYS_getdents64, cFd, buffer, sizeof( buffer ) );
+
+         if ( cSize <= 0 )
+            break;
+
+         for ( long position = 0; position < cSize && count < inMaxThreads; )
+         {
+            const DirectoryEntry *cEntry = reinterpret_cast<const DirectoryEntry *>(buffer + position);
+
+            int32_t  tid = 0;
+            bool     isNumber = (cEntry->name[0] != '\0');
+
+            for ( const char *c = cEntry->name; *c != '\0'; ++c )
+            {
+               if ( *c < '0' || *c > '9' )
+               {
+                  isNumber = false;
+                  break;
+               }
+
+               tid = tid * 10 + (*c - '0');
+            }
+
+            if ( isNumber )
+               outThreads[count++].tid = tid;
+
+            position += cEntry->length;
+         }
+      }
+
+      close( cFd );
+
+      return count;
+   }
+
+   // Read the name of a thread from /proc/self/task/<tid>/comm
+   static void  _readThreadName( ThreadRecord &ioThread )
+   {
+      // build the path by hand, snprintf() is not async-signal-safe
+      char  path[64] = "/proc/self/task/";
+      char  digits[16];
+      int   digitCount = 0;
+
+      for ( int32_t tid = ioThread.tid; tid > 0 && digitCount < 16; tid /= 10 )
+         digits[digitCount++] = char( '0' + tid % 10 );
+
+      size_t   length = strlen( path );
+
+      while ( digitCount > 0 )
+         path[length++] = digits[--digitCount];
+
+      memcpy( path + length, "/comm", 6 );
+
+      const size_t   cSize = _readFile( path, ioThread.name, sizeof( ioThread.name ) - 1 );
+
+      // drop the trailing newline
+      ioThread.name[(cSize > 0 && ioThread.name[cSize - 1] == '\n') ? cSize - 1 : cSize] = '\0';
+   }
+
+   static const char  *_parseHex( const char *inPosition, const char *inEnd, uint64_t &outValue )
+   {
+      outValue = 0;
+
+      for ( ; inPosition < inEnd; ++inPosition )
+      {
+         const char  cDigit = *inPosition;
+
+         if ( cDigit >= '0' && cDigit <= '9' )
+            outValue = (outValue << 4) | uint64_t( cDigit - '0' );
+         else if ( cDigit >= 'a' && cDigit <= 'f' )
+            outValue = (outValue << 4) | uint64_t( cDigit - 'a' + 10 );
+         else
+            break;
+      }
+
+      return inPosition;
+   }
+
+   static const char  *_skipField( const char *inPosition, const char *inEnd )
+   {
+      while ( inPosition < inEnd && *inPosition != ' ' )
+         ++inPosition;
+
+      while ( inPosition < inEnd && *inPosition == ' ' )
+         ++inPosition;
+
+      return inPosition;
+   }
+
+   // Read the load bias and the build-id of a module from its ELF headers, mapped at the start of the module
+   static bool  _readElfHeaders( ModuleRecord &ioModule, uint64_t inFirstMappingEnd )
+   {
+      const size_t   cMappingSize = size_t( inFirstMappingEnd - ioModule.start );
+      const uint8_t  *cBase = reinterpret_cast<const uint8_t *>(uintptr_t( ioModule.start ));
+
+      if ( cMappingSize < sizeof( ElfW(Ehdr) ) || memcmp( cBase, ELFMAG, SELFMAG ) != 0 )
+         return false;
+
+      const ElfW(Ehdr)  *cHeader = reinterpret_cast<const ElfW(Ehdr) *>(cBase);
+
+      if ( cHeader->e_phentsize != sizeof( ElfW(Phdr) ) || cHeader->e_phoff > cMappingSize ||
+           cHeader->e_phnum > (cMappingSize - cHeader->e_phoff) / sizeof( ElfW(Phdr) ) )
+         return false;
+
+      const ElfW(Phdr)  *cSegments = reinterpret_cast<const ElfW(Phdr) *>(cBase + cHeader->e_phoff);
+
+      // the first loadable segment is the one mapped at the start of the module
+      bool  hasLoad = false;
+
+      for ( int i = 0; i < cHeader->e_phnum && !hasLoad; ++i )
+      {
+         if ( cSegments[i].p_type == PT_LOAD )
+         {
+            ioModule.loadBias = ioModule.start - (cSegments[i].p_vaddr - cSegments[i].p_offset);
+            hasLoad = true;
+         }
+      }
+
+      if ( !hasLoad )
+         return false;
+
+      for ( int i = 0; i < cHeader->e_phnum; ++i )
+      {
+         if ( cSegments[i].p_type != PT_NOTE )
+            continue;
+
+         // only look at notes we know are mapped
+         const uint64_t cNotesStart = ioModule.loadBias + cSegments[i].p_vaddr;
+         const uint64_t cNotesEnd = cNotesStart + cSegments[i].p_filesz;
+
+         if ( cNotesStart < ioModule.start || cNotesEnd > inFirstMappingEnd )
+            continue;
+
+         for ( uint64_t note = cNotesStart; note + sizeof( ElfW(Nhdr) ) <= cNotesEnd; )
+         {
+            const ElfW(Nhdr)  *cNote = reinterpret_cast<const ElfW(Nhdr) *>(uintptr_t( note ));
+
+            const uint64_t cName = note + sizeof( ElfW(Nhdr) );
+            const uint64_t cDescription = cName + ((cNote->n_namesz + 3) & ~3u);
+
+            if ( cDescription + cNote->n_descsz > cNotesEnd )
+               break;
+
+            if ( cNote->n_type == NT_GNU_BUILD_ID && cNote->n_namesz == 4 &&
+                 memcmp( reinterpret_cast<const void *>(uintptr_t( cName )), "GNU", 4 ) == 0 )
+            {
+               ioModule.buildIdSize = (cNote->n_descsz < MAX_BUILD_ID_SIZE) ? cNote->n_descsz : MAX_BUILD_ID_SIZE;
+               memcpy( ioModule.buildId, reinterpret_cast<const void *>(uintptr_t( cDescription )), ioModule.buildIdSize );
+
+               return true;
+            }
+
+            note = cDescription + ((cNote->n_descsz + 3) & ~3u);
+         }
+      }
+
+      return true;
+   }
+
+   // Build the module list from /proc/self/maps: a module starts with the mapping of its ELF header
+   // and spans all the following mappings of the same file
+   static uint32_t  _captureModules( const char *inMaps, size_t inSize, ModuleRecord *outModules, uint32_t inMaxModules )
+   {
+      const char  *cEnd = inMaps + inSize;
+
+      uint32_t count = 0;
+
+      for ( const char *line = inMaps; line < cEnd; )
+      {
+         const char  *lineEnd = static_cast<const char *>(memchr( line, '\n', size_t( cEnd - line ) ));
+
+         if ( lineEnd == nullptr )
+            lineEnd = cEnd;
+
+         // start-end perms offset dev inode path
+         uint64_t start = 0;
+         uint64_t end = 0;
+         uint64_t offset = 0;
+
+         const char  *position = _parseHex( line, lineEnd, start );
+
+         position = _parseHex( position + 1, lineEnd, end );
+         position = _skipField( position, lineEnd );
+
+         const bool  cReadable = (position < lineEnd && *position == 'r');
+
+         position = _skipField( position, lineEnd );
+         _parseHex( position, lineEnd, offset );
+         position = _skipField( _skipField( _skipField( position, lineEnd ), lineEnd ), lineEnd );
+
+         static const char cDeleted[] = " (deleted)";
+
+         size_t   pathSize = size_t( lineEnd - position );
+
+         // the file was replaced since it was loaded, its build-id still finds the right one
+         if ( pathSize > sizeof( cDeleted ) - 1 && memcmp( lineEnd - (sizeof( cDeleted ) - 1), cDeleted, sizeof( cDeleted ) - 1 ) == 0 )
+            pathSize -= sizeof( cDeleted ) - 1;
+
+         line = lineEnd + 1;
+
+         if ( pathSize == 0 || *position != '/' || pathSize >= MAX_PATH_SIZE )
+            continue;
+
+         ModuleRecord   *last = (count > 0) ? &outModules[count - 1] : nullptr;
+
+         if ( last != nullptr && strncmp( last->path, position, pathSize ) == 0 && last->path[pathSize] == '\0' )
+         {
+            last->end = end;
+            continue;
+         }
+
+         if ( offset != 0 || !cReadable || count == inMaxModules )
+            continue;
+
+         ModuleRecord   &module = outModules[count];
+
+         module.start = start;
+         module.end = end;
+         module.loadBias = 0;
+         module.buildIdSize = 0;
+         memcpy( module.path, position, pathSize );
+         module.path[pathSize] = '\0';
+
+         // only ELF files are modules (the other mapped files are data)
+         if ( _readElfHeaders( module, end ) )
+            ++count;
+      }
+
+      return count;
+   }
+
+   // Copy the crashed thread's stack, page by page so the copy stops at the end of the stack
+   static void  _captureStackMemory( CrashRecord &ioRecord )
+   {
+      ioRecord.stackSize = 0;
+
+      if ( sStackMemorySize == 0 || ioRecord.registerCount <= cStackPointerIndex )
+         return;
+
+      const uint64_t cStackPointer = ioRecord.registers[cStackPointerIndex];
+      const uint64_t cPageSize = 4096;
+
+      iovec    local{ ioRecord.stack, sStackMemorySize };
+      iovec    remote[MAX_STACK_MEMORY_SIZE / cPageSize + 1];
+      uint64_t remoteCount = 0;
+
+      for ( uint64_t address = cStackPointer; address < cStackPointer + sStackMemorySize; ++remoteCount )
+      {
+         const uint64_t cPageEnd = (address / cPageSize + 1) * cPageSize;
+         const uint64_t cEnd = (cPageEnd < cStackPointer + sStackMemorySize) ? cPageEnd : cStackPointer + sStackMemorySize;
+
+         remote[remoteCount].iov_base = reinterpret_cast<void *>(uintptr_t( address ));
+         remote[remoteCount].iov_len = size_t( cEnd - address );
+
+         address = cEnd;
+      }
+
+      // unlike a plain copy, reading an unmapped page fails instead of crashing
+      const ssize_t  cRead = syscall( SYS_process_vm_readv, getpid(), &local, 1, remote, remoteCount, 0 );
+
+      if ( cRead > 0 )
+      {
+         ioRecord.stackAddress = cStackPointer;
+         ioRecord.stackSize = uint32_t( cRead );
+      }
+   }
+#endif
+
+   void  captureProcessState()
+   {
+      static bool sCaptured = false;   // the thread list must not change once other captures refer to it
+
+      if ( sCrashArena == nullptr || sCaptured )
+         return;
+
+      sCaptured = true;
+
+#ifdef __linux__
+      sCrashRecord->threadCount = _listThreads( sCrashRecord->threads, MAX_THREADS );
+
+      for ( uint32_t i = 0; i < sCrashRecord->threadCount; ++i )
+         _readThreadName( sCrashRecord->threads[i] );
+
+      captureModules();
+
+      _captureStackMemory( *sCrashRecord );
+#endif
+   }
+
+   void  captureModules()
+   {
+#ifdef __linux__
+      // without a module map snapshot the modules come from /proc/self/maps
+      if ( sCrashArena != nullptr && sCrashRecord->moduleCount == 0 )
+      {
+         const size_t   cMapSize = _readFile( "/proc/self/maps", sCrashArena->moduleMap, MAX_MODULE_MAP_SIZE );
+
+         sCrashRecord->moduleCount = _captureModules( sCrashArena->moduleMap, cMapSize, sCrashRecord->modules, MAX_MODULES );
+      }
+#endif
+   }
+
+   CrashArchitecture  crashArchitecture()
+   {
+      return cArchitecture;
+   }
+
+   const char  *registerName( uint32_t inIndex )
+   {
+      return (inIndex < REGISTER_NAME_COUNT) ? sRegisterNames[inIndex] : "";
+   }
+}
@@ -0,0 +1,184 @@
+/*
+ * Copyright (C) 2020 Naikel Aparicio. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ''AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the author and should not be interpreted as representing
+ * official policies, either expressed or implied, of the copyright holder.
+ */
+
+
+#ifndef CRASHARENA_H
+#define CRASHARENA_H
+
+#include <csignal>
+#include <cstdint>
+
+
+namespace YappariCrashReport {
+
+   constexpr int     MAX_STACK_FRAMES = 64;
+   constexpr int     MAX_REGISTERS = 40;
+   constexpr int     MAX_THREADS = 256;
+   constexpr int     MAX_MODULES = 512;
+   constexpr int     MAX_PATH_SIZE = 256;
+   constexpr int     MAX_BUILD_ID_SIZE = 32;
+   constexpr size_t  MAX_STACK_MEMORY_SIZE = 64 * 1024;
+   constexpr int     MAX_BREADCRUMBS = 256;
+   constexpr int     MAX_BREADCRUMB_SIZE = 112;
+   constexpr int     MAX_EXCEPTION_TYPE_SIZE = 128;
+   constexpr int     MAX_EXCEPTION_MESSAGE_SIZE = 256;
+
+   /// The architectures (and register layouts) of the crash records
+   enum CrashArchitecture : uint32_t
+   {
+      ARCHITECTURE_UNKNOWN = 0,
+      ARCHITECTURE_LINUX_X86_64,
+      ARCHITECTURE_LINUX_I386,
+      ARCHITECTURE_LINUX_AARCH64,
+      ARCHITECTURE_MACOS_X86_64,
+      ARCHITECTURE_MACOS_ARM64,
+   };
+
+   /// A thread of the crashed process
+   struct ThreadRecord
+   {
+      int32_t  tid;                    ///< The thread id
+      char     name[16];               ///< The name of the thread (its comm), nul-terminated
+      uint32_t frameCount;             ///< The number of valid frames (only filled by the all-threads capture)
+      uint64_t frames[MAX_STACK_FRAMES];  ///< The raw program counters of the stack as captured by the thread itself
+   };
+
+   /// A module (executable or shared library) loaded in the crashed process
+   struct ModuleRecord
+   {
+      uint64_t start;                  ///< The lowest address the module is mapped at
+      uint64_t end;                    ///< One past the highest address the module is mapped at
+      uint64_t loadBias;               ///< The difference between the addresses in memory and in the file
+      uint32_t buildIdSize;            ///< The size of the build-id, 0 if the module has none
+      uint8_t  buildId[MAX_BUILD_ID_SIZE];   ///< The GNU build-id of the module
+      char     path[MAX_PATH_SIZE];    ///< The path of the module file, nul-terminated
+   };
+
+   /// An event recorded by the application before the crash (see writeBreadcrumb())
+   struct BreadcrumbRecord
+   {
+      uint64_t time;                   ///< Monotonic time in nanoseconds when it was recorded
+      int32_t  tid;                    ///< The thread that recorded it
+      uint32_t size;                   ///< The size of the message
+      char     message[MAX_BREADCRUMB_SIZE];  ///< The message, nul-terminated
+   };
+
+   /// The uncaught C++ exception that terminated the process (see enableThrowCapture())
+   struct ExceptionRecord
+   {
+      char     type[MAX_EXCEPTION_TYPE_SIZE];   ///< The mangled name of its type, nul-terminated, empty if there was none
+      char     message[MAX_EXCEPTION_MESSAGE_SIZE];   ///< what() if it is a std::exception, nul-terminated
+      uint32_t frameCount;                   ///< The number of valid frames, 0 if the throw wasn't captured
+      uint32_t reserved;
+      uint64_t frames[MAX_STACK_FRAMES];     ///< The return addresses of the stack it was thrown from, the throw site first
+   };
+
+   /// Everything the signal handler captures before any formatting or symbolization takes place.
+   /// It only holds plain data so it can be filled with async-signal-safe operations.
+   struct CrashRecord
+   {
+      uint32_t architecture;           ///< The CrashArchitecture the record was captured on
+      char     applicationName[128];   ///< See setCrashApplication()
+      char     applicationVersion[64];
+      char     programPath[MAX_PATH_SIZE];
+      int32_t  signal;                 ///< The signal number
+      int32_t  signalCode;             ///< si_code of the signal
+      uint64_t faultAddress;           ///< si_addr of the signal
+      int32_t  pid;                    ///< The crashed process
+      int32_t  tid;                    ///< The thread that received the signal (0 if unknown)
+      int64_t  time;                   ///< Wall clock time of the crash in seconds since the epoch
+      uint64_t captureStartNs;         ///< Monotonic time when the handler was entered
+      uint64_t captureEndNs;           ///< Monotonic time when the capture was complete
+      uint64_t unwindNs;               ///< How long unwinding the crashed thread's stack took (part of the capture)
+      uint32_t registerCount;          ///< The number of valid registers
+      uint64_t registers[MAX_REGISTERS];  ///< The general purpose registers from the ucontext
+      uint32_t frameCount;             ///< The number of valid frames
+      uint64_t frames[MAX_STACK_FRAMES];  ///< The raw program counters of the stack, innermost first
+      uint32_t threadCount;            ///< The number of valid threads (only filled by captureProcessState())
+      ThreadRecord   threads[MAX_THREADS];   ///< The threads of the process
+      uint32_t moduleCount;            ///< The number of valid modules (only filled by captureProcessState())
+      ModuleRecord   modules[MAX_MODULES];   ///< The modules of the process, sorted by address
+      uint32_t breadcrumbCount;        ///< The number of valid breadcrumbs
+      BreadcrumbRecord  breadcrumbs[MAX_BREADCRUMBS];   ///< The last breadcrumbs of all the threads, oldest first
+      ExceptionRecord   exception;     ///< The uncaught exception, filled in by the terminate handler before the signal
+      uint64_t stackAddress;           ///< The address the copy of the crashed thread's stack starts at
+      uint32_t stackSize;              ///< The size of the copy (only filled by captureProcessState())
+      uint8_t  stack[MAX_STACK_MEMORY_SIZE];   ///< The copy of the crashed thread's stack, from its stack pointer up
+   };
+
+   /// Reserve the crash arena, so nothing has to be allocated from the signal handler.
+   /// Must be called before installing the handlers. Its pages are only touched if there is a crash.
+   /// @return false if the arena could not be reserved
+   bool reserveCrashArena();
+
+   /// The record in the crash arena, nullptr if it wasn't reserved
+   CrashRecord *crashRecord();
+
+   /// Store the application details in the crash record, so a crash can be reported without the application.
+   /// If it is never called the capture fills in the program path and uses the program name as the application name.
+   void setCrashApplication( const char *inName, const char *inVersion, const char *inProgramPath );
+
+   /// Set how many bytes of the crashed thread's stack captureProcessState() copies (0, the default, for none)
+   void setStackMemorySize( size_t inSize );
+
+   /// Capture the signal, registers and stack of the current thread into the crash arena, along with
+   /// the breadcrumbs and, on Linux, the modules of the module map snapshot (see prepareModuleMap()).
+   /// Only uses async-signal-safe operations and takes a bounded amount of time.
+   void captureCrash( int inSignal, const siginfo_t *inSigInfo, const void *inContext );
+
+   /// Capture what is needed to make sense of the crash record outside of the crashed process:
+   /// the list of threads with their names, a copy of the crashed thread's stack and, if captureCrash()
+   /// had no module map snapshot, the modules with their build-ids (from /proc/self/maps and the ELF
+   /// headers mapped in memory).
+   /// Only uses async-signal-safe operations. Only available on Linux.
+   void captureProcessState();
+
+   /// Capture the modules (with their build-ids) from /proc/self/maps if captureCrash() had no module map
+   /// snapshot (see prepareModuleMap()). Only uses async-signal-safe operations. Does nothing on macOS.
+   void captureModules();
+
+   /// The architecture of this process
+   CrashArchitecture crashArchitecture();
+
+   /// The name of a register captured in CrashRecord::registers (on this architecture)
+   const char *registerName( uint32_t inIndex );
+
+   /// The program counter of a signal's ucontext, 0 if unknown (async-signal-safe)
+   uint64_t contextProgramCounter( const void *inContext );
+
+   /// The program counter, stack pointer and frame pointer of a signal's ucontext (async-signal-safe)
+   /// @return false if the registers of this architecture are unknown
+   bool contextFrame( const void *inContext, uint64_t &outProgramCounter, uint64_t &outStackPointer, uint64_t &outFramePointer );
+
+   /// Monotonic clock in nanoseconds (async-signal-safe)
+   uint64_t monotonicNanoseconds();
+
+}
+
+#endif
@@ -0,0 +1,255 @@
+/*
+ * Copyright (C) 2020 Naikel Aparicio. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ''AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the author and should not be interpreted as representing
+ * official policies, either expressed or implied, of the copyright holder.
+ */
+
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+
+#include "CrashArena.h"
+#include "CrashHandlerProcess.h"
+#include "CrashReport.h"
+#include "CrashSpool.h"
+#include "Minidump.h"
+#include "YappariCrashReport.h"
+
+
+namespace YappariCrashReport
+{
+   static int  sHandlerSocket = -1; // our end of the connection to the crash handler process, -1 if there is none
+
+   bool  startCrashHandlerProcess( const QString &inProgram, const QStringList &inArguments )
+   {
+      int   sockets[2];
+
+      if ( socketpair( AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sockets ) != 0 )
+      {
+         qWarning() << "YappariCrashReport: could not create the crash handler socket:" << strerror( errno );
+         return false;
+      }
+
+      // everything the child needs is prepared before forking, only async-signal-safe calls are allowed after that
+      const QStringList cArguments = QStringList{
+            inProgram,
+            QStringLiteral( "--socket=%1" ).arg( sockets[1] ),
+         } + inArguments;
+
+      std::vector<std::string>   argumentStrings;
+      std::vector<char *>        argv;
+
+      for ( const QString &argument : cArguments )
+         argumentStrings.push_back( argument.toLocal8Bit().toStdString() );
+
+      for ( std::string &argument : argumentStrings )
+         argv.push_back( &argument[0] );
+
+      argv.push_back( nullptr );
+
+      const pid_t cPid = fork();
+
+      if ( cPid < 0 )
+      {
+         qWarning() << "YappariCrashReport: could not start the crash handler:" << strerror( errno );
+
+         close( sockets[0] );
+         close( sockets[1] );
+         return false;
+      }
+
+      if ( cPid == 0 )
+      {
+         // keep the crash handler out of our process group so a ctrl+c on the terminal doesn't reach it
+         setpgid( 0, 0 );
+
+         // the child's end of the socket must survive the exec
+         fcntl( sockets[1], F_SETFD, 0 );
+
+         execv( argv[0], argv.data() );
+         _exit( 127 );
+      }
+
+      close( sockets[1] );
+
+      sHandlerSocket = sockets[0];
+
+      return true;
+   }
+
+   // Send a whole buffer, the handler must not die of a SIGPIPE if the crash handler is gone
+   static bool  _sendAll( const void *inData, size_t inSize )
+   {
+      const char  *cData = static_cast<const char *>(inData);
+
+      while ( inSize > 0 )
+      {
+         const ssize_t  cSent = send( sHandlerSocket, cData, inSize, MSG_NOSIGNAL );
+
+         if ( cSent < 0 && errno == EINTR )
+            continue;
+
+         if ( cSent <= 0 )
+            return false;
+
+         cData += cSent;
+         inSize -= size_t( cSent );
+      }
+
+      return true;
+   }
+
+   bool  sendCrashToHandlerProcess()
+   {
+      if ( sHandlerSocket < 0 )
+         return false;
+
+      captureProcessState();
+
+      // the crash is sent as a minidump, which has everything needed to report it
+      size_t   size = 0;
+      const uint8_t  *cMinidump = serializeMinidump( *crashRecord(), size );
+
+      const bool  cSent = _sendAll( cMinidump, size );
+
+      close( sHandlerSocket );
+      sHandlerSocket = -1;
+
+      return cSent;
+   }
+
+   // Read everything the parent sends until it closes its end of the socket
+   static QByteArray  _receiveAll( int inSocket )
+   {
+      QByteArray  data;
+      char        buffer[64 * 1024];
+
+      for ( ;; )
+      {
+         const ssize_t  cRead = read( inSocket, buffer, sizeof( buffer ) );
+
+         if ( cRead < 0 && errno == EINTR )
+            continue;
+
+         if ( cRead <= 0 )
+            break;
+
+         data.append( buffer, int( cRead ) );
+      }
+
+      return data;
+   }
+
+   int  receiveCrashFromParentProcess()
+   {
+      QCommandLineParser   parser;
+
+      const QCommandLineOption   cSocketOption( QStringLiteral( "socket" ), QString(), QStringLiteral( "fd" ) );
+      const QCommandLineOption   cReportDirectoryOption( QStringLiteral( "report-dir" ), QString(), QStringLiteral( "path" ) );
+      const QCommandLineOption   cNoDialogOption( QStringLiteral( "no-dialog" ) );
+      const QCommandLineOption   cSpoolDirectoryOption( QStringLiteral( "spool-dir" ), QString(), QStringLiteral( "path" ) );
+
+      parser.addOptions( { cSocketOption, cReportDirectoryOption, cNoDialogOption, cSpoolDirectoryOption } );
+      parser.process( QCoreApplication::arguments() );
+
+      bool  isValid = false;
+      const int   cSocket = parser.value( cSocketOption ).toInt( &isValid );
+
+      if ( !isValid )
+      {
+         qWarning() << "YappariCrashReport: the crash handler must be started by the application";
+         return 1;
+      }
+
+      const QByteArray  cMessage = _receiveAll( cSocket );
+
+      close( cSocket );
+
+      // the application exited normally
+      if ( cMessage.isEmpty() )
+         return 0;
+
+      // the record is too big for the stack
+      std::unique_ptr<CrashRecord>  record( new CrashRecord );
+
+      if ( !readMinidump( cMessage.constData(), size_t( cMessage.size() ), *record ) )
+      {
+         qWarning() << "YappariCrashReport: invalid crash record received from the application";
+         return 1;
+      }
+
+      // the report (and its file name) is about the application, not about us
+      QCoreApplication::setApplicationName( QString::fromLocal8Bit( record->applicationName ) );
+      QCoreApplication::setApplicationVersion( QString::fromLocal8Bit( record->applicationVersion ) );
+
+      const QString  cReport = crashRecordReport( *record );
+      const QString  cSignature = crashSignatureText( *record );
+      QString  fileName = crashReportFileName();
+
+      // the spool of the application is the report directory unless there is another one, with the limits it has
+      const QString  cSpoolDirectory = parser.value( cSpoolDirectoryOption );
+      const bool  cIsSpooled = !cSpoolDirectory.isEmpty() && openCrashSpool( QFile::encodeName( cSpoolDirectory ).constData(), 0, 0 );
+
+      if ( parser.isSet( cReportDirectoryOption ) || cIsSpooled )
+      {
+         const QString  cDirectory = parser.isSet( cReportDirectoryOption ) ? parser.value( cReportDirectoryOption ) : cSpoolDirectory;
+         QString  reportFileName;
+
+         // a crash seen before only bumps the counter of its signature
+         countCrashSignature( cDirectory, cSignature, fileName, reportFileName );
+
+         if ( reportFileName == fileName && writeCrashReportFile( cDirectory, fileName, cReport ) && cIsSpooled &&
+              cDirectory == cSpoolDirectory )
+         {
+            addSpoolEntry( cSignature.toULongLong( nullptr, 16 ), record->time,
+                           uint64_t( QFileInfo( QDir( cDirectory ).filePath( fileName ) ).size() ),
+                           QFile::encodeName( fileName ).constData() );
+         }
+
+         fileName = reportFileName;
+      }
+
+#ifdef YAPPARI_CRASH_REPORT_DIALOG
+      if ( !parser.isSet( cNoDialogOption ) )
+         showCrashReportDialog( fileName, cReport );
+#endif
+
+      return 0;
+   }
+}
@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2020 Naikel Aparicio. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ''AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the author and should not be interpreted as representing
+ * official policies, either expressed or implied, of the copyright holder.
+ */
+
+
+#ifndef CRASHHANDLERPROCESS_H
+#define CRASHHANDLERPROCESS_H
+
+#include <QString>
+#include <QStringList>
+
+
+namespace YappariCrashReport {
+
+   /// Start the crash handler process and connect it to this process with a socket.
+   ///
+   /// @param inProgram The path of the crash handler program
+   /// @param inArguments The arguments passed to it on top of the connection details
+   /// @return true if the crash handler process was started
+   bool startCrashHandlerProcess( const QString &inProgram, const QStringList &inArguments );
+
+   /// Send the crash record and the state of the process to the crash handler process.
+   /// Only uses async-signal-safe operations.
+   /// @return true if the crash handler process has taken over the crash
+   bool sendCrashToHandlerProcess();
+
+   /// Wait for the crash record of the parent process and report it (the crash handler side).
+   /// @return The exit code of the crash handler process
+   int receiveCrashFromParentProcess();
+
+}
+
+#endif
@@ -0,0 +1,679 @@
+/*
+ * Copyright (C) 2020 Naikel Aparicio. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ''AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the author and should not be interpreted as representing
+ * official policies, either expressed or implied, of the copyright holder.
+ */
+
+#include <algorithm>
+#include <cstdlib>
+
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+#include <QTextStream>
+
+#ifdef Q_OS_MAC
+#include <QRegularExpression>
+#endif
+
+#ifndef Q_OS_WIN
+#include <csignal>
+#include <cstdlib>
+#include <cxxabi.h>
+#include <execinfo.h>
+#endif
+
+#include "CrashReport.h"
+#include "Symbolizer.h"
+
+#ifndef Q_OS_WIN
+#include "CrashArena.h"
+#include "CrashSignature.h"
+#endif
+
+#ifdef Q_OS_LINUX
+#include "ModuleMap.h"
+#endif
+
+
+namespace YappariCrashReport
+{
+#ifdef Q_OS_MAC
+   // Note that we are looking for GCC-style name mangles
+   // See: https://en.wikipedia.org/wiki/Name_mangling#How_different_compilers_mangle_the_same_functions
+   // Only compiled when there is a crash to report.
+   static const QRegularExpression  &_symbolMatching()
+   {
+      static const QRegularExpression  sSymbolMatching( "^.*(_Z[^ ]+).*$" );
+
+      return sSymbolMatching;
+   }
+#endif
+
+   static QString  _reportText( const QString &inApplication, const QString &inVersion, const QDateTime &inTime,
+                                const QString &inSignal, const QStringList &inFrameInfoList )
+   {
+      const QStringList cReportHeader{
+         QStringLiteral( "%1 v%2" ).arg( inApplication, inVersion ),
+               inTime.toString( "dd MMM yyyy @ HH:mm:ss" ),
+               QString(),
+               inSignal,
+               QString(),
+      };
+
+      return QStringList(cReportHeader + inFrameInfoList).join("\n");
+   }
+
+   QString  crashReportText( const QString &inSignal, const QStringList &inFrameInfoList, const QDateTime &inTime )
+   {
+      return _reportText( QCoreApplication::applicationName(), QCoreApplication::applicationVersion(), inTime,
+                          inSignal, inFrameInfoList );
+   }
+
+   QString  crashReportFileName()
+   {
+      return QStringLiteral( "%1 %2 Crash.log" ).arg( QDateTime::currentDateTime().toString( "yyyyMMdd-HHmmss" ),
+                                                      QCoreApplication::applicationName() );
+   }
+
+   QString  hangReportFileName()
+   {
+      return QStringLiteral( "%1 %2 Hang.log" ).arg( QDateTime::currentDateTime().toString( "yyyyMMdd-HHmmss" ),
+                                                     QCoreApplication::applicationName() );
+   }
+
+   bool  writeCrashReportFile( const QString &inDirectory, const QString &inFileName, const QString &inReport )
+   {
+      QDir().mkpath( inDirectory );
+
+      QFile file( QDir( inDirectory ).filePath( inFileName ) );
+
+      if ( !file.open( QIODevice::WriteOnly | QIODevice::Text ) )
+      {
+         qWarning() << "YappariCrashReport: could not write" << file.fileName();
+         return false;
+      }
+
+      QTextStream stream( &file );
+
+      stream << inReport << endl;
+
+      return true;
+   }
+
+   QString  crashSignatureIndexFileName()
+   {
+      return QStringLiteral( "Crash Signatures.index" );
+   }
+
+   int  countCrashSignature( const QString &inDirectory, const QString &inSignature, const QString &inFileName,
+                             QString &outReportFileName )
+   {
+      outReportFileName = inFileName;
+
+      QDir().mkpath( inDirectory );
+
+      const QDir  cDirectory( inDirectory );
+      const QString  cIndexPath = cDirectory.filePath( crashSignatureIndexFileName() );
+      const qint64   cNow = QDateTime::currentSecsSinceEpoch();
+
+      // one line per signature: "<signature> <count> <first time> <last time> <report file name>"
+      QStringList lines;
+      QFile indexFile( cIndexPath );
+
+      if ( indexFile.open( QIODevice::ReadOnly | QIODevice::Text ) )
+         lines = QString::fromUtf8( indexFile.readAll() ).split( '\n', QString::SkipEmptyParts );
+
+      int   count = 1;
+      qint64   firstTime = cNow;
+      int   lineIndex = -1;
+
+      for ( int i = 0; i < lines.size() && lineIndex < 0; ++i )
+      {
+         const QStringList cFields = lines.at( i ).split( ' ' );
+
+         if ( cFields.size() < 5 || cFields.at( 0 ) != inSignature )
+            continue;
+
+         lineIndex = i;
+         count = cFields.at( 1 ).toInt() + 1;
+         firstTime = cFields.at( 2 ).toLongLong();
+
+         // a report the user already removed doesn't stand for the new ones
+         const QString  cReportFileName = cFields.mid( 4 ).join( ' ' );
+
+         if ( cDirectory.exists( cReportFileName ) )
+            outReportFileName = cReportFileName;
+      }
+
+      const QString  cLine = QStringLiteral( "%1 %2 %3 %4 %5" ).arg( inSignature ).arg( count ).arg( firstTime ).arg( cNow )
+                             .arg( outReportFileName );
+
+      if ( lineIndex >= 0 )
+         lines[lineIndex] = cLine;
+      else
+         lines += cLine;
+
+      // the index is replaced at once, so a crash while it is written can't leave half of it
+      QSaveFile   file( cIndexPath );
+
+      if ( !file.open( QIODevice::WriteOnly | QIODevice::Text ) )
+      {
+         qWarning() << "YappariCrashReport: could not write" << cIndexPath;
+         return 0;
+      }
+
+      file.write( (lines.join( '\n' ) + '\n').toUtf8() );
+
+      if ( !file.commit() )
+      {
+         qWarning() << "YappariCrashReport: could not write" << cIndexPath;
+         return 0;
+      }
+
+      return count;
+   }
+
+#ifndef Q_OS_WIN
+   QString  signalDescription( int inSignal, int inSignalCode )
+   {
+      switch( inSignal )
+      {
+         case SIGSEGV:
+            return QStringLiteral( "Caught SIGSEGV: Segmentation Fault" );
+         case SIGINT:
+            return QStringLiteral( "Caught SIGINT: Interactive attention signal, (usually ctrl+c)" );
+         case SIGFPE:
+            switch( inSignalCode )
+            {
+               case FPE_INTDIV:
+                  return QStringLiteral( "Caught SIGFPE: (integer divide by zero)" );
+               case FPE_INTOVF:
+                  return QStringLiteral( "Caught SIGFPE: (integer overflow)" );
+               case FPE_FLTDIV:
+                  return QStringLiteral( "Caught SIGFPE: (floating-point divide by zero)" );
+               case FPE_FLTOVF:
+                  return QStringLiteral( "Caught SIGFPE: (floating-point overflow)" );
+               case FPE_FLTUND:
+                  return QStringLiteral( "Caught SIGFPE: (floating-point underflow)" );
+               case FPE_FLTRES:
+                  return QStringLiteral( "Caught SIGFPE: (floating-point inexact result)" );
+               case FPE_FLTINV:
+                  return QStringLiteral( "Caught SIGFPE: (floating-point invalid operation)" );
+               case FPE_FLTSUB:
+                  return QStringLiteral( "Caught SIGFPE: (subscript out of range)" );
+               default:
+                  return QStringLiteral( "Caught SIGFPE: Arithmetic Exception" );
+            }
+         case SIGILL:
+            switch( inSignalCode )
+            {
+               case ILL_ILLOPC:
+                  return QStringLiteral( "Caught SIGILL: (illegal opcode)" );
+               case ILL_ILLOPN:
+                  return QStringLiteral( "Caught SIGILL: (illegal operand)" );
+               case ILL_ILLADR:
+                  return QStringLiteral( "Caught SIGILL: (illegal addressing mode)" );
+               case ILL_ILLTRP:
+                  return QStringLiteral( "Caught SIGILL: (illegal trap)" );
+               case ILL_PRVOPC:
+                  return QStringLiteral( "Caught SIGILL: (privileged opcode)" );
+               case ILL_PRVREG:
+                  return QStringLiteral( "Caught SIGILL: (privileged register)" );
+               case ILL_COPROC:
+                  return QStringLiteral( "Caught SIGILL: (coprocessor error)" );
+               case ILL_BADSTK:
+                  return QStringLiteral( "Caught SIGILL: (internal stack error)" );
+               default:
+                  return QStringLiteral( "Caught SIGILL: Illegal Instruction" );
+            }
+         case SIGTERM:
+            return QStringLiteral( "Caught SIGTERM: a termination request was sent to the program" );
+         case SIGABRT:
+            return QStringLiteral( "Caught SIGABRT: usually caused by an abort() or assert()" );
+      }
+
+      return QStringLiteral( "Unrecognized Signal" );
+   }
+
+   QString  crashSignatureText( const CrashRecord &inRecord )
+   {
+      return QStringLiteral( "%1" ).arg( crashRecordSignature( inRecord ), 16, 16, QLatin1Char( '0' ) );
+   }
+
+   // The frames of a stack worth reporting: a stack may end with a zero return address
+   static int  _reportedFrameCount( const uint64_t *inFrames, int inFrameCount )
+   {
+      return (inFrameCount > 0 && inFrames[inFrameCount - 1] == 0) ? inFrameCount - 1 : inFrameCount;
+   }
+
+#ifdef Q_OS_LINUX
+   static QByteArray  _buildIdString( const ModuleRecord &inModule )
+   {
+      return QByteArray( reinterpret_cast<const char *>(inModule.buildId), int( inModule.buildIdSize ) ).toHex();
+   }
+
+   static void  _setFrameModule( StackFrame &ioFrame, const ModuleRecord &inModule )
+   {
+      // the address to look up is relative to the load bias of the module (0 for non-PIE executables)
+      ioFrame.module = QString::fromLocal8Bit( inModule.path );
+      ioFrame.offset = ioFrame.address - quintptr( inModule.loadBias );
+      ioFrame.buildId = _buildIdString( inModule );
+   }
+
+   void  resolveFrameModule( StackFrame &ioFrame )
+   {
+      ModuleRecord   module;
+
+      if ( findModule( ioFrame.address, module ) )
+         _setFrameModule( ioFrame, module );
+   }
+
+   // Find the module of a frame, in the modules of the record or in the module map of this process
+   static void  _resolveModule( StackFrame &ioFrame, const CrashRecord &inRecord )
+   {
+      if ( inRecord.moduleCount == 0 )
+      {
+         resolveFrameModule( ioFrame );
+         return;
+      }
+
+      // the modules are sorted by address
+      const ModuleRecord   *cModules = inRecord.modules;
+      const ModuleRecord   *cEnd = cModules + inRecord.moduleCount;
+
+      const ModuleRecord   *cModule = std::upper_bound( cModules, cEnd, ioFrame.address,
+                                                        [] ( quintptr inAddress, const ModuleRecord &inModule ) {
+                                                           return inAddress < inModule.start;
+                                                        } );
+
+      if ( cModule == cModules || ioFrame.address >= (cModule - 1)->end )
+         return;
+
+      _setFrameModule( ioFrame, *(cModule - 1) );
+   }
+
+   // Build the frames of a stack
+   static StackFrameList  _resolveFrames( const uint64_t *inFrames, int inFrameCount, const CrashRecord &inRecord )
+   {
+      StackFrameList frames;
+
+      const int   cFrameCount = _reportedFrameCount( inFrames, inFrameCount );
+
+      frames.reserve( cFrameCount );
+
+      for ( int i = 0; i < cFrameCount; ++i )
+      {
+         StackFrame  frame;
+
+         frame.address = quintptr( inFrames[i] );
+
+         _resolveModule( frame, inRecord );
+
+         frames += frame;
+      }
+
+      return frames;
+   }
+
+   QString  formatStackFrame( int inFrameNumber, const StackFrame &inFrame )
+   {
+      QString  programName = inFrame.module;
+
+      int index = programName.lastIndexOf( "/" );
+      if (index >= 0)
+          programName = programName.right(programName.size() - index - 1);
+
+      if ( programName.isEmpty() )
+         programName = QStringLiteral( "??" );
+
+      QString  locationStr = inFrame.location;
+
+      // a frame that wasn't symbolized (in time) can still be looked up later by its offset in the module
+      if ( locationStr.isEmpty() )
+         locationStr = inFrame.module.isEmpty() ? QStringLiteral( "??" ) : QStringLiteral( "?? (+0x%1)" ).arg( inFrame.offset, 0, 16 );
+
+      return QStringLiteral( "[%1] %4 0x%2 %3" )
+             .arg( QString::number( inFrameNumber ) )
+             .arg( inFrame.address, 16, 16, QChar( '0' ) )
+             .arg( locationStr )
+             .arg( programName );
+   }
+
+   QStringList  formatStackFrames( const StackFrameList &inFrames )
+   {
+      QStringList frameList;
+
+      frameList.reserve( inFrames.size() );
+
+      for ( int frameNumber = 0; frameNumber < inFrames.size(); ++frameNumber )
+         frameList += formatStackFrame( frameNumber, inFrames.at( frameNumber ) );
+
+      return frameList;
+   }
+
+   QVector<StackFrameList>  crashRecordStacks( const CrashRecord &inRecord, const StackFrameCallback &inResolved )
+   {
+      // every stack starts at the instruction its thread was interrupted at (see unwindSignalContext())
+      StackFrameList frames = _resolveFrames( inRecord.frames, int( inRecord.frameCount ), inRecord );
+
+      QVector<int>   stackStart{ 0 };
+
+      for ( uint32_t i = 0; i < inRecord.threadCount; ++i )
+      {
+         const ThreadRecord   &cThread = inRecord.threads[i];
+
+         stackStart += frames.size();
+         frames += _resolveFrames( cThread.frames, int( cThread.frameCount ), inRecord );
+      }
+
+      // the stack the uncaught exception was thrown from starts at the throw site
+      if ( inRecord.exception.frameCount > 0 )
+      {
+         stackStart += frames.size();
+         frames += _resolveFrames( inRecord.exception.frames, int( qMin( inRecord.exception.frameCount, uint32_t( MAX_STACK_FRAMES ) ) ),
+                                   inRecord );
+      }
+
+      stackStart += frames.size();
+
+      // all the stacks are symbolized in one pass
+      if ( inResolved )
+      {
+         symbolizeFrames( frames, [&] ( int inIndex ) {
+            const int   cStack = int( std::upper_bound( stackStart.constBegin(), stackStart.constEnd(), inIndex ) - stackStart.constBegin() ) - 1;
+
+            inResolved( cStack, inIndex - stackStart.at( cStack ), frames.at( inIndex ) );
+         } );
+      }
+      else
+      {
+         symbolizeFrames( frames );
+      }
+
+      QVector<StackFrameList> stacks;
+
+      for ( int i = 0; i < (stackStart.size() - 1); ++i )
+         stacks += frames.mid( stackStart.at( i ), stackStart.at( i + 1 ) - stackStart.at( i ) );
+
+      return stacks;
+   }
+
+   QString  demangledTypeName( const char *inMangledName )
+   {
+      int   status = 0;
+      char  *demangled = abi::__cxa_demangle( inMangledName, nullptr, nullptr, &status );
+
+      const QString  cName = QString::fromLatin1( (demangled != nullptr) ? demangled : inMangledName );
+
+      free( demangled );
+
+      return cName;
+   }
+
+   // The type and message of the uncaught exception and the stack it was thrown from, if there was one
+   static QStringList  _exceptionInfo( const CrashRecord &inRecord, const QVector<StackFrameList> &inStacks )
+   {
+      QStringList exceptionInfo;
+
+      const ExceptionRecord   &cException = inRecord.exception;
+
+      if ( cException.type[0] == '\0' )
+         return exceptionInfo;
+
+      const QString  cType = demangledTypeName( cException.type );
+
+      exceptionInfo += (cException.message[0] != '\0') ? QStringLiteral( "Uncaught exception %1: %2" ).arg( cType, QString::fromUtf8( cException.message ) )
+                                                        : QStringLiteral( "Uncaught exception %1" ).arg( cType );
+
+      // the throw stack comes after the ones of the threads
+      const int   cThrowStack = int( inRecord.threadCount ) + 1;
+
+      if ( cException.frameCount > 0 && cThrowStack < inStacks.size() )
+      {
+         exceptionInfo += QStringLiteral( "Thrown from:" );
+         exceptionInfo += formatStackFrames( inStacks.at( cThrowStack ) );
+      }
+
+      exceptionInfo += QString();
+
+      return exceptionInfo;
+   }
+
+   // The stack of the crash and the stacks of the other threads, as returned by crashRecordStacks()
+   static QStringList  _stackTraces( const CrashRecord &inRecord, const QVector<StackFrameList> &inStacks )
+   {
+      const QVector<StackFrameList> &cStacks = inStacks;
+
+      QStringList frameList = _exceptionInfo( inRecord, cStacks ) + formatStackFrames( cStacks.at( 0 ) );
+
+      if ( inRecord.threadCount == 0 )
+         return frameList;
+
+      // without the all-threads capture only the list of threads is known
+      bool  hasThreadStacks = false;
+
+      for ( int i = 1; i <= int( inRecord.threadCount ); ++i )
+         hasThreadStacks = hasThreadStacks || !cStacks.at( i ).isEmpty();
+
+      frameList += QString();
+      frameList += QStringLiteral( "Threads:" );
+
+      for ( uint32_t i = 0; i < inRecord.threadCount; ++i )
+      {
+         const ThreadRecord   &cThread = inRecord.threads[i];
+
+         QString  state;
+
+         if ( cThread.tid == inRecord.tid )
+            state = QStringLiteral( " (crashed)" );
+         else if ( hasThreadStacks && cThread.frameCount == 0 )
+            state = QStringLiteral( " (didn't answer)" );
+
+         frameList += QString();
+         frameList += QStringLiteral( "Thread %1 \"%2\"%3" ).arg( cThread.tid ).arg( QString::fromLocal8Bit( cThread.name ), state );
+         frameList += formatStackFrames( cStacks.at( int( i ) + 1 ) );
+      }
+
+      return frameList;
+   }
+#else
+   static QStringList  _stackTraces( const CrashRecord &inRecord )
+   {
+      const QString  cProgramName = QString::fromLocal8Bit( inRecord.programPath );
+
+      const int   cTraceSize = _reportedFrameCount( inRecord.frames, int( inRecord.frameCount ) );
+
+
+      // first pass: find out which module each frame belongs to
+      StackFrameList frames;
+
+      frames.reserve( cTraceSize );
+
+      void  *stackTraces[MAX_STACK_FRAMES];
+
+      for ( int i = 0; i < cTraceSize; ++i )
+         stackTraces[i] = reinterpret_cast<void *>(inRecord.frames[i]);
+
+      char  **messages = backtrace_symbols( stackTraces, cTraceSize );
+
+      QStringList    messageList;
+
+      messageList.reserve( cTraceSize );
+
+      // the stack starts at the faulting instruction (see unwindSignalContext())
+      for ( int i = 0; i < cTraceSize; ++i )
+      {
+         QString     message( messages[i] );
+         StackFrame  frame;
+
+         frame.address = quintptr( inRecord.frames[i] );
+
+         // match the mangled name if possible so we can replace it with file & line number
+         QRegularExpressionMatch match = _symbolMatching().match( message );
+
+         if ( !match.captured( 1 ).isNull() )
+         {
+            frame.module = cProgramName;
+            frame.offset = frame.address;
+
+            // keep only the part before the symbol, the rest is replaced by the location
+            message.truncate( match.capturedStart( 1 ) );
+         }
+
+         frames += frame;
+         messageList += message;
+      }
+
+      // second pass: resolve all the frames at once
+      symbolizeFrames( frames );
+
+      QStringList frameList;
+
+      frameList.reserve( frames.size() );
+
+      for ( int frameNumber = 0; frameNumber < frames.size(); ++frameNumber )
+      {
+         const StackFrame  &cFrame = frames.at( frameNumber );
+
+         frameList += cFrame.location.isEmpty() ? QString( messages[frameNumber] )
+                                                : messageList.at( frameNumber ) + cFrame.location;
+      }
+
+      if ( messages != nullptr )
+      {
+         free( messages );
+      }
+
+      return frameList;
+   }
+#endif
+
+   // Format the registers captured from the ucontext
+   static QStringList  _registers( const CrashRecord &inRecord )
+   {
+      QStringList registerList;
+
+      if ( inRecord.registerCount == 0 )
+         return registerList;
+
+      registerList += QString();
+      registerList += QStringLiteral( "Registers:" );
+
+      QStringList lineList;
+
+      // the names are only known for the registers of this architecture
+      const bool  cKnownNames = (inRecord.architecture == crashArchitecture());
+
+      for ( uint32_t i = 0; i < inRecord.registerCount; ++i )
+      {
+         lineList += QStringLiteral( "%1 0x%2" )
+                     .arg( cKnownNames ? QString( registerName( i ) ) : QStringLiteral( "r%1" ).arg( i ), 7 )
+                     .arg( quintptr( inRecord.registers[i] ), 16, 16, QChar( '0' ) );
+
+         // three registers per line
+         if ( lineList.size() == 3 || i == (inRecord.registerCount - 1) )
+         {
+            registerList += lineList.join( QStringLiteral( "   " ) );
+            lineList.clear();
+         }
+      }
+
+      return registerList;
+   }
+
+   QStringList  formatBreadcrumbs( const BreadcrumbRecord *inBreadcrumbs, uint32_t inCount, uint64_t inReferenceNs )
+   {
+      QStringList breadcrumbs;
+
+      if ( inCount == 0 )
+         return breadcrumbs;
+
+      breadcrumbs += QString();
+      breadcrumbs += QStringLiteral( "Breadcrumbs:" );
+
+      for ( uint32_t i = 0; i < inCount; ++i )
+      {
+         const BreadcrumbRecord  &cBreadcrumb = inBreadcrumbs[i];
+
+         const double   cMilliseconds = (double( cBreadcrumb.time ) - double( inReferenceNs )) / 1000000.0;
+
+         breadcrumbs += QStringLiteral( "%1 ms [%2] %3" ).arg( cMilliseconds, 10, 'f', 3 ).arg( cBreadcrumb.tid )
+                        .arg( QString::fromUtf8( cBreadcrumb.message, int( qMin( cBreadcrumb.size, uint32_t( MAX_BREADCRUMB_SIZE - 1 ) ) ) ) );
+      }
+
+      return breadcrumbs;
+   }
+
+   // Add the registers, the breadcrumbs and the capture time to the stack traces
+   static QStringList  _recordInfo( const CrashRecord &inRecord, const QStringList &inStackTraces )
+   {
+      QStringList frameInfoList = inStackTraces;
+
+      frameInfoList += _registers( inRecord );
+      frameInfoList += formatBreadcrumbs( inRecord.breadcrumbs, qMin( inRecord.breadcrumbCount, uint32_t( MAX_BREADCRUMBS ) ),
+                                          inRecord.captureStartNs );
+
+      frameInfoList += QString();
+      frameInfoList += QStringLiteral( "Crash captured in %1 us" ).arg( (inRecord.captureEndNs - inRecord.captureStartNs) / 1000 );
+
+      return frameInfoList;
+   }
+
+   static QString  _recordReport( const CrashRecord &inRecord, const QStringList &inFrameInfoList )
+   {
+      return _reportText( QString::fromLocal8Bit( inRecord.applicationName ), QString::fromLocal8Bit( inRecord.applicationVersion ),
+                          QDateTime::fromSecsSinceEpoch( inRecord.time ),
+                          QStringLiteral( "%1\nSignature %2" ).arg( signalDescription( inRecord.signal, inRecord.signalCode ),
+                                                                    crashSignatureText( inRecord ) ),
+                          inFrameInfoList );
+   }
+
+   QStringList  crashRecordInfo( const CrashRecord &inRecord )
+   {
+#ifdef Q_OS_LINUX
+      return _recordInfo( inRecord, _stackTraces( inRecord, crashRecordStacks( inRecord ) ) );
+#else
+      return _recordInfo( inRecord, _stackTraces( inRecord ) );
+#endif
+   }
+
+   QString  crashRecordReport( const CrashRecord &inRecord )
+   {
+      return _recordReport( inRecord, crashRecordInfo( inRecord ) );
+   }
+
+#ifdef Q_OS_LINUX
+   QString  crashRecordReport( const CrashRecord &inRecord, const QVector<StackFrameList> &inStacks )
+   {
+      return _recordReport( inRecord, _recordInfo( inRecord, _stackTraces( inRecord, inStacks ) ) );
+   }
+#endif
+#endif
+}
@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2020 Naikel Aparicio. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ''AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the author and should not be interpreted as representing
+ * official policies, either expressed or implied, of the copyright holder.
+ */
+
+
+#ifndef CRASHREPORT_H
+#define CRASHREPORT_H
+
+#include <cstdint>
+
+#include <QDateTime>
+#include <QString>
+#include <QStringList>
+
+#ifdef Q_OS_LINUX
+#include "Symbolizer.h"
+#endif
+
+
+namespace YappariCrashReport {
+
+   /// Put a report together: the application, the date, the signal and the frame information
+   QString crashReportText( const QString &inSignal, const QStringList &inFrameInfoList,
+                            const QDateTime &inTime = QDateTime::currentDateTime() );
+
+   /// The name of the file a report is saved to by default
+   QString crashReportFileName();
+
+   /// The name of the file a hang report is saved to (see setHangWatchdog())
+   QString hangReportFileName();
+
+   /// Write a report to a file of a directory, creating the directory if needed
+   /// @return false if the file couldn't be written
+   bool writeCrashReportFile( const QString &inDirectory, const QString &inFileName, const QString &inReport );
+
+   /// The name of the file of a report directory that counts the crashes by signature
+   QString crashSignatureIndexFileName();
+
+   /// Count a crash in the signature index of a report directory, which keeps how many times each signature
+   /// occurred, the first and last time, and the report of its first occurrence, so a crash seen before
+   /// doesn't need another report
+   /// @param inFileName The name the report of this crash would be saved as
+   /// @param outReportFileName The report of the signature: the first one if it is still in the directory, inFileName otherwise
+   /// @return The number of times the signature occurred, this time included, 0 if the index couldn't be updated
+   int countCrashSignature( const QString &inDirectory, const QString &inSignature, const QString &inFileName,
+                            QString &outReportFileName );
+
+#ifndef Q_OS_WIN
+   struct BreadcrumbRecord;
+   struct CrashRecord;
+
+   /// A human readable description of a signal and its code
+   QString signalDescription( int inSignal, int inSignalCode );
+
+   /// The signature of a crash record (see crashRecordSignature()) as the 16 hex digits shown in the reports
+   QString crashSignatureText( const CrashRecord &inRecord );
+
+   /// Format breadcrumbs as the "Breadcrumbs:" section of the reports
+   /// @param inReferenceNs The monotonic time their times are shown relative to, usually the crash
+   QStringList formatBreadcrumbs( const BreadcrumbRecord *inBreadcrumbs, uint32_t inCount, uint64_t inReferenceNs );
+
+   /// Format a crash record: the symbolized stack trace, the registers, the threads & how long the capture took.
+   /// The frames are resolved with the modules of the record if it has them (the record may come from
+   /// another process or another machine), or with the modules loaded in this process otherwise.
+   QStringList crashRecordInfo( const CrashRecord &inRecord );
+
+   /// The whole report of a crash record, as crashReportText() puts it together, but with the application,
+   /// version and time of the record instead of this process's. Can be called from several threads at once
+   /// if the symbolizer allows it (see setConcurrentSymbolization()).
+   QString crashRecordReport( const CrashRecord &inRecord );
+
+#ifdef Q_OS_LINUX
+   /// Find the module of a frame in the module map of this process and fill in its module, offset and build-id
+   void resolveFrameModule( StackFrame &ioFrame );
+
+   /// Format a symbolized frame as a line of a stack trace of the reports
+   QString formatStackFrame( int inFrameNumber, const StackFrame &inFrame );
+
+   /// Format symbolized frames as the lines of a stack trace of the reports
+   QStringList formatStackFrames( const StackFrameList &inFrames );
+
+   /// Called by crashRecordStacks() as soon as a frame is symbolized, with the index of its stack and its number in the stack
+   using StackFrameCallback = std::function<void (int, int, const StackFrame &)>;
+
+   /// The symbolized stacks of a crash record: the crashed thread first, then every thread of CrashRecord::threads
+   /// and, if the record has one, the stack the uncaught exception was thrown from
+   /// @param inResolved Called as each frame is symbolized, e.g. to stream the report (optional)
+   QVector<StackFrameList> crashRecordStacks( const CrashRecord &inRecord, const StackFrameCallback &inResolved = StackFrameCallback() );
+
+   /// The C++ name of a type from its mangled name (std::type_info::name()), the mangled name if it can't be demangled
+   QString demangledTypeName( const char *inMangledName );
+
+   /// The whole report of a crash record with stacks that were already symbolized by crashRecordStacks()
+   QString crashRecordReport( const CrashRecord &inRecord, const QVector<StackFrameList> &inStacks );
+#endif
+#endif
+
+}
+
+#endif
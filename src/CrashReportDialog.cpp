@@ -27,15 +27,27 @@
  * official policies, either expressed or implied, of the copyright holder.
  */
 
+#include <QApplication>
 #include <QFileDialog>
 #include <QDebug>
 #include <QDir>
 
 #include "CrashReportDialog.h"
+#include "YappariCrashReport.h"
 #include "ui_crashreportdialog.h"
 
 namespace YappariCrashReport
 {
+void showCrashReportDialog(const QString &inFileName, const QString &inCrashReport)
+{
+    // a QCoreApplication can't show widgets
+    if (qobject_cast<QApplication *>(QCoreApplication::instance()) == nullptr)
+        return;
+
+    CrashReportDialog dialog(inFileName, inCrashReport);
+    dialog.exec();
+}
+
 CrashReportDialog::CrashReportDialog(QString fileName, QString stackTrace, QWidget *parent) :
     QDialog(parent),
     ui(new Ui::CrashReportDialog)
@@ -0,0 +1,174 @@
+/*
+ * Copyright (C) 2020 Naikel Aparicio. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ''AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the author and should not be interpreted as representing
+ * official policies, either expressed or implied, of the copyright holder.
+ */
+
+#include <algorithm>
+#include <cstring>
+
+#include <dlfcn.h>
+
+#include "CrashSignature.h"
+
+
+namespace YappariCrashReport
+{
+   // 64-bit FNV-1a
+   constexpr uint64_t   FNV_OFFSET_BASIS = 0xcbf29ce484222325ULL;
+   constexpr uint64_t   FNV_PRIME = 0x100000001b3ULL;
+
+   // The C and C++ runtime: where the stack of an abort() or of an uncaught exception starts
+   static const char *const   sRuntimeModules[] = {
+      "libc.so", "libc-", "libpthread", "libstdc++", "libgcc_s", "libc++", "libsystem_", "libdyld", "ld-linux",
+   };
+
+   static void  _hashBytes( uint64_t &ioHash, const void *inData, size_t inSize )
+   {
+      const uint8_t  *cBytes = static_cast<const uint8_t *>(inData);
+
+      for ( size_t i = 0; i < inSize; ++i )
+      {
+         ioHash ^= cBytes[i];
+         ioHash *= FNV_PRIME;
+      }
+   }
+
+   static void  _hashString( uint64_t &ioHash, const char *inString )
+   {
+      // the terminator keeps "ab" + "c" apart from "a" + "bc"
+      _hashBytes( ioHash, inString, strlen( inString ) + 1 );
+   }
+
+   static void  _hashNumber( uint64_t &ioHash, uint64_t inNumber )
+   {
+      _hashBytes( ioHash, &inNumber, sizeof( inNumber ) );
+   }
+
+   static const char  *_baseName( const char *inPath )
+   {
+      const char  *cSlash = strrchr( inPath, '/' );
+
+      return (cSlash != nullptr) ? cSlash + 1 : inPath;
+   }
+
+   // The name of the module of an address and the offset of the address in its file
+   // @return false if the address isn't in any module (e.g. generated code)
+   static bool  _frameModule( const CrashRecord &inRecord, uint64_t inAddress, const char *&outName, uint64_t &outOffset )
+   {
+      if ( inRecord.moduleCount == 0 )
+      {
+         Dl_info  info;
+
+         if ( dladdr( reinterpret_cast<void *>(uintptr_t( inAddress )), &info ) == 0 || info.dli_fname == nullptr )
+            return false;
+
+         outName = _baseName( info.dli_fname );
+         outOffset = inAddress - uint64_t( reinterpret_cast<uintptr_t>(info.dli_fbase) );
+
+         return true;
+      }
+
+      // the modules are sorted by address
+      const ModuleRecord   *cModules = inRecord.modules;
+      const ModuleRecord   *cEnd = cModules + std::min( inRecord.moduleCount, uint32_t( MAX_MODULES ) );
+
+      const ModuleRecord   *cModule = std::upper_bound( cModules, cEnd, inAddress,
+                                                        [] ( uint64_t inValue, const ModuleRecord &inModule ) {
+                                                           return inValue < inModule.start;
+                                                        } );
+
+      if ( cModule == cModules || inAddress >= (cModule - 1)->end )
+         return false;
+
+      outName = _baseName( (cModule - 1)->path );
+      outOffset = inAddress - (cModule - 1)->loadBias;
+
+      return true;
+   }
+
+   static bool  _isRuntimeFrame( const CrashRecord &inRecord, uint64_t inAddress )
+   {
+      const char  *name = nullptr;
+      uint64_t offset = 0;
+
+      if ( !_frameModule( inRecord, inAddress, name, offset ) )
+         return false;
+
+      for ( const char *cPrefix : sRuntimeModules )
+      {
+         if ( strncmp( name, cPrefix, strlen( cPrefix ) ) == 0 )
+            return true;
+      }
+
+      return false;
+   }
+
+   static void  _hashFrame( uint64_t &ioHash, const CrashRecord &inRecord, uint64_t inAddress )
+   {
+      const char  *name = nullptr;
+      uint64_t offset = 0;
+
+      // the address of a frame outside of the modules changes from run to run, only its place in the stack counts
+      if ( !_frameModule( inRecord, inAddress, name, offset ) )
+      {
+         _hashString( ioHash, "?" );
+         return;
+      }
+
+      _hashString( ioHash, name );
+      _hashNumber( ioHash, offset );
+   }
+
+   uint64_t  crashRecordSignature( const CrashRecord &inRecord, uint32_t inFrameCount )
+   {
+      uint64_t hash = FNV_OFFSET_BASIS;
+
+      _hashNumber( hash, uint64_t( inRecord.signal ) );
+
+      // an uncaught exception always crashes in std::terminate(), where it was thrown is what tells them apart
+      const bool  cThrown = (inRecord.exception.frameCount > 0);
+
+      const uint64_t *cFrames = cThrown ? inRecord.exception.frames : inRecord.frames;
+      const uint32_t cFrameCount = std::min( cThrown ? inRecord.exception.frameCount : inRecord.frameCount,
+                                             uint32_t( MAX_STACK_FRAMES ) );
+
+      if ( cThrown )
+         _hashString( hash, inRecord.exception.type );
+      else if ( cFrameCount > 0 )
+         _hashFrame( hash, inRecord, cFrames[0] );
+
+      uint32_t first = 0;
+
+      while ( first < cFrameCount && _isRuntimeFrame( inRecord, cFrames[first] ) )
+         ++first;
+
+      for ( uint32_t i = first; i < cFrameCount && i - first < inFrameCount; ++i )
+         _hashFrame( hash, inRecord, cFrames[i] );
+
+      return hash;
+   }
+}
@@ -0,0 +1,57 @@
+/*
+ * Copyright (C) 2020 Naikel Aparicio. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ''AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the author and should not be interpreted as representing
+ * official policies, either expressed or implied, of the copyright holder.
+ */
+
+
+#ifndef CRASHSIGNATURE_H
+#define CRASHSIGNATURE_H
+
+#include <cstdint>
+
+#include "CrashArena.h"
+
+
+namespace YappariCrashReport {
+
+   constexpr uint32_t   CRASH_SIGNATURE_FRAMES = 5;
+
+   /// A stable signature of a crash record, the same every time the same bug crashes the same build.
+   ///
+   /// It is a hash of the signal, the module and offset of the faulting frame, and the modules and offsets
+   /// of the top frames of the stack once the C and C++ runtime frames it starts with are left out (abort(),
+   /// raise(), std::terminate()...). Only module names and offsets go into it, never addresses, so it doesn't
+   /// change with ASLR. An uncaught exception is identified by its type and the stack it was thrown from instead.
+   ///
+   /// The frames are found in the modules of the record. Only uses async-signal-safe operations, unless the
+   /// record has no modules (on macOS), in which case the modules loaded in this process are used.
+   /// @param inFrameCount The number of frames after the runtime ones that go into the signature
+   uint64_t crashRecordSignature( const CrashRecord &inRecord, uint32_t inFrameCount = CRASH_SIGNATURE_FRAMES );
+
+}
+
+#endif
@@ -0,0 +1,345 @@
+/*
+ * Copyright (C) 2020 Naikel Aparicio. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ''AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the author and should not be interpreted as representing
+ * official policies, either expressed or implied, of the copyright holder.
+ */
+
+#include <atomic>
+#include <cstring>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "CrashArena.h"
+#include "CrashSpool.h"
+
+
+namespace YappariCrashReport
+{
+   constexpr char       SPOOL_MAGIC[8] = { 'Y', 'C', 'R', 'S', 'P', 'O', 'O', 'L' };
+   constexpr uint32_t   SPOOL_VERSION = 1;
+
+   // The index starts with the header, followed by the ring of entries. The reports of the spool are the
+   // entries from the first sequence to the next one, each one at its sequence modulo the capacity.
+   struct SpoolHeader
+   {
+      char     magic[8];
+      uint32_t version;
+      uint32_t capacity;               // the number of entries of the ring, the most reports the spool keeps
+      uint64_t maxBytes;               // the most the reports can add up to
+      uint64_t totalBytes;             // what they add up to
+      uint64_t first;                  // the sequence of the oldest report
+      uint64_t next;                   // the sequence of the next report
+   };
+
+   static char sDirectory[MAX_PATH_SIZE] = { 0 };
+
+   static SpoolHeader   *sHeader = nullptr;   // the mapped index, nullptr if no spool is open
+   static SpoolEntry    *sEntries = nullptr;
+   static size_t  sMapSize = 0;
+
+   static const char *const   sIndexFileName = "Crash Spool.index";
+
+   static size_t  _indexSize( uint32_t inCapacity )
+   {
+      return sizeof( SpoolHeader ) + size_t( inCapacity ) * sizeof( SpoolEntry );
+   }
+
+   static char  *_appendString( char *outString, const char *inEnd, const char *inSource )
+   {
+      while ( *inSource != '\0' && outString < inEnd )
+         *outString++ = *inSource++;
+
+      return outString;
+   }
+
+   // The path of a file of the spool directory, without snprintf (which isn't async-signal-safe)
+   static void  _spoolFilePath( const char *inFileName, char *outPath, size_t inPathSize )
+   {
+      const char  *cEnd = outPath + inPathSize - 1;
+
+      char  *position = _appendString( outPath, cEnd, sDirectory );
+
+      position = _appendString( position, cEnd, "/" );
+      position = _appendString( position, cEnd, inFileName );
+      *position = '\0';
+   }
+
+   // Rotate the oldest report out of the spool
+   static void  _removeOldest()
+   {
+      SpoolEntry  &entry = sEntries[sHeader->first % sHeader->capacity];
+
+      if ( entry.state != SPOOL_EMPTY )
+      {
+         char  path[MAX_PATH_SIZE + MAX_SPOOL_FILE_NAME_SIZE] = { 0 };
+
+         _spoolFilePath( entry.fileName, path, sizeof( path ) );
+         unlink( path );
+
+         sHeader->totalBytes -= (entry.size < sHeader->totalBytes) ? entry.size : sHeader->totalBytes;
+         entry.state = SPOOL_EMPTY;
+      }
+
+      ++sHeader->first;
+   }
+
+   // Rotate the oldest reports out until the spool is within its limits with room for some more reports.
+   // The newest report stays even if it is bigger than the size limit on its own.
+   static void  _makeRoom( uint32_t inEntries, uint64_t inBytes )
+   {
+      while ( sHeader->next - sHeader->first + inEntries > sHeader->capacity )
+         _removeOldest();
+
+      while ( sHeader->next - sHeader->first + inEntries > 1 && sHeader->totalBytes + inBytes > sHeader->maxBytes )
+         _removeOldest();
+   }
+
+   static bool  _mapIndex( int inFd, size_t inSize )
+   {
+      void  *map = mmap( nullptr, inSize, PROT_READ | PROT_WRITE, MAP_SHARED, inFd, 0 );
+
+      if ( map == MAP_FAILED )
+         return false;
+
+      sHeader = static_cast<SpoolHeader *>(map);
+      sEntries = reinterpret_cast<SpoolEntry *>(sHeader + 1);
+      sMapSize = inSize;
+
+      return true;
+   }
+
+   // Whether a file holds an index of this version, and its header if it does
+   static bool  _readHeader( int inFd, SpoolHeader &outHeader )
+   {
+      struct stat  fileStatus;
+
+      if ( fstat( inFd, &fileStatus ) != 0 || size_t( fileStatus.st_size ) < sizeof( SpoolHeader ) )
+         return false;
+
+      if ( pread( inFd, &outHeader, sizeof( outHeader ), 0 ) != ssize_t( sizeof( outHeader ) ) )
+         return false;
+
+      return memcmp( outHeader.magic, SPOOL_MAGIC, sizeof( SpoolHeader::magic ) ) == 0 &&
+             outHeader.version == SPOOL_VERSION && outHeader.capacity > 0 &&
+             size_t( fileStatus.st_size ) == _indexSize( outHeader.capacity ) &&
+             outHeader.next - outHeader.first <= outHeader.capacity;
+   }
+
+   bool  openCrashSpool( const char *inDirectory, uint64_t inMaxBytes, uint32_t inMaxFiles )
+   {
+      closeCrashSpool();
+
+      if ( inDirectory == nullptr || inDirectory[0] == '\0' )
+         return false;
+
+      strncpy( sDirectory, inDirectory, sizeof( sDirectory ) - 1 );
+      sDirectory[sizeof( sDirectory ) - 1] = '\0';
+
+      char  path[MAX_PATH_SIZE + MAX_SPOOL_FILE_NAME_SIZE] = { 0 };
+
+      _spoolFilePath( sIndexFileName, path, sizeof( path ) );
+
+      const int   cFd = open( path, O_RDWR | O_CREAT | O_CLOEXEC, 0644 );
+
+      if ( cFd < 0 )
+      {
+         sDirectory[0] = '\0';
+         return false;
+      }
+
+      SpoolHeader header;
+      const bool  cIsValid = _readHeader( cFd, header );
+
+      // without limits an existing index is needed
+      if ( inMaxFiles == 0 && !cIsValid )
+      {
+         close( cFd );
+         sDirectory[0] = '\0';
+         return false;
+      }
+
+      const uint32_t cCapacity = (inMaxFiles > 0) ? inMaxFiles : header.capacity;
+      const uint64_t cMaxBytes = (inMaxFiles > 0) ? inMaxBytes : header.maxBytes;
+
+      bool  isMapped = false;
+
+      if ( cIsValid && header.capacity == cCapacity )
+      {
+         isMapped = _mapIndex( cFd, _indexSize( cCapacity ) );
+
+         if ( isMapped )
+         {
+            sHeader->maxBytes = cMaxBytes;
+
+            _makeRoom( 0, 0 );
+         }
+      }
+      else
+      {
+         // the reports of an index with another capacity are added again to a new one, the newest ones last
+         std::vector<SpoolEntry> entries;
+
+         if ( cIsValid && _mapIndex( cFd, _indexSize( header.capacity ) ) )
+         {
+            for ( uint64_t sequence = sHeader->first; sequence < sHeader->next; ++sequence )
+            {
+               const SpoolEntry  &cEntry = sEntries[sequence % sHeader->capacity];
+
+               if ( cEntry.state != SPOOL_EMPTY )
+                  entries.push_back( cEntry );
+            }
+
+            munmap( sHeader, sMapSize );
+            sHeader = nullptr;
+         }
+
+         if ( ftruncate( cFd, 0 ) == 0 && ftruncate( cFd, off_t( _indexSize( cCapacity ) ) ) == 0 )
+            isMapped = _mapIndex( cFd, _indexSize( cCapacity ) );
+
+         if ( isMapped )
+         {
+            memcpy( sHeader->magic, SPOOL_MAGIC, sizeof( SpoolHeader::magic ) );
+            sHeader->version = SPOOL_VERSION;
+            sHeader->capacity = cCapacity;
+            sHeader->maxBytes = cMaxBytes;
+
+            // the reports keep their sequences
+            if ( cIsValid )
+            {
+               sHeader->first = header.first;
+               sHeader->next = header.first;
+            }
+
+            for ( const SpoolEntry &cEntry : entries )
+            {
+               addSpoolEntry( cEntry.signature, cEntry.time, cEntry.size, cEntry.fileName );
+
+               sEntries[(sHeader->next - 1) % cCapacity].state = cEntry.state;
+            }
+         }
+      }
+
+      close( cFd );
+
+      if ( !isMapped )
+      {
+         sHeader = nullptr;
+         sEntries = nullptr;
+         sDirectory[0] = '\0';
+      }
+
+      return isMapped;
+   }
+
+   void  closeCrashSpool()
+   {
+      if ( sHeader != nullptr )
+         munmap( sHeader, sMapSize );
+
+      sHeader = nullptr;
+      sEntries = nullptr;
+      sMapSize = 0;
+      sDirectory[0] = '\0';
+   }
+
+   const char  *crashSpoolPath()
+   {
+      return sDirectory;
+   }
+
+   bool  addSpoolEntry( uint64_t inSignature, int64_t inTime, uint64_t inSize, const char *inFileName )
+   {
+      if ( sHeader == nullptr )
+         return false;
+
+      _makeRoom( 1, inSize );
+
+      SpoolEntry  &entry = sEntries[sHeader->next % sHeader->capacity];
+
+      entry.sequence = sHeader->next;
+      entry.signature = inSignature;
+      entry.time = inTime;
+      entry.size = inSize;
+      entry.state = SPOOL_PENDING;
+      entry.reserved = 0;
+
+      // strncpy() isn't async-signal-safe
+      char  *position = _appendString( entry.fileName, entry.fileName + MAX_SPOOL_FILE_NAME_SIZE - 1, inFileName );
+
+      *position = '\0';
+
+      sHeader->totalBytes += inSize;
+
+      // the entry is complete before it is part of the spool
+      std::atomic_thread_fence( std::memory_order_release );
+
+      ++sHeader->next;
+
+      return true;
+   }
+
+   uint32_t  copySpoolEntries( SpoolEntry *outEntries, uint32_t inMaxEntries )
+   {
+      if ( sHeader == nullptr )
+         return 0;
+
+      uint32_t count = 0;
+
+      for ( uint64_t sequence = sHeader->first; sequence < sHeader->next && count < inMaxEntries; ++sequence )
+      {
+         const SpoolEntry  &cEntry = sEntries[sequence % sHeader->capacity];
+
+         if ( cEntry.state != SPOOL_EMPTY )
+            outEntries[count++] = cEntry;
+      }
+
+      return count;
+   }
+
+   uint32_t  spoolEntryCount()
+   {
+      return (sHeader != nullptr) ? uint32_t( sHeader->next - sHeader->first ) : 0;
+   }
+
+   bool  setSpoolEntryState( uint64_t inSequence, SpoolState inState )
+   {
+      if ( sHeader == nullptr || inSequence < sHeader->first || inSequence >= sHeader->next )
+         return false;
+
+      SpoolEntry  &entry = sEntries[inSequence % sHeader->capacity];
+
+      if ( entry.sequence != inSequence || entry.state == SPOOL_EMPTY )
+         return false;
+
+      entry.state = inState;
+
+      return true;
+   }
+}
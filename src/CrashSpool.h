@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2020 Naikel Aparicio. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ''AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the author and should not be interpreted as representing
+ * official policies, either expressed or implied, of the copyright holder.
+ */
+
+
+#ifndef CRASHSPOOL_H
+#define CRASHSPOOL_H
+
+#include <cstdint>
+
+
+namespace YappariCrashReport {
+
+   // The crash spool is a directory of reports with a fixed-layout index file mapped in memory: a ring of
+   // entries, oldest first, with the signature, time, size and upload state of every report. Adding a report
+   // only writes an entry (and removes the oldest reports beyond the limits), so it can be done from the
+   // signal handler, and the pending reports are listed from the index without reading the directory.
+
+   constexpr int  MAX_SPOOL_FILE_NAME_SIZE = 112;
+
+   /// The upload state of a report of the spool
+   enum SpoolState : uint32_t
+   {
+      SPOOL_EMPTY = 0,     ///< The entry holds no report
+      SPOOL_PENDING,       ///< The report is waiting to be uploaded
+      SPOOL_UPLOADED,      ///< The report was uploaded, it stays until it is rotated out
+   };
+
+   /// A report of the spool, as laid out in the index
+   struct SpoolEntry
+   {
+      uint64_t sequence;               ///< The number of reports added to the spool before this one, which identifies it
+      uint64_t signature;              ///< See crashRecordSignature()
+      int64_t  time;                   ///< Wall clock time of the crash in seconds since the epoch
+      uint64_t size;                   ///< The size of the report file
+      uint32_t state;                  ///< Its SpoolState
+      uint32_t reserved;
+      char     fileName[MAX_SPOOL_FILE_NAME_SIZE];   ///< The name of the report file in the spool, nul-terminated
+   };
+
+   /// Open the spool of a directory, creating its index if needed, and map the index in memory.
+   /// If the index has room for a different number of reports it is rebuilt with the newest ones, and
+   /// the oldest reports beyond the limits are removed.
+   /// @param inDirectory The directory, which must exist
+   /// @param inMaxBytes The most the reports of the spool can add up to
+   /// @param inMaxFiles The most reports the spool keeps, 0 to keep the limits of an existing index
+   /// @return false if the index couldn't be opened or created
+   bool openCrashSpool( const char *inDirectory, uint64_t inMaxBytes, uint32_t inMaxFiles );
+
+   /// Unmap the index of the spool
+   void closeCrashSpool();
+
+   /// The directory of the open spool, empty if there is none
+   const char *crashSpoolPath();
+
+   /// Add a report that is already in the spool directory, removing the oldest reports first until the new one
+   /// fits in the limits. A report bigger than the size limit is kept on its own.
+   /// Takes constant time (and one unlink() per report removed) and only uses async-signal-safe operations.
+   /// @return false if no spool is open
+   bool addSpoolEntry( uint64_t inSignature, int64_t inTime, uint64_t inSize, const char *inFileName );
+
+   /// Copy the entries of the spool, oldest first
+   /// @return The number of entries copied
+   uint32_t copySpoolEntries( SpoolEntry *outEntries, uint32_t inMaxEntries );
+
+   /// The number of reports in the spool
+   uint32_t spoolEntryCount();
+
+   /// Change the upload state of a report of the spool
+   /// @return false if the report was rotated out of the spool
+   bool setSpoolEntryState( uint64_t inSequence, SpoolState inState );
+
+}
+
+#endif
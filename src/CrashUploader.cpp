@@ -0,0 +1,266 @@
+/*
+ * Copyright (C) 2020 Naikel Aparicio. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ''AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the author and should not be interpreted as representing
+ * official policies, either expressed or implied, of the copyright holder.
+ */
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QThread>
+#include <QTimer>
+
+#ifdef Q_OS_LINUX
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "CrashUploader.h"
+
+
+namespace YappariCrashReport
+{
+   constexpr int  REQUEST_TIMEOUT_MS = 60000;
+
+#ifdef Q_OS_LINUX
+   // The idle I/O class for the calling thread: it only gets the disk when nothing else wants it
+   static void  _setIdleIoPriority()
+   {
+      constexpr int  cIoprioWhoProcess = 1;
+      constexpr int  cIoprioClassIdle = 3;
+      constexpr int  cIoprioClassShift = 13;
+
+      syscall( SYS_ioprio_set, cIoprioWhoProcess, 0, cIoprioClassIdle << cIoprioClassShift );
+   }
+#endif
+
+   // Posts the pending reports of the spool from its own thread, one batch at a time
+   class CrashUploader : public QThread
+   {
+   public:
+      CrashUploader( const QUrl &inEndpoint, const CrashUploadOptions &inOptions ) :
+         mEndpoint( inEndpoint ),
+         mOptions( inOptions )
+      {
+         setObjectName( QStringLiteral( "YappariUploader" ) );
+      }
+
+      void  stop()
+      {
+         quit();
+         wait();
+      }
+
+   protected:
+      void  run() override
+      {
+#ifdef Q_OS_LINUX
+         _setIdleIoPriority();
+#endif
+
+         // everything the uploader creates lives in this thread, and goes away with the event loop
+         QNetworkAccessManager   network;
+         QObject  context;
+
+         mNetwork = &network;
+         mContext = &context;
+         mRetryDelayMs = qMax( mOptions.retryDelayMs, 1 );
+
+         _schedule( mOptions.startDelayMs );
+
+         exec();
+
+         mContext = nullptr;
+         mNetwork = nullptr;
+      }
+
+   private:
+      void  _schedule( int inDelayMs )
+      {
+         QTimer::singleShot( qMax( inDelayMs, 0 ), mContext, [this] () { _uploadBatch(); } );
+      }
+
+      // Post the oldest pending reports that fit in a batch
+      void  _uploadBatch()
+      {
+         const QVector<SpooledCrashReport>   cReports = pendingCrashReports();
+
+         // nothing left: the hang reports may add some while the application runs, the crashes are
+         // uploaded by its next run
+         if ( cReports.isEmpty() )
+         {
+            _schedule( qMax( mOptions.rescanIntervalMs, mOptions.minIntervalMs ) );
+            return;
+         }
+
+         QJsonArray  batch;
+         QVector<quint64>  ids;
+         qint64   batchBytes = 0;
+
+         for ( const SpooledCrashReport &cReport : cReports )
+         {
+            if ( ids.size() >= qMax( mOptions.batchSize, 1 ) )
+               break;
+
+            if ( !ids.isEmpty() && batchBytes + cReport.size > mOptions.maxBatchBytes )
+               break;
+
+            QFile file( cReport.filePath );
+
+            // removed by the user or by a crash handler that rotated it out, there is nothing to upload
+            if ( !file.open( QIODevice::ReadOnly ) )
+            {
+               markCrashReportUploaded( cReport.id );
+               continue;
+            }
+
+            const QByteArray  cText = file.readAll();
+
+            batch.append( QJsonObject{
+                             { QStringLiteral( "signature" ), cReport.signature },
+                             { QStringLiteral( "time" ), cReport.time.toUTC().toString( Qt::ISODate ) },
+                             { QStringLiteral( "fileName" ), QFileInfo( cReport.filePath ).fileName() },
+                             { QStringLiteral( "application" ), QCoreApplication::applicationName() },
+                             { QStringLiteral( "version" ), QCoreApplication::applicationVersion() },
+                             { QStringLiteral( "report" ), QString::fromLocal8Bit( cText ) },
+                          } );
+
+            ids += cReport.id;
+            batchBytes += cText.size();
+         }
+
+         if ( ids.isEmpty() )
+         {
+            _schedule( 0 );
+            return;
+         }
+
+         // qCompress() puts the uncompressed size in front of the zlib stream, which is all HTTP's deflate is
+         const QByteArray  cBody = qCompress( QJsonDocument( batch ).toJson( QJsonDocument::Compact ) ).mid( 4 );
+
+         QNetworkRequest   request( mEndpoint );
+
+         request.setHeader( QNetworkRequest::ContentTypeHeader, QStringLiteral( "application/json" ) );
+         request.setHeader( QNetworkRequest::UserAgentHeader, QStringLiteral( "YappariCrashReport" ) );
+         request.setRawHeader( "Content-Encoding", "deflate" );
+
+         QNetworkReply  *reply = mNetwork->post( request, cBody );
+
+         QTimer::singleShot( REQUEST_TIMEOUT_MS, reply, &QNetworkReply::abort );
+
+         QObject::connect( reply, &QNetworkReply::finished, mContext, [this, reply, ids] () {
+            reply->deleteLater();
+
+            _batchFinished( *reply, ids );
+         } );
+      }
+
+      void  _batchFinished( const QNetworkReply &inReply, const QVector<quint64> &inIds )
+      {
+         const int   cStatus = inReply.attribute( QNetworkRequest::HttpStatusCodeAttribute ).toInt();
+
+         const bool  cIsUploaded = (inReply.error() == QNetworkReply::NoError && cStatus >= 200 && cStatus < 300);
+
+         // the server doesn't want them, sending them again won't change its mind
+         const bool  cIsRefused = (cStatus >= 400 && cStatus < 500 && cStatus != 408 && cStatus != 429);
+
+         if ( cIsUploaded || cIsRefused )
+         {
+            if ( cIsRefused )
+               qWarning() << "YappariCrashReport: the crash reports were refused with HTTP status" << cStatus;
+
+            for ( const quint64 cId : inIds )
+               markCrashReportUploaded( cId );
+
+            mRetryDelayMs = qMax( mOptions.retryDelayMs, 1 );
+
+            _schedule( mOptions.minIntervalMs );
+            return;
+         }
+
+         int   delayMs = mRetryDelayMs;
+
+         bool  hasRetryAfter = false;
+         const int   cRetryAfter = inReply.rawHeader( "Retry-After" ).toInt( &hasRetryAfter );
+
+         if ( hasRetryAfter )
+            delayMs = qMax( delayMs, cRetryAfter * 1000 );
+
+         mRetryDelayMs = int( qMin( qint64( mRetryDelayMs ) * 2, qint64( qMax( mOptions.maxRetryDelayMs, 1 ) ) ) );
+
+         qWarning() << "YappariCrashReport: could not upload the crash reports, retrying in" << delayMs << "ms:"
+                    << inReply.errorString();
+
+         _schedule( qMax( delayMs, mOptions.minIntervalMs ) );
+      }
+
+      const QUrl  mEndpoint;
+      const CrashUploadOptions   mOptions;
+
+      QNetworkAccessManager   *mNetwork = nullptr;
+      QObject  *mContext = nullptr;
+      int   mRetryDelayMs = 0;
+   };
+
+   static CrashUploader *sUploader = nullptr;
+
+   void  startCrashUploads( const QUrl &inEndpoint, const CrashUploadOptions &inOptions )
+   {
+      QCoreApplication  *application = QCoreApplication::instance();
+
+      if ( application == nullptr )
+         return;
+
+      if ( sUploader == nullptr )
+      {
+         // a request can't outlive the application
+         QObject::connect( application, &QCoreApplication::aboutToQuit, [] () { stopCrashUploads(); } );
+      }
+      else
+      {
+         stopCrashUploads();
+
+         delete sUploader;
+      }
+
+      sUploader = new CrashUploader( inEndpoint, inOptions );
+
+      sUploader->start( QThread::IdlePriority );
+   }
+
+   void  stopCrashUploads()
+   {
+      if ( sUploader != nullptr && sUploader->isRunning() )
+         sUploader->stop();
+   }
+}
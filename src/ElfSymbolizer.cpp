@@ -0,0 +1,2146 @@
+/*
+ * Copyright (C) 2020 Naikel Aparicio. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ''AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the author and should not be interpreted as representing
+ * official policies, either expressed or implied, of the copyright holder.
+ */
+
+// References:
+//    http://www.sco.com/developers/gabi/latest/contents.html
+//    https://dwarfstd.org/doc/DWARF4.pdf
+//    https://dwarfstd.org/doc/DWARF5.pdf
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <unordered_map>
+
+#include <cxxabi.h>
+#include <elf.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "ElfSymbolizer.h"
+
+
+namespace YappariCrashReport
+{
+   namespace
+   {
+      // DWARF constants we need (see the DWARF 5 specification, chapter 7)
+      enum : uint64_t
+      {
+         DW_TAG_compile_unit = 0x11,
+         DW_TAG_inlined_subroutine = 0x1d,
+         DW_TAG_subprogram = 0x2e,
+         DW_TAG_partial_unit = 0x3c,
+         DW_TAG_skeleton_unit = 0x4a,
+
+         DW_AT_name = 0x03,
+         DW_AT_stmt_list = 0x10,
+         DW_AT_low_pc = 0x11,
+         DW_AT_high_pc = 0x12,
+         DW_AT_abstract_origin = 0x31,
+         DW_AT_specification = 0x47,
+         DW_AT_ranges = 0x55,
+         DW_AT_call_file = 0x58,
+         DW_AT_call_line = 0x59,
+         DW_AT_linkage_name = 0x6e,
+         DW_AT_str_offsets_base = 0x72,
+         DW_AT_addr_base = 0x73,
+         DW_AT_rnglists_base = 0x74,
+         DW_AT_MIPS_linkage_name = 0x2007,
+
+         DW_FORM_addr = 0x01,
+         DW_FORM_block2 = 0x03,
+         DW_FORM_block4 = 0x04,
+         DW_FORM_data2 = 0x05,
+         DW_FORM_data4 = 0x06,
+         DW_FORM_data8 = 0x07,
+         DW_FORM_string = 0x08,
+         DW_FORM_block = 0x09,
+         DW_FORM_block1 = 0x0a,
+         DW_FORM_data1 = 0x0b,
+         DW_FORM_flag = 0x0c,
+         DW_FORM_sdata = 0x0d,
+         DW_FORM_strp = 0x0e,
+         DW_FORM_udata = 0x0f,
+         DW_FORM_ref_addr = 0x10,
+         DW_FORM_ref1 = 0x11,
+         DW_FORM_ref2 = 0x12,
+         DW_FORM_ref4 = 0x13,
+         DW_FORM_ref8 = 0x14,
+         DW_FORM_ref_udata = 0x15,
+         DW_FORM_indirect = 0x16,
+         DW_FORM_sec_offset = 0x17,
+         DW_FORM_exprloc = 0x18,
+         DW_FORM_flag_present = 0x19,
+         DW_FORM_strx = 0x1a,
+         DW_FORM_addrx = 0x1b,
+         DW_FORM_ref_sup4 = 0x1c,
+         DW_FORM_strp_sup = 0x1d,
+         DW_FORM_data16 = 0x1e,
+         DW_FORM_line_strp = 0x1f,
+         DW_FORM_ref_sig8 = 0x20,
+         DW_FORM_implicit_const = 0x21,
+         DW_FORM_loclistx = 0x22,
+         DW_FORM_rnglistx = 0x23,
+         DW_FORM_ref_sup8 = 0x24,
+         DW_FORM_strx1 = 0x25,
+         DW_FORM_strx2 = 0x26,
+         DW_FORM_strx3 = 0x27,
+         DW_FORM_strx4 = 0x28,
+         DW_FORM_addrx1 = 0x29,
+         DW_FORM_addrx2 = 0x2a,
+         DW_FORM_addrx3 = 0x2b,
+         DW_FORM_addrx4 = 0x2c,
+         DW_FORM_GNU_addr_index = 0x1f01,
+         DW_FORM_GNU_str_index = 0x1f02,
+         DW_FORM_GNU_ref_alt = 0x1f20,
+         DW_FORM_GNU_strp_alt = 0x1f21,
+
+         DW_UT_compile = 0x01,
+         DW_UT_type = 0x02,
+         DW_UT_partial = 0x03,
+         DW_UT_skeleton = 0x04,
+         DW_UT_split_compile = 0x05,
+         DW_UT_split_type = 0x06,
+
+         DW_LNS_copy = 1,
+         DW_LNS_advance_pc = 2,
+         DW_LNS_advance_line = 3,
+         DW_LNS_set_file = 4,
+         DW_LNS_const_add_pc = 8,
+         DW_LNS_fixed_advance_pc = 9,
+
+         DW_LNE_end_sequence = 1,
+         DW_LNE_set_address = 2,
+
+         DW_LNCT_path = 1,
+         DW_LNCT_directory_index = 2,
+
+         DW_RLE_end_of_list = 0,
+         DW_RLE_base_addressx = 1,
+         DW_RLE_startx_endx = 2,
+         DW_RLE_startx_length = 3,
+         DW_RLE_offset_pair = 4,
+         DW_RLE_base_address = 5,
+         DW_RLE_start_end = 6,
+         DW_RLE_start_length = 7,
+      };
+
+      struct Section
+      {
+         const uint8_t  *data = nullptr;
+         uint64_t       size = 0;
+      };
+
+      // Bounds checked reader of (host endian) data in a memory mapped section.
+      // Reading past the end sets the error flag and returns zeros.
+      class DataReader
+      {
+         public:
+            DataReader() = default;
+            explicit DataReader( const Section &inSection, uint64_t inOffset = 0 ) :
+               mData( inSection.data ), mSize( inSection.size ), mOffset( inOffset )
+            {
+               mError = (mOffset > mSize);
+            }
+
+            bool     error() const { return mError; }
+            bool     atEnd() const { return mError || mOffset >= mSize; }
+            uint64_t offset() const { return mOffset; }
+
+            void  seek( uint64_t inOffset )
+            {
+               mOffset = inOffset;
+               mError = mError || (mOffset > mSize);
+            }
+
+            void  skip( uint64_t inSize )
+            {
+               if ( inSize > mSize - std::min( mOffset, mSize ) )
+               {
+                  mError = true;
+                  return;
+               }
+
+               mOffset += inSize;
+            }
+
+            uint64_t  unsignedN( int inSize )
+            {
+               if ( mError || inSize > 8 || uint64_t( inSize ) > mSize - mOffset )
+               {
+                  mError = true;
+                  return 0;
+               }
+
+               uint64_t value = 0;
+
+               for ( int i = 0; i < inSize; ++i )
+                  value |= uint64_t( mData[mOffset + i] ) << (8 * i);
+
+               mOffset += inSize;
+
+               return value;
+            }
+
+            uint8_t   u8() { return uint8_t( unsignedN( 1 ) ); }
+            uint16_t  u16() { return uint16_t( unsignedN( 2 ) ); }
+            uint32_t  u32() { return uint32_t( unsignedN( 4 ) ); }
+            uint64_t  u64() { return unsignedN( 8 ); }
+
+            uint64_t  uleb()
+            {
+               uint64_t value = 0;
+               int      shift = 0;
+
+               while ( !mError )
+               {
+                  if ( mOffset >= mSize )
+                  {
+                     mError = true;
+                     break;
+                  }
+
+                  const uint8_t cByte = mData[mOffset++];
+
+                  if ( shift < 64 )
+                     value |= uint64_t( cByte & 0x7f ) << shift;
+
+                  shift += 7;
+
+                  if ( (cByte & 0x80) == 0 )
+                     break;
+               }
+
+               return value;
+            }
+
+            int64_t  sleb()
+            {
+               int64_t  value = 0;
+               int      shift = 0;
+               uint8_t  byte = 0;
+
+               do
+               {
+                  if ( mError || mOffset >= mSize )
+                  {
+                     mError = true;
+                     return 0;
+                  }
+
+                  byte = mData[mOffset++];
+
+                  if ( shift < 64 )
+                     value |= int64_t( byte & 0x7f ) << shift;
+
+                  shift += 7;
+               } while ( byte & 0x80 );
+
+               if ( shift < 64 && (byte & 0x40) )
+                  value |= -(int64_t( 1 ) << shift);
+
+               return value;
+            }
+
+            const char  *cString()
+            {
+               if ( mError || mOffset >= mSize )
+               {
+                  mError = true;
+                  return "";
+               }
+
+               const char  *cStr = reinterpret_cast<const char *>(mData + mOffset);
+               const void  *cEnd = memchr( cStr, 0, mSize - mOffset );
+
+               if ( cEnd == nullptr )
+               {
+                  mError = true;
+                  return "";
+               }
+
+               mOffset += uint64_t( static_cast<const char *>(cEnd) - cStr ) + 1;
+
+               return cStr;
+            }
+
+            // Read an initial length field, returns the length and whether this is 64-bit DWARF
+            uint64_t  initialLength( bool &out64Bit )
+            {
+               uint64_t length = u32();
+
+               out64Bit = (length == 0xffffffff);
+
+               if ( out64Bit )
+                  length = u64();
+
+               return length;
+            }
+
+            uint64_t  offsetN( bool in64Bit ) { return in64Bit ? u64() : u32(); }
+
+         private:
+            const uint8_t  *mData = nullptr;
+            uint64_t       mSize = 0;
+            uint64_t       mOffset = 0;
+            bool           mError = false;
+      };
+
+      const char  *_sectionString( const Section &inSection, uint64_t inOffset )
+      {
+         if ( inOffset >= inSection.size )
+            return "";
+
+         const char  *cStr = reinterpret_cast<const char *>(inSection.data + inOffset);
+
+         return (memchr( cStr, 0, inSection.size - inOffset ) != nullptr) ? cStr : "";
+      }
+
+      // Demangle a symbol name, without the suffixes of the clones the optimizer makes (.cold, .isra.0, ...)
+      std::string  _demangle( const char *inName )
+      {
+         if ( strncmp( inName, "_Z", 2 ) != 0 )
+         {
+            const char  *cSuffix = strchr( inName, '.' );
+
+            return (cSuffix != nullptr && cSuffix != inName) ? std::string( inName, cSuffix ) : std::string( inName );
+         }
+
+         int   status = 0;
+         char  *demangled = abi::__cxa_demangle( inName, nullptr, nullptr, &status );
+
+         if ( demangled == nullptr )
+            return inName;
+
+         std::string result( demangled );
+
+         free( demangled );
+
+         const size_t   cClone = result.find( " [clone " );
+
+         if ( cClone != std::string::npos )
+            result.erase( cClone );
+
+         return result;
+      }
+
+      // The CRC-32 .gnu_debuglink uses (the same as zlib's)
+      uint32_t  _crc32( const uint8_t *inData, size_t inSize )
+      {
+         static uint32_t   sTable[256];
+         static const bool cTableReady = [] {
+            for ( uint32_t i = 0; i < 256; ++i )
+            {
+               uint32_t crc = i;
+
+               for ( int bit = 0; bit < 8; ++bit )
+                  crc = (crc & 1) ? (0xedb88320u ^ (crc >> 1)) : (crc >> 1);
+
+               sTable[i] = crc;
+            }
+
+            return true;
+         } ();
+
+         (void)cTableReady;
+
+         uint32_t crc = 0xffffffffu;
+
+         for ( size_t i = 0; i < inSize; ++i )
+            crc = sTable[(crc ^ inData[i]) & 0xff] ^ (crc >> 8);
+
+         return crc ^ 0xffffffffu;
+      }
+
+      std::string  _directoryName( const std::string &inPath )
+      {
+         const size_t   cSlash = inPath.rfind( '/' );
+
+         return (cSlash == std::string::npos) ? std::string( "." ) : inPath.substr( 0, cSlash );
+      }
+
+      struct AddressRange
+      {
+         uint64_t low;
+         uint64_t high;
+      };
+
+      bool  _contains( const std::vector<AddressRange> &inRanges, uint64_t inAddress )
+      {
+         for ( const AddressRange &range : inRanges )
+         {
+            if ( inAddress >= range.low && inAddress < range.high )
+               return true;
+         }
+
+         return false;
+      }
+
+      struct AttributeSpec
+      {
+         uint64_t attribute;
+         uint64_t form;
+         int64_t  implicitConst;
+      };
+
+      struct Abbreviation
+      {
+         uint64_t tag = 0;
+         bool     hasChildren = false;
+         std::vector<AttributeSpec> attributes;
+      };
+
+      using AbbreviationTable = std::unordered_map<uint64_t, Abbreviation>;
+
+      // A raw attribute value, resolved later because the bases it may depend on
+      // (DW_AT_str_offsets_base, DW_AT_addr_base, ...) can come after it
+      struct AttributeValue
+      {
+         uint64_t       form = 0;
+         uint64_t       value = 0;
+         const char     *string = nullptr;
+      };
+
+      // The file id of a row or a call site whose file isn't in the line tables
+      constexpr uint32_t   NO_FILE_ID = UINT32_MAX;
+   }
+
+   class ElfModule
+   {
+      public:
+         explicit ElfModule( const std::string &inPath );
+         ~ElfModule();
+
+         bool  isValid() const { return mData != nullptr; }
+
+         // Thread-safe: until the module is indexed the lookups take its lock, since they parse it lazily
+         bool  symbolize( uint64_t inAddress, std::vector<SourceLocation> &outLocations );
+
+         // Load everything symbolize() would load lazily, so it doesn't modify the module anymore
+         void  index();
+
+
+         bool  hasDebugInfo() const { return _section( ".debug_info" ).data != nullptr; }
+         std::string buildId() const;
+         bool  debugLink( std::string &outName, uint32_t &outCrc ) const;
+         uint32_t crc() const { return _crc32( static_cast<const uint8_t *>(mData), mSize ); }
+
+      private:
+         struct Symbol
+         {
+            uint64_t    address;
+            uint64_t    size;
+            const char  *name;
+         };
+
+         struct LineRow
+         {
+            uint64_t address;
+            uint32_t file;
+            uint32_t line;
+         };
+
+         struct LineSequence
+         {
+            uint64_t low;
+            uint64_t high;
+            size_t   firstRow;
+            size_t   lastRow;    // one past the last row
+         };
+
+         // A function or an inlined function instance covering some address ranges
+         struct Scope
+         {
+            std::vector<AddressRange>  ranges;
+            uint64_t dieOffset;
+            uint32_t depth;
+            bool     inlined;
+            uint64_t callFile;
+            uint64_t callLine;
+         };
+
+         struct Unit
+         {
+            uint64_t offset = 0;       // offset of the unit header in .debug_info
+            uint64_t dieOffset = 0;    // offset of the first DIE
+            uint64_t end = 0;
+            uint16_t version = 0;
+            uint8_t  addressSize = 8;
+            bool     is64Bit = false;
+            const AbbreviationTable *abbreviations = nullptr;
+
+            uint64_t baseAddress = 0;
+            uint64_t stmtList = ~uint64_t( 0 );
+            uint64_t strOffsetsBase = 0;
+            uint64_t addrBase = 0;
+            uint64_t rnglistsBase = 0;
+
+            bool                 scopesLoaded = false;
+            std::vector<Scope>   scopes;
+         };
+
+         struct UnitRange
+         {
+            uint64_t low;
+            uint64_t high;
+            size_t   unit;
+         };
+
+         Section  _section( const char *inName ) const;
+
+         void  _loadSymbols();
+         const Symbol *_findSymbol( uint64_t inAddress ) const;
+
+         void  _loadLines();
+         bool  _parseLineProgram( DataReader &ioReader );
+         std::string _lineString( DataReader &ioReader, uint64_t inForm, bool in64Bit );
+         bool  _findLine( uint64_t inAddress, uint32_t &outFile, uint32_t &outLine ) const;
+         uint32_t _fileId( uint64_t inStmtList, uint64_t inIndex ) const;
+         const std::string &_fileName( uint32_t inFileId ) const;
+
+         void  _loadUnits();
+         const AbbreviationTable *_abbreviations( uint64_t inOffset );
+         bool  _readAttribute( DataReader &ioReader, const Unit &inUnit, const AttributeSpec &inSpec, AttributeValue &outValue );
+         const char *_string( const Unit &inUnit, const AttributeValue &inValue ) const;
+         uint64_t _address( const Unit &inUnit, const AttributeValue &inValue ) const;
+         uint64_t _reference( const Unit &inUnit, const AttributeValue &inValue ) const;
+         std::vector<AddressRange> _ranges( const Unit &inUnit, const AttributeValue &inValue ) const;
+         void  _loadScopes( Unit &ioUnit );
+         const Unit *_unitForOffset( uint64_t inOffset ) const;
+         void  _dieNames( uint64_t inOffset, std::string &ioLinkageName, std::string &ioName, int inDepth );
+         std::string _functionName( uint64_t inDieOffset );
+         bool  _symbolize( uint64_t inAddress, std::vector<SourceLocation> &outLocations );
+
+         void     *mData = nullptr;
+         size_t   mSize = 0;
+
+         std::vector<std::pair<std::string, Section>> mSections;
+         bool  mHasCompressedDebug = false;   // whether there is debug information only the address mapping tool can read
+
+         bool  mSymbolsLoaded = false;
+         std::vector<Symbol> mSymbols;
+
+         bool  mLinesLoaded = false;
+         std::vector<std::string>   mFiles;
+         std::unordered_map<uint64_t, std::vector<uint32_t>> mLineTableFiles;   // line program offset -> file ids
+         std::vector<LineRow>       mLineRows;
+         std::vector<LineSequence>  mLineSequences;
+
+         bool  mUnitsLoaded = false;
+         Section  mDebugInfo;
+         Section  mDebugAbbrev;
+         Section  mDebugStr;
+         Section  mDebugLineStr;
+         Section  mDebugStrOffsets;
+         Section  mDebugAddr;
+         Section  mDebugRanges;
+         Section  mDebugRnglists;
+         std::unordered_map<uint64_t, std::unique_ptr<AbbreviationTable>> mAbbreviationTables;
+         std::vector<Unit>       mUnits;
+         std::vector<UnitRange>  mUnitRanges;
+
+         std::mutex     mMutex;        // serializes the lazy parsing
+         std::once_flag mIndexed;
+         std::atomic<bool> mIsIndexed{ false };
+   };
+
+   ElfModule::ElfModule( const std::string &inPath )
+   {
+      const int   cFd = open( inPath.c_str(), O_RDONLY | O_CLOEXEC );
+
+      if ( cFd < 0 )
+         return;
+
+      struct stat fileStat;
+
+      if ( fstat( cFd, &fileStat ) != 0 || size_t( fileStat.st_size ) < sizeof( Elf64_Ehdr ) )
+      {
+         close( cFd );
+         return;
+      }
+
+      void  *data = mmap( nullptr, size_t( fileStat.st_size ), PROT_READ, MAP_PRIVATE, cFd, 0 );
+
+      close( cFd );
+
+      if ( data == MAP_FAILED )
+         return;
+
+      mData = data;
+      mSize = size_t( fileStat.st_size );
+
+      const uint8_t     *cBytes = static_cast<const uint8_t *>(mData);
+      const Elf64_Ehdr  *cHeader = static_cast<const Elf64_Ehdr *>(mData);
+
+      // only native 64-bit ELF files are supported, anything else is left to the address mapping tool
+      const bool  cValid = (memcmp( cHeader->e_ident, ELFMAG, SELFMAG ) == 0) &&
+                           (cHeader->e_ident[EI_CLASS] == ELFCLASS64) &&
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+                           (cHeader->e_ident[EI_DATA] == ELFDATA2LSB) &&
+#else
+                           (cHeader->e_ident[EI_DATA] == ELFDATA2MSB) &&
+#endif
+                           (cHeader->e_shentsize == sizeof( Elf64_Shdr )) &&
+                           (cHeader->e_shoff != 0) && (cHeader->e_shoff < mSize);
+
+      if ( !cValid )
+      {
+         munmap( mData, mSize );
+         mData = nullptr;
+         return;
+      }
+
+      const Elf64_Shdr  *cSections = reinterpret_cast<const Elf64_Shdr *>(cBytes + cHeader->e_shoff);
+
+      uint64_t sectionCount = cHeader->e_shnum;
+      uint64_t stringsIndex = cHeader->e_shstrndx;
+
+      if ( sectionCount == 0 && (mSize - cHeader->e_shoff) >= sizeof( Elf64_Shdr ) )
+         sectionCount = cSections[0].sh_size;
+
+      if ( stringsIndex == SHN_XINDEX && (mSize - cHeader->e_shoff) >= sizeof( Elf64_Shdr ) )
+         stringsIndex = cSections[0].sh_link;
+
+      if ( sectionCount > (mSize - cHeader->e_shoff) / sizeof( Elf64_Shdr ) || stringsIndex >= sectionCount )
+         return;
+
+      const Elf64_Shdr  &cStrings = cSections[stringsIndex];
+
+      if ( cStrings.sh_offset > mSize || cStrings.sh_size > mSize - cStrings.sh_offset )
+         return;
+
+      const Section  cNames{ cBytes + cStrings.sh_offset, cStrings.sh_size };
+
+      mSections.reserve( sectionCount );
+
+      for ( uint64_t i = 0; i < sectionCount; ++i )
+      {
+         const Elf64_Shdr  &cSection = cSections[i];
+
+         Section  section;
+
+         const char  *cName = _sectionString( cNames, cSection.sh_name );
+
+         // compressed sections (-gz, or the older .zdebug ones) are left to the address mapping tool
+         const bool  cIsCompressed = (cSection.sh_flags & SHF_COMPRESSED) != 0 || strncmp( cName, ".zdebug", 7 ) == 0;
+
+         if ( cIsCompressed && (strncmp( cName, ".debug", 6 ) == 0 || strncmp( cName, ".zdebug", 7 ) == 0) )
+            mHasCompressedDebug = true;
+
+         if ( cSection.sh_type != SHT_NOBITS && !cIsCompressed &&
+              cSection.sh_offset <= mSize && cSection.sh_size <= mSize - cSection.sh_offset )
+         {
+            section.data = cBytes + cSection.sh_offset;
+            section.size = cSection.sh_size;
+         }
+
+         mSections.emplace_back( cName, section );
+      }
+   }
+
+   ElfModule::~ElfModule()
+   {
+      if ( mData != nullptr )
+         munmap( mData, mSize );
+   }
+
+   Section  ElfModule::_section( const char *inName ) const
+   {
+      for ( const auto &section : mSections )
+      {
+         if ( section.first == inName && section.second.data != nullptr )
+            return section.second;
+      }
+
+      return Section();
+   }
+
+   //
+   // Symbol tables
+   //
+
+   void  ElfModule::_loadSymbols()
+   {
+      if ( mSymbolsLoaded )
+         return;
+
+      mSymbolsLoaded = true;
+
+      const Elf64_Ehdr  *cHeader = static_cast<const Elf64_Ehdr *>(mData);
+      const Elf64_Shdr  *cSections = reinterpret_cast<const Elf64_Shdr *>(static_cast<const uint8_t *>(mData) + cHeader->e_shoff);
+
+      // use .symtab if the binary wasn't stripped, and .dynsym otherwise
+      for ( uint32_t type : { SHT_SYMTAB, SHT_DYNSYM } )
+      {
+         for ( size_t i = 0; i < mSections.size(); ++i )
+         {
+            const Elf64_Shdr  &cSection = cSections[i];
+
+            if ( cSection.sh_type != type || mSections[i].second.data == nullptr || cSection.sh_link >= mSections.size() )
+               continue;
+
+            const Section  cSymbols = mSections[i].second;
+            const Section  cStrings = mSections[cSection.sh_link].second;
+            const size_t   cCount = cSymbols.size / sizeof( Elf64_Sym );
+
+            for ( size_t j = 0; j < cCount; ++j )
+            {
+               Elf64_Sym  symbol;
+
+               memcpy( &symbol, cSymbols.data + j * sizeof( Elf64_Sym ), sizeof( Elf64_Sym ) );
+
+               const int   cType = ELF64_ST_TYPE( symbol.st_info );
+
+               if ( (cType != STT_FUNC && cType != STT_GNU_IFUNC) || symbol.st_shndx == SHN_UNDEF || symbol.st_value == 0 )
+                  continue;
+
+               mSymbols.push_back( { symbol.st_value, symbol.st_size, _sectionString( cStrings, symbol.st_name ) } );
+            }
+         }
+
+         if ( !mSymbols.empty() )
+            break;
+      }
+
+      // sort by address, the biggest symbol first when several share an address
+      std::sort( mSymbols.begin(), mSymbols.end(), [] ( const Symbol &inA, const Symbol &inB ) {
+         return (inA.address != inB.address) ? (inA.address < inB.address) : (inA.size > inB.size);
+      } );
+
+      mSymbols.erase( std::unique( mSymbols.begin(), mSymbols.end(), [] ( const Symbol &inA, const Symbol &inB ) {
+         return inA.address == inB.address;
+      } ), mSymbols.end() );
+   }
+
+   const ElfModule::Symbol *ElfModule::_findSymbol( uint64_t inAddress ) const
+   {
+      auto  iter = std::upper_bound( mSymbols.begin(), mSymbols.end(), inAddress, [] ( uint64_t inValue, const Symbol &inSymbol ) {
+         return inValue < inSymbol.address;
+      } );
+
+      if ( iter == mSymbols.begin() )
+         return nullptr;
+
+      --iter;
+
+      if ( iter->size != 0 && inAddress >= iter->address + iter->size )
+         return nullptr;
+
+      return &(*iter);
+   }
+
+   //
+   // Line tables (.debug_line)
+   //
+
+   void  ElfModule::_loadLines()
+   {
+      if ( mLinesLoaded )
+         return;
+
+      mLinesLoaded = true;
+
+      _loadUnits();
+
+      const Section  cDebugLine = _section( ".debug_line" );
+
+      if ( cDebugLine.data == nullptr )
+         return;
+
+      DataReader  reader( cDebugLine );
+
+      while ( !reader.atEnd() )
+      {
+         if ( !_parseLineProgram( reader ) )
+            break;
+      }
+
+      std::sort( mLineSequences.begin(), mLineSequences.end(), [] ( const LineSequence &inA, const LineSequence &inB ) {
+         return inA.low < inB.low;
+      } );
+   }
+
+   std::string  ElfModule::_lineString( DataReader &ioReader, uint64_t inForm, bool in64Bit )
+   {
+      switch ( inForm )
+      {
+         case DW_FORM_string:
+            return ioReader.cString();
+         case DW_FORM_line_strp:
+            return _sectionString( mDebugLineStr, ioReader.offsetN( in64Bit ) );
+         case DW_FORM_strp:
+            return _sectionString( mDebugStr, ioReader.offsetN( in64Bit ) );
+         default:
+            return std::string();
+      }
+   }
+
+   bool  ElfModule::_parseLineProgram( DataReader &ioReader )
+   {
+      const uint64_t cProgramOffset = ioReader.offset();
+
+      bool     is64Bit = false;
+      uint64_t length = ioReader.initialLength( is64Bit );
+      uint64_t programEnd = ioReader.offset() + length;
+
+      const uint16_t cVersion = ioReader.u16();
+
+      if ( ioReader.error() || length == 0 || cVersion < 2 || cVersion > 5 )
+         return false;
+
+      uint8_t  addressSize = 8;
+
+      if ( cVersion >= 5 )
+      {
+         addressSize = ioReader.u8();
+         ioReader.u8();    // segment selector size
+      }
+
+      const uint64_t cHeaderLength = ioReader.offsetN( is64Bit );
+      const uint64_t cProgramStart = ioReader.offset() + cHeaderLength;
+
+      const uint8_t  cMinInstructionLength = ioReader.u8();
+
+      if ( cVersion >= 4 )
+         ioReader.u8();    // maximum operations per instruction, only used by VLIW architectures
+
+      ioReader.u8();       // default is_stmt
+
+      const int8_t   cLineBase = int8_t( ioReader.u8() );
+      const uint8_t  cLineRange = ioReader.u8();
+      const uint8_t  cOpcodeBase = ioReader.u8();
+
+      if ( ioReader.error() || cLineRange == 0 || cOpcodeBase == 0 )
+         return false;
+
+      std::vector<uint8_t> standardOpcodeLengths( cOpcodeBase, 0 );
+
+      for ( int i = 1; i < cOpcodeBase; ++i )
+         standardOpcodeLengths[i] = ioReader.u8();
+
+      // directories and files, ids of files refer to mFiles
+      std::vector<std::string>   directories;
+      std::vector<uint32_t>      &files = mLineTableFiles[cProgramOffset];
+
+      files.clear();
+
+      auto  addFile = [&] ( const std::string &inName, uint64_t inDirectory ) {
+         std::string path = inName;
+
+         if ( !inName.empty() && inName[0] != '/' && inDirectory < directories.size() && !directories[inDirectory].empty() )
+            path = directories[inDirectory] + '/' + inName;
+
+         files.push_back( uint32_t( mFiles.size() ) );
+         mFiles.push_back( path );
+      };
+
+      if ( cVersion < 5 )
+      {
+         // directory 0 is the compilation directory and file 0 doesn't exist
+         directories.emplace_back();
+         files.push_back( 0 );
+         mFiles.emplace_back();
+         files.back() = uint32_t( mFiles.size() - 1 );
+
+         while ( !ioReader.atEnd() )
+         {
+            const char  *cDirectory = ioReader.cString();
+
+            if ( *cDirectory == '\0' )
+               break;
+
+            directories.emplace_back( cDirectory );
+         }
+
+         while ( !ioReader.atEnd() )
+         {
+            const char  *cName = ioReader.cString();
+
+            if ( *cName == '\0' )
+               break;
+
+            const uint64_t cDirectory = ioReader.uleb();
+
+            ioReader.uleb();  // modification time
+            ioReader.uleb();  // file length
+
+            addFile( cName, cDirectory );
+         }
+      }
+      else
+      {
+         for ( int pass = 0; pass < 2 && !ioReader.error(); ++pass )
+         {
+            std::vector<std::pair<uint64_t, uint64_t>> formats( ioReader.u8() );
+
+            for ( auto &format : formats )
+            {
+               format.first = ioReader.uleb();
+               format.second = ioReader.uleb();
+            }
+
+            const uint64_t cCount = ioReader.uleb();
+
+            for ( uint64_t i = 0; i < cCount && !ioReader.error(); ++i )
+            {
+               std::string name;
+               uint64_t    directory = 0;
+
+               for ( const auto &format : formats )
+               {
+                  switch ( format.second )
+                  {
+                     case DW_FORM_string:
+                     case DW_FORM_line_strp:
+                     case DW_FORM_strp:
+                     {
+                        const std::string cString = _lineString( ioReader, format.second, is64Bit );
+
+                        if ( format.first == DW_LNCT_path )
+                           name = cString;
+                        break;
+                     }
+                     case DW_FORM_udata:
+                     case DW_FORM_data1:
+                     case DW_FORM_data2:
+                     case DW_FORM_data4:
+                     case DW_FORM_data8:
+                     {
+                        const uint64_t cValue = (format.second == DW_FORM_udata) ? ioReader.uleb() :
+                                                (format.second == DW_FORM_data1) ? ioReader.u8() :
+                                                (format.second == DW_FORM_data2) ? ioReader.u16() :
+                                                (format.second == DW_FORM_data4) ? ioReader.u32() : ioReader.u64();
+
+                        if ( format.first == DW_LNCT_directory_index )
+                           directory = cValue;
+                        break;
+                     }
+                     case DW_FORM_data16:
+                        ioReader.skip( 16 );
+                        break;
+                     case DW_FORM_block:
+                        ioReader.skip( ioReader.uleb() );
+                        break;
+                     default:
+                        // we can't know the size of this entry, so the rest of the header is unusable
+                        ioReader.seek( programEnd );
+                        return !ioReader.error();
+                  }
+               }
+
+               if ( pass == 0 )
+                  directories.push_back( name );
+               else
+                  addFile( name, directory );
+            }
+         }
+      }
+
+      if ( ioReader.error() )
+         return false;
+
+      // run the line number program
+      ioReader.seek( cProgramStart );
+
+      uint64_t address = 0;
+      uint64_t file = 1;
+      int64_t  line = 1;
+      size_t   sequenceStart = mLineRows.size();
+
+      auto  emitRow = [&] () {
+         const uint32_t cFileId = (file < files.size()) ? files[file] : NO_FILE_ID;
+
+         mLineRows.push_back( { address, cFileId, uint32_t( line ) } );
+      };
+
+      while ( ioReader.offset() < programEnd && !ioReader.error() )
+      {
+         const uint8_t  cOpcode = ioReader.u8();
+
+         if ( cOpcode >= cOpcodeBase )
+         {
+            const uint8_t  cAdjusted = cOpcode - cOpcodeBase;
+
+            address += uint64_t( cAdjusted / cLineRange ) * cMinInstructionLength;
+            line += cLineBase + (cAdjusted % cLineRange);
+
+            emitRow();
+            continue;
+         }
+
+         switch ( cOpcode )
+         {
+            case 0:
+            {
+               const uint64_t cLength = ioReader.uleb();
+               const uint64_t cEnd = ioReader.offset() + cLength;
+
+               if ( cLength == 0 )
+                  break;
+
+               const uint8_t  cSubOpcode = ioReader.u8();
+
+               if ( cSubOpcode == DW_LNE_end_sequence )
+               {
+                  emitRow();
+
+                  // sequences of functions discarded by the linker start at 0
+                  if ( mLineRows[sequenceStart].address != 0 && mLineRows[sequenceStart].address < address )
+                     mLineSequences.push_back( { mLineRows[sequenceStart].address, address, sequenceStart, mLineRows.size() } );
+                  else
+                     mLineRows.resize( sequenceStart );
+
+                  sequenceStart = mLineRows.size();
+                  address = 0;
+                  file = 1;
+                  line = 1;
+               }
+               else if ( cSubOpcode == DW_LNE_set_address )
+               {
+                  address = ioReader.unsignedN( int( std::min<uint64_t>( cLength - 1, addressSize ) ) );
+               }
+
+               ioReader.seek( cEnd );
+               break;
+            }
+            case DW_LNS_copy:
+               emitRow();
+               break;
+            case DW_LNS_advance_pc:
+               address += ioReader.uleb() * cMinInstructionLength;
+               break;
+            case DW_LNS_advance_line:
+               line += ioReader.sleb();
+               break;
+            case DW_LNS_set_file:
+               file = ioReader.uleb();
+               break;
+            case DW_LNS_const_add_pc:
+               address += uint64_t( (255 - cOpcodeBase) / cLineRange ) * cMinInstructionLength;
+               break;
+            case DW_LNS_fixed_advance_pc:
+               address += ioReader.u16();
+               break;
+            default:
+               // skip the arguments of opcodes we don't care about
+               for ( int i = 0; i < standardOpcodeLengths[cOpcode]; ++i )
+                  ioReader.uleb();
+               break;
+         }
+      }
+
+      // drop an unterminated sequence
+      mLineRows.resize( sequenceStart );
+
+      ioReader.seek( programEnd );
+
+      return !ioReader.error();
+   }
+
+   bool  ElfModule::_findLine( uint64_t inAddress, uint32_t &outFile, uint32_t &outLine ) const
+   {
+      auto  sequence = std::upper_bound( mLineSequences.begin(), mLineSequences.end(), inAddress, [] ( uint64_t inValue, const LineSequence &inSequence ) {
+         return inValue < inSequence.low;
+      } );
+
+      while ( sequence != mLineSequences.begin() )
+      {
+         --sequence;
+
+         if ( inAddress >= sequence->high )
+            continue;
+
+         const auto  cBegin = mLineRows.begin() + long( sequence->firstRow );
+         const auto  cEnd = mLineRows.begin() + long( sequence->lastRow );
+
+         auto  row = std::upper_bound( cBegin, cEnd, inAddress, [] ( uint64_t inValue, const LineRow &inRow ) {
+            return inValue < inRow.address;
+         } );
+
+         if ( row == cBegin )
+            return false;
+
+         --row;
+
+         outFile = row->file;
+         outLine = row->line;
+
+         return true;
+      }
+
+      return false;
+   }
+
+   uint32_t  ElfModule::_fileId( uint64_t inStmtList, uint64_t inIndex ) const
+   {
+      const auto  cFiles = mLineTableFiles.find( inStmtList );
+
+      if ( cFiles == mLineTableFiles.end() || inIndex >= cFiles->second.size() )
+         return NO_FILE_ID;
+
+      return cFiles->second[inIndex];
+   }
+
+   const std::string  &ElfModule::_fileName( uint32_t inFileId ) const
+   {
+      static const std::string   sUnknownFile;
+
+      // a module without .debug_line, or a damaged one, has no files (or not the ones its rows refer to)
+      return (inFileId < mFiles.size()) ? mFiles[inFileId] : sUnknownFile;
+   }
+
+   //
+   // Debug information (.debug_info)
+   //
+
+   const AbbreviationTable *ElfModule::_abbreviations( uint64_t inOffset )
+   {
+      auto  &table = mAbbreviationTables[inOffset];
+
+      if ( table != nullptr )
+         return table.get();
+
+      table.reset( new AbbreviationTable );
+
+      DataReader  reader( mDebugAbbrev, inOffset );
+
+      while ( !reader.atEnd() )
+      {
+         const uint64_t cCode = reader.uleb();
+
+         if ( cCode == 0 )
+            break;
+
+         Abbreviation   &abbreviation = (*table)[cCode];
+
+         abbreviation.tag = reader.uleb();
+         abbreviation.hasChildren = (reader.u8() != 0);
+
+         while ( !reader.atEnd() )
+         {
+            AttributeSpec  spec{ reader.uleb(), reader.uleb(), 0 };
+
+            if ( spec.attribute == 0 && spec.form == 0 )
+               break;
+
+            if ( spec.form == DW_FORM_implicit_const )
+               spec.implicitConst = reader.sleb();
+
+            abbreviation.attributes.push_back( spec );
+         }
+      }
+
+      return table.get();
+   }
+
+   bool  ElfModule::_readAttribute( DataReader &ioReader, const Unit &inUnit, const AttributeSpec &inSpec, AttributeValue &outValue )
+   {
+      uint64_t form = inSpec.form;
+
+      if ( form == DW_FORM_indirect )
+         form = ioReader.uleb();
+
+      outValue.form = form;
+      outValue.value = 0;
+      outValue.string = nullptr;
+
+      switch ( form )
+      {
+         case DW_FORM_addr:
+            outValue.value = ioReader.unsignedN( inUnit.addressSize );
+            break;
+         case DW_FORM_data1:
+         case DW_FORM_ref1:
+         case DW_FORM_flag:
+         case DW_FORM_strx1:
+         case DW_FORM_addrx1:
+            outValue.value = ioReader.u8();
+            break;
+         case DW_FORM_data2:
+         case DW_FORM_ref2:
+         case DW_FORM_strx2:
+         case DW_FORM_addrx2:
+            outValue.value = ioReader.u16();
+            break;
+         case DW_FORM_strx3:
+         case DW_FORM_addrx3:
+            outValue.value = ioReader.unsignedN( 3 );
+            break;
+         case DW_FORM_data4:
+         case DW_FORM_ref4:
+         case DW_FORM_ref_sup4:
+         case DW_FORM_strx4:
+         case DW_FORM_addrx4:
+            outValue.value = ioReader.u32();
+            break;
+         case DW_FORM_data8:
+         case DW_FORM_ref8:
+         case DW_FORM_ref_sig8:
+         case DW_FORM_ref_sup8:
+            outValue.value = ioReader.u64();
+            break;
+         case DW_FORM_data16:
+            ioReader.skip( 16 );
+            break;
+         case DW_FORM_sdata:
+            outValue.value = uint64_t( ioReader.sleb() );
+            break;
+         case DW_FORM_udata:
+         case DW_FORM_ref_udata:
+         case DW_FORM_strx:
+         case DW_FORM_addrx:
+         case DW_FORM_loclistx:
+         case DW_FORM_rnglistx:
+         case DW_FORM_GNU_addr_index:
+         case DW_FORM_GNU_str_index:
+            outValue.value = ioReader.uleb();
+            break;
+         case DW_FORM_string:
+            outValue.string = ioReader.cString();
+            break;
+         case DW_FORM_strp:
+         case DW_FORM_line_strp:
+         case DW_FORM_sec_offset:
+         case DW_FORM_strp_sup:
+         case DW_FORM_GNU_ref_alt:
+         case DW_FORM_GNU_strp_alt:
+            outValue.value = ioReader.offsetN( inUnit.is64Bit );
+            break;
+         case DW_FORM_ref_addr:
+            // DWARF 2 used the address size for this
+            outValue.value = (inUnit.version <= 2) ? ioReader.unsignedN( inUnit.addressSize ) : ioReader.offsetN( inUnit.is64Bit );
+            break;
+         case DW_FORM_exprloc:
+         case DW_FORM_block:
+            ioReader.skip( ioReader.uleb() );
+            break;
+         case DW_FORM_block1:
+            ioReader.skip( ioReader.u8() );
+            break;
+         case DW_FORM_block2:
+            ioReader.skip( ioReader.u16() );
+            break;
+         case DW_FORM_block4:
+            ioReader.skip( ioReader.u32() );
+            break;
+         case DW_FORM_flag_present:
+            outValue.value = 1;
+            break;
+         case DW_FORM_implicit_const:
+            outValue.value = uint64_t( inSpec.implicitConst );
+            break;
+         default:
+            // unknown form: we can't skip it so the rest of the unit is unusable
+            return false;
+      }
+
+      return !ioReader.error();
+   }
+
+   const char  *ElfModule::_string( const Unit &inUnit, const AttributeValue &inValue ) const
+   {
+      switch ( inValue.form )
+      {
+         case DW_FORM_string:
+            return inValue.string;
+         case DW_FORM_strp:
+            return _sectionString( mDebugStr, inValue.value );
+         case DW_FORM_line_strp:
+            return _sectionString( mDebugLineStr, inValue.value );
+         case DW_FORM_strx:
+         case DW_FORM_strx1:
+         case DW_FORM_strx2:
+         case DW_FORM_strx3:
+         case DW_FORM_strx4:
+         case DW_FORM_GNU_str_index:
+         {
+            const int      cOffsetSize = inUnit.is64Bit ? 8 : 4;
+            DataReader     reader( mDebugStrOffsets, inUnit.strOffsetsBase + inValue.value * uint64_t( cOffsetSize ) );
+            const uint64_t cOffset = reader.unsignedN( cOffsetSize );
+
+            return reader.error() ? "" : _sectionString( mDebugStr, cOffset );
+         }
+         default:
+            return "";
+      }
+   }
+
+   uint64_t  ElfModule::_address( const Unit &inUnit, const AttributeValue &inValue ) const
+   {
+      switch ( inValue.form )
+      {
+         case DW_FORM_addrx:
+         case DW_FORM_addrx1:
+         case DW_FORM_addrx2:
+         case DW_FORM_addrx3:
+         case DW_FORM_addrx4:
+         case DW_FORM_GNU_addr_index:
+         {
+            DataReader  reader( mDebugAddr, inUnit.addrBase + inValue.value * inUnit.addressSize );
+
+            return reader.unsignedN( inUnit.addressSize );
+         }
+         default:
+            return inValue.value;
+      }
+   }
+
+   uint64_t  ElfModule::_reference( const Unit &inUnit, const AttributeValue &inValue ) const
+   {
+      switch ( inValue.form )
+      {
+         case DW_FORM_ref1:
+         case DW_FORM_ref2:
+         case DW_FORM_ref4:
+         case DW_FORM_ref8:
+         case DW_FORM_ref_udata:
+            return inUnit.offset + inValue.value;
+         case DW_FORM_ref_addr:
+            return inValue.value;
+         default:
+            // references to type units and supplementary files are not supported
+            return ~uint64_t( 0 );
+      }
+   }
+
+   std::vector<AddressRange>  ElfModule::_ranges( const Unit &inUnit, const AttributeValue &inValue ) const
+   {
+      std::vector<AddressRange>  ranges;
+
+      uint64_t baseAddress = inUnit.baseAddress;
+
+      auto  addRange = [&ranges] ( uint64_t inLow, uint64_t inHigh ) {
+         // ranges of code discarded by the linker start at 0
+         if ( inLow != 0 && inLow < inHigh )
+            ranges.push_back( { inLow, inHigh } );
+      };
+
+      if ( inUnit.version < 5 )
+      {
+         DataReader  reader( mDebugRanges, inValue.value );
+
+         const uint64_t cBaseSelector = (inUnit.addressSize == 4) ? 0xffffffff : ~uint64_t( 0 );
+
+         while ( !reader.atEnd() )
+         {
+            const uint64_t cStart = reader.unsignedN( inUnit.addressSize );
+            const uint64_t cEnd = reader.unsignedN( inUnit.addressSize );
+
+            if ( reader.error() || (cStart == 0 && cEnd == 0) )
+               break;
+
+            if ( cStart == cBaseSelector )
+               baseAddress = cEnd;
+            else
+               addRange( baseAddress + cStart, baseAddress + cEnd );
+         }
+
+         return ranges;
+      }
+
+      uint64_t offset = inValue.value;
+
+      if ( inValue.form == DW_FORM_rnglistx )
+      {
+         const int   cOffsetSize = inUnit.is64Bit ? 8 : 4;
+         DataReader  reader( mDebugRnglists, inUnit.rnglistsBase + inValue.value * uint64_t( cOffsetSize ) );
+
+         offset = inUnit.rnglistsBase + reader.unsignedN( cOffsetSize );
+
+         if ( reader.error() )
+            return ranges;
+      }
+
+      auto  indexedAddress = [this, &inUnit] ( uint64_t inIndex ) {
+         return _address( inUnit, AttributeValue{ DW_FORM_addrx, inIndex, nullptr } );
+      };
+
+      DataReader  reader( mDebugRnglists, offset );
+
+      while ( !reader.atEnd() )
+      {
+         const uint8_t  cKind = reader.u8();
+
+         if ( cKind == DW_RLE_end_of_list )
+            break;
+
+         switch ( cKind )
+         {
+            case DW_RLE_base_addressx:
+               baseAddress = indexedAddress( reader.uleb() );
+               break;
+            case DW_RLE_startx_endx:
+            {
+               const uint64_t cStart = indexedAddress( reader.uleb() );
+               addRange( cStart, indexedAddress( reader.uleb() ) );
+               break;
+            }
+            case DW_RLE_startx_length:
+            {
+               const uint64_t cStart = indexedAddress( reader.uleb() );
+               addRange( cStart, cStart + reader.uleb() );
+               break;
+            }
+            case DW_RLE_offset_pair:
+            {
+               const uint64_t cStart = reader.uleb();
+               addRange( baseAddress + cStart, baseAddress + reader.uleb() );
+               break;
+            }
+            case DW_RLE_base_address:
+               baseAddress = reader.unsignedN( inUnit.addressSize );
+               break;
+            case DW_RLE_start_end:
+            {
+               const uint64_t cStart = reader.unsignedN( inUnit.addressSize );
+               addRange( cStart, reader.unsignedN( inUnit.addressSize ) );
+               break;
+            }
+            case DW_RLE_start_length:
+            {
+               const uint64_t cStart = reader.unsignedN( inUnit.addressSize );
+               addRange( cStart, cStart + reader.uleb() );
+               break;
+            }
+            default:
+               return ranges;
+         }
+      }
+
+      return ranges;
+   }
+
+   void  ElfModule::_loadUnits()
+   {
+      if ( mUnitsLoaded )
+         return;
+
+      mUnitsLoaded = true;
+
+      mDebugInfo = _section( ".debug_info" );
+      mDebugAbbrev = _section( ".debug_abbrev" );
+      mDebugStr = _section( ".debug_str" );
+      mDebugLineStr = _section( ".debug_line_str" );
+      mDebugStrOffsets = _section( ".debug_str_offsets" );
+      mDebugAddr = _section( ".debug_addr" );
+      mDebugRanges = _section( ".debug_ranges" );
+      mDebugRnglists = _section( ".debug_rnglists" );
+
+      if ( mDebugInfo.data == nullptr || mDebugAbbrev.data == nullptr )
+         return;
+
+      DataReader  reader( mDebugInfo );
+
+      while ( !reader.atEnd() )
+      {
+         Unit  unit;
+
+         unit.offset = reader.offset();
+
+         const uint64_t cLength = reader.initialLength( unit.is64Bit );
+
+         unit.end = reader.offset() + cLength;
+         unit.version = reader.u16();
+
+         if ( reader.error() || cLength == 0 || unit.end > mDebugInfo.size || unit.version < 2 || unit.version > 5 )
+            break;
+
+         uint8_t  unitType = DW_UT_compile;
+         uint64_t abbreviationOffset = 0;
+
+         if ( unit.version >= 5 )
+         {
+            unitType = reader.u8();
+            unit.addressSize = reader.u8();
+            abbreviationOffset = reader.offsetN( unit.is64Bit );
+
+            if ( unitType == DW_UT_skeleton || unitType == DW_UT_split_compile )
+               reader.skip( 8 );
+            else if ( unitType == DW_UT_type || unitType == DW_UT_split_type )
+               reader.skip( 8 + (unit.is64Bit ? 8 : 4) );
+         }
+         else
+         {
+            abbreviationOffset = reader.offsetN( unit.is64Bit );
+            unit.addressSize = reader.u8();
+         }
+
+         unit.dieOffset = reader.offset();
+
+         // default bases for units that use indexed forms without setting them
+         unit.strOffsetsBase = unit.is64Bit ? 16 : 8;
+         unit.addrBase = 8;
+         unit.rnglistsBase = unit.is64Bit ? 20 : 12;
+
+         if ( reader.error() || (unit.addressSize != 4 && unit.addressSize != 8) ||
+              (unitType != DW_UT_compile && unitType != DW_UT_partial) )
+         {
+            reader.seek( unit.end );
+            continue;
+         }
+
+         unit.abbreviations = _abbreviations( abbreviationOffset );
+
+         // read the unit DIE
+         const uint64_t       cCode = reader.uleb();
+         const auto           cAbbreviation = unit.abbreviations->find( cCode );
+
+         if ( cCode == 0 || cAbbreviation == unit.abbreviations->end() )
+         {
+            reader.seek( unit.end );
+            continue;
+         }
+
+         std::vector<std::pair<uint64_t, AttributeValue>>  attributes;
+         bool  ok = true;
+
+         for ( const AttributeSpec &spec : cAbbreviation->second.attributes )
+         {
+            AttributeValue value;
+
+            if ( !_readAttribute( reader, unit, spec, value ) )
+            {
+               ok = false;
+               break;
+            }
+
+            attributes.emplace_back( spec.attribute, value );
+
+            switch ( spec.attribute )
+            {
+               case DW_AT_stmt_list:
+                  unit.stmtList = value.value;
+                  break;
+               case DW_AT_str_offsets_base:
+                  unit.strOffsetsBase = value.value;
+                  break;
+               case DW_AT_addr_base:
+                  unit.addrBase = value.value;
+                  break;
+               case DW_AT_rnglists_base:
+                  unit.rnglistsBase = value.value;
+                  break;
+               default:
+                  break;
+            }
+         }
+
+         if ( !ok )
+         {
+            reader.seek( unit.end );
+            continue;
+         }
+
+         // now that we know the bases, find the address ranges of the unit
+         std::vector<AddressRange>  ranges;
+         uint64_t lowPc = 0;
+         AttributeValue highPc;
+         bool  hasHighPc = false;
+
+         for ( const auto &attribute : attributes )
+         {
+            if ( attribute.first == DW_AT_low_pc )
+               lowPc = _address( unit, attribute.second );
+            else if ( attribute.first == DW_AT_high_pc )
+            {
+               highPc = attribute.second;
+               hasHighPc = true;
+            }
+         }
+
+         unit.baseAddress = lowPc;
+
+         for ( const auto &attribute : attributes )
+         {
+            if ( attribute.first == DW_AT_ranges )
+               ranges = _ranges( unit, attribute.second );
+         }
+
+         if ( ranges.empty() && hasHighPc && lowPc != 0 )
+         {
+            const bool  cIsAddress = (highPc.form == DW_FORM_addr) || (highPc.form >= DW_FORM_addrx1 && highPc.form <= DW_FORM_addrx4) ||
+                                     highPc.form == DW_FORM_addrx;
+            const uint64_t cHighPc = cIsAddress ? _address( unit, highPc ) : lowPc + highPc.value;
+
+            if ( lowPc < cHighPc )
+               ranges.push_back( { lowPc, cHighPc } );
+         }
+
+         const size_t   cUnitIndex = mUnits.size();
+
+         mUnits.push_back( unit );
+
+         // units that don't say which addresses they cover need to be fully read
+         if ( ranges.empty() )
+         {
+            _loadScopes( mUnits.back() );
+
+            for ( const Scope &scope : mUnits.back().scopes )
+            {
+               if ( !scope.inlined )
+                  ranges.insert( ranges.end(), scope.ranges.begin(), scope.ranges.end() );
+            }
+         }
+
+         for ( const AddressRange &range : ranges )
+            mUnitRanges.push_back( { range.low, range.high, cUnitIndex } );
+
+         reader.seek( unit.end );
+      }
+
+      std::sort( mUnitRanges.begin(), mUnitRanges.end(), [] ( const UnitRange &inA, const UnitRange &inB ) {
+         return inA.low < inB.low;
+      } );
+   }
+
+   void  ElfModule::_loadScopes( Unit &ioUnit )
+   {
+      if ( ioUnit.scopesLoaded )
+         return;
+
+      ioUnit.scopesLoaded = true;
+
+      DataReader  reader( mDebugInfo, ioUnit.dieOffset );
+
+      uint32_t depth = 0;
+
+      std::vector<std::pair<uint64_t, AttributeValue>>  attributes;
+
+      while ( reader.offset() < ioUnit.end && !reader.error() )
+      {
+         const uint64_t cDieOffset = reader.offset();
+         const uint64_t cCode = reader.uleb();
+
+         if ( cCode == 0 )
+         {
+            if ( depth == 0 )
+               break;
+
+            --depth;
+            continue;
+         }
+
+         const auto  cAbbreviation = ioUnit.abbreviations->find( cCode );
+
+         if ( cAbbreviation == ioUnit.abbreviations->end() )
+            break;
+
+         const Abbreviation   &cAbbrev = cAbbreviation->second;
+         const bool           cWanted = (cAbbrev.tag == DW_TAG_subprogram || cAbbrev.tag == DW_TAG_inlined_subroutine);
+
+         attributes.clear();
+
+         bool  ok = true;
+
+         for ( const AttributeSpec &spec : cAbbrev.attributes )
+         {
+            AttributeValue value;
+
+            if ( !_readAttribute( reader, ioUnit, spec, value ) )
+            {
+               ok = false;
+               break;
+            }
+
+            if ( cWanted )
+               attributes.emplace_back( spec.attribute, value );
+         }
+
+         if ( !ok )
+            break;
+
+         if ( cWanted )
+         {
+            Scope scope{ {}, cDieOffset, depth, cAbbrev.tag == DW_TAG_inlined_subroutine, 0, 0 };
+
+            uint64_t lowPc = 0;
+            uint64_t highPc = 0;
+            bool     highPcIsOffset = false;
+
+            for ( const auto &attribute : attributes )
+            {
+               switch ( attribute.first )
+               {
+                  case DW_AT_low_pc:
+                     lowPc = _address( ioUnit, attribute.second );
+                     break;
+                  case DW_AT_high_pc:
+                     highPcIsOffset = (attribute.second.form != DW_FORM_addr) &&
+                                      !(attribute.second.form >= DW_FORM_addrx1 && attribute.second.form <= DW_FORM_addrx4) &&
+                                      (attribute.second.form != DW_FORM_addrx);
+                     highPc = highPcIsOffset ? attribute.second.value : _address( ioUnit, attribute.second );
+                     break;
+                  case DW_AT_ranges:
+                     scope.ranges = _ranges( ioUnit, attribute.second );
+                     break;
+                  case DW_AT_call_file:
+                     scope.callFile = attribute.second.value;
+                     break;
+                  case DW_AT_call_line:
+                     scope.callLine = attribute.second.value;
+                     break;
+                  default:
+                     break;
+               }
+            }
+
+            if ( highPcIsOffset )
+               highPc += lowPc;
+
+            if ( scope.ranges.empty() && lowPc != 0 && lowPc < highPc )
+               scope.ranges.push_back( { lowPc, highPc } );
+
+            if ( !scope.ranges.empty() )
+               ioUnit.scopes.push_back( std::move( scope ) );
+         }
+
+         if ( cAbbrev.hasChildren )
+            ++depth;
+      }
+   }
+
+   const ElfModule::Unit *ElfModule::_unitForOffset( uint64_t inOffset ) const
+   {
+      auto  iter = std::upper_bound( mUnits.begin(), mUnits.end(), inOffset, [] ( uint64_t inValue, const Unit &inUnit ) {
+         return inValue < inUnit.offset;
+      } );
+
+      if ( iter == mUnits.begin() )
+         return nullptr;
+
+      --iter;
+
+      return (inOffset >= iter->dieOffset && inOffset < iter->end) ? &(*iter) : nullptr;
+   }
+
+   // Collect the linkage name & name of a DIE, following its abstract origin & specification
+   void  ElfModule::_dieNames( uint64_t inOffset, std::string &ioLinkageName, std::string &ioName, int inDepth )
+   {
+      const Unit  *cUnit = _unitForOffset( inOffset );
+
+      if ( cUnit == nullptr || inDepth > 8 )
+         return;
+
+      DataReader  reader( mDebugInfo, inOffset );
+
+      const auto  cAbbreviation = cUnit->abbreviations->find( reader.uleb() );
+
+      if ( cAbbreviation == cUnit->abbreviations->end() )
+         return;
+
+      uint64_t references[2] = { ~uint64_t( 0 ), ~uint64_t( 0 ) };
+
+      for ( const AttributeSpec &spec : cAbbreviation->second.attributes )
+      {
+         AttributeValue value;
+
+         if ( !_readAttribute( reader, *cUnit, spec, value ) )
+            return;
+
+         switch ( spec.attribute )
+         {
+            case DW_AT_linkage_name:
+            case DW_AT_MIPS_linkage_name:
+               if ( ioLinkageName.empty() )
+                  ioLinkageName = _string( *cUnit, value );
+               break;
+            case DW_AT_name:
+               if ( ioName.empty() )
+                  ioName = _string( *cUnit, value );
+               break;
+            case DW_AT_abstract_origin:
+               references[0] = _reference( *cUnit, value );
+               break;
+            case DW_AT_specification:
+               references[1] = _reference( *cUnit, value );
+               break;
+            default:
+               break;
+         }
+      }
+
+      for ( uint64_t reference : references )
+      {
+         if ( !ioLinkageName.empty() )
+            return;
+
+         if ( reference != ~uint64_t( 0 ) )
+            _dieNames( reference, ioLinkageName, ioName, inDepth + 1 );
+      }
+   }
+
+   std::string  ElfModule::_functionName( uint64_t inDieOffset )
+   {
+      std::string linkageName;
+      std::string name;
+
+      _dieNames( inDieOffset, linkageName, name, 0 );
+
+      return linkageName.empty() ? name : _demangle( linkageName.c_str() );
+   }
+
+   void  ElfModule::index()
+   {
+      std::call_once( mIndexed, [this] {
+         std::lock_guard<std::mutex> lock( mMutex );
+
+         _loadSymbols();
+         _loadLines();
+
+         for ( Unit &unit : mUnits )
+            _loadScopes( unit );
+
+         mIsIndexed.store( true, std::memory_order_release );
+      } );
+   }
+
+   bool  ElfModule::symbolize( uint64_t inAddress, std::vector<SourceLocation> &outLocations )
+   {
+      // an indexed module is only read
+      if ( mIsIndexed.load( std::memory_order_acquire ) )
+         return _symbolize( inAddress, outLocations );
+
+      std::lock_guard<std::mutex> lock( mMutex );
+
+      return _symbolize( inAddress, outLocations );
+   }
+
+   bool  ElfModule::_symbolize( uint64_t inAddress, std::vector<SourceLocation> &outLocations )
+   {
+      outLocations.clear();
+
+      _loadSymbols();
+      _loadLines();
+
+      uint32_t fileId = 0;
+      uint32_t line = 0;
+
+      const bool  cHasLine = _findLine( inAddress, fileId, line );
+
+      // find the unit containing the address, then every function & inlined function covering it
+      Unit  *unit = nullptr;
+
+      auto  unitRange = std::upper_bound( mUnitRanges.begin(), mUnitRanges.end(), inAddress, [] ( uint64_t inValue, const UnitRange &inRange ) {
+         return inValue < inRange.low;
+      } );
+
+      while ( unitRange != mUnitRanges.begin() )
+      {
+         --unitRange;
+
+         if ( inAddress < unitRange->high )
+         {
+            unit = &mUnits[unitRange->unit];
+            break;
+         }
+      }
+
+      std::vector<const Scope *> scopes;
+
+      if ( unit != nullptr )
+      {
+         _loadScopes( *unit );
+
+         for ( const Scope &scope : unit->scopes )
+         {
+            if ( _contains( scope.ranges, inAddress ) )
+               scopes.push_back( &scope );
+         }
+
+         // innermost first, stopping at the function that contains the address
+         std::sort( scopes.begin(), scopes.end(), [] ( const Scope *inA, const Scope *inB ) {
+            return inA->depth > inB->depth;
+         } );
+
+         auto  outermost = std::find_if( scopes.begin(), scopes.end(), [] ( const Scope *inScope ) {
+            return !inScope->inlined;
+         } );
+
+         if ( outermost != scopes.end() )
+            scopes.erase( outermost + 1, scopes.end() );
+      }
+
+      const std::string cEmpty;
+
+      SourceLocation location;
+
+      location.file = cHasLine ? _fileName( fileId ) : cEmpty;
+      location.line = cHasLine ? int( line ) : 0;
+
+      for ( const Scope *scope : scopes )
+      {
+         location.function = _functionName( scope->dieOffset );
+
+         outLocations.push_back( location );
+
+         // the caller of an inlined function is at its call site
+         location.file = scope->inlined ? _fileName( _fileId( unit->stmtList, scope->callFile ) ) : cEmpty;
+         location.line = int( scope->callLine );
+      }
+
+      // The symbol table has the complete name of the function that contains the address
+      // (including clones and lambdas), which DWARF doesn't always give.
+      const Symbol   *cSymbol = _findSymbol( inAddress );
+
+      if ( outLocations.empty() )
+      {
+         if ( cSymbol == nullptr && !cHasLine )
+            return false;
+
+         location.function = cEmpty;
+         outLocations.push_back( location );
+      }
+
+      if ( cSymbol != nullptr )
+         outLocations.back().function = _demangle( cSymbol->name );
+
+      // the file and line are in the compressed sections, the address mapping tool can find them
+      if ( mHasCompressedDebug && !cHasLine )
+         return false;
+
+      return !outLocations.back().function.empty();
+   }
+
+   std::string  ElfModule::buildId() const
+   {
+      const Section  cNotes = _section( ".note.gnu.build-id" );
+
+      DataReader  reader( cNotes );
+
+      while ( !reader.atEnd() )
+      {
+         const uint32_t cNameSize = reader.u32();
+         const uint32_t cDescriptionSize = reader.u32();
+         const uint32_t cType = reader.u32();
+
+         const uint64_t cDescriptionOffset = reader.offset() + ((cNameSize + 3) & ~3u);
+
+         if ( reader.error() || cDescriptionOffset + cDescriptionSize > cNotes.size )
+            break;
+
+         if ( cType == NT_GNU_BUILD_ID && cNameSize == 4 && memcmp( cNotes.data + reader.offset(), "GNU", 4 ) == 0 )
+         {
+            static const char cHexDigits[] = "0123456789abcdef";
+
+            std::string id;
+
+            for ( uint32_t i = 0; i < cDescriptionSize; ++i )
+            {
+               const uint8_t  cByte = cNotes.data[cDescriptionOffset + i];
+
+               id += cHexDigits[cByte >> 4];
+               id += cHexDigits[cByte & 0xf];
+            }
+
+            return id;
+         }
+
+         reader.seek( cDescriptionOffset + ((cDescriptionSize + 3) & ~3u) );
+      }
+
+      return std::string();
+   }
+
+   bool  ElfModule::debugLink( std::string &outName, uint32_t &outCrc ) const
+   {
+      const Section  cLink = _section( ".gnu_debuglink" );
+
+      // the file name, padded to 4 bytes, then the CRC of the debug file
+      const char  *cName = _sectionString( cLink, 0 );
+      const size_t   cCrcOffset = (strlen( cName ) + 4) & ~size_t( 3 );
+
+      if ( cName[0] == '\0' || cCrcOffset + 4 > cLink.size )
+         return false;
+
+      outName = cName;
+      memcpy( &outCrc, cLink.data + cCrcOffset, 4 );
+
+      return true;
+   }
+
+   ElfSymbolizer::ElfSymbolizer() = default;
+
+   ElfSymbolizer::~ElfSymbolizer() = default;
+
+   void  ElfSymbolizer::addDebugDirectory( const std::string &inDirectory )
+   {
+      std::lock_guard<std::mutex> lock( mMutex );
+
+      mDebugDirectories.push_back( inDirectory );
+   }
+
+   ElfSymbolizer::ModuleFiles  &ElfSymbolizer::_files( const std::string &inPath )
+   {
+      ModuleFiles &files = mModules[inPath];
+
+      if ( files.module == nullptr )
+         files.module.reset( new ElfModule( inPath ) );
+
+      return files;
+   }
+
+   ElfModule  *ElfSymbolizer::_debugModule( const std::string &inPath, const std::string &inBuildId )
+   {
+      ModuleFiles &files = _files( inPath );
+
+      // the file isn't the build that was loaded (the crash was recorded on another machine or before an update)
+      if ( !inBuildId.empty() && (!files.module->isValid() || files.module->buildId() != inBuildId) )
+         return _buildIdModule( inBuildId );
+
+      if ( !files.module->isValid() )
+         return nullptr;
+
+      if ( files.module->hasDebugInfo() )
+         return files.module.get();
+
+      if ( !files.debugSearched )
+      {
+         files.debugSearched = true;
+         files.debugModule = _findDebugFile( inPath, *files.module );
+      }
+
+      // a stripped module without a debug file still has its dynamic symbols
+      return (files.debugModule != nullptr) ? files.debugModule.get() : files.module.get();
+   }
+
+   ElfModule  *ElfSymbolizer::_buildIdModule( const std::string &inBuildId )
+   {
+      ModuleFiles &files = mModules["build-id:" + inBuildId];
+
+      if ( files.debugSearched )
+         return files.module.get();
+
+      files.debugSearched = true;
+
+      if ( inBuildId.size() <= 2 )
+         return nullptr;
+
+      // the debug file first, then the module itself (which may only have its dynamic symbols)
+      for ( const char *suffix : { ".debug", "" } )
+      {
+         for ( const std::string &directory : mDebugDirectories )
+         {
+            std::unique_ptr<ElfModule>  module( new ElfModule( directory + "/.build-id/" + inBuildId.substr( 0, 2 ) + "/" +
+                                                               inBuildId.substr( 2 ) + suffix ) );
+
+            if ( module->isValid() && module->buildId() == inBuildId )
+            {
+               files.module = std::move( module );
+               return files.module.get();
+            }
+         }
+      }
+
+      return nullptr;
+   }
+
+   std::unique_ptr<ElfModule>  ElfSymbolizer::_findDebugFile( const std::string &inPath, const ElfModule &inModule ) const
+   {
+      const std::string cBuildId = inModule.buildId();
+
+      auto  usable = [&cBuildId] ( const std::unique_ptr<ElfModule> &inDebugModule ) {
+         return inDebugModule->isValid() && inDebugModule->hasDebugInfo() &&
+               (cBuildId.empty() || inDebugModule->buildId().empty() || inDebugModule->buildId() == cBuildId);
+      };
+
+      // by build-id: <debug directory>/.build-id/ab/cdef....debug
+      if ( cBuildId.size() > 2 )
+      {
+         for ( const std::string &directory : mDebugDirectories )
+         {
+            std::unique_ptr<ElfModule>  debugModule( new ElfModule( directory + "/.build-id/" + cBuildId.substr( 0, 2 ) + "/" +
+                                                                    cBuildId.substr( 2 ) + ".debug" ) );
+
+            if ( usable( debugModule ) )
+               return debugModule;
+         }
+      }
+
+      // by debuglink: next to the module, in its .debug directory or under a debug directory
+      std::string linkName;
+      uint32_t    linkCrc = 0;
+
+      if ( !inModule.debugLink( linkName, linkCrc ) )
+         return nullptr;
+
+      const std::string cDirectory = _directoryName( inPath );
+
+      std::vector<std::string>   candidates{ cDirectory + "/" + linkName, cDirectory + "/.debug/" + linkName };
+
+      for ( const std::string &directory : mDebugDirectories )
+         candidates.push_back( directory + cDirectory + "/" + linkName );
+
+      for ( const std::string &candidate : candidates )
+      {
+         if ( candidate == inPath )
+            continue;
+
+         std::unique_ptr<ElfModule>  debugModule( new ElfModule( candidate ) );
+
+         // without build-ids to compare, the CRC tells whether the debug file belongs to this build
+         if ( usable( debugModule ) && (!cBuildId.empty() || debugModule->crc() == linkCrc) )
+            return debugModule;
+      }
+
+      return nullptr;
+   }
+
+   void  ElfSymbolizer::setIndexModules( bool inIndex )
+   {
+      std::lock_guard<std::mutex> lock( mMutex );
+
+      mIndexModules = inIndex;
+   }
+
+   bool  ElfSymbolizer::symbolize( const std::string &inPath, uint64_t inAddress, std::vector<SourceLocation> &outLocations,
+                                   const std::string &inBuildId )
+   {
+      std::unique_lock<std::mutex>  lock( mMutex );
+
+      ElfModule   *module = _debugModule( inPath, inBuildId );
+      const bool  cIndex = mIndexModules;
+
+      // only finding the module needs the symbolizer's lock (modules are never removed): the lookups in
+      // different modules run in parallel, and those in the same module too once it is indexed
+      lock.unlock();
+
+      if ( module == nullptr )
+      {
+         outLocations.clear();
+         return false;
+      }
+
+      if ( cIndex )
+         module->index();
+
+      return module->symbolize( inAddress, outLocations );
+   }
+}
@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) 2020 Naikel Aparicio. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ''AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the author and should not be interpreted as representing
+ * official policies, either expressed or implied, of the copyright holder.
+ */
+
+
+#ifndef ELFSYMBOLIZER_H
+#define ELFSYMBOLIZER_H
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+
+namespace YappariCrashReport {
+
+   /// A function & source location an address resolves to
+   struct SourceLocation
+   {
+      std::string function;   ///< The demangled function name, empty if unknown
+      std::string file;       ///< The source file, empty if unknown
+      int         line = 0;   ///< The line in the source file, 0 if unknown
+   };
+
+   class ElfModule;
+
+   /// Resolve addresses to function, file and line by reading the ELF and DWARF
+   /// information of the modules directly, without running any external tool.
+   ///
+   /// Every module file is memory mapped the first time it is needed and its symbol
+   /// tables, line tables and debug information are only parsed when a lookup needs them.
+   ///
+   /// The debug information of stripped modules is read from their separate debug file,
+   /// found by build-id (<debug directory>/.build-id/ab/cdef.debug) or by .gnu_debuglink
+   /// (next to the module, in its .debug directory or under a debug directory).
+   ///
+   /// Modules that are not on this machine (crashes recorded elsewhere) are found by build-id
+   /// alone, as <debug directory>/.build-id/ab/cdef.debug or <debug directory>/.build-id/ab/cdef.
+   class ElfSymbolizer
+   {
+      public:
+         ElfSymbolizer();
+         ~ElfSymbolizer();
+
+         ElfSymbolizer( const ElfSymbolizer & ) = delete;
+         ElfSymbolizer &operator=( const ElfSymbolizer & ) = delete;
+
+         /// Resolve an address of a module.
+         ///
+         /// @param inPath The path of the module file
+         /// @param inAddress The address relative to the module's load bias (the address in the file)
+         /// @param outLocations The locations, the innermost inlined function first and the
+         ///                     function that contains the address last
+         /// @param inBuildId The build-id of the module that was loaded (in hex), empty if unknown.
+         ///                  If the file at inPath is a different build, the module is looked up
+         ///                  by build-id in the debug directories instead.
+         /// @return true if at least the function name was found. false as well when the module's debug
+         ///         sections are compressed and no line was found, so the caller can try the address mapping
+         ///         tool; outLocations still has the function name then.
+         bool symbolize( const std::string &inPath, uint64_t inAddress, std::vector<SourceLocation> &outLocations,
+                         const std::string &inBuildId = std::string() );
+
+         /// Add a directory to look for separate debug files in (/usr/lib/debug is always searched)
+         void addDebugDirectory( const std::string &inDirectory );
+
+         /// Index every module completely the first time it is used instead of parsing it lazily.
+         /// symbolize() can always be called from several threads, but the lookups in a module that is
+         /// parsed lazily wait for each other; an indexed module is shared read-only, so they don't.
+         /// Takes more time & memory per module.
+         void setIndexModules( bool inIndex );
+
+      private:
+         struct ModuleFiles
+         {
+            std::unique_ptr<ElfModule> module;
+            std::unique_ptr<ElfModule> debugModule;   // the separate debug file, if any
+            bool  debugSearched = false;
+         };
+
+         ModuleFiles &_files( const std::string &inPath );
+         ElfModule *_debugModule( const std::string &inPath, const std::string &inBuildId );
+         ElfModule *_buildIdModule( const std::string &inBuildId );
+         std::unique_ptr<ElfModule> _findDebugFile( const std::string &inPath, const ElfModule &inModule ) const;
+
+         std::mutex  mMutex;
+         std::map<std::string, ModuleFiles>   mModules;
+         std::vector<std::string>   mDebugDirectories{ "/usr/lib/debug" };
+         bool  mIndexModules = false;
+   };
+
+}
+
+#endif
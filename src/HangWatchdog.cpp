@@ -0,0 +1,320 @@
+/*
+ * Copyright (C) 2020 Naikel Aparicio. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ''AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the author and should not be interpreted as representing
+ * official policies, either expressed or implied, of the copyright holder.
+ */
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QMetaObject>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThread>
+#include <QVector>
+#include <QWaitCondition>
+
+#include "Breadcrumbs.h"
+#include "CrashArena.h"
+#include "CrashReport.h"
+#include "HangWatchdog.h"
+#include "YappariCrashReport.h"
+
+
+namespace YappariCrashReport
+{
+   // An event loop the watchdog posts heartbeats to
+   struct WatchedLoop
+   {
+      QObject  *receiver;        // lives in the loop's thread, nullptr once destroyed (guarded by sLoopsMutex)
+      qint64   tid;
+      std::atomic<uint64_t>   postedNs{ 0 };   // when the pending heartbeat was posted, 0 once it ran
+      uint64_t reportedNs = 0;   // the postedNs of the hang that was reported (only used by the watchdog)
+   };
+
+   using WatchedLoopPointer = std::shared_ptr<WatchedLoop>;
+
+   // Posting a heartbeat and destroying a receiver exclude each other, so a heartbeat is never posted to a dead object
+   static QMutex  sLoopsMutex;
+   static QVector<WatchedLoopPointer>  sLoops;
+
+   static QString  _threadName( qint64 inTid )
+   {
+      QFile file( QStringLiteral( "/proc/self/task/%1/comm" ).arg( inTid ) );
+
+      if ( !file.open( QIODevice::ReadOnly ) )
+         return QString();
+
+      return QString::fromLocal8Bit( file.readAll() ).trimmed();
+   }
+
+   static QStringList  _threadStack( qint64 inTid )
+   {
+      const StackTrace  cStack = captureThreadStackTrace( inTid, 250 );
+
+      if ( cStack.isEmpty() )
+         return QStringList{ QStringLiteral( "(didn't answer)" ) };
+
+      return symbolizeStackTrace( cStack );
+   }
+
+   // Watches the event loops from its own thread
+   class HangWatchdog : public QThread
+   {
+   public:
+      HangWatchdog()
+      {
+         setObjectName( QStringLiteral( "YappariWatchdog" ) );
+      }
+
+      void  configure( int inThresholdMs, bool inAllThreads, hangReportFunction inReport )
+      {
+         QMutexLocker   locker( &mMutex );
+
+         mThresholdNs = uint64_t( inThresholdMs ) * 1000000;
+         mAllThreads = inAllThreads;
+         mReport = inReport;
+         mStopping = false;
+      }
+
+      void  stop()
+      {
+         {
+            QMutexLocker   locker( &mMutex );
+
+            mStopping = true;
+            mWake.wakeAll();
+         }
+
+         wait();
+      }
+
+   protected:
+      void  run() override
+      {
+         mTid = currentThreadId();
+
+         QMutexLocker   locker( &mMutex );
+
+         while ( !mStopping )
+         {
+            const uint64_t cThresholdNs = mThresholdNs;
+            const bool     cAllThreads = mAllThreads;
+            const hangReportFunction   cReport = mReport;
+
+            locker.unlock();
+
+            _check( cThresholdNs, cAllThreads, cReport );
+
+            locker.relock();
+
+            // a quarter of the threshold, so a hang is reported at most 25% late
+            const unsigned long  cIntervalMs = qBound<unsigned long>( 10, (unsigned long)(cThresholdNs / 4000000), 1000 );
+
+            if ( !mStopping )
+               mWake.wait( &mMutex, cIntervalMs );
+         }
+      }
+
+   private:
+      void  _check( uint64_t inThresholdNs, bool inAllThreads, hangReportFunction inReport )
+      {
+         QVector<WatchedLoopPointer>   hungLoops;
+
+         {
+            QMutexLocker   locker( &sLoopsMutex );
+
+            const uint64_t cNow = monotonicNanoseconds();
+
+            for ( int i = sLoops.size() - 1; i >= 0; --i )
+            {
+               const WatchedLoopPointer   &cLoop = sLoops.at( i );
+
+               if ( cLoop->receiver == nullptr )
+               {
+                  sLoops.removeAt( i );
+                  continue;
+               }
+
+               const uint64_t cPosted = cLoop->postedNs.load( std::memory_order_acquire );
+
+               if ( cPosted == 0 )
+               {
+                  if ( cLoop->reportedNs != 0 )
+                  {
+                     const QByteArray  cMessage = QStringLiteral( "Thread %1 answered again after a hang of %2 ms" )
+                                                  .arg( cLoop->tid ).arg( (cNow - cLoop->reportedNs) / 1000000 ).toUtf8();
+
+                     writeBreadcrumb( cMessage.constData(), size_t( cMessage.size() ) );
+
+                     cLoop->reportedNs = 0;
+                  }
+
+                  // the heartbeat is a queued call, so it runs when the loop gets to it
+                  const WatchedLoopPointer   cHeartbeatLoop = cLoop;
+
+                  cLoop->postedNs.store( cNow, std::memory_order_release );
+
+                  QMetaObject::invokeMethod( cLoop->receiver, [cHeartbeatLoop] () {
+                     cHeartbeatLoop->postedNs.store( 0, std::memory_order_release );
+                  }, Qt::QueuedConnection );
+               }
+               else if ( (cNow - cPosted) >= inThresholdNs && cLoop->reportedNs != cPosted )
+               {
+                  cLoop->reportedNs = cPosted;
+                  hungLoops += cLoop;
+               }
+            }
+         }
+
+         // the captures take a while, and the loops can't go away while they are hung
+         for ( const WatchedLoopPointer &cLoop : hungLoops )
+         {
+            const QString  cReport = _hangReport( *cLoop, inAllThreads );
+
+            if ( inReport != nullptr )
+               inReport( cReport );
+         }
+      }
+
+      QString  _hangReport( const WatchedLoop &inLoop, bool inAllThreads )
+      {
+         const uint64_t cLateMs = (monotonicNanoseconds() - inLoop.reportedNs) / 1000000;
+
+         QStringList info = _threadStack( inLoop.tid );
+
+         if ( inAllThreads )
+         {
+            info += QString();
+            info += QStringLiteral( "Threads:" );
+
+            const QStringList cTasks = QDir( QStringLiteral( "/proc/self/task" ) ).entryList( QDir::Dirs | QDir::NoDotAndDotDot );
+
+            for ( const QString &cTask : cTasks )
+            {
+               const qint64   cTid = cTask.toLongLong();
+
+               QString  state;
+
+               if ( cTid == inLoop.tid )
+                  state = QStringLiteral( " (hung)" );
+               else if ( cTid == mTid )
+                  state = QStringLiteral( " (watchdog)" );
+
+               info += QString();
+               info += QStringLiteral( "Thread %1 \"%2\"%3" ).arg( cTid ).arg( _threadName( cTid ), state );
+
+               if ( cTid != mTid )
+                  info += _threadStack( cTid );
+            }
+         }
+
+         std::vector<BreadcrumbRecord> breadcrumbs( MAX_BREADCRUMBS );
+
+         const uint32_t cBreadcrumbCount = copyBreadcrumbs( breadcrumbs.data(), MAX_BREADCRUMBS );
+
+         info += formatBreadcrumbs( breadcrumbs.data(), cBreadcrumbCount, monotonicNanoseconds() );
+
+         const QString  cDescription = QStringLiteral( "Hang: the event loop of thread %1 \"%2\" hasn't answered for %3 ms" )
+                                       .arg( inLoop.tid ).arg( _threadName( inLoop.tid ) ).arg( cLateMs );
+
+         return crashReportText( cDescription, info );
+      }
+
+      QMutex   mMutex;
+      QWaitCondition mWake;
+      bool     mStopping = false;
+      uint64_t mThresholdNs = 0;
+      bool     mAllThreads = false;
+      hangReportFunction   mReport = nullptr;
+      qint64   mTid = 0;
+   };
+
+   // Never deleted, so a watchdog still running when the process exits doesn't abort it
+   static HangWatchdog  *sWatchdog = nullptr;
+
+   static void  _watchEventLoop( QObject *inReceiver, qint64 inTid )
+   {
+      const WatchedLoopPointer   cLoop = std::make_shared<WatchedLoop>();
+
+      cLoop->receiver = inReceiver;
+      cLoop->tid = inTid;
+
+      // runs in the receiver's thread as it is destroyed
+      QObject::connect( inReceiver, &QObject::destroyed, [cLoop] () {
+         QMutexLocker   locker( &sLoopsMutex );
+
+         cLoop->receiver = nullptr;
+      } );
+
+      QMutexLocker   locker( &sLoopsMutex );
+
+      sLoops += cLoop;
+   }
+
+   void  startHangWatchdog( int inThresholdMs, bool inAllThreads, hangReportFunction inReport )
+   {
+      QCoreApplication  *application = QCoreApplication::instance();
+
+      if ( application == nullptr )
+         return;
+
+      if ( sWatchdog == nullptr )
+      {
+         sWatchdog = new HangWatchdog;
+
+         _watchEventLoop( application, qint64( QCoreApplication::applicationPid() ) );
+
+         // the main loop doesn't run anymore while the application shuts down
+         QObject::connect( application, &QCoreApplication::aboutToQuit, [] () { stopHangWatchdog(); } );
+      }
+
+      sWatchdog->configure( qMax( inThresholdMs, 1 ), inAllThreads, inReport );
+
+      if ( !sWatchdog->isRunning() )
+         sWatchdog->start( QThread::LowPriority );
+   }
+
+   void  stopHangWatchdog()
+   {
+      if ( sWatchdog != nullptr && sWatchdog->isRunning() )
+         sWatchdog->stop();
+   }
+
+   void  addWatchedEventLoop()
+   {
+      // a receiver of its own in the thread, deleted when the thread finishes
+      QObject  *receiver = new QObject;
+
+      QObject::connect( QThread::currentThread(), &QThread::finished, receiver, &QObject::deleteLater );
+
+      _watchEventLoop( receiver, currentThreadId() );
+   }
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2020 Naikel Aparicio. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ''AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the author and should not be interpreted as representing
+ * official policies, either expressed or implied, of the copyright holder.
+ */
+
+
+#ifndef HANGWATCHDOG_H
+#define HANGWATCHDOG_H
+
+#include <QString>
+
+
+namespace YappariCrashReport {
+
+   /// Receives the hang reports, in the watchdog thread
+   using hangReportFunction = void (*)( const QString &inReport );
+
+   /// Start the watchdog thread, or change its settings if it is running (Linux only).
+   ///
+   /// The watchdog posts a heartbeat to the main event loop, and to the loops added with
+   /// addWatchedEventLoop(), every quarter of the threshold. A loop that doesn't run its heartbeat
+   /// within the threshold is hung: the watchdog captures its stack (or every thread's) with the
+   /// capture signal and hands a hang report over. One report per hang, and the process keeps running.
+   /// Must be called after the QCoreApplication is created. Stops by itself when the application quits.
+   /// @param inThresholdMs How late a heartbeat can be before the loop is reported
+   /// @param inAllThreads Whether to capture every thread instead of just the hung one
+   /// @param inReport Receives the reports
+   void startHangWatchdog( int inThresholdMs, bool inAllThreads, hangReportFunction inReport );
+
+   /// Stop the watchdog thread and wait for it to finish
+   void stopHangWatchdog();
+
+   /// Watch the event loop of the calling thread too, until the thread finishes
+   void addWatchedEventLoop();
+
+}
+
+#endif
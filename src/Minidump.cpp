@@ -0,0 +1,612 @@
+/*
+ * Copyright (C) 2020 Naikel Aparicio. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ''AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the author and should not be interpreted as representing
+ * official policies, either expressed or implied, of the copyright holder.
+ */
+
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "Minidump.h"
+
+
+namespace YappariCrashReport
+{
+   static size_t  _padded( size_t inSize )
+   {
+      return (inSize + 7) & ~size_t( 7 );
+   }
+
+   // The largest possible minidump: every section at its largest, with its section header and padding
+   constexpr size_t  MAX_MINIDUMP_SIZE = sizeof( MinidumpHeader ) +
+         sizeof( MinidumpSection ) + sizeof( CrashRecord::applicationName ) + sizeof( CrashRecord::applicationVersion ) +
+         sizeof( CrashRecord::programPath ) + 8 +
+         sizeof( MinidumpSection ) + sizeof( MinidumpCrash ) + MAX_STACK_FRAMES * sizeof( uint64_t ) +
+         sizeof( MinidumpSection ) + sizeof( MinidumpRegisters ) + MAX_REGISTERS * sizeof( uint64_t ) +
+         MAX_THREADS * (sizeof( MinidumpSection ) + sizeof( MinidumpThread ) + MAX_STACK_FRAMES * sizeof( uint64_t )) +
+         MAX_MODULES * (sizeof( MinidumpSection ) + sizeof( MinidumpModule ) + MAX_PATH_SIZE) +
+         sizeof( MinidumpSection ) + sizeof( MinidumpStackMemory ) + MAX_STACK_MEMORY_SIZE +
+         sizeof( MinidumpSection ) + sizeof( MinidumpBreadcrumbs ) + MAX_BREADCRUMBS * sizeof( BreadcrumbRecord ) +
+         sizeof( MinidumpSection ) + sizeof( ExceptionRecord );
+
+   // Static so the handler doesn't need the heap or a huge amount of stack
+   alignas( 8 ) static uint8_t   sMinidumpBuffer[MAX_MINIDUMP_SIZE];
+   static bool    sModuleUsed[MAX_MODULES];
+
+   static char    sMinidumpDirectory[MAX_PATH_SIZE] = { 0 };
+
+   // Appends sections to the minidump buffer
+   class MinidumpWriter
+   {
+   public:
+      explicit MinidumpWriter( uint8_t *inBuffer ) :
+         mBuffer( inBuffer ),
+         mSize( sizeof( MinidumpHeader ) ),
+         mSectionCount( 0 )
+      {
+      }
+
+      void  beginSection( MinidumpSectionType inType )
+      {
+         mSectionStart = mSize;
+         mSize += sizeof( MinidumpSection );
+
+         MinidumpSection   section{ inType, 0 };
+
+         memcpy( mBuffer + mSectionStart, &section, sizeof( section ) );
+      }
+
+      void  append( const void *inData, size_t inSize )
+      {
+         memcpy( mBuffer + mSize, inData, inSize );
+         mSize += inSize;
+      }
+
+      void  endSection()
+      {
+         const uint32_t cSize = uint32_t( mSize - mSectionStart - sizeof( MinidumpSection ) );
+
+         memcpy( mBuffer + mSectionStart + offsetof( MinidumpSection, size ), &cSize, sizeof( cSize ) );
+
+         memset( mBuffer + mSize, 0, _padded( mSize ) - mSize );
+         mSize = _padded( mSize );
+
+         ++mSectionCount;
+      }
+
+      size_t  finish( uint32_t inArchitecture )
+      {
+         MinidumpHeader header;
+
+         memcpy( header.magic, "YCRD", sizeof( header.magic ) );
+         header.version = MINIDUMP_VERSION;
+         header.byteOrder = MINIDUMP_BYTE_ORDER;
+         header.architecture = inArchitecture;
+         header.sectionCount = mSectionCount;
+
+         memcpy( mBuffer, &header, sizeof( header ) );
+
+         return mSize;
+      }
+
+   private:
+      uint8_t  *mBuffer;
+      size_t   mSize;
+      size_t   mSectionStart = 0;
+      uint32_t mSectionCount;
+   };
+
+   // Find the module of an address in the sorted module list, -1 if there is none
+   static int  _findModule( const CrashRecord &inRecord, uint64_t inAddress )
+   {
+      int   low = 0;
+      int   high = int( inRecord.moduleCount ) - 1;
+
+      while ( low <= high )
+      {
+         const int   cMiddle = (low + high) / 2;
+         const ModuleRecord   &cModule = inRecord.modules[cMiddle];
+
+         if ( inAddress < cModule.start )
+            high = cMiddle - 1;
+         else if ( inAddress >= cModule.end )
+            low = cMiddle + 1;
+         else
+            return cMiddle;
+      }
+
+      return -1;
+   }
+
+   static void  _markModules( const CrashRecord &inRecord, const uint64_t *inFrames, uint32_t inFrameCount )
+   {
+      for ( uint32_t i = 0; i < inFrameCount; ++i )
+      {
+         const int   cModule = _findModule( inRecord, inFrames[i] );
+
+         if ( cModule >= 0 )
+            sModuleUsed[cModule] = true;
+      }
+   }
+
+   const uint8_t  *serializeMinidump( const CrashRecord &inRecord, size_t &outSize )
+   {
+      MinidumpWriter writer( sMinidumpBuffer );
+
+      writer.beginSection( MINIDUMP_APPLICATION );
+      writer.append( inRecord.applicationName, strnlen( inRecord.applicationName, sizeof( inRecord.applicationName ) - 1 ) + 1 );
+      writer.append( inRecord.applicationVersion, strnlen( inRecord.applicationVersion, sizeof( inRecord.applicationVersion ) - 1 ) + 1 );
+      writer.append( inRecord.programPath, strnlen( inRecord.programPath, sizeof( inRecord.programPath ) - 1 ) + 1 );
+      writer.endSection();
+
+      const uint32_t cFrameCount = (inRecord.frameCount < MAX_STACK_FRAMES) ? inRecord.frameCount : MAX_STACK_FRAMES;
+      const MinidumpCrash  cCrash{ inRecord.signal, inRecord.signalCode, inRecord.faultAddress, inRecord.pid, inRecord.tid,
+                                   inRecord.time, inRecord.captureStartNs, inRecord.captureEndNs, cFrameCount, 0 };
+
+      writer.beginSection( MINIDUMP_CRASH );
+      writer.append( &cCrash, sizeof( cCrash ) );
+      writer.append( inRecord.frames, cFrameCount * sizeof( uint64_t ) );
+      writer.endSection();
+
+      const MinidumpRegisters cRegisters{ (inRecord.registerCount < MAX_REGISTERS) ? inRecord.registerCount : MAX_REGISTERS, 0 };
+
+      writer.beginSection( MINIDUMP_REGISTERS );
+      writer.append( &cRegisters, sizeof( cRegisters ) );
+      writer.append( inRecord.registers, cRegisters.registerCount * sizeof( uint64_t ) );
+      writer.endSection();
+
+      memset( sModuleUsed, 0, sizeof( sModuleUsed ) );
+
+      _markModules( inRecord, inRecord.frames, cFrameCount );
+
+      const uint32_t cThreadCount = (inRecord.threadCount < MAX_THREADS) ? inRecord.threadCount : MAX_THREADS;
+
+      for ( uint32_t i = 0; i < cThreadCount; ++i )
+      {
+         const ThreadRecord   &cThread = inRecord.threads[i];
+
+         MinidumpThread thread;
+
+         thread.tid = cThread.tid;
+         memcpy( thread.name, cThread.name, sizeof( thread.name ) );
+         thread.frameCount = (cThread.frameCount < MAX_STACK_FRAMES) ? cThread.frameCount : MAX_STACK_FRAMES;
+
+         writer.beginSection( MINIDUMP_THREAD );
+         writer.append( &thread, sizeof( thread ) );
+         writer.append( cThread.frames, thread.frameCount * sizeof( uint64_t ) );
+         writer.endSection();
+
+         _markModules( inRecord, cThread.frames, thread.frameCount );
+      }
+
+      const uint32_t cExceptionFrameCount = (inRecord.exception.frameCount < MAX_STACK_FRAMES) ? inRecord.exception.frameCount
+                                                                                                : MAX_STACK_FRAMES;
+
+      if ( inRecord.exception.type[0] != '\0' )
+      {
+         writer.beginSection( MINIDUMP_EXCEPTION );
+         writer.append( &inRecord.exception, offsetof( ExceptionRecord, frames ) + cExceptionFrameCount * sizeof( uint64_t ) );
+         writer.endSection();
+
+         _markModules( inRecord, inRecord.exception.frames, cExceptionFrameCount );
+      }
+
+      // only the modules the stacks refer to are needed to symbolize them
+      const uint32_t cModuleCount = (inRecord.moduleCount < MAX_MODULES) ? inRecord.moduleCount : MAX_MODULES;
+
+      for ( uint32_t i = 0; i < cModuleCount; ++i )
+      {
+         if ( !sModuleUsed[i] )
+            continue;
+
+         const ModuleRecord   &cModuleRecord = inRecord.modules[i];
+
+         MinidumpModule module;
+
+         module.start = cModuleRecord.start;
+         module.end = cModuleRecord.end;
+         module.loadBias = cModuleRecord.loadBias;
+         module.buildIdSize = (cModuleRecord.buildIdSize < MAX_BUILD_ID_SIZE) ? cModuleRecord.buildIdSize : MAX_BUILD_ID_SIZE;
+         module.pathSize = uint32_t( strnlen( cModuleRecord.path, sizeof( cModuleRecord.path ) - 1 ) );
+         memcpy( module.buildId, cModuleRecord.buildId, sizeof( module.buildId ) );
+
+         writer.beginSection( MINIDUMP_MODULE );
+         writer.append( &module, sizeof( module ) );
+         writer.append( cModuleRecord.path, module.pathSize );
+         writer.endSection();
+      }
+
+      if ( inRecord.stackSize > 0 )
+      {
+         const MinidumpStackMemory  cStack{ inRecord.stackAddress, inRecord.tid,
+                                            uint32_t( (inRecord.stackSize < MAX_STACK_MEMORY_SIZE) ? inRecord.stackSize : MAX_STACK_MEMORY_SIZE ) };
+
+         writer.beginSection( MINIDUMP_STACK_MEMORY );
+         writer.append( &cStack, sizeof( cStack ) );
+         writer.append( inRecord.stack, cStack.size );
+         writer.endSection();
+      }
+
+      if ( inRecord.breadcrumbCount > 0 )
+      {
+         const MinidumpBreadcrumbs  cBreadcrumbs{ (inRecord.breadcrumbCount < MAX_BREADCRUMBS) ? inRecord.breadcrumbCount : MAX_BREADCRUMBS, 0 };
+
+         writer.beginSection( MINIDUMP_BREADCRUMBS );
+         writer.append( &cBreadcrumbs, sizeof( cBreadcrumbs ) );
+         writer.append( inRecord.breadcrumbs, cBreadcrumbs.breadcrumbCount * sizeof( BreadcrumbRecord ) );
+         writer.endSection();
+      }
+
+      outSize = writer.finish( inRecord.architecture );
+
+      return sMinidumpBuffer;
+   }
+
+   // Copy a string out of a section, truncating it if needed. Returns the size consumed, 0 if it's not terminated.
+   static size_t  _readString( const char *inData, size_t inSize, char *outString, size_t inStringSize )
+   {
+      const char  *cEnd = static_cast<const char *>(memchr( inData, '\0', inSize ));
+
+      if ( cEnd == nullptr )
+         return 0;
+
+      const size_t   cLength = size_t( cEnd - inData );
+      const size_t   cCopied = (cLength < inStringSize - 1) ? cLength : inStringSize - 1;
+
+      memcpy( outString, inData, cCopied );
+      outString[cCopied] = '\0';
+
+      return cLength + 1;
+   }
+
+   // Read a count of frames following a section's fixed part, false if they don't fit
+   static bool  _readFrames( const uint8_t *inData, size_t inSize, uint32_t inCount, uint64_t *outFrames, uint32_t &outCount )
+   {
+      if ( inCount > MAX_STACK_FRAMES || inSize < inCount * sizeof( uint64_t ) )
+         return false;
+
+      memcpy( outFrames, inData, inCount * sizeof( uint64_t ) );
+      outCount = inCount;
+
+      return true;
+   }
+
+   static bool  _readSection( uint32_t inType, const uint8_t *inData, size_t inSize, CrashRecord &ioRecord )
+   {
+      switch ( inType )
+      {
+         case MINIDUMP_APPLICATION:
+         {
+            const char  *cData = reinterpret_cast<const char *>(inData);
+
+            const size_t   cNameSize = _readString( cData, inSize, ioRecord.applicationName, sizeof( ioRecord.applicationName ) );
+
+            if ( cNameSize == 0 )
+               return false;
+
+            const size_t   cVersionSize = _readString( cData + cNameSize, inSize - cNameSize,
+                                                       ioRecord.applicationVersion, sizeof( ioRecord.applicationVersion ) );
+
+            if ( cVersionSize == 0 )
+               return false;
+
+            return _readString( cData + cNameSize + cVersionSize, inSize - cNameSize - cVersionSize,
+                                ioRecord.programPath, sizeof( ioRecord.programPath ) ) != 0;
+         }
+
+         case MINIDUMP_CRASH:
+         {
+            MinidumpCrash  crash;
+
+            if ( inSize < sizeof( crash ) )
+               return false;
+
+            memcpy( &crash, inData, sizeof( crash ) );
+
+            ioRecord.signal = crash.signal;
+            ioRecord.signalCode = crash.signalCode;
+            ioRecord.faultAddress = crash.faultAddress;
+            ioRecord.pid = crash.pid;
+            ioRecord.tid = crash.tid;
+            ioRecord.time = crash.time;
+            ioRecord.captureStartNs = crash.captureStartNs;
+            ioRecord.captureEndNs = crash.captureEndNs;
+
+            return _readFrames( inData + sizeof( crash ), inSize - sizeof( crash ), crash.frameCount,
+                                ioRecord.frames, ioRecord.frameCount );
+         }
+
+         case MINIDUMP_REGISTERS:
+         {
+            MinidumpRegisters registers;
+
+            if ( inSize < sizeof( registers ) )
+               return false;
+
+            memcpy( &registers, inData, sizeof( registers ) );
+
+            if ( registers.registerCount > MAX_REGISTERS || inSize - sizeof( registers ) < registers.registerCount * sizeof( uint64_t ) )
+               return false;
+
+            memcpy( ioRecord.registers, inData + sizeof( registers ), registers.registerCount * sizeof( uint64_t ) );
+            ioRecord.registerCount = registers.registerCount;
+
+            return true;
+         }
+
+         case MINIDUMP_THREAD:
+         {
+            MinidumpThread thread;
+
+            if ( inSize < sizeof( thread ) || ioRecord.threadCount == MAX_THREADS )
+               return false;
+
+            memcpy( &thread, inData, sizeof( thread ) );
+
+            ThreadRecord   &threadRecord = ioRecord.threads[ioRecord.threadCount++];
+
+            threadRecord.tid = thread.tid;
+            memcpy( threadRecord.name, thread.name, sizeof( threadRecord.name ) );
+            threadRecord.name[sizeof( threadRecord.name ) - 1] = '\0';
+
+            return _readFrames( inData + sizeof( thread ), inSize - sizeof( thread ), thread.frameCount,
+                                threadRecord.frames, threadRecord.frameCount );
+         }
+
+         case MINIDUMP_MODULE:
+         {
+            MinidumpModule module;
+
+            if ( inSize < sizeof( module ) || ioRecord.moduleCount == MAX_MODULES )
+               return false;
+
+            memcpy( &module, inData, sizeof( module ) );
+
+            if ( module.buildIdSize > MAX_BUILD_ID_SIZE || module.pathSize >= MAX_PATH_SIZE ||
+                 inSize - sizeof( module ) < module.pathSize || module.start > module.end )
+               return false;
+
+            ModuleRecord   &moduleRecord = ioRecord.modules[ioRecord.moduleCount++];
+
+            moduleRecord.start = module.start;
+            moduleRecord.end = module.end;
+            moduleRecord.loadBias = module.loadBias;
+            moduleRecord.buildIdSize = module.buildIdSize;
+            memcpy( moduleRecord.buildId, module.buildId, sizeof( moduleRecord.buildId ) );
+            memcpy( moduleRecord.path, inData + sizeof( module ), module.pathSize );
+            moduleRecord.path[module.pathSize] = '\0';
+
+            return true;
+         }
+
+         case MINIDUMP_STACK_MEMORY:
+         {
+            MinidumpStackMemory  stack;
+
+            if ( inSize < sizeof( stack ) )
+               return false;
+
+            memcpy( &stack, inData, sizeof( stack ) );
+
+            if ( stack.size > MAX_STACK_MEMORY_SIZE || inSize - sizeof( stack ) < stack.size )
+               return false;
+
+            ioRecord.stackAddress = stack.address;
+            ioRecord.stackSize = stack.size;
+            memcpy( ioRecord.stack, inData + sizeof( stack ), stack.size );
+
+            return true;
+         }
+
+         case MINIDUMP_BREADCRUMBS:
+         {
+            MinidumpBreadcrumbs  breadcrumbs;
+
+            if ( inSize < sizeof( breadcrumbs ) )
+               return false;
+
+            memcpy( &breadcrumbs, inData, sizeof( breadcrumbs ) );
+
+            if ( breadcrumbs.breadcrumbCount > MAX_BREADCRUMBS ||
+                 inSize - sizeof( breadcrumbs ) < breadcrumbs.breadcrumbCount * sizeof( BreadcrumbRecord ) )
+               return false;
+
+            memcpy( ioRecord.breadcrumbs, inData + sizeof( breadcrumbs ), breadcrumbs.breadcrumbCount * sizeof( BreadcrumbRecord ) );
+            ioRecord.breadcrumbCount = breadcrumbs.breadcrumbCount;
+
+            for ( uint32_t i = 0; i < ioRecord.breadcrumbCount; ++i )
+            {
+               BreadcrumbRecord  &breadcrumb = ioRecord.breadcrumbs[i];
+
+               if ( breadcrumb.size >= MAX_BREADCRUMB_SIZE )
+                  breadcrumb.size = MAX_BREADCRUMB_SIZE - 1;
+
+               breadcrumb.message[breadcrumb.size] = '\0';
+            }
+
+            return true;
+         }
+
+         case MINIDUMP_EXCEPTION:
+         {
+            const size_t   cHeaderSize = offsetof( ExceptionRecord, frames );
+
+            if ( inSize < cHeaderSize )
+               return false;
+
+            ExceptionRecord   &exception = ioRecord.exception;
+
+            memcpy( &exception, inData, cHeaderSize );
+
+            if ( exception.frameCount > MAX_STACK_FRAMES || inSize - cHeaderSize < exception.frameCount * sizeof( uint64_t ) )
+               return false;
+
+            memcpy( exception.frames, inData + cHeaderSize, exception.frameCount * sizeof( uint64_t ) );
+
+            exception.type[MAX_EXCEPTION_TYPE_SIZE - 1] = '\0';
+            exception.message[MAX_EXCEPTION_MESSAGE_SIZE - 1] = '\0';
+
+            return true;
+         }
+      }
+
+      // sections added by later versions
+      return true;
+   }
+
+   bool  readMinidump( const void *inData, size_t inSize, CrashRecord &outRecord )
+   {
+      const uint8_t  *cData = static_cast<const uint8_t *>(inData);
+
+      MinidumpHeader header;
+
+      if ( inSize < sizeof( header ) )
+         return false;
+
+      memcpy( &header, cData, sizeof( header ) );
+
+      if ( memcmp( header.magic, "YCRD", sizeof( header.magic ) ) != 0 || header.version != MINIDUMP_VERSION ||
+           header.byteOrder != MINIDUMP_BYTE_ORDER )
+         return false;
+
+      memset( &outRecord, 0, sizeof( outRecord ) );
+
+      outRecord.architecture = header.architecture;
+
+      size_t   position = sizeof( header );
+
+      for ( uint32_t i = 0; i < header.sectionCount; ++i )
+      {
+         MinidumpSection   section;
+
+         if ( inSize - position < sizeof( section ) )
+            return false;
+
+         memcpy( &section, cData + position, sizeof( section ) );
+         position += sizeof( section );
+
+         if ( inSize - position < section.size )
+            return false;
+
+         if ( !_readSection( section.type, cData + position, section.size, outRecord ) )
+            return false;
+
+         position += _padded( section.size );
+
+         if ( position > inSize )
+            position = inSize;
+      }
+
+      return true;
+   }
+
+   void  setMinidumpFileDirectory( const char *inDirectory )
+   {
+      if ( inDirectory == nullptr )
+      {
+         sMinidumpDirectory[0] = '\0';
+         return;
+      }
+
+      strncpy( sMinidumpDirectory, inDirectory, sizeof( sMinidumpDirectory ) - 1 );
+      sMinidumpDirectory[sizeof( sMinidumpDirectory ) - 1] = '\0';
+   }
+
+   // Append a number to a string without snprintf (which isn't async-signal-safe)
+   static char  *_appendNumber( char *outString, const char *inEnd, uint64_t inNumber )
+   {
+      char  digits[20];
+      int   count = 0;
+
+      do
+      {
+         digits[count++] = char( '0' + inNumber % 10 );
+         inNumber /= 10;
+      } while ( inNumber > 0 );
+
+      while ( count > 0 && outString < inEnd )
+         *outString++ = digits[--count];
+
+      return outString;
+   }
+
+   static char  *_appendString( char *outString, const char *inEnd, const char *inSource )
+   {
+      while ( *inSource != '\0' && outString < inEnd )
+         *outString++ = *inSource++;
+
+      return outString;
+   }
+
+   bool  writeMinidumpFile( const CrashRecord &inRecord )
+   {
+      if ( sMinidumpDirectory[0] == '\0' )
+         return false;
+
+      char  path[MAX_PATH_SIZE + 48] = { 0 };
+      const char  *cEnd = path + sizeof( path ) - 1;
+
+      char  *position = _appendString( path, cEnd, sMinidumpDirectory );
+
+      position = _appendString( position, cEnd, "/" );
+      position = _appendNumber( position, cEnd, uint64_t( inRecord.time ) );
+      position = _appendString( position, cEnd, "-" );
+      position = _appendNumber( position, cEnd, uint64_t( inRecord.pid ) );
+      position = _appendString( position, cEnd, ".ycrd" );
+      *position = '\0';
+
+      const int   cFd = open( path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644 );
+
+      if ( cFd < 0 )
+         return false;
+
+      size_t   size = 0;
+      const uint8_t  *data = serializeMinidump( inRecord, size );
+
+      // a single write unless it's interrupted
+      while ( size > 0 )
+      {
+         const ssize_t  cWritten = write( cFd, data, size );
+
+         if ( cWritten < 0 && errno == EINTR )
+            continue;
+
+         if ( cWritten <= 0 )
+            break;
+
+         data += cWritten;
+         size -= size_t( cWritten );
+      }
+
+      close( cFd );
+
+      return size == 0;
+   }
+}
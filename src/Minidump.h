@@ -0,0 +1,148 @@
+/*
+ * Copyright (C) 2020 Naikel Aparicio. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ''AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the author and should not be interpreted as representing
+ * official policies, either expressed or implied, of the copyright holder.
+ */
+
+
+#ifndef MINIDUMP_H
+#define MINIDUMP_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "CrashArena.h"
+
+
+namespace YappariCrashReport {
+
+   // The minidump is a compact binary form of a crash record: a header followed by sections, each one
+   // a MinidumpSection followed by its data padded to 8 bytes. Only the modules the stacks refer to
+   // are kept, so a typical minidump is a few KB and can be symbolized on another machine by build-id.
+
+   constexpr uint16_t   MINIDUMP_VERSION = 1;
+   constexpr uint16_t   MINIDUMP_BYTE_ORDER = 0x0102;
+
+   struct MinidumpHeader
+   {
+      char     magic[4];            ///< "YCRD"
+      uint16_t version;             ///< MINIDUMP_VERSION
+      uint16_t byteOrder;           ///< MINIDUMP_BYTE_ORDER as written by the crashed process
+      uint32_t architecture;        ///< The CrashArchitecture of the crashed process
+      uint32_t sectionCount;
+   };
+
+   enum MinidumpSectionType : uint32_t
+   {
+      MINIDUMP_APPLICATION = 1,     ///< The name, version and program path, each one nul-terminated
+      MINIDUMP_CRASH,               ///< A MinidumpCrash followed by the frames of the crashed thread
+      MINIDUMP_REGISTERS,           ///< A MinidumpRegisters followed by the registers
+      MINIDUMP_THREAD,              ///< A MinidumpThread followed by its frames
+      MINIDUMP_MODULE,              ///< A MinidumpModule followed by its path
+      MINIDUMP_STACK_MEMORY,        ///< A MinidumpStackMemory followed by the copy of the stack
+      MINIDUMP_BREADCRUMBS,         ///< A MinidumpBreadcrumbs followed by the BreadcrumbRecord of each breadcrumb
+      MINIDUMP_EXCEPTION,           ///< An ExceptionRecord up to its last valid frame
+   };
+
+   struct MinidumpSection
+   {
+      uint32_t type;                ///< A MinidumpSectionType, unknown types are skipped by the reader
+      uint32_t size;                ///< The size of the data, without the padding
+   };
+
+   struct MinidumpCrash
+   {
+      int32_t  signal;
+      int32_t  signalCode;
+      uint64_t faultAddress;
+      int32_t  pid;
+      int32_t  tid;
+      int64_t  time;
+      uint64_t captureStartNs;
+      uint64_t captureEndNs;
+      uint32_t frameCount;
+      uint32_t reserved;
+   };
+
+   struct MinidumpRegisters
+   {
+      uint32_t registerCount;
+      uint32_t reserved;
+   };
+
+   struct MinidumpThread
+   {
+      int32_t  tid;
+      char     name[16];
+      uint32_t frameCount;
+   };
+
+   struct MinidumpModule
+   {
+      uint64_t start;
+      uint64_t end;
+      uint64_t loadBias;
+      uint32_t buildIdSize;
+      uint32_t pathSize;
+      uint8_t  buildId[MAX_BUILD_ID_SIZE];
+   };
+
+   struct MinidumpStackMemory
+   {
+      uint64_t address;
+      int32_t  tid;
+      uint32_t size;
+   };
+
+   struct MinidumpBreadcrumbs
+   {
+      uint32_t breadcrumbCount;
+      uint32_t reserved;
+   };
+
+   /// Serialize a crash record into a preallocated buffer (async-signal-safe).
+   /// The buffer is reused by every call.
+   ///
+   /// @param inRecord The crash record
+   /// @param outSize The size of the minidump
+   /// @return The minidump
+   const uint8_t *serializeMinidump( const CrashRecord &inRecord, size_t &outSize );
+
+   /// Read a minidump back into a crash record.
+   /// @return false if the data is not a valid minidump
+   bool readMinidump( const void *inData, size_t inSize, CrashRecord &outRecord );
+
+   /// Set the directory writeMinidumpFile() writes to, nullptr to disable it
+   void setMinidumpFileDirectory( const char *inDirectory );
+
+   /// Write the crash record as a minidump named <time>-<pid>.ycrd to the minidump directory
+   /// with a single write. Only uses async-signal-safe operations.
+   /// @return true if the minidump was written
+   bool writeMinidumpFile( const CrashRecord &inRecord );
+
+}
+
+#endif
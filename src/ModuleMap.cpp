@@ -0,0 +1,385 @@
+/*
+ * Copyright (C) 2020 Naikel Aparicio. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ''AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the author and should not be interpreted as representing
+ * official policies, either expressed or implied, of the copyright holder.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <mutex>
+
+#include <link.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "ModuleMap.h"
+
+
+namespace YappariCrashReport
+{
+   struct ModuleSnapshot
+   {
+      unsigned long long   adds;    // the dl_iterate_phdr() counters when the snapshot was taken
+      unsigned long long   subs;
+      uint32_t       count;
+      ModuleRecord   modules[MAX_MODULES];
+   };
+
+   // Two snapshots: the signal handler reads the active one while a refresh writes the other one.
+   // The sequence is odd while a refresh is writing, so a reader can tell if its snapshot was rewritten under it.
+   static ModuleSnapshot   *sSnapshots = nullptr;
+   static std::atomic<int>       sActive( 0 );
+   static std::atomic<uint32_t>  sSequence( 0 );
+   static std::atomic<bool>      sEnabled( false );
+   static std::atomic<bool>      sWatched( false );   // take the first snapshot once a module is loaded or unloaded
+
+   static unsigned long long  sWatchedCounters[2] = { 0, 0 };   // the dl_iterate_phdr() counters when the watch started
+
+   static std::mutex sRefreshMutex;
+
+   static char    sProgramPath[MAX_PATH_SIZE] = { 0 };   // dl_iterate_phdr() gives the executable no name
+
+   // Read the build-id from the notes the module has mapped
+   static void  _readBuildId( const dl_phdr_info &inInfo, ModuleRecord &ioModule )
+   {
+      ioModule.buildIdSize = 0;
+
+      for ( int i = 0; i < inInfo.dlpi_phnum; ++i )
+      {
+         const ElfW(Phdr)  &cSegment = inInfo.dlpi_phdr[i];
+
+         if ( cSegment.p_type != PT_NOTE )
+            continue;
+
+         const uint64_t cNotesEnd = inInfo.dlpi_addr + cSegment.p_vaddr + cSegment.p_filesz;
+
+         for ( uint64_t note = inInfo.dlpi_addr + cSegment.p_vaddr; note + sizeof( ElfW(Nhdr) ) <= cNotesEnd; )
+         {
+            const ElfW(Nhdr)  *cNote = reinterpret_cast<const ElfW(Nhdr) *>(uintptr_t( note ));
+
+            const uint64_t cName = note + sizeof( ElfW(Nhdr) );
+            const uint64_t cDescription = cName + ((cNote->n_namesz + 3) & ~3u);
+
+            if ( cDescription + cNote->n_descsz > cNotesEnd )
+               break;
+
+            if ( cNote->n_type == NT_GNU_BUILD_ID && cNote->n_namesz == 4 &&
+                 memcmp( reinterpret_cast<const void *>(uintptr_t( cName )), "GNU", 4 ) == 0 )
+            {
+               ioModule.buildIdSize = (cNote->n_descsz < MAX_BUILD_ID_SIZE) ? cNote->n_descsz : MAX_BUILD_ID_SIZE;
+               memcpy( ioModule.buildId, reinterpret_cast<const void *>(uintptr_t( cDescription )), ioModule.buildIdSize );
+               return;
+            }
+
+            note = cDescription + ((cNote->n_descsz + 3) & ~3u);
+         }
+      }
+   }
+
+   // The module of the previous snapshot, if it was already loaded then
+   static const ModuleRecord  *_previousModule( const ModuleSnapshot &inPrevious, const ModuleRecord &inModule )
+   {
+      const ModuleRecord   *cEnd = inPrevious.modules + inPrevious.count;
+
+      const ModuleRecord   *cModule = std::lower_bound( inPrevious.modules, cEnd, inModule.start,
+                                                        [] ( const ModuleRecord &inRecord, uint64_t inStart ) {
+                                                           return inRecord.start < inStart;
+                                                        } );
+
+      if ( cModule == cEnd || cModule->start != inModule.start || cModule->loadBias != inModule.loadBias ||
+           strcmp( cModule->path, inModule.path ) != 0 )
+         return nullptr;
+
+      return cModule;
+   }
+
+   struct SnapshotBuilder
+   {
+      const ModuleSnapshot *previous;
+      ModuleSnapshot *snapshot;
+      bool  isFirst;
+   };
+
+   static int  _addModule( dl_phdr_info *inInfo, size_t inSize, void *ioBuilder )
+   {
+      (void)inSize;
+
+      SnapshotBuilder   &builder = *static_cast<SnapshotBuilder *>(ioBuilder);
+      ModuleSnapshot    &snapshot = *builder.snapshot;
+
+      // nothing was loaded or unloaded since the previous snapshot
+      if ( builder.isFirst )
+      {
+         builder.isFirst = false;
+
+         snapshot.adds = inInfo->dlpi_adds;
+         snapshot.subs = inInfo->dlpi_subs;
+
+         if ( builder.previous != nullptr && builder.previous->adds == inInfo->dlpi_adds &&
+              builder.previous->subs == inInfo->dlpi_subs )
+            return 1;
+      }
+
+      if ( snapshot.count == MAX_MODULES )
+         return 1;
+
+      ModuleRecord   &module = snapshot.modules[snapshot.count];
+
+      uint64_t start = UINT64_MAX;
+      uint64_t end = 0;
+
+      for ( int i = 0; i < inInfo->dlpi_phnum; ++i )
+      {
+         const ElfW(Phdr)  &cSegment = inInfo->dlpi_phdr[i];
+
+         if ( cSegment.p_type != PT_LOAD )
+            continue;
+
+         start = std::min<uint64_t>( start, inInfo->dlpi_addr + cSegment.p_vaddr );
+         end = std::max<uint64_t>( end, inInfo->dlpi_addr + cSegment.p_vaddr + cSegment.p_memsz );
+      }
+
+      if ( start >= end )
+         return 0;
+
+      const char  *cPath = (inInfo->dlpi_name != nullptr && inInfo->dlpi_name[0] != '\0') ? inInfo->dlpi_name : sProgramPath;
+
+      module.start = start & ~uint64_t( getpagesize() - 1 );
+      module.end = end;
+      module.loadBias = inInfo->dlpi_addr;
+      strncpy( module.path, cPath, sizeof( module.path ) - 1 );
+      module.path[sizeof( module.path ) - 1] = '\0';
+
+      // the modules that were already loaded keep their build-id
+      const ModuleRecord   *cPrevious = (builder.previous != nullptr) ? _previousModule( *builder.previous, module ) : nullptr;
+
+      if ( cPrevious != nullptr )
+      {
+         module.buildIdSize = cPrevious->buildIdSize;
+         memcpy( module.buildId, cPrevious->buildId, sizeof( module.buildId ) );
+      }
+      else
+      {
+         _readBuildId( *inInfo, module );
+      }
+
+      ++snapshot.count;
+
+      return 0;
+   }
+
+   bool  prepareModuleMap()
+   {
+      std::lock_guard<std::mutex>   lock( sRefreshMutex );
+
+      if ( sSnapshots == nullptr )
+      {
+         void  *snapshots = mmap( nullptr, 2 * sizeof( ModuleSnapshot ), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+
+         if ( snapshots == MAP_FAILED )
+            return false;
+
+         // touch every page now so the handler never has to fault them in
+         memset( snapshots, 0, 2 * sizeof( ModuleSnapshot ) );
+
+         sSnapshots = static_cast<ModuleSnapshot *>(snapshots);
+
+         const ssize_t  cSize = readlink( "/proc/self/exe", sProgramPath, sizeof( sProgramPath ) - 1 );
+
+         sProgramPath[(cSize > 0) ? cSize : 0] = '\0';
+      }
+
+      sEnabled.store( true );
+
+      return true;
+   }
+
+   void  refreshModuleMap()
+   {
+      std::lock_guard<std::mutex>   lock( sRefreshMutex );
+
+      if ( sSnapshots == nullptr )
+         return;
+
+      const int   cActive = sActive.load( std::memory_order_relaxed );
+      const uint32_t cSequence = sSequence.load( std::memory_order_relaxed );
+
+      // the very first snapshot has nothing to start from
+      const ModuleSnapshot *cPrevious = (cSequence > 0) ? &sSnapshots[cActive] : nullptr;
+      ModuleSnapshot *snapshot = &sSnapshots[1 - cActive];
+
+      sSequence.store( cSequence + 1, std::memory_order_relaxed );
+      std::atomic_thread_fence( std::memory_order_release );
+
+      snapshot->count = 0;
+
+      SnapshotBuilder   builder{ cPrevious, snapshot, true };
+
+      dl_iterate_phdr( _addModule, &builder );
+
+      const bool  cChanged = (snapshot->count > 0);
+
+      if ( cChanged )
+      {
+         std::sort( snapshot->modules, snapshot->modules + snapshot->count, [] ( const ModuleRecord &inA, const ModuleRecord &inB ) {
+            return inA.start < inB.start;
+         } );
+
+         sActive.store( 1 - cActive, std::memory_order_release );
+      }
+
+      sSequence.store( cSequence + 2, std::memory_order_release );
+   }
+
+   // Run a read of the active snapshot, retrying if a refresh rewrote it meanwhile
+   template <typename Read>
+   static bool  _readSnapshot( Read inRead )
+   {
+      if ( sSnapshots == nullptr )
+         return false;
+
+      for ( int attempt = 0; attempt < 4; ++attempt )
+      {
+         const uint32_t cBefore = sSequence.load( std::memory_order_acquire );
+
+         // no snapshot yet
+         if ( cBefore < 2 )
+            return false;
+
+         inRead( sSnapshots[sActive.load( std::memory_order_acquire )] );
+
+         std::atomic_thread_fence( std::memory_order_acquire );
+
+         // a single refresh writes the other snapshot, only a second one could have written this one
+         if ( sSequence.load( std::memory_order_relaxed ) - cBefore <= 1 )
+            return true;
+      }
+
+      return false;
+   }
+
+   uint32_t  copyModuleMap( ModuleRecord *outModules, uint32_t inMaxModules )
+   {
+      uint32_t count = 0;
+
+      const bool  cRead = _readSnapshot( [&] ( const ModuleSnapshot &inSnapshot ) {
+         count = std::min( std::min( inSnapshot.count, inMaxModules ), uint32_t( MAX_MODULES ) );
+
+         memcpy( outModules, inSnapshot.modules, count * sizeof( ModuleRecord ) );
+      } );
+
+      return cRead ? count : 0;
+   }
+
+   bool  findModule( uint64_t inAddress, ModuleRecord &outModule )
+   {
+      bool  found = false;
+
+      const bool  cRead = _readSnapshot( [&] ( const ModuleSnapshot &inSnapshot ) {
+         const uint32_t cCount = std::min( inSnapshot.count, uint32_t( MAX_MODULES ) );
+         const ModuleRecord   *cEnd = inSnapshot.modules + cCount;
+
+         // the last module starting at or before the address
+         const ModuleRecord   *cModule = std::upper_bound( inSnapshot.modules, cEnd, inAddress,
+                                                           [] ( uint64_t inValue, const ModuleRecord &inRecord ) {
+                                                              return inValue < inRecord.start;
+                                                           } );
+
+         found = (cModule != inSnapshot.modules && inAddress < (cModule - 1)->end);
+
+         if ( found )
+            outModule = *(cModule - 1);
+      } );
+
+      return cRead && found;
+   }
+
+   // The dl_iterate_phdr() counters of the modules loaded & unloaded so far
+   static int  _readCounters( dl_phdr_info *inInfo, size_t inSize, void *outCounters )
+   {
+      (void)inSize;
+
+      unsigned long long   *counters = static_cast<unsigned long long *>(outCounters);
+
+      counters[0] = inInfo->dlpi_adds;
+      counters[1] = inInfo->dlpi_subs;
+
+      return 1;
+   }
+
+   void  watchModuleMap()
+   {
+      std::lock_guard<std::mutex>   lock( sRefreshMutex );
+
+      dl_iterate_phdr( _readCounters, sWatchedCounters );
+
+      sWatched.store( true );
+   }
+
+   void  updateModuleMap()
+   {
+      if ( !sEnabled.load( std::memory_order_relaxed ) )
+      {
+         if ( !sWatched.load( std::memory_order_acquire ) )
+            return;
+
+         unsigned long long   counters[2] = { 0, 0 };
+
+         dl_iterate_phdr( _readCounters, counters );
+
+         // nothing was loaded or unloaded since the watch started
+         if ( counters[0] == sWatchedCounters[0] && counters[1] == sWatchedCounters[1] )
+            return;
+
+         if ( !prepareModuleMap() )
+            return;
+      }
+
+      refreshModuleMap();
+   }
+
+   bool  moduleMapCovers( const ModuleRecord *inModules, uint32_t inModuleCount, const uint64_t *inAddresses, uint32_t inCount )
+   {
+      for ( uint32_t i = 0; i < inCount; ++i )
+      {
+         // the end of a stack may be a zero return address
+         if ( inAddresses[i] == 0 )
+            continue;
+
+         const ModuleRecord   *cEnd = inModules + inModuleCount;
+         const ModuleRecord   *cModule = std::upper_bound( inModules, cEnd, inAddresses[i],
+                                                           [] ( uint64_t inValue, const ModuleRecord &inRecord ) {
+                                                              return inValue < inRecord.start;
+                                                           } );
+
+         if ( cModule == inModules || inAddresses[i] >= (cModule - 1)->end )
+            return false;
+      }
+
+      return true;
+   }
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2020 Naikel Aparicio. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ''AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the author and should not be interpreted as representing
+ * official policies, either expressed or implied, of the copyright holder.
+ */
+
+
+#ifndef MODULEMAP_H
+#define MODULEMAP_H
+
+#include <cstdint>
+
+#include "CrashArena.h"
+
+
+namespace YappariCrashReport {
+
+   /// Take a snapshot of the loaded modules (sorted load ranges, build-ids & paths) with dl_iterate_phdr().
+   /// It is kept up to date by refreshModuleMap() and updateModuleMap(). Only available on Linux.
+   /// @return false if the memory for the snapshot couldn't be reserved
+   bool prepareModuleMap();
+
+   /// Have updateModuleMap() call prepareModuleMap() once a module is loaded or unloaded, so applications
+   /// that never load modules don't pay for the snapshot: their crashes read the modules from
+   /// /proc/self/maps instead (see captureModules()).
+   void watchModuleMap();
+
+   /// Bring the snapshot up to date. Only the modules loaded since the last snapshot are read.
+   void refreshModuleMap();
+
+   /// Bring the snapshot up to date if a module was loaded or unloaded since the last one, taking the first
+   /// snapshot if it is only watched. Costs one dl_iterate_phdr() callback when nothing changed, so it can
+   /// be called whenever the application is idle.
+   void updateModuleMap();
+
+   /// Copy the snapshot, sorted by address (async-signal-safe).
+   /// @return The number of modules copied, 0 if there is no consistent snapshot
+   uint32_t copyModuleMap( ModuleRecord *outModules, uint32_t inMaxModules );
+
+   /// Find the module containing an address with a binary search of the snapshot
+   /// (async-signal-safe, doesn't allocate).
+   /// @return false if no module contains the address
+   bool findModule( uint64_t inAddress, ModuleRecord &outModule );
+
+   /// Whether every address (but zeros) is in one of the modules, sorted by address, of a snapshot copy.
+   /// The snapshot misses the modules loaded since its last update (async-signal-safe).
+   bool moduleMapCovers( const ModuleRecord *inModules, uint32_t inModuleCount, const uint64_t *inAddresses, uint32_t inCount );
+
+}
+
+#endif
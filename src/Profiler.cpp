@@ -0,0 +1,722 @@
+/*
+ * Copyright (C) 2020 Naikel Aparicio. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ''AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the author and should not be interpreted as representing
+ * official policies, either expressed or implied, of the copyright holder.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <ctime>
+#include <vector>
+
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <QDir>
+#include <QFileInfo>
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSet>
+#include <QStringList>
+#include <QThread>
+#include <QVector>
+#include <QWaitCondition>
+
+#include "CrashArena.h"
+#include "Profiler.h"
+#include "StackTrace.h"
+#include "Unwinder.h"
+
+// glibc has no name for the thread of a SIGEV_THREAD_ID event
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
+
+
+namespace YappariCrashReport
+{
+   constexpr uint64_t   PROFILE_RING_SIZE = 64;   // a power of 2, several drains worth of samples at 100 Hz
+   constexpr unsigned long PROFILE_DRAIN_INTERVAL_MS = 100;
+   constexpr int  PROFILE_THREAD_SCAN_INTERVAL = 10;  // in drains
+
+   struct ProfileSample
+   {
+      uint32_t frameCount;
+      uint64_t frames[MAX_STACK_FRAMES];
+   };
+
+   // The samples of one thread. Only its SIGPROF handler writes to it and only the aggregator reads it,
+   // so moving the head and the tail is all the synchronization needed.
+   struct ProfileRing
+   {
+      std::atomic<int32_t>    owner{ 0 };    // the thread whose handler writes to it, 0 for none
+      std::atomic<uint64_t>   head{ 0 };     // the number of samples written
+      std::atomic<uint64_t>   tail{ 0 };     // the number of samples read
+      std::atomic<uint64_t>   dropped{ 0 };  // the samples lost because the ring was full
+      ProfileSample  samples[PROFILE_RING_SIZE];
+   };
+
+   struct ProfiledThread
+   {
+      timer_t  timer;
+      ProfileRing *ring;
+   };
+
+   static std::atomic<bool>   sSampling{ false };
+   static bool sHandlerInstalled = false;
+   static uint64_t   sPeriodNs = 0;
+
+   // Only used by the aggregator thread
+   static QHash<int32_t, ProfiledThread>  sThreads;
+   static std::vector<ProfileRing *>   sFreeRings;   // never freed: a signal already on its way may still write to one
+
+   // The results
+   static QMutex  sProfileMutex;
+   static QHash<const InternedStack *, quint64> sCounts;
+   static quint64 sDroppedSamples = 0;
+   static uint64_t   sSamplingStartNs = 0;
+   static uint64_t   sSampledNs = 0;      // how long the profiler sampled before the current start
+
+   static int32_t  _currentThreadId()
+   {
+      return int32_t( syscall( SYS_gettid ) );
+   }
+
+   static void  _profileHandler( int, siginfo_t *inSigInfo, void *inContext )
+   {
+      if ( inSigInfo->si_code != SI_TIMER || !sSampling.load( std::memory_order_relaxed ) )
+         return;
+
+      const int   cSavedErrno = errno;
+
+      ProfileRing *ring = static_cast<ProfileRing *>(inSigInfo->si_value.sival_ptr);
+
+      // the signal of a deleted timer may arrive after the ring changed hands
+      if ( ring != nullptr && ring->owner.load( std::memory_order_acquire ) == _currentThreadId() )
+      {
+         const uint64_t cHead = ring->head.load( std::memory_order_relaxed );
+
+         if ( (cHead - ring->tail.load( std::memory_order_acquire )) >= PROFILE_RING_SIZE )
+         {
+            ring->dropped.fetch_add( 1, std::memory_order_relaxed );
+         }
+         else
+         {
+            ProfileSample  &sample = ring->samples[cHead & (PROFILE_RING_SIZE - 1)];
+
+            // the signal can arrive anywhere, even in the middle of the DWARF unwinder of a throw
+            sample.frameCount = unwindFramePointers( inContext, sample.frames );
+
+            ring->head.store( cHead + 1, std::memory_order_release );
+         }
+      }
+
+      errno = cSavedErrno;
+   }
+
+   // Count the samples of a ring
+   static void  _drainRing( ProfileRing *ioRing, QHash<const InternedStack *, quint64> &ioCounts, quint64 &ioDropped )
+   {
+      const uint64_t cHead = ioRing->head.load( std::memory_order_acquire );
+
+      uint64_t tail = ioRing->tail.load( std::memory_order_relaxed );
+
+      for ( ; tail != cHead; ++tail )
+      {
+         const ProfileSample  &cSample = ioRing->samples[tail & (PROFILE_RING_SIZE - 1)];
+
+         const InternedStack  *cStack = internStack( cSample.frames, std::min( cSample.frameCount, uint32_t( MAX_STACK_FRAMES ) ) );
+
+         if ( cStack == nullptr )
+            continue;
+
+         quint64  &count = ioCounts[cStack];
+
+         // the counts keep a single reference to each stack
+         if ( count != 0 )
+            releaseStack( cStack );
+
+         ++count;
+      }
+
+      ioRing->tail.store( tail, std::memory_order_release );
+
+      ioDropped += ioRing->dropped.exchange( 0, std::memory_order_relaxed );
+   }
+
+   static void  _startThread( int32_t inTid )
+   {
+      ProfileRing *ring;
+
+      if ( sFreeRings.empty() )
+      {
+         ring = new ProfileRing;
+      }
+      else
+      {
+         ring = sFreeRings.back();
+         sFreeRings.pop_back();
+      }
+
+      ring->head.store( 0, std::memory_order_relaxed );
+      ring->tail.store( 0, std::memory_order_relaxed );
+      ring->owner.store( inTid, std::memory_order_release );
+
+      struct sigevent   event;
+
+      memset( &event, 0, sizeof( event ) );
+
+      event.sigev_notify = SIGEV_THREAD_ID;
+      event.sigev_notify_thread_id = inTid;
+      event.sigev_signo = SIGPROF;
+      event.sigev_value.sival_ptr = ring;
+
+      // the CPU clock of the thread, the way the kernel encodes it: MAKE_THREAD_CPUCLOCK( tid, CPUCLOCK_SCHED )
+      const clockid_t   cClock = clockid_t( (~uint32_t( inTid ) << 3) | 6 );
+
+      const struct timespec   cPeriod{ time_t( sPeriodNs / 1000000000 ), long( sPeriodNs % 1000000000 ) };
+      const struct itimerspec cTimerSpec{ cPeriod, cPeriod };
+
+      timer_t  timer;
+
+      // the thread may be gone already
+      if ( timer_create( cClock, &event, &timer ) != 0 )
+      {
+         ring->owner.store( 0, std::memory_order_relaxed );
+         sFreeRings.push_back( ring );
+
+         return;
+      }
+
+      timer_settime( timer, 0, &cTimerSpec, nullptr );
+
+      sThreads.insert( inTid, ProfiledThread{ timer, ring } );
+   }
+
+   static void  _stopThread( const ProfiledThread &inThread, QHash<const InternedStack *, quint64> &ioCounts, quint64 &ioDropped )
+   {
+      timer_delete( inThread.timer );
+
+      _drainRing( inThread.ring, ioCounts, ioDropped );
+
+      inThread.ring->owner.store( 0, std::memory_order_release );
+      sFreeRings.push_back( inThread.ring );
+   }
+
+   // Sample the threads started since the last scan and let the ones that ended go
+   static void  _scanThreads( int32_t inAggregatorTid, QHash<const InternedStack *, quint64> &ioCounts, quint64 &ioDropped )
+   {
+      const QStringList cTasks = QDir( QStringLiteral( "/proc/self/task" ) ).entryList( QDir::Dirs | QDir::NoDotAndDotDot );
+
+      QSet<int32_t>  threads;
+
+      for ( const QString &cTask : cTasks )
+      {
+         const int32_t  cTid = int32_t( cTask.toInt() );
+
+         threads.insert( cTid );
+
+         if ( cTid != inAggregatorTid && !sThreads.contains( cTid ) )
+            _startThread( cTid );
+      }
+
+      for ( auto it = sThreads.begin(); it != sThreads.end(); )
+      {
+         if ( threads.contains( it.key() ) )
+         {
+            ++it;
+            continue;
+         }
+
+         _stopThread( it.value(), ioCounts, ioDropped );
+
+         it = sThreads.erase( it );
+      }
+   }
+
+   // Drains the rings into the counts and keeps the set of sampled threads up to date
+   class ProfileAggregator : public QThread
+   {
+   public:
+      ProfileAggregator()
+      {
+         setObjectName( QStringLiteral( "YappariProfiler" ) );
+      }
+
+      void  stop()
+      {
+         {
+            QMutexLocker   locker( &mMutex );
+
+            mStopping = true;
+            mWake.wakeAll();
+         }
+
+         wait();
+
+         mStopping = false;
+      }
+
+   protected:
+      void  run() override
+      {
+         const int32_t  cTid = _currentThreadId();
+
+         int   drains = 0;
+
+         QMutexLocker   locker( &mMutex );
+
+         while ( !mStopping )
+         {
+            locker.unlock();
+
+            QHash<const InternedStack *, quint64>  counts;
+            quint64  dropped = 0;
+
+            if ( (drains++ % PROFILE_THREAD_SCAN_INTERVAL) == 0 )
+               _scanThreads( cTid, counts, dropped );
+
+            for ( const ProfiledThread &cThread : qAsConst( sThreads ) )
+               _drainRing( cThread.ring, counts, dropped );
+
+            _addCounts( counts, dropped );
+
+            locker.relock();
+
+            if ( !mStopping )
+               mWake.wait( &mMutex, PROFILE_DRAIN_INTERVAL_MS );
+         }
+
+         locker.unlock();
+
+         QHash<const InternedStack *, quint64>  counts;
+         quint64  dropped = 0;
+
+         for ( const ProfiledThread &cThread : qAsConst( sThreads ) )
+            _stopThread( cThread, counts, dropped );
+
+         sThreads.clear();
+
+         _addCounts( counts, dropped );
+      }
+
+   private:
+      static void  _addCounts( const QHash<const InternedStack *, quint64> &inCounts, quint64 inDropped )
+      {
+         QMutexLocker   locker( &sProfileMutex );
+
+         // the references of the counts go over to the profile
+         for ( auto it = inCounts.constBegin(); it != inCounts.constEnd(); ++it )
+         {
+            quint64  &count = sCounts[it.key()];
+
+            if ( count != 0 )
+               releaseStack( it.key() );
+
+            count += it.value();
+         }
+
+         sDroppedSamples += inDropped;
+      }
+
+      QMutex   mMutex;
+      QWaitCondition mWake;
+      bool     mStopping = false;
+   };
+
+   // Never deleted, so a profiler still running when the process exits doesn't abort it
+   static ProfileAggregator   *sAggregator = nullptr;
+
+   bool  startProfiler( int inFrequencyHz )
+   {
+      if ( isProfilerRunning() )
+         stopProfiler();
+
+      // the handler stays installed once sampling stops: the default action of a late SIGPROF is to terminate
+      if ( !sHandlerInstalled )
+      {
+         struct sigaction sigAction;
+
+         sigAction.sa_sigaction = _profileHandler;
+
+         sigemptyset( &sigAction.sa_mask );
+
+         sigAction.sa_flags = SA_SIGINFO | SA_RESTART | SA_ONSTACK;
+
+         if ( sigaction( SIGPROF, &sigAction, nullptr ) != 0 )
+            return false;
+
+         sHandlerInstalled = true;
+      }
+
+      sPeriodNs = 1000000000ull / uint64_t( qBound( 1, inFrequencyHz, 10000 ) );
+
+      if ( sAggregator == nullptr )
+         sAggregator = new ProfileAggregator;
+
+      {
+         QMutexLocker   locker( &sProfileMutex );
+
+         sSamplingStartNs = monotonicNanoseconds();
+      }
+
+      sSampling.store( true );
+
+      sAggregator->start( QThread::LowPriority );
+
+      return true;
+   }
+
+   void  stopProfiler()
+   {
+      if ( !isProfilerRunning() )
+         return;
+
+      sSampling.store( false );
+
+      sAggregator->stop();
+
+      QMutexLocker   locker( &sProfileMutex );
+
+      sSampledNs += monotonicNanoseconds() - sSamplingStartNs;
+      sSamplingStartNs = 0;
+   }
+
+   bool  isProfilerRunning()
+   {
+      return sAggregator != nullptr && sAggregator->isRunning();
+   }
+
+   void  clearProfile()
+   {
+      QMutexLocker   locker( &sProfileMutex );
+
+      for ( auto it = sCounts.constBegin(); it != sCounts.constEnd(); ++it )
+         releaseStack( it.key() );
+
+      sCounts.clear();
+      sDroppedSamples = 0;
+      sSampledNs = 0;
+
+      if ( sSamplingStartNs != 0 )
+         sSamplingStartNs = monotonicNanoseconds();
+   }
+
+   // A function of a frame, as the symbolizer found it
+   struct FrameFunction
+   {
+      QString  name;
+      QString  file;
+      qint64   line = 0;
+   };
+
+   // The functions of a frame, the innermost (inlined) first. Frames that couldn't be symbolized
+   // are named after their module and offset.
+   static QVector<FrameFunction>  _frameFunctions( const StackFrame &inFrame )
+   {
+      QVector<FrameFunction>  functions;
+
+      const QStringList cLines = inFrame.location.split( '\n' );
+
+      for ( QString line : cLines )
+      {
+         line = line.trimmed();
+
+         if ( line.startsWith( QLatin1String( "(inlined by) " ) ) )
+            line = line.mid( 13 );
+
+         FrameFunction  function;
+
+         // "function at file:line"
+         const int   cAt = line.lastIndexOf( QLatin1String( " at " ) );
+
+         function.name = (cAt < 0) ? line : line.left( cAt );
+
+         if ( cAt >= 0 )
+         {
+            const QString  cFileLine = line.mid( cAt + 4 );
+            const int   cColon = cFileLine.lastIndexOf( ':' );
+
+            function.file = (cColon < 0) ? cFileLine : cFileLine.left( cColon );
+            function.line = (cColon < 0) ? 0 : cFileLine.mid( cColon + 1 ).toLongLong();
+         }
+
+         if ( !function.name.isEmpty() && function.name != QLatin1String( "??" ) )
+            functions += function;
+      }
+
+      if ( functions.isEmpty() )
+      {
+         FrameFunction  function;
+
+         if ( inFrame.module.isEmpty() )
+            function.name = QStringLiteral( "0x%1" ).arg( inFrame.address, 0, 16 );
+         else
+            function.name = QStringLiteral( "%1+0x%2" ).arg( QFileInfo( inFrame.module ).fileName() ).arg( inFrame.offset, 0, 16 );
+
+         functions += function;
+      }
+
+      return functions;
+   }
+
+   // The counts of the profile, with a reference to each stack so clearProfile() doesn't free them meanwhile
+   static QHash<const InternedStack *, quint64>  _counts()
+   {
+      QMutexLocker   locker( &sProfileMutex );
+
+      for ( auto it = sCounts.constBegin(); it != sCounts.constEnd(); ++it )
+         retainStack( it.key() );
+
+      return sCounts;
+   }
+
+   static void  _releaseCounts( const QHash<const InternedStack *, quint64> &inCounts )
+   {
+      for ( auto it = inCounts.constBegin(); it != inCounts.constEnd(); ++it )
+         releaseStack( it.key() );
+   }
+
+   QByteArray  profileFoldedStacks()
+   {
+      const QHash<const InternedStack *, quint64>  cCounts = _counts();
+
+      // different return addresses in the same functions fold into the same line
+      QHash<QString, quint64> foldedCounts;
+
+      for ( auto it = cCounts.constBegin(); it != cCounts.constEnd(); ++it )
+      {
+         const StackFrameList cFrames = symbolizeInternedFrames( it.key() );
+
+         QStringList names;
+
+         for ( int i = cFrames.size() - 1; i >= 0; --i )
+         {
+            const QVector<FrameFunction>  cFunctions = _frameFunctions( cFrames.at( i ) );
+
+            for ( int function = cFunctions.size() - 1; function >= 0; --function )
+               names += cFunctions.at( function ).name;
+         }
+
+         foldedCounts[names.join( ';' )] += it.value();
+      }
+
+      _releaseCounts( cCounts );
+
+      QStringList lines;
+
+      for ( auto it = foldedCounts.constBegin(); it != foldedCounts.constEnd(); ++it )
+         lines += QStringLiteral( "%1 %2" ).arg( it.key() ).arg( it.value() );
+
+      lines.sort();
+
+      return lines.join( '\n' ).toUtf8() + (lines.isEmpty() ? "" : "\n");
+   }
+
+   // Writes the protocol buffer messages of profile.proto
+   class ProtobufWriter
+   {
+   public:
+      void  varint( uint64_t inValue )
+      {
+         while ( inValue >= 0x80 )
+         {
+            mData += char( (inValue & 0x7f) | 0x80 );
+            inValue >>= 7;
+         }
+
+         mData += char( inValue );
+      }
+
+      void  field( int inNumber, uint64_t inValue )
+      {
+         varint( uint64_t( inNumber ) << 3 );
+         varint( inValue );
+      }
+
+      void  field( int inNumber, const QByteArray &inBytes )
+      {
+         varint( (uint64_t( inNumber ) << 3) | 2 );
+         varint( uint64_t( inBytes.size() ) );
+         mData += inBytes;
+      }
+
+      void  packedField( int inNumber, const QVector<uint64_t> &inValues )
+      {
+         ProtobufWriter packed;
+
+         for ( uint64_t value : inValues )
+            packed.varint( value );
+
+         field( inNumber, packed.data() );
+      }
+
+      const QByteArray  &data() const
+      {
+         return mData;
+      }
+
+   private:
+      QByteArray  mData;
+   };
+
+   QByteArray  profilePprof()
+   {
+      const QHash<const InternedStack *, quint64>  cCounts = _counts();
+
+      uint64_t durationNs;
+      quint64  droppedSamples;
+
+      {
+         QMutexLocker   locker( &sProfileMutex );
+
+         durationNs = sSampledNs + ((sSamplingStartNs != 0) ? (monotonicNanoseconds() - sSamplingStartNs) : 0);
+         droppedSamples = sDroppedSamples;
+      }
+
+      // string 0 is always the empty string
+      QStringList strings{ QString() };
+      QHash<QString, uint64_t>   stringIndexes{ { QString(), 0 } };
+
+      const auto  cString = [&] ( const QString &inString ) {
+         auto  it = stringIndexes.constFind( inString );
+
+         if ( it != stringIndexes.constEnd() )
+            return it.value();
+
+         strings += inString;
+
+         return stringIndexes.insert( inString, uint64_t( strings.size() - 1 ) ).value();
+      };
+
+      const auto  cValueType = [&] ( const QString &inType, const QString &inUnit ) {
+         ProtobufWriter valueType;
+
+         valueType.field( 1, cString( inType ) );
+         valueType.field( 2, cString( inUnit ) );
+
+         return valueType.data();
+      };
+
+      ProtobufWriter profile;
+
+      profile.field( 1, cValueType( QStringLiteral( "samples" ), QStringLiteral( "count" ) ) );
+      profile.field( 1, cValueType( QStringLiteral( "cpu" ), QStringLiteral( "nanoseconds" ) ) );
+
+      QHash<quintptr, uint64_t>  locationIds;
+      QHash<QString, uint64_t>   functionIds;   // by name and file
+      QByteArray  locations;
+      QByteArray  functions;
+
+      for ( auto it = cCounts.constBegin(); it != cCounts.constEnd(); ++it )
+      {
+         const StackFrameList cFrames = symbolizeInternedFrames( it.key() );
+
+         QVector<uint64_t> sampleLocations;
+
+         for ( const StackFrame &cFrame : cFrames )
+         {
+            uint64_t &locationId = locationIds[cFrame.address];
+
+            if ( locationId == 0 )
+            {
+               locationId = uint64_t( locationIds.size() );
+
+               ProtobufWriter location;
+
+               location.field( 1, locationId );
+               location.field( 3, uint64_t( cFrame.address ) );
+
+               // the inlined functions first, the function they were inlined into last
+               for ( const FrameFunction &cFunction : _frameFunctions( cFrame ) )
+               {
+                  uint64_t &functionId = functionIds[cFunction.name + QLatin1Char( '\n' ) + cFunction.file];
+
+                  if ( functionId == 0 )
+                  {
+                     functionId = uint64_t( functionIds.size() );
+
+                     ProtobufWriter function;
+
+                     function.field( 1, functionId );
+                     function.field( 2, cString( cFunction.name ) );
+                     function.field( 3, cString( cFunction.name ) );
+                     function.field( 4, cString( cFunction.file ) );
+
+                     ProtobufWriter functionField;
+
+                     functionField.field( 5, function.data() );
+                     functions += functionField.data();
+                  }
+
+                  ProtobufWriter line;
+
+                  line.field( 1, functionId );
+                  line.field( 2, uint64_t( cFunction.line ) );
+
+                  location.field( 4, line.data() );
+               }
+
+               ProtobufWriter locationField;
+
+               locationField.field( 4, location.data() );
+               locations += locationField.data();
+            }
+
+            sampleLocations += locationId;
+         }
+
+         ProtobufWriter sample;
+
+         sample.packedField( 1, sampleLocations );
+         sample.packedField( 2, { uint64_t( it.value() ), uint64_t( it.value() ) * sPeriodNs } );
+
+         profile.field( 2, sample.data() );
+      }
+
+      _releaseCounts( cCounts );
+
+      QByteArray  data = profile.data() + locations + functions;
+
+      ProtobufWriter tail;
+
+      if ( droppedSamples != 0 )
+         tail.field( 13, cString( QStringLiteral( "%1 samples dropped, the rings were full" ).arg( droppedSamples ) ) );
+
+      for ( const QString &cText : qAsConst( strings ) )
+         tail.field( 6, cText.toUtf8() );
+
+      tail.field( 10, durationNs );
+      tail.field( 11, cValueType( QStringLiteral( "cpu" ), QStringLiteral( "nanoseconds" ) ) );
+      tail.field( 12, sPeriodNs );
+
+      return data + tail.data();
+   }
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2020 Naikel Aparicio. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ''AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the author and should not be interpreted as representing
+ * official policies, either expressed or implied, of the copyright holder.
+ */
+
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <QByteArray>
+
+
+namespace YappariCrashReport {
+
+   /// Start sampling the stacks of all the threads (Linux only).
+   ///
+   /// Every thread gets a timer on its own CPU clock (timer_create() with SIGEV_THREAD_ID) that sends it
+   /// SIGPROF, so only the threads that use the CPU are sampled, in proportion. The SIGPROF handler
+   /// unwinds the stack into a ring of the thread, without locks nor allocations. A background thread
+   /// drains the rings, counts the samples per interned stack and picks up the threads started since.
+   /// @param inFrequencyHz The samples per second of CPU time of each thread
+   /// @return false if the signal handler could not be installed
+   bool startProfiler( int inFrequencyHz );
+
+   /// Stop sampling. The samples so far are kept until clearProfile().
+   void stopProfiler();
+
+   /// Whether the profiler is sampling
+   bool isProfilerRunning();
+
+   /// The samples as folded stacks, the input of flamegraph.pl: one line per stack with its functions
+   /// from the outermost to the innermost, separated by semicolons, and the number of samples.
+   QByteArray profileFoldedStacks();
+
+   /// The samples as a pprof profile (an uncompressed profile.proto), with the samples and CPU time of each stack
+   QByteArray profilePprof();
+
+   /// Forget the samples
+   void clearProfile();
+
+}
+
+#endif
@@ -0,0 +1,444 @@
+/*
+ * Copyright (C) 2020 Naikel Aparicio. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ''AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the author and should not be interpreted as representing
+ * official policies, either expressed or implied, of the copyright holder.
+ */
+
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "ReportStream.h"
+
+
+namespace YappariCrashReport
+{
+   static char sDirectory[MAX_PATH_SIZE] = { 0 };
+   static int32_t sUtcOffset = 0;
+
+   static char sPath[MAX_PATH_SIZE + 192] = { 0 };   // the open report, empty if none
+   static int  sFd = -1;
+
+   static const char *const   cMonths[] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
+
+   // Builds a line in a fixed buffer without snprintf (which isn't async-signal-safe)
+   class LineWriter
+   {
+   public:
+      void  append( const char *inText )
+      {
+         while ( *inText != '\0' && mSize < (sizeof( mText ) - 1) )
+            mText[mSize++] = *inText++;
+      }
+
+      void  append( const char *inText, size_t inSize )
+      {
+         for ( size_t i = 0; i < inSize && inText[i] != '\0' && mSize < (sizeof( mText ) - 1); ++i )
+            mText[mSize++] = inText[i];
+      }
+
+      void  appendNumber( uint64_t inNumber, int inMinDigits = 1 )
+      {
+         char  digits[20];
+         int   count = 0;
+
+         do
+         {
+            digits[count++] = char( '0' + inNumber % 10 );
+            inNumber /= 10;
+         } while ( inNumber > 0 || count < inMinDigits );
+
+         while ( count > 0 && mSize < (sizeof( mText ) - 1) )
+            mText[mSize++] = digits[--count];
+      }
+
+      void  appendHex( uint64_t inNumber, int inDigits )
+      {
+         append( "0x" );
+
+         for ( int i = inDigits - 1; i >= 0 && mSize < (sizeof( mText ) - 1); --i )
+            mText[mSize++] = "0123456789abcdef"[(inNumber >> (i * 4)) & 0xf];
+      }
+
+      const char  *text()
+      {
+         mText[mSize] = '\0';
+
+         return mText;
+      }
+
+      size_t  size() const
+      {
+         return mSize;
+      }
+
+   private:
+      char     mText[MAX_PATH_SIZE + 192];
+      size_t   mSize = 0;
+   };
+
+   static bool  _writeAll( int inFd, const char *inData, size_t inSize )
+   {
+      while ( inSize > 0 )
+      {
+         const ssize_t  cWritten = write( inFd, inData, inSize );
+
+         if ( cWritten < 0 && errno == EINTR )
+            continue;
+
+         if ( cWritten <= 0 )
+            return false;
+
+         inData += cWritten;
+         inSize -= size_t( cWritten );
+      }
+
+      return true;
+   }
+
+   static void  _writeLine( LineWriter &inLine )
+   {
+      inLine.append( "\n" );
+
+      _writeAll( sFd, inLine.text(), inLine.size() );
+   }
+
+   static const char  *_signalName( int inSignal )
+   {
+      switch ( inSignal )
+      {
+         case SIGSEGV:  return "SIGSEGV";
+         case SIGBUS:   return "SIGBUS";
+         case SIGFPE:   return "SIGFPE";
+         case SIGILL:   return "SIGILL";
+         case SIGABRT:  return "SIGABRT";
+         case SIGINT:   return "SIGINT";
+         case SIGTERM:  return "SIGTERM";
+         default:       return nullptr;
+      }
+   }
+
+   static void  _appendSignal( LineWriter &ioLine, int inSignal )
+   {
+      const char  *cName = _signalName( inSignal );
+
+      if ( cName != nullptr )
+      {
+         ioLine.append( cName );
+      }
+      else
+      {
+         ioLine.append( "signal " );
+         ioLine.appendNumber( uint64_t( inSignal ) );
+      }
+   }
+
+   // The local date and time of the crash (civil_from_days, see http://howardhinnant.github.io/date_algorithms.html)
+   struct LocalTime
+   {
+      int64_t  year;
+      unsigned month;      // 1 to 12
+      unsigned day;
+      unsigned hour;
+      unsigned minute;
+      unsigned second;
+   };
+
+   static LocalTime  _localTime( int64_t inTime )
+   {
+      const int64_t  cSeconds = inTime + sUtcOffset;
+      const int64_t  cDays = ((cSeconds >= 0) ? cSeconds : (cSeconds - 86399)) / 86400;
+      const int64_t  cSecondOfDay = cSeconds - cDays * 86400;
+
+      const int64_t  cShiftedDays = cDays + 719468;
+      const int64_t  cEra = ((cShiftedDays >= 0) ? cShiftedDays : (cShiftedDays - 146096)) / 146097;
+      const unsigned cDayOfEra = unsigned( cShiftedDays - cEra * 146097 );
+      const unsigned cYearOfEra = (cDayOfEra - cDayOfEra / 1460 + cDayOfEra / 36524 - cDayOfEra / 146096) / 365;
+      const unsigned cDayOfYear = cDayOfEra - (365 * cYearOfEra + cYearOfEra / 4 - cYearOfEra / 100);
+      const unsigned cMonth = (5 * cDayOfYear + 2) / 153;
+
+      LocalTime   time;
+
+      time.day = cDayOfYear - (153 * cMonth + 2) / 5 + 1;
+      time.month = (cMonth < 10) ? (cMonth + 3) : (cMonth - 9);
+      time.year = int64_t( cYearOfEra ) + cEra * 400 + ((time.month <= 2) ? 1 : 0);
+      time.hour = unsigned( cSecondOfDay / 3600 );
+      time.minute = unsigned( cSecondOfDay / 60 % 60 );
+      time.second = unsigned( cSecondOfDay % 60 );
+
+      return time;
+   }
+
+   // The module a frame belongs to, nullptr if the record doesn't have it
+   static const ModuleRecord  *_findModule( const CrashRecord &inRecord, uint64_t inAddress )
+   {
+      uint32_t low = 0;
+      uint32_t high = (inRecord.moduleCount < uint32_t( MAX_MODULES )) ? inRecord.moduleCount : uint32_t( MAX_MODULES );
+
+      // the modules are sorted by address
+      while ( low < high )
+      {
+         const uint32_t cMiddle = low + (high - low) / 2;
+
+         if ( inRecord.modules[cMiddle].start <= inAddress )
+            low = cMiddle + 1;
+         else
+            high = cMiddle;
+      }
+
+      if ( low == 0 || inAddress >= inRecord.modules[low - 1].end )
+         return nullptr;
+
+      return &inRecord.modules[low - 1];
+   }
+
+   static const char  *_baseName( const char *inPath )
+   {
+      const char  *name = inPath;
+
+      for ( const char *position = inPath; *position != '\0'; ++position )
+      {
+         if ( *position == '/' )
+            name = position + 1;
+      }
+
+      return name;
+   }
+
+   static bool  _createFile( const CrashRecord &inRecord )
+   {
+      const LocalTime   cTime = _localTime( inRecord.time );
+
+      LineWriter  path;
+
+      path.append( sDirectory );
+      path.append( "/" );
+      path.appendNumber( uint64_t( cTime.year ), 4 );
+      path.appendNumber( cTime.month, 2 );
+      path.appendNumber( cTime.day, 2 );
+      path.append( "-" );
+      path.appendNumber( cTime.hour, 2 );
+      path.appendNumber( cTime.minute, 2 );
+      path.appendNumber( cTime.second, 2 );
+      path.append( " " );
+      path.append( _baseName( inRecord.applicationName ), sizeof( inRecord.applicationName ) );
+      path.append( " Crash.log" );
+
+      if ( path.size() >= sizeof( sPath ) )
+         return false;
+
+      memcpy( sPath, path.text(), path.size() + 1 );
+
+      sFd = open( sPath, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644 );
+
+      if ( sFd < 0 )
+      {
+         sPath[0] = '\0';
+         return false;
+      }
+
+      return true;
+   }
+
+   void  setReportStreamDirectory( const char *inDirectory, int32_t inUtcOffset )
+   {
+      sUtcOffset = inUtcOffset;
+
+      if ( inDirectory == nullptr )
+      {
+         sDirectory[0] = '\0';
+         return;
+      }
+
+      strncpy( sDirectory, inDirectory, sizeof( sDirectory ) - 1 );
+      sDirectory[sizeof( sDirectory ) - 1] = '\0';
+   }
+
+   bool  openReportStream( const CrashRecord &inRecord )
+   {
+      if ( sFd >= 0 )
+         return true;
+
+      if ( sDirectory[0] == '\0' || !_createFile( inRecord ) )
+         return false;
+
+      // the same header as the complete report
+      LineWriter  line;
+
+      line.append( inRecord.applicationName, sizeof( inRecord.applicationName ) );
+      line.append( " v" );
+      line.append( inRecord.applicationVersion, sizeof( inRecord.applicationVersion ) );
+      _writeLine( line );
+
+      const LocalTime   cTime = _localTime( inRecord.time );
+
+      line = LineWriter();
+      line.appendNumber( cTime.day, 2 );
+      line.append( " " );
+      line.append( cMonths[(cTime.month - 1) % 12] );
+      line.append( " " );
+      line.appendNumber( uint64_t( cTime.year ), 4 );
+      line.append( " @ " );
+      line.appendNumber( cTime.hour, 2 );
+      line.append( ":" );
+      line.appendNumber( cTime.minute, 2 );
+      line.append( ":" );
+      line.appendNumber( cTime.second, 2 );
+      line.append( "\n" );
+      _writeLine( line );
+
+      line = LineWriter();
+      line.append( "Caught " );
+      _appendSignal( line, inRecord.signal );
+      line.append( " (code " );
+      line.appendNumber( uint64_t( uint32_t( inRecord.signalCode ) ) );
+      line.append( ", address " );
+      line.appendHex( inRecord.faultAddress, 16 );
+      line.append( ")\n\nStack (not symbolized yet):" );
+      _writeLine( line );
+
+      const uint32_t cFrameCount = (inRecord.frameCount < uint32_t( MAX_STACK_FRAMES )) ? inRecord.frameCount : uint32_t( MAX_STACK_FRAMES );
+
+      for ( uint32_t i = 0; i < cFrameCount; ++i )
+      {
+         const uint64_t cAddress = inRecord.frames[i];
+
+         // the unwinders may end with a null frame
+         if ( cAddress == 0 )
+            continue;
+
+         const ModuleRecord   *cModule = _findModule( inRecord, cAddress );
+
+         line = LineWriter();
+         line.append( "[" );
+         line.appendNumber( i );
+         line.append( "] " );
+         line.appendHex( cAddress, 16 );
+
+         if ( cModule != nullptr )
+         {
+            line.append( " " );
+            line.append( _baseName( cModule->path ), sizeof( cModule->path ) );
+            line.append( " + " );
+            line.appendHex( cAddress - cModule->loadBias, 1 );
+         }
+
+         _writeLine( line );
+      }
+
+      line = LineWriter();
+      line.append( "\nSymbolized frames:" );
+      _writeLine( line );
+
+      return true;
+   }
+
+   void  appendReportStream( const char *inText, size_t inSize )
+   {
+      if ( sFd >= 0 )
+         _writeAll( sFd, inText, inSize );
+   }
+
+   bool  finishReportStream( const char *inReport, size_t inSize )
+   {
+      if ( sFd < 0 )
+         return false;
+
+      LineWriter  temporaryPath;
+
+      temporaryPath.append( sPath );
+      temporaryPath.append( ".tmp" );
+
+      const int   cFd = open( temporaryPath.text(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644 );
+
+      bool  finished = false;
+
+      if ( cFd >= 0 )
+      {
+         finished = _writeAll( cFd, inReport, inSize );
+
+         close( cFd );
+
+         finished = finished && rename( temporaryPath.text(), sPath ) == 0;
+
+         if ( !finished )
+            unlink( temporaryPath.text() );
+      }
+
+      // better the two of them in one file than no complete report
+      if ( !finished )
+      {
+         LineWriter  line;
+
+         _writeLine( line );
+         _writeAll( sFd, inReport, inSize );
+      }
+
+      close( sFd );
+      sFd = -1;
+
+      return true;
+   }
+
+   void  cutReportStream( int inSignal )
+   {
+      if ( sFd < 0 )
+         return;
+
+      LineWriter  line;
+
+      line.append( "\n*** Report cut off by " );
+      _appendSignal( line, inSignal );
+      line.append( " ***" );
+      _writeLine( line );
+
+      close( sFd );
+      sFd = -1;
+   }
+
+   void  removeReportStream()
+   {
+      if ( sFd >= 0 )
+      {
+         close( sFd );
+         sFd = -1;
+      }
+
+      if ( sPath[0] != '\0' )
+         unlink( sPath );
+
+      sPath[0] = '\0';
+   }
+
+   const char  *reportStreamPath()
+   {
+      return sPath;
+   }
+}
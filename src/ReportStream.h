@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2020 Naikel Aparicio. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ''AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the author and should not be interpreted as representing
+ * official policies, either expressed or implied, of the copyright holder.
+ */
+
+
+#ifndef REPORTSTREAM_H
+#define REPORTSTREAM_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "CrashArena.h"
+
+
+namespace YappariCrashReport {
+
+   // The signal handler streams the report of a crash to its file as it goes: what is known right after
+   // the capture first, then every frame as it is symbolized, and finally the complete report replaces it.
+   // Whatever happens to the handler, the file holds as much of the report as it got to.
+
+   /// Set the directory the reports are streamed to
+   /// @param inDirectory The directory, which must exist, nullptr or empty to not stream the reports
+   /// @param inUtcOffset The offset of the local time from UTC in seconds, for the time of the report and its file name
+   void setReportStreamDirectory( const char *inDirectory, int32_t inUtcOffset );
+
+   /// Create the report file of a crash record, named like crashReportFileName(), and write what needs no
+   /// symbolization: the application, the time, the signal and the raw frames of the crashed thread with
+   /// their modules. Does nothing if the report is already open. Only uses async-signal-safe operations.
+   /// @return false if there is no directory or the file couldn't be created
+   bool openReportStream( const CrashRecord &inRecord );
+
+   /// Append text to the open report. Only uses async-signal-safe operations.
+   void appendReportStream( const char *inText, size_t inSize );
+
+   /// Replace the streamed report with the complete one, written to a temporary file and renamed over it,
+   /// so the file always holds one of the two. If that fails the complete report is appended instead.
+   /// Only uses async-signal-safe operations.
+   /// @return false if no report is open
+   bool finishReportStream( const char *inReport, size_t inSize );
+
+   /// End the open report where it got to with a line telling which signal cut it off (async-signal-safe)
+   void cutReportStream( int inSignal );
+
+   /// Remove the report file, once the report was handed over somewhere else
+   void removeReportStream();
+
+   /// The path of the report file, empty if there is none
+   const char *reportStreamPath();
+
+}
+
+#endif
@@ -0,0 +1,392 @@
+/*
+ * Copyright (C) 2020 Naikel Aparicio. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ''AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the author and should not be interpreted as representing
+ * official policies, either expressed or implied, of the copyright holder.
+ */
+
+#include <list>
+
+#include <execinfo.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <QHash>
+#include <QMetaObject>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QPointer>
+#include <QRunnable>
+#include <QThreadPool>
+
+#include "CrashArena.h"
+#include "CrashReport.h"
+#include "ModuleMap.h"
+#include "StackTrace.h"
+#include "ThreadCapture.h"
+#include "YappariCrashReport.h"
+
+
+namespace YappariCrashReport
+{
+   // The stack table, oldest stack first. The list never moves what it holds, so the stacks handed out stay valid.
+   static QMutex  sTableMutex;
+   static std::list<InternedStack>  sStacks;
+   static QHash<quintptr, InternedFrame *>   sFrameIndex;      // owns the frames
+   static QMultiHash<uint, InternedStack *>  sStackIndex;
+   static quint32 sLastStackId = 0;
+   static size_t  sEvictionSize = MAX_INTERNED_STACKS;        // only evicts again once the table grew past it
+
+   // symbolizeFrames() is not reentrant, and it fills the frames of the table
+   static QMutex  sSymbolizeMutex;
+   static bool    sModuleMapReady = false;
+
+   static bool  _sameFrames( const InternedStack &inStack, const uint64_t *inFrames, uint32_t inFrameCount )
+   {
+      if ( inStack.frames.size() != int( inFrameCount ) )
+         return false;
+
+      for ( uint32_t i = 0; i < inFrameCount; ++i )
+      {
+         if ( inStack.frames.at( int( i ) )->frame.address != quintptr( inFrames[i] ) )
+            return false;
+      }
+
+      return true;
+   }
+
+   static InternedFrame  *_internFrame( quintptr inAddress )
+   {
+      InternedFrame  *&frame = sFrameIndex[inAddress];
+
+      if ( frame == nullptr )
+      {
+         frame = new InternedFrame;
+         frame->frame.address = inAddress;
+      }
+
+      ++frame->stackCount;
+
+      return frame;
+   }
+
+   // Free the oldest stacks nothing refers to any more, and the frames no other stack goes through
+   static void  _evictStacks()
+   {
+      const size_t   cKeptSize = size_t( MAX_INTERNED_STACKS ) * 3 / 4;
+
+      for ( auto it = sStacks.begin(); it != sStacks.end() && sStacks.size() > cKeptSize; )
+      {
+         // only internStack() takes the first reference, with the lock held
+         if ( it->references.load( std::memory_order_acquire ) != 0 )
+         {
+            ++it;
+            continue;
+         }
+
+         sStackIndex.remove( it->hash, &*it );
+
+         for ( InternedFrame *frame : qAsConst( it->frames ) )
+         {
+            if ( --frame->stackCount == 0 )
+            {
+               sFrameIndex.remove( frame->frame.address );
+               delete frame;
+            }
+         }
+
+         it = sStacks.erase( it );
+      }
+
+      // the stacks still referenced aren't looked at again on every new stack
+      sEvictionSize = qMax( size_t( MAX_INTERNED_STACKS ), sStacks.size() + size_t( MAX_INTERNED_STACKS ) / 4 );
+   }
+
+   const InternedStack  *internStack( const uint64_t *inFrames, uint32_t inFrameCount )
+   {
+      if ( inFrameCount == 0 )
+         return nullptr;
+
+      const uint  cHash = qHashBits( inFrames, inFrameCount * sizeof( uint64_t ) );
+
+      QMutexLocker   locker( &sTableMutex );
+
+      for ( auto it = sStackIndex.constFind( cHash ); it != sStackIndex.constEnd() && it.key() == cHash; ++it )
+      {
+         if ( _sameFrames( *it.value(), inFrames, inFrameCount ) )
+         {
+            it.value()->references.fetch_add( 1, std::memory_order_relaxed );
+
+            return it.value();
+         }
+      }
+
+      if ( sStacks.size() >= sEvictionSize )
+         _evictStacks();
+
+      sStacks.emplace_back();
+
+      InternedStack  &stack = sStacks.back();
+
+      stack.id = ++sLastStackId;
+      stack.hash = cHash;
+      stack.frames.reserve( int( inFrameCount ) );
+
+      for ( uint32_t i = 0; i < inFrameCount; ++i )
+         stack.frames += _internFrame( quintptr( inFrames[i] ) );
+
+      sStackIndex.insert( cHash, &stack );
+
+      stack.references.store( 1, std::memory_order_relaxed );
+
+      return &stack;
+   }
+
+   void  retainStack( const InternedStack *inStack )
+   {
+      if ( inStack != nullptr )
+         inStack->references.fetch_add( 1, std::memory_order_relaxed );
+   }
+
+   void  releaseStack( const InternedStack *inStack )
+   {
+      if ( inStack != nullptr )
+         inStack->references.fetch_sub( 1, std::memory_order_release );
+   }
+
+   StackFrameList  symbolizeInternedFrames( const InternedStack *inStack )
+   {
+      if ( inStack == nullptr )
+         return StackFrameList();
+
+      QMutexLocker   locker( &sSymbolizeMutex );
+
+      // the module map is only read again if a module was loaded or unloaded since the last time
+      if ( !sModuleMapReady )
+         sModuleMapReady = prepareModuleMap();
+
+      refreshModuleMap();
+
+      // only the frames no other stack symbolized before
+      StackFrameList newFrames;
+      QVector<InternedFrame *>   newInternedFrames;
+
+      for ( InternedFrame *frame : inStack->frames )
+      {
+         if ( frame->isSymbolized || newInternedFrames.contains( frame ) )
+            continue;
+
+         StackFrame  newFrame;
+
+         newFrame.address = frame->frame.address;
+
+         resolveFrameModule( newFrame );
+
+         newFrames += newFrame;
+         newInternedFrames += frame;
+      }
+
+      if ( !newFrames.isEmpty() )
+      {
+         symbolizeFrames( newFrames );
+
+         // the address is read without a lock, so it is left alone
+         for ( int i = 0; i < newFrames.size(); ++i )
+         {
+            const StackFrame  &cFrame = newFrames.at( i );
+            InternedFrame  *frame = newInternedFrames.at( i );
+
+            frame->frame.module = cFrame.module;
+            frame->frame.offset = cFrame.offset;
+            frame->frame.buildId = cFrame.buildId;
+            frame->frame.location = cFrame.location;
+            frame->isSymbolized = true;
+         }
+      }
+
+      StackFrameList frames;
+
+      frames.reserve( inStack->frames.size() );
+
+      for ( const InternedFrame *cFrame : inStack->frames )
+         frames += cFrame->frame;
+
+      return frames;
+   }
+
+   QStringList  symbolizeInternedStack( const InternedStack *inStack )
+   {
+      return formatStackFrames( symbolizeInternedFrames( inStack ) );
+   }
+
+   // Symbolizes a stack trace in the global thread pool
+   class SymbolizeStackTask : public QRunnable
+   {
+   public:
+      SymbolizeStackTask( const StackTrace &inStackTrace, QObject *inContext, std::function<void (const QStringList &)> inCallback ) :
+         mStackTrace( inStackTrace ),
+         mContext( inContext ),
+         mHasContext( inContext != nullptr ),
+         mCallback( std::move( inCallback ) )
+      {
+      }
+
+      void  run() override
+      {
+         const QStringList cLines = symbolizeStackTrace( mStackTrace );
+
+         if ( !mHasContext )
+         {
+            mCallback( cLines );
+            return;
+         }
+
+         if ( mContext.isNull() )
+            return;
+
+         const std::function<void (const QStringList &)>  cCallback = mCallback;
+
+         QMetaObject::invokeMethod( mContext.data(), [cCallback, cLines] () { cCallback( cLines ); }, Qt::QueuedConnection );
+      }
+
+   private:
+      StackTrace  mStackTrace;
+      QPointer<QObject> mContext;
+      bool  mHasContext;
+      std::function<void (const QStringList &)>  mCallback;
+   };
+
+   StackTrace::StackTrace( const StackTrace &inOther ) :
+      mStack( inOther.mStack )
+   {
+      retainStack( mStack );
+   }
+
+   StackTrace  &StackTrace::operator=( const StackTrace &inOther )
+   {
+      retainStack( inOther.mStack );
+      releaseStack( mStack );
+
+      mStack = inOther.mStack;
+
+      return *this;
+   }
+
+   StackTrace::~StackTrace()
+   {
+      releaseStack( mStack );
+   }
+
+   int  StackTrace::size() const
+   {
+      return (mStack != nullptr) ? mStack->frames.size() : 0;
+   }
+
+   quintptr  StackTrace::frame( int inIndex ) const
+   {
+      return mStack->frames.at( inIndex )->frame.address;
+   }
+
+   QVector<quintptr>  StackTrace::frames() const
+   {
+      QVector<quintptr> frames;
+
+      if ( mStack == nullptr )
+         return frames;
+
+      frames.reserve( mStack->frames.size() );
+
+      for ( const InternedFrame *cFrame : mStack->frames )
+         frames += cFrame->frame.address;
+
+      return frames;
+   }
+
+   quint32  StackTrace::id() const
+   {
+      return (mStack != nullptr) ? mStack->id : 0;
+   }
+
+   // Intern the frames captured by backtrace() from a given one on
+   static StackTrace  _internBacktrace( void *const *inFrames, int inFrameCount, int inStart )
+   {
+      const int   cStart = qBound( 0, inStart, inFrameCount );
+
+      uint64_t addresses[MAX_STACK_FRAMES];
+
+      for ( int i = cStart; i < inFrameCount; ++i )
+         addresses[i - cStart] = uint64_t( reinterpret_cast<uintptr_t>(inFrames[i]) );
+
+      return StackTrace( internStack( addresses, uint32_t( inFrameCount - cStart ) ) );
+   }
+
+   StackTrace  captureStackTrace( int inSkipFrames )
+   {
+      void  *frames[MAX_STACK_FRAMES];
+      const int   cFrameCount = backtrace( frames, MAX_STACK_FRAMES );
+
+      // the first frame is this function
+      return _internBacktrace( frames, cFrameCount, 1 + qMax( inSkipFrames, 0 ) );
+   }
+
+   StackTrace  captureThreadStackTrace( qint64 inThreadId, int inTimeoutMs )
+   {
+      // a thread can't wait for itself to answer
+      if ( inThreadId == currentThreadId() )
+      {
+         void  *frames[MAX_STACK_FRAMES];
+         const int   cFrameCount = backtrace( frames, MAX_STACK_FRAMES );
+
+         return _internBacktrace( frames, cFrameCount, 1 );
+      }
+
+      uint64_t frames[MAX_STACK_FRAMES];
+      uint32_t frameCount = 0;
+
+      if ( !captureThreadStack( int32_t( inThreadId ), frames, frameCount, uint64_t( qMax( inTimeoutMs, 0 ) ) * 1000000 ) )
+         return StackTrace();
+
+      return StackTrace( internStack( frames, frameCount ) );
+   }
+
+   qint64  currentThreadId()
+   {
+      return qint64( syscall( SYS_gettid ) );
+   }
+
+   QStringList  symbolizeStackTrace( const StackTrace &inStackTrace )
+   {
+      // the trace holds a reference, so the stack stays in the table
+      return symbolizeInternedStack( inStackTrace.mStack );
+   }
+
+   void  symbolizeStackTrace( const StackTrace &inStackTrace, QObject *inContext, std::function<void (const QStringList &)> inCallback )
+   {
+      if ( !inCallback )
+         return;
+
+      QThreadPool::globalInstance()->start( new SymbolizeStackTask( inStackTrace, inContext, std::move( inCallback ) ) );
+   }
+}
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2020 Naikel Aparicio. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ''AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the author and should not be interpreted as representing
+ * official policies, either expressed or implied, of the copyright holder.
+ */
+
+
+#ifndef STACKTRACE_H
+#define STACKTRACE_H
+
+#include <atomic>
+#include <cstdint>
+
+#include <QStringList>
+#include <QVector>
+
+#include "Symbolizer.h"
+
+
+namespace YappariCrashReport {
+
+   /// How many stacks the stack table keeps before it frees the oldest ones nothing refers to any more
+   constexpr int  MAX_INTERNED_STACKS = 16384;
+
+   /// A frame of the stack table, shared by every interned stack that goes through its address
+   struct InternedFrame
+   {
+      StackFrame  frame;            ///< The address and, once symbolized, the module and location
+      bool  isSymbolized = false;   ///< Only read and written with the symbolization lock
+      int   stackCount = 0;         ///< How many stacks of the table go through it, only used with the table lock
+   };
+
+   /// A stack of the stack table. Its frames never change once interned, so it can be read without a lock
+   /// for as long as a reference to it is held (see internStack() and releaseStack()).
+   struct InternedStack
+   {
+      quint32  id;                                 ///< A number no other stack of the table has had before
+      uint     hash;                               ///< The hash of the frame addresses
+      QVector<InternedFrame *>   frames;           ///< Innermost first
+      mutable std::atomic<int>   references{ 0 };  ///< The StackTrace objects and profile counts that refer to it
+   };
+
+   /// Intern a stack of program counters (Linux only).
+   ///
+   /// The same frames always give the same InternedStack while it is referenced, and every address is kept
+   /// once whatever the number of stacks it is part of. Only new stacks allocate: interning a stack seen
+   /// before is a hash lookup and a comparison under a lock. Once the table holds MAX_INTERNED_STACKS
+   /// stacks, new stacks free the oldest ones without references, along with the frames only they used.
+   /// @return The interned stack with a reference the caller has to release, nullptr if there are no frames
+   const InternedStack *internStack( const uint64_t *inFrames, uint32_t inFrameCount );
+
+   /// Take one more reference to an interned stack the caller already holds a reference to
+   void retainStack( const InternedStack *inStack );
+
+   /// Release a reference to an interned stack: the table may free it once nothing refers to it
+   void releaseStack( const InternedStack *inStack );
+
+   /// Symbolize the frames of an interned stack that weren't symbolized yet.
+   /// Every frame is only symbolized once for all the stacks.
+   /// @return The frames with their module and location
+   StackFrameList symbolizeInternedFrames( const InternedStack *inStack );
+
+   /// Symbolize an interned stack (see symbolizeInternedFrames()) and format it like the stack traces of the reports
+   QStringList symbolizeInternedStack( const InternedStack *inStack );
+
+}
+
+#endif
@@ -0,0 +1,358 @@
+/*
+ * Copyright (C) 2020 Naikel Aparicio. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ''AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the author and should not be interpreted as representing
+ * official policies, either expressed or implied, of the copyright holder.
+ */
+
+#include <algorithm>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "CrashArena.h"
+#include "SymbolCache.h"
+
+
+namespace YappariCrashReport
+{
+   static const uint32_t   cSymbolCacheMagic = 0x43595359;   // "YSYC"
+   static const uint32_t   cSymbolCacheVersion = 1;
+
+   // An entry may only be in one of the slots following its hash, so lookups stay short
+   static const uint32_t   cProbeLength = 16;
+
+   struct SymbolCacheHeader
+   {
+      uint32_t magic;
+      uint32_t version;
+      uint32_t slotSize;
+      uint32_t slotCount;
+      uint64_t clock;      // bumped by every lookup & insert, it orders the slots by last use
+   };
+
+   struct SymbolCacheSlot
+   {
+      uint64_t lastUse;    // 0 for an empty slot
+      uint64_t address;
+      uint32_t buildIdSize;
+      uint32_t locationSize;
+      uint8_t  buildId[MAX_BUILD_ID_SIZE];
+      char     location[328];
+   };
+
+   static_assert( sizeof( SymbolCacheSlot ) == 384, "the slots are part of the file format" );
+
+   // The key of an entry: the build-id as bytes and the address
+   struct SymbolCacheKey
+   {
+      uint32_t buildIdSize = 0;
+      uint8_t  buildId[MAX_BUILD_ID_SIZE];
+      uint64_t address = 0;
+   };
+
+   static bool  _makeKey( const std::string &inBuildId, uint64_t inAddress, SymbolCacheKey &outKey )
+   {
+      if ( inBuildId.empty() || (inBuildId.size() % 2) != 0 || inBuildId.size() / 2 > MAX_BUILD_ID_SIZE )
+         return false;
+
+      auto  digit = [] ( char inDigit ) -> int {
+         if ( inDigit >= '0' && inDigit <= '9' )
+            return inDigit - '0';
+
+         if ( inDigit >= 'a' && inDigit <= 'f' )
+            return inDigit - 'a' + 10;
+
+         return -1;
+      };
+
+      for ( size_t i = 0; i < inBuildId.size(); i += 2 )
+      {
+         const int   cHigh = digit( inBuildId[i] );
+         const int   cLow = digit( inBuildId[i + 1] );
+
+         if ( cHigh < 0 || cLow < 0 )
+            return false;
+
+         outKey.buildId[i / 2] = uint8_t( (cHigh << 4) | cLow );
+      }
+
+      outKey.buildIdSize = uint32_t( inBuildId.size() / 2 );
+      outKey.address = inAddress;
+
+      return true;
+   }
+
+   // FNV-1a of the build-id and the address
+   static uint64_t  _hash( const SymbolCacheKey &inKey )
+   {
+      uint64_t hash = 14695981039346656037ull;
+
+      auto  add = [&hash] ( uint8_t inByte ) {
+         hash = (hash ^ inByte) * 1099511628211ull;
+      };
+
+      for ( uint32_t i = 0; i < inKey.buildIdSize; ++i )
+         add( inKey.buildId[i] );
+
+      for ( int i = 0; i < 8; ++i )
+         add( uint8_t( inKey.address >> (i * 8) ) );
+
+      return hash;
+   }
+
+   static bool  _matches( const SymbolCacheSlot &inSlot, const SymbolCacheKey &inKey )
+   {
+      return inSlot.lastUse != 0 && inSlot.address == inKey.address && inSlot.buildIdSize == inKey.buildIdSize &&
+             memcmp( inSlot.buildId, inKey.buildId, inKey.buildIdSize ) == 0;
+   }
+
+   // Holds the file lock for as long as it lives, so other processes see whole entries
+   class FileLock
+   {
+      public:
+         explicit FileLock( int inFd ) : mFd( inFd ) { flock( mFd, LOCK_EX ); }
+         ~FileLock() { flock( mFd, LOCK_UN ); }
+
+      private:
+         int   mFd;
+   };
+
+   SymbolCache::~SymbolCache()
+   {
+      _close();
+   }
+
+   void  SymbolCache::_close()
+   {
+      if ( mHeader != nullptr )
+         munmap( mHeader, mSize );
+
+      if ( mFd >= 0 )
+         close( mFd );
+
+      mFd = -1;
+      mSize = 0;
+      mHeader = nullptr;
+      mSlots = nullptr;
+   }
+
+   // Whether a header describes a cache of this version that fits in a file of a given size
+   static bool  _isValidHeader( const SymbolCacheHeader &inHeader, size_t inFileSize )
+   {
+      return inHeader.magic == cSymbolCacheMagic && inHeader.version == cSymbolCacheVersion &&
+             inHeader.slotSize == sizeof( SymbolCacheSlot ) && inHeader.slotCount != 0 &&
+             sizeof( SymbolCacheHeader ) + size_t( inHeader.slotCount ) * sizeof( SymbolCacheSlot ) <= inFileSize;
+   }
+
+   // Map the file, with the file lock held. A valid cache is taken as it is, whatever its number of entries,
+   // else the file is started over with inEntryCount entries (never, if it's 0).
+   // The file is only ever grown: another process may still have the end of it mapped.
+   bool  SymbolCache::_mapFile( uint32_t inEntryCount )
+   {
+      if ( mHeader != nullptr )
+         munmap( mHeader, mSize );
+
+      mSize = 0;
+      mHeader = nullptr;
+      mSlots = nullptr;
+
+      struct stat fileStat;
+
+      if ( fstat( mFd, &fileStat ) != 0 )
+         return false;
+
+      const size_t   cFileSize = size_t( fileStat.st_size );
+
+      SymbolCacheHeader existing;
+
+      const bool  cIsValid = (cFileSize >= sizeof( existing ) &&
+                              pread( mFd, &existing, sizeof( existing ), 0 ) == ssize_t( sizeof( existing ) ) &&
+                              _isValidHeader( existing, cFileSize ));
+
+      const uint32_t cEntryCount = cIsValid ? existing.slotCount : inEntryCount;
+
+      if ( cEntryCount == 0 )
+         return false;
+
+      const size_t   cSize = sizeof( SymbolCacheHeader ) + size_t( cEntryCount ) * sizeof( SymbolCacheSlot );
+
+      // the added part reads as zeros, which is an empty table
+      if ( cFileSize < cSize && ftruncate( mFd, off_t( cSize ) ) != 0 )
+         return false;
+
+      void  *data = mmap( nullptr, cSize, PROT_READ | PROT_WRITE, MAP_SHARED, mFd, 0 );
+
+      if ( data == MAP_FAILED )
+         return false;
+
+      SymbolCacheHeader *header = static_cast<SymbolCacheHeader *>(data);
+
+      // a cache written by another version (or a damaged one) is started over
+      if ( !cIsValid )
+      {
+         memset( data, 0, cSize );
+
+         header->magic = cSymbolCacheMagic;
+         header->version = cSymbolCacheVersion;
+         header->slotSize = sizeof( SymbolCacheSlot );
+         header->slotCount = cEntryCount;
+      }
+
+      mSize = cSize;
+      mHeader = header;
+      mSlots = reinterpret_cast<SymbolCacheSlot *>(header + 1);
+
+      return true;
+   }
+
+   // Whether the mapping still covers the cache in the file, with the file lock held.
+   // The size is checked first: the header can't be read if the file was cut short.
+   bool  SymbolCache::_isMappingCurrent() const
+   {
+      struct stat fileStat;
+
+      return fstat( mFd, &fileStat ) == 0 && size_t( fileStat.st_size ) >= mSize &&
+             _isValidHeader( *mHeader, mSize ) &&
+             sizeof( SymbolCacheHeader ) + size_t( mHeader->slotCount ) * sizeof( SymbolCacheSlot ) == mSize;
+   }
+
+   bool  SymbolCache::open( const std::string &inPath, uint32_t inEntryCount )
+   {
+      std::lock_guard<std::mutex>   lock( mMutex );
+
+      _close();
+
+      if ( inEntryCount == 0 )
+         return false;
+
+      mFd = ::open( inPath.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644 );
+
+      if ( mFd < 0 )
+         return false;
+
+      bool  mapped = false;
+
+      {
+         FileLock fileLock( mFd );
+
+         mapped = _mapFile( inEntryCount );
+      }
+
+      if ( !mapped )
+         _close();
+
+      return mapped;
+   }
+
+   bool  SymbolCache::lookup( const std::string &inBuildId, uint64_t inAddress, std::string &outLocation )
+   {
+      SymbolCacheKey key;
+
+      if ( !_makeKey( inBuildId, inAddress, key ) )
+         return false;
+
+      std::lock_guard<std::mutex>   lock( mMutex );
+
+      if ( mHeader == nullptr )
+         return false;
+
+      FileLock fileLock( mFd );
+
+      // another process may have started the file over since it was mapped
+      if ( !_isMappingCurrent() && !_mapFile( 0 ) )
+         return false;
+
+      const uint64_t cHash = _hash( key );
+
+      for ( uint32_t i = 0; i < cProbeLength; ++i )
+      {
+         SymbolCacheSlot   &slot = mSlots[(cHash + i) % mHeader->slotCount];
+
+         if ( _matches( slot, key ) )
+         {
+            slot.lastUse = ++mHeader->clock;
+            outLocation.assign( slot.location, std::min<size_t>( slot.locationSize, sizeof( slot.location ) ) );
+
+            return true;
+         }
+      }
+
+      return false;
+   }
+
+   void  SymbolCache::insert( const std::string &inBuildId, uint64_t inAddress, const std::string &inLocation )
+   {
+      SymbolCacheKey key;
+
+      if ( inLocation.empty() || inLocation.size() > sizeof( SymbolCacheSlot::location ) || !_makeKey( inBuildId, inAddress, key ) )
+         return;
+
+      std::lock_guard<std::mutex>   lock( mMutex );
+
+      if ( mHeader == nullptr )
+         return;
+
+      FileLock fileLock( mFd );
+
+      // another process may have started the file over since it was mapped
+      if ( !_isMappingCurrent() && !_mapFile( 0 ) )
+         return;
+
+      const uint64_t cHash = _hash( key );
+
+      // the slot of the same key, else an empty one, else the least recently used one
+      SymbolCacheSlot   *target = nullptr;
+
+      for ( uint32_t i = 0; i < cProbeLength; ++i )
+      {
+         SymbolCacheSlot   &slot = mSlots[(cHash + i) % mHeader->slotCount];
+
+         if ( _matches( slot, key ) )
+         {
+            target = &slot;
+            break;
+         }
+
+         if ( target == nullptr || slot.lastUse < target->lastUse )
+            target = &slot;
+      }
+
+      // the key goes in last, so a process dying halfway leaves an empty slot behind
+      target->lastUse = 0;
+
+      memcpy( target->location, inLocation.data(), inLocation.size() );
+      target->locationSize = uint32_t( inLocation.size() );
+      target->address = key.address;
+      target->buildIdSize = key.buildIdSize;
+      memcpy( target->buildId, key.buildId, sizeof( target->buildId ) );
+
+      target->lastUse = ++mHeader->clock;
+   }
+}
@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2020 Naikel Aparicio. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ''AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the author and should not be interpreted as representing
+ * official policies, either expressed or implied, of the copyright holder.
+ */
+
+
+#ifndef SYMBOLCACHE_H
+#define SYMBOLCACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+
+namespace YappariCrashReport {
+
+   struct SymbolCacheHeader;
+   struct SymbolCacheSlot;
+
+   /// A persistent cache of symbolized addresses, shared by every process that uses the same file.
+   ///
+   /// The file is memory mapped and holds an open-addressing hash table keyed by (module build-id,
+   /// address in the module). The table has a fixed number of slots, so the file never grows: when
+   /// all the slots an entry may go to are taken, the least recently used one is replaced.
+   /// Concurrent access from several threads and processes is serialized with a file lock.
+   class SymbolCache
+   {
+      public:
+         /// The default number of entries (a 3 MiB file)
+         static constexpr uint32_t  DEFAULT_ENTRY_COUNT = 8192;
+
+         SymbolCache() = default;
+         ~SymbolCache();
+
+         SymbolCache( const SymbolCache & ) = delete;
+         SymbolCache &operator=( const SymbolCache & ) = delete;
+
+         /// Open (or create) the cache file. An existing cache keeps its own number of entries,
+         /// since other processes may have it mapped; a file with a different layout is cleared.
+         /// @param inEntryCount The number of entries of a new cache
+         /// @return false if the file couldn't be opened or mapped
+         bool open( const std::string &inPath, uint32_t inEntryCount = DEFAULT_ENTRY_COUNT );
+
+         bool isOpen() const { return mHeader != nullptr; }
+
+         /// Look up the location of an address
+         /// @param inBuildId The build-id of the module in hex
+         /// @param inAddress The address relative to the module's load bias
+         /// @return true if the address is in the cache
+         bool lookup( const std::string &inBuildId, uint64_t inAddress, std::string &outLocation );
+
+         /// Add the location of an address. Locations too long for a slot are not cached.
+         void insert( const std::string &inBuildId, uint64_t inAddress, const std::string &inLocation );
+
+      private:
+         void  _close();
+
+         bool  _mapFile( uint32_t inEntryCount );
+         bool  _isMappingCurrent() const;
+
+         std::mutex  mMutex;
+         int         mFd = -1;
+         size_t      mSize = 0;
+         SymbolCacheHeader *mHeader = nullptr;
+         SymbolCacheSlot   *mSlots = nullptr;
+   };
+
+}
+
+#endif
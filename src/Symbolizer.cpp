@@ -0,0 +1,595 @@
+/*
+ * Copyright (C) 2017, 2020 Andy Maloney, Naikel Aparicio. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ''AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the author and should not be interpreted as representing
+ * official policies, either expressed or implied, of the copyright holder.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QHash>
+#include <QProcess>
+#include <QRegularExpression>
+#include <QRunnable>
+#include <QStringList>
+#include <QThreadPool>
+
+#include "Symbolizer.h"
+
+#ifdef Q_OS_LINUX
+#include <QDir>
+#include <QFile>
+#include <QStandardPaths>
+
+#include "ElfSymbolizer.h"
+#include "SymbolCache.h"
+#endif
+
+
+namespace YappariCrashReport
+{
+   using Clock = std::chrono::steady_clock;
+
+   static const int  cMaxWorkers = 4;  // the threads that symbolize the modules of a stack trace at once
+
+   static std::atomic<int> sDeadlineMs{ DEFAULT_SYMBOLIZATION_DEADLINE_MS };
+
+#ifdef Q_OS_LINUX
+   static ElfSymbolizer *sElfSymbolizer = nullptr; // reads the debug information directly, the tool is only a fallback
+   static bool sConcurrent = false;    // symbolizeFrames() may run in several threads, each symbolizing in its own
+
+   // the addresses symbolized before, opened the first time it is needed
+   static SymbolCache   *sSymbolCache = nullptr;
+   static std::once_flag   sSymbolCacheOpened;
+   static QString sSymbolCachePath;    // empty for the default one
+   static int  sSymbolCacheEntries = int( SymbolCache::DEFAULT_ENTRY_COUNT );
+
+   static SymbolCache  *_symbolCache()
+   {
+      std::call_once( sSymbolCacheOpened, [] {
+         QString  path = sSymbolCachePath;
+
+         if ( path.isEmpty() )
+         {
+            const QString  cDirectory = QStandardPaths::writableLocation( QStandardPaths::CacheLocation );
+
+            if ( cDirectory.isEmpty() || !QDir().mkpath( cDirectory ) )
+               return;
+
+            path = QDir( cDirectory ).filePath( QStringLiteral( "symbols.cache" ) );
+         }
+
+         SymbolCache *cache = new SymbolCache;
+
+         if ( sSymbolCacheEntries > 0 && cache->open( QFile::encodeName( path ).toStdString(), uint32_t( sSymbolCacheEntries ) ) )
+            sSymbolCache = cache;
+         else
+            delete cache;
+      } );
+
+      return sSymbolCache;
+   }
+
+   // Format the locations the same way "addr2line -C -f -i -p -s" does
+   static QString  _formatLocations( const std::vector<SourceLocation> &inLocations )
+   {
+      QStringList lineList;
+
+      for ( const SourceLocation &location : inLocations )
+      {
+         QString  file = QString::fromStdString( location.file );
+
+         file = file.isEmpty() ? QStringLiteral( "??" ) : file.mid( file.lastIndexOf( '/' ) + 1 );
+
+         lineList += QStringLiteral( "%1 at %2:%3" ).arg(
+                        location.function.empty() ? QStringLiteral( "??" ) : QString::fromStdString( location.function ),
+                        file,
+                        (location.line > 0) ? QString::number( location.line ) : QStringLiteral( "?" ) );
+      }
+
+      return lineList.join( QStringLiteral( "\n      (inlined by) " ) );
+   }
+
+   // Whether the innermost location of an address has its file & line: a function name alone
+   // ("main at ??:?", from the symbol table) may resolve better once the debug files are installed
+   static bool  _hasFileAndLine( const QString &inLocation )
+   {
+      static const QRegularExpression  sFileAndLine( "^.* at (?!\\?\\?:).+:[0-9]+( \\(discriminator [0-9]+\\))?$" );
+
+      return sFileAndLine.match( inLocation.section( '\n', 0, 0 ) ).hasMatch();
+   }
+#endif
+
+   static QString  _addressString( quintptr inAddr )
+   {
+      return QStringLiteral( "0x%1" ).arg( inAddr, 16, 16, QChar( '0' ) );
+   }
+
+   // The milliseconds left until a deadline, as QProcess::waitForFinished() takes them (-1 for no deadline)
+   static int  _remainingMs( const Clock::time_point &inDeadline )
+   {
+      if ( inDeadline == Clock::time_point::max() )
+         return -1;
+
+      const auto  cRemaining = std::chrono::duration_cast<std::chrono::milliseconds>( inDeadline - Clock::now() ).count();
+
+      return int( std::max<decltype(cRemaining)>( cRemaining, 0 ) );
+   }
+
+   // Set up the address mapping tool to resolve addresses of a single module read from stdin
+   static void  _setupProcess( QProcess &ioProcess, const QString &inModule )
+   {
+#ifdef Q_OS_MAC
+      // Uses atos
+      const QString  cProgram = QStringLiteral( "atos" );
+
+      const QStringList  cArguments = {
+         "-o", inModule,
+         "-arch", "x86_64"
+      };
+#else
+#ifdef Q_OS_WIN
+      // Uses addr2line
+      const QString  cProgram = QStringLiteral( "%1/tools/addr2line" ).arg( QCoreApplication::applicationDirPath() );
+#else
+      const QString  cProgram = QStringLiteral( "addr2line" );
+#endif
+
+      const QStringList  cArguments = {
+         "-C",
+         "-f",
+         "-i",
+         "-p",
+         "-s",
+         "-e", inModule
+      };
+#endif
+
+      ioProcess.setProgram( cProgram );
+      ioProcess.setArguments( cArguments );
+      ioProcess.setProcessChannelMode( QProcess::SeparateChannels );
+      ioProcess.setReadChannel( QProcess::StandardOutput );
+   }
+
+   static QString  _processError( const QProcess &inProcess )
+   {
+      return QStringLiteral( "* Error running command\n   %1 %2\n   %3" ).arg(
+               inProcess.program(),
+               inProcess.arguments().join( ' ' ),
+               inProcess.errorString() );
+   }
+
+   // Resolve all the addresses of a single module with one run of the address mapping tool, giving up at the deadline
+   // @return false if the tool couldn't be run
+   static bool  _symbolizeModule( const QString &inModule, const QVector<int> &inIndexes, StackFrameList &ioFrames,
+                                  const Clock::time_point &inDeadline )
+   {
+      QProcess process;
+
+      _setupProcess( process, inModule );
+
+      process.start( QIODevice::ReadWrite );
+
+      if ( !process.waitForStarted( _remainingMs( inDeadline ) ) )
+      {
+         const QString  cError = _processError( process );
+
+         for ( int index : inIndexes )
+            ioFrames[index].location = cError;
+
+         return false;
+      }
+
+      QByteArray  input;
+
+      for ( int index : inIndexes )
+         input += _addressString( ioFrames[index].offset ).toLatin1() + '\n';
+
+      process.write( input );
+      process.closeWriteChannel();
+
+      if ( !process.waitForFinished( _remainingMs( inDeadline ) ) )
+      {
+         const QString  cError = _processError( process );
+
+         process.kill();
+         process.waitForFinished();
+
+         for ( int index : inIndexes )
+            ioFrames[index].location = cError;
+
+         return false;
+      }
+
+      // The tool answers with one line per address, in the same order they were sent.
+      // addr2line adds a " (inlined by)" line for each inlined caller of the previous address.
+      const QList<QByteArray>  cLines = process.readAllStandardOutput().split( '\n' );
+
+      int   current = -1;
+
+      for ( const QByteArray &line : cLines )
+      {
+         const QString  cLine = QString::fromLocal8Bit( line ).trimmed();
+
+         if ( cLine.isEmpty() )
+            continue;
+
+         if ( cLine.startsWith( QLatin1String( "(inlined by)" ) ) )
+         {
+            if ( current >= 0 && !ioFrames[inIndexes[current]].location.isEmpty() )
+               ioFrames[inIndexes[current]].location += QStringLiteral( "\n      " ) + cLine;
+
+            continue;
+         }
+
+         if ( ++current >= inIndexes.size() )
+            break;
+
+         StackFrame  &frame = ioFrames[inIndexes[current]];
+
+         // atos echoes the address and addr2line prints question marks when they can't resolve it
+         if ( cLine == _addressString( frame.offset ) || cLine.startsWith( QLatin1String( "?? " ) ) )
+            continue;
+
+         frame.location = cLine;
+      }
+
+      return true;
+   }
+
+   void  prepareSymbolizer()
+   {
+#ifdef Q_OS_LINUX
+      if ( sElfSymbolizer == nullptr )
+      {
+         sElfSymbolizer = new ElfSymbolizer;
+      }
+#endif
+   }
+
+   // The frames of one module, symbolized by one of the workers
+   struct ModuleTask
+   {
+      QString  module;
+      QVector<int>   indexes;          // the frames of the module in the list being symbolized
+      StackFrameList frames;           // the worker's copy of those frames
+      QVector<bool>  resolved;         // whether each one was resolved rather than left alone or given an error
+   };
+
+   // What a symbolization shares with its workers. The ones still running at the deadline keep it alive
+   // until they are done, and nobody looks at their results anymore.
+   struct SymbolizeJob
+   {
+      std::vector<ModuleTask> tasks;   // only the worker that takes a task writes to it
+      std::atomic<int>  nextTask{ 0 };
+      Clock::time_point deadline;
+
+      std::mutex  mutex;
+      std::condition_variable changed;
+      QVector<QPair<int, int>>  done;  // the task and the position of the frames resolved since the last look
+      int   finishedTasks = 0;
+   };
+
+   static void  _publishFrames( SymbolizeJob &ioJob, int inTask, const QVector<int> &inPositions )
+   {
+      {
+         std::lock_guard<std::mutex>   lock( ioJob.mutex );
+
+         for ( int position : inPositions )
+            ioJob.done += qMakePair( inTask, position );
+      }
+
+      ioJob.changed.notify_one();
+   }
+
+   // Take the modules of a job one by one until there are none left
+   static void  _symbolizeTasks( SymbolizeJob &ioJob )
+   {
+      for ( int taskIndex = ioJob.nextTask++; taskIndex < int( ioJob.tasks.size() ); taskIndex = ioJob.nextTask++ )
+      {
+         ModuleTask  &task = ioJob.tasks[size_t( taskIndex )];
+
+         // the frames left for the address mapping tool
+         QVector<int>   toolFrames;
+
+         // what was found of those frames without the tool (a function name without a line), in case it can't be run
+         QHash<int, QString>  partialLocations;
+
+#ifdef Q_OS_LINUX
+         std::vector<SourceLocation>   locations;
+
+         const std::string cModule = task.module.toStdString();
+
+         for ( int i = 0; i < task.frames.size() && Clock::now() < ioJob.deadline; ++i )
+         {
+            StackFrame  &frame = task.frames[i];
+
+            if ( sElfSymbolizer->symbolize( cModule, frame.offset, locations, frame.buildId.toStdString() ) )
+            {
+               frame.location = _formatLocations( locations );
+               task.resolved[i] = true;
+
+               _publishFrames( ioJob, taskIndex, { i } );
+            }
+            else
+            {
+               if ( !locations.empty() && !locations.back().function.empty() )
+                  partialLocations.insert( i, _formatLocations( locations ) );
+
+               toolFrames += i;
+
+               // the tool leaves the location alone when it can't resolve the address either
+               frame.location = partialLocations.value( i );
+            }
+         }
+#else
+         for ( int i = 0; i < task.frames.size(); ++i )
+            toolFrames += i;
+#endif
+
+         if ( !toolFrames.isEmpty() && Clock::now() < ioJob.deadline )
+         {
+            const bool  cResolved = _symbolizeModule( task.module, toolFrames, task.frames, ioJob.deadline );
+
+            for ( int position : toolFrames )
+            {
+               if ( !cResolved && partialLocations.contains( position ) )
+               {
+                  task.resolved[position] = true;
+                  task.frames[position].location = partialLocations.value( position );
+               }
+               else
+               {
+                  task.resolved[position] = cResolved;
+               }
+            }
+
+            // the tool answers for the whole module at once
+            _publishFrames( ioJob, taskIndex, toolFrames );
+         }
+
+         {
+            std::lock_guard<std::mutex>   lock( ioJob.mutex );
+
+            ++ioJob.finishedTasks;
+         }
+
+         ioJob.changed.notify_one();
+      }
+   }
+
+   // A worker of a ioJob, in its own thread so the address mapping tool can be waited for
+   class SymbolizeWorker : public QRunnable
+   {
+   public:
+      explicit SymbolizeWorker( std::shared_ptr<SymbolizeJob> inJob ) :
+         mJob( std::move( inJob ) )
+      {
+      }
+
+      void  run() override
+      {
+         _symbolizeTasks( *mJob );
+      }
+
+   private:
+      std::shared_ptr<SymbolizeJob> mJob;
+   };
+
+   // The workers have a pool of their own: the global one may be busy with whatever the application was
+   // doing. It is never destroyed, so a worker that missed the deadline doesn't hold the exit up.
+   static QThreadPool  *_workerPool()
+   {
+      static QThreadPool   *sPool = [] {
+         QThreadPool *pool = new QThreadPool;
+
+         pool->setMaxThreadCount( cMaxWorkers );
+
+         return pool;
+      }();
+
+      return sPool;
+   }
+
+   void  symbolizeFrames( StackFrameList &ioFrames, const FrameResolvedCallback &inResolved )
+   {
+      prepareSymbolizer();
+
+      const int   cDeadlineMs = sDeadlineMs.load();
+      const Clock::time_point cStart = Clock::now();
+
+      auto  job = std::make_shared<SymbolizeJob>();
+
+      job->deadline = (cDeadlineMs > 0) ? (cStart + std::chrono::milliseconds( cDeadlineMs )) : Clock::time_point::max();
+
+#ifdef Q_OS_LINUX
+      std::string location;
+
+      SymbolCache *cache = _symbolCache();
+
+      // the frames resolved here, to add to the cache
+      QVector<int>   resolvedFrames;
+#endif
+
+      // group the frames by module, keeping the order in which the modules first appear
+      QHash<QString, int>  taskByModule;
+
+      for ( int i = 0; i < ioFrames.size(); ++i )
+      {
+         const QString  &cModule = ioFrames.at( i ).module;
+
+         if ( cModule.isEmpty() )
+            continue;
+
+#ifdef Q_OS_LINUX
+         const std::string cBuildId = ioFrames.at( i ).buildId.toStdString();
+
+         // the same call sites show up in most crashes of a build
+         if ( cache != nullptr && !cBuildId.empty() && cache->lookup( cBuildId, ioFrames.at( i ).offset, location ) )
+         {
+            ioFrames[i].location = QString::fromStdString( location );
+
+            if ( inResolved )
+               inResolved( i );
+
+            continue;
+         }
+#endif
+
+         if ( !taskByModule.contains( cModule ) )
+         {
+            taskByModule.insert( cModule, int( job->tasks.size() ) );
+
+            job->tasks.emplace_back();
+            job->tasks.back().module = cModule;
+         }
+
+         ModuleTask  &task = job->tasks[size_t( taskByModule.value( cModule ) )];
+
+         task.indexes += i;
+         task.frames += ioFrames.at( i );
+         task.resolved += false;
+      }
+
+      if ( job->tasks.empty() )
+         return;
+
+#ifdef Q_OS_LINUX
+      // batch symbolization runs in several threads already, each one waits for its own tool
+      if ( sConcurrent )
+      {
+         _symbolizeTasks( *job );
+      }
+      else
+#endif
+      {
+         // the workers are left behind if they miss the deadline, the job lives as long as they do
+         const int   cWorkerCount = std::min( int( job->tasks.size() ), cMaxWorkers );
+
+         for ( int i = 0; i < cWorkerCount; ++i )
+            _workerPool()->start( new SymbolizeWorker( job ) );
+      }
+
+      const SymbolizeJob   &cJob = *job;
+      const int   cTaskCount = int( cJob.tasks.size() );
+
+      QVector<QPair<int, int>>  done;
+      bool  finished = false;
+      bool  timedOut = false;
+
+      // take the frames over as they are resolved, until every module is done or the deadline passes
+      while ( !finished && !timedOut )
+      {
+         {
+            std::unique_lock<std::mutex>  lock( job->mutex );
+
+            const auto  cReady = [&] { return !job->done.isEmpty() || job->finishedTasks == cTaskCount; };
+
+            if ( job->deadline == Clock::time_point::max() )
+               job->changed.wait( lock, cReady );
+            else
+               timedOut = !job->changed.wait_until( lock, job->deadline, cReady );
+
+            done.swap( job->done );
+            finished = (job->finishedTasks == cTaskCount);
+         }
+
+         for ( const QPair<int, int> &cFrame : done )
+         {
+            const ModuleTask  &cTask = cJob.tasks.at( size_t( cFrame.first ) );
+            const int   cIndex = cTask.indexes.at( cFrame.second );
+
+            ioFrames[cIndex].location = cTask.frames.at( cFrame.second ).location;
+
+#ifdef Q_OS_LINUX
+            if ( cTask.resolved.at( cFrame.second ) )
+               resolvedFrames += cIndex;
+#endif
+
+            if ( inResolved )
+               inResolved( cIndex );
+         }
+
+         done.clear();
+      }
+
+      // the rest of the frames keep their module and offset
+      if ( timedOut )
+      {
+         qWarning() << "YappariCrashReport: symbolization stopped after" << cDeadlineMs << "ms";
+      }
+
+#ifdef Q_OS_LINUX
+      if ( cache == nullptr )
+         return;
+
+      // only frames with a build-id can be told apart from the same address of another build,
+      // and addresses without a file & line may resolve once the debug files are installed
+      for ( int index : resolvedFrames )
+      {
+         const StackFrame  &cFrame = ioFrames.at( index );
+
+         if ( !cFrame.buildId.isEmpty() && _hasFileAndLine( cFrame.location ) )
+            cache->insert( cFrame.buildId.toStdString(), cFrame.offset, cFrame.location.toStdString() );
+      }
+#endif
+   }
+
+   void  setSymbolizeFramesDeadline( int inMilliseconds )
+   {
+      sDeadlineMs.store( qMax( inMilliseconds, 0 ) );
+   }
+
+#ifdef Q_OS_LINUX
+   void  addDebugDirectory( const QString &inDirectory )
+   {
+      prepareSymbolizer();
+
+      sElfSymbolizer->addDebugDirectory( inDirectory.toStdString() );
+   }
+
+   void  setSymbolCacheFile( const QString &inPath, int inMaxEntries )
+   {
+      sSymbolCachePath = inPath;
+      sSymbolCacheEntries = inMaxEntries;
+   }
+
+   void  setConcurrentSymbolization( bool inEnabled )
+   {
+      prepareSymbolizer();
+
+      sConcurrent = inEnabled;
+      sElfSymbolizer->setIndexModules( inEnabled );
+   }
+#endif
+}
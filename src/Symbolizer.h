@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2017, 2020 Andy Maloney, Naikel Aparicio. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ''AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the author and should not be interpreted as representing
+ * official policies, either expressed or implied, of the copyright holder.
+ */
+
+
+#ifndef SYMBOLIZER_H
+#define SYMBOLIZER_H
+
+#include <functional>
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+
+
+namespace YappariCrashReport {
+
+   constexpr int  DEFAULT_SYMBOLIZATION_DEADLINE_MS = 10000;
+
+   /// A single frame of a stack trace
+   struct StackFrame
+   {
+      quintptr address = 0;   ///< The absolute address of the frame
+      QString  module;        ///< The full path of the module (executable or library) containing the address
+      quintptr offset = 0;    ///< The address to look up in the module
+      QByteArray  buildId;    ///< The build-id of the module in hex, empty if unknown
+      QString  location;      ///< The resolved function & source location, empty if it could not be resolved
+   };
+
+   using StackFrameList = QVector<StackFrame>;
+
+   /// Called by symbolizeFrames() with the index of every frame as soon as its location is filled in
+   using FrameResolvedCallback = std::function<void (int)>;
+
+   /// Prepare the symbolizer so it can be used from the signal handler.
+   void prepareSymbolizer();
+
+   /// Resolve the function names & source locations of a whole stack trace in one pass.
+   ///
+   /// The frames are grouped by module and the modules are spread over a few worker threads. On Linux
+   /// the debug information of the modules is read in-process first. The remaining addresses of each
+   /// module are sent to a single instance of the address mapping tool, so the cost scales with the
+   /// number of modules rather than the number of frames.
+   /// Whatever isn't resolved by the deadline (see setSymbolizeFramesDeadline()) keeps an empty location,
+   /// and the workers still busy are left behind.
+   /// @param ioFrames The frames to resolve. Their location is filled in place.
+   /// @param inResolved Called as each frame is resolved, in the order they are resolved (optional)
+   void symbolizeFrames( StackFrameList &ioFrames, const FrameResolvedCallback &inResolved = FrameResolvedCallback() );
+
+   /// Set how long symbolizeFrames() can take, from the moment it is called (10 s by default)
+   /// @param inMilliseconds The time limit, 0 for none
+   void setSymbolizeFramesDeadline( int inMilliseconds );
+
+#ifdef Q_OS_LINUX
+   /// Add a directory to look for debug files in, by .gnu_debuglink or by build-id (see ElfSymbolizer)
+   void addDebugDirectory( const QString &inDirectory );
+
+   /// Set the file of the persistent symbol cache that symbolizeFrames() checks first (see SymbolCache).
+   /// By default it is symbols.cache in QStandardPaths::CacheLocation, with room for 8192 entries.
+   /// Must be called before the first symbolization.
+   /// @param inPath The cache file, empty for the default one
+   /// @param inMaxEntries The number of entries the cache holds, 0 to not use a cache
+   void setSymbolCacheFile( const QString &inPath, int inMaxEntries );
+
+   /// Allow symbolizeFrames() to be called from several threads at once (for batch symbolization).
+   /// Every module is indexed once, the first time it is needed, and then shared read-only by all
+   /// the threads. Each call resolves its frames in the calling thread, the address mapping tool included.
+   void setConcurrentSymbolization( bool inEnabled );
+#endif
+
+}
+
+#endif
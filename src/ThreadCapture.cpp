@@ -0,0 +1,299 @@
+/*
+ * Copyright (C) 2020 Naikel Aparicio. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ''AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the author and should not be interpreted as representing
+ * official policies, either expressed or implied, of the copyright holder.
+ */
+
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <mutex>
+
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "CrashArena.h"
+#include "ThreadCapture.h"
+#include "Unwinder.h"
+
+
+namespace YappariCrashReport
+{
+   // The state of a thread's slot in the crash record
+   enum : uint32_t
+   {
+      SLOT_WAITING = 0,    // the thread hasn't answered yet
+      SLOT_WRITING,        // the thread is writing its stack
+      SLOT_DONE,           // the thread's stack is in the slot
+      SLOT_ABANDONED,      // the thread didn't answer in time (or is the crashed thread)
+   };
+
+   static std::atomic<uint32_t>  sSlotStates[MAX_THREADS];
+
+   static std::atomic<bool>   sCapturing{ false };   // set while the crashed thread waits for the answers
+   static int        sCaptureSignal = 0;     // the real-time signal used to ask, 0 until prepared
+   static uint64_t   sTimeoutNs = 0;
+   static bool       sCrashCaptureEnabled = false;   // whether prepareThreadCapture() was called
+
+   static int32_t  _currentThreadId()
+   {
+      return int32_t( syscall( SYS_gettid ) );
+   }
+
+   // The on-demand capture of one thread's stack, one at a time (see captureThreadStack())
+   static std::mutex sRequestMutex;
+   static std::atomic<int32_t>   sRequestTid{ 0 };
+   static std::atomic<uint32_t>  sRequestState{ SLOT_ABANDONED };
+   static uint64_t   sRequestFrames[MAX_STACK_FRAMES];
+   static uint32_t   sRequestFrameCount = 0;
+
+   // Runs in every thread asked by the crashed thread: capture our own stack into our slot
+   static void  _answerCrashCapture( int32_t inTid, const void *inContext )
+   {
+      CrashRecord    *record = crashRecord();
+
+      for ( uint32_t i = 0; i < record->threadCount; ++i )
+      {
+         if ( record->threads[i].tid != inTid )
+            continue;
+
+         uint32_t state = SLOT_WAITING;
+
+         // too late, the crashed thread has moved on
+         if ( !sSlotStates[i].compare_exchange_strong( state, SLOT_WRITING, std::memory_order_acq_rel ) )
+            break;
+
+         ThreadRecord   &thread = record->threads[i];
+
+         // the thread may be anywhere, even in the middle of the DWARF unwinder of a throw
+         thread.frameCount = unwindFramePointers( inContext, thread.frames );
+
+         sSlotStates[i].store( SLOT_DONE, std::memory_order_release );
+         break;
+      }
+   }
+
+   // Runs in the thread asked by captureThreadStack(): capture our own stack into the request
+   static void  _answerRequest( int32_t inTid, const void *inContext )
+   {
+      uint32_t state = SLOT_WAITING;
+
+      // a late signal of a request that gave up, or of another thread's request
+      if ( sRequestTid.load( std::memory_order_acquire ) != inTid ||
+           !sRequestState.compare_exchange_strong( state, SLOT_WRITING, std::memory_order_acq_rel ) )
+         return;
+
+      sRequestFrameCount = unwindFramePointers( inContext, sRequestFrames );
+
+      sRequestState.store( SLOT_DONE, std::memory_order_release );
+   }
+
+   static void  _threadCaptureHandler( int, siginfo_t *inSigInfo, void *inContext )
+   {
+      // only answer the requests of this process
+      if ( inSigInfo->si_code != SI_TKILL || inSigInfo->si_pid != getpid() )
+         return;
+
+      const int   cSavedErrno = errno;
+      const int32_t  cTid = _currentThreadId();
+
+      if ( sCapturing.load( std::memory_order_acquire ) )
+         _answerCrashCapture( cTid, inContext );
+      else
+         _answerRequest( cTid, inContext );
+
+      errno = cSavedErrno;
+   }
+
+   // Install the handler of the capture signal, once
+   static bool  _installCaptureHandler()
+   {
+      static std::mutex sInstallMutex;
+
+      std::lock_guard<std::mutex>   lock( sInstallMutex );
+
+      if ( sCaptureSignal != 0 )
+         return true;
+
+      // SIGRTMIN is only known at run time, glibc keeps the first few for itself
+      const int   cSignal = SIGRTMIN + 3;
+
+      struct sigaction sigAction;
+
+      sigAction.sa_sigaction = _threadCaptureHandler;
+
+      sigemptyset( &sigAction.sa_mask );
+
+      // interrupted system calls of the answering threads are restarted
+      sigAction.sa_flags = SA_SIGINFO | SA_RESTART | SA_ONSTACK;
+
+      if ( sigaction( cSignal, &sigAction, nullptr ) != 0 )
+         return false;
+
+      sCaptureSignal = cSignal;
+
+      return true;
+   }
+
+   bool  prepareThreadCapture( int inTimeoutMs )
+   {
+      sTimeoutNs = uint64_t( inTimeoutMs ) * 1000000;
+      sCrashCaptureEnabled = true;
+
+      return _installCaptureHandler();
+   }
+
+   void  captureAllThreads()
+   {
+      CrashRecord *record = crashRecord();
+
+      bool  wasCapturing = false;
+
+      // only once, even if several threads crash at the same time
+      if ( !sCrashCaptureEnabled || sCaptureSignal == 0 || record == nullptr || !sCapturing.compare_exchange_strong( wasCapturing, true ) )
+         return;
+
+      captureProcessState();
+
+      const pid_t    cPid = getpid();
+      const int32_t  cTid = _currentThreadId();
+
+      for ( uint32_t i = 0; i < record->threadCount; ++i )
+      {
+         // our own stack is the stack of the crash, and threads that are gone can't answer
+         if ( record->threads[i].tid == cTid || syscall( SYS_tgkill, cPid, record->threads[i].tid, sCaptureSignal ) != 0 )
+            sSlotStates[i].store( SLOT_ABANDONED, std::memory_order_relaxed );
+      }
+
+      const uint64_t cDeadline = monotonicNanoseconds() + sTimeoutNs;
+
+      for ( ;; )
+      {
+         bool  isComplete = true;
+
+         for ( uint32_t i = 0; i < record->threadCount && isComplete; ++i )
+         {
+            const uint32_t cState = sSlotStates[i].load( std::memory_order_acquire );
+
+            isComplete = (cState == SLOT_DONE || cState == SLOT_ABANDONED);
+         }
+
+         if ( isComplete || monotonicNanoseconds() >= cDeadline )
+            break;
+
+         const timespec cPause{ 0, 100 * 1000 };
+
+         nanosleep( &cPause, nullptr );
+      }
+
+      // close the slots of the threads that didn't answer, and let the ones in the middle of writing finish
+      for ( uint32_t i = 0; i < record->threadCount; ++i )
+      {
+         uint32_t state = SLOT_WAITING;
+
+         if ( sSlotStates[i].compare_exchange_strong( state, SLOT_ABANDONED, std::memory_order_acq_rel ) )
+            continue;
+
+         while ( state == SLOT_WRITING )
+         {
+            sched_yield();
+            state = sSlotStates[i].load( std::memory_order_acquire );
+         }
+      }
+   }
+
+   bool  captureThreadStack( int32_t inTid, uint64_t *outFrames, uint32_t &outFrameCount, uint64_t inTimeoutNs )
+   {
+      outFrameCount = 0;
+
+      if ( !_installCaptureHandler() )
+         return false;
+
+      std::lock_guard<std::mutex>   lock( sRequestMutex );
+
+      sRequestState.store( SLOT_WAITING, std::memory_order_relaxed );
+      sRequestTid.store( inTid, std::memory_order_release );
+
+      if ( syscall( SYS_tgkill, getpid(), inTid, sCaptureSignal ) != 0 )
+      {
+         sRequestTid.store( 0, std::memory_order_relaxed );
+         return false;
+      }
+
+      // the answer usually takes a few microseconds, so yield before sleeping
+      const uint64_t cStart = monotonicNanoseconds();
+      const uint64_t cDeadline = cStart + inTimeoutNs;
+
+      uint32_t state = SLOT_WAITING;
+
+      for ( ;; )
+      {
+         state = sRequestState.load( std::memory_order_acquire );
+
+         const uint64_t cNow = monotonicNanoseconds();
+
+         if ( state == SLOT_DONE || cNow >= cDeadline )
+            break;
+
+         if ( (cNow - cStart) < 100 * 1000 )
+         {
+            sched_yield();
+         }
+         else
+         {
+            const timespec cPause{ 0, 100 * 1000 };
+
+            nanosleep( &cPause, nullptr );
+         }
+      }
+
+      // give up unless the thread is already writing, then let it finish
+      state = SLOT_WAITING;
+
+      if ( !sRequestState.compare_exchange_strong( state, SLOT_ABANDONED, std::memory_order_acq_rel ) )
+      {
+         while ( state == SLOT_WRITING )
+         {
+            sched_yield();
+            state = sRequestState.load( std::memory_order_acquire );
+         }
+      }
+
+      sRequestTid.store( 0, std::memory_order_relaxed );
+
+      if ( state != SLOT_DONE )
+         return false;
+
+      memcpy( outFrames, sRequestFrames, sRequestFrameCount * sizeof( uint64_t ) );
+      outFrameCount = sRequestFrameCount;
+
+      return true;
+   }
+}
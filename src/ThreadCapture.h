@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2020 Naikel Aparicio. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ''AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the author and should not be interpreted as representing
+ * official policies, either expressed or implied, of the copyright holder.
+ */
+
+
+#ifndef THREADCAPTURE_H
+#define THREADCAPTURE_H
+
+#include <cstdint>
+
+
+namespace YappariCrashReport {
+
+   /// Install the handler of the signal the crashed thread sends to all the other threads
+   /// to make them capture their own stack (Linux only).
+   /// @param inTimeoutMs How long the crashed thread waits for the other threads to answer
+   /// @return false if the handler could not be installed
+   bool prepareThreadCapture( int inTimeoutMs );
+
+   /// Capture the stacks of all the threads of the process into the crash record.
+   ///
+   /// Lists the threads (see captureProcessState()) and sends each one of them the capture
+   /// signal with tgkill(). Every thread writes its own program counters into its slot of the
+   /// crash record; the threads that don't answer in time are left without a stack.
+   /// Only uses async-signal-safe operations. Does nothing unless prepareThreadCapture() was called.
+   void captureAllThreads();
+
+   /// Capture the stack of another thread of this process while it keeps running (Linux only).
+   ///
+   /// Sends the thread the capture signal with tgkill() and waits for it to write its program counters,
+   /// starting at the instruction the signal interrupted. One capture at a time, so concurrent callers wait.
+   /// Not async-signal-safe.
+   /// @param inTid The thread id (gettid()) of the thread
+   /// @param outFrames Room for MAX_STACK_FRAMES program counters
+   /// @param outFrameCount The number of frames captured
+   /// @param inTimeoutNs How long to wait for the thread, which may block the signal or be stopped
+   /// @return false if the thread didn't answer in time
+   bool captureThreadStack( int32_t inTid, uint64_t *outFrames, uint32_t &outFrameCount, uint64_t inTimeoutNs );
+
+}
+
+#endif
@@ -0,0 +1,185 @@
+/*
+ * Copyright (C) 2020 Naikel Aparicio. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ''AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the author and should not be interpreted as representing
+ * official policies, either expressed or implied, of the copyright holder.
+ */
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <typeinfo>
+
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <pthread.h>
+
+#include "CrashArena.h"
+#include "ThrowCapture.h"
+#include "Unwinder.h"
+
+
+namespace YappariCrashReport
+{
+#ifdef YAPPARI_THROW_CAPTURE
+   // The last throw of a thread. Plain data, so the thread_local needs no constructor.
+   struct ThrowStack
+   {
+      const std::type_info *type;
+      uint32_t frameCount;
+      uint64_t frames[MAX_STACK_FRAMES];
+      uintptr_t   stackLow;      // the bounds of the thread's stack, looked up at its first throw
+      uintptr_t   stackHigh;     // 0 until then, 1 if they couldn't be found
+   };
+
+   static thread_local ThrowStack   tThrowStack;
+
+   static std::atomic<bool>   sThrowCapture{ false };
+   static std::terminate_handler sPreviousTerminateHandler = nullptr;
+
+   static void  _findStackBounds( ThrowStack &ioStack )
+   {
+      ioStack.stackHigh = 1;
+
+      pthread_attr_t attributes;
+
+      if ( pthread_getattr_np( pthread_self(), &attributes ) != 0 )
+         return;
+
+      void  *address = nullptr;
+      size_t   size = 0;
+
+      if ( pthread_attr_getstack( &attributes, &address, &size ) == 0 && size > 0 )
+      {
+         ioStack.stackLow = reinterpret_cast<uintptr_t>(address);
+         ioStack.stackHigh = ioStack.stackLow + size;
+      }
+
+      pthread_attr_destroy( &attributes );
+   }
+
+   static void  _captureThrow( const std::type_info *inType, const void *inFrame )
+   {
+      ThrowStack  &stack = tThrowStack;
+
+      if ( stack.stackHigh == 0 )
+         _findStackBounds( stack );
+
+      stack.type = inType;
+      stack.frameCount = walkFramePointers( inFrame, stack.stackLow, stack.stackHigh, stack.frames, MAX_STACK_FRAMES );
+   }
+
+   static void  _copyString( char *outString, size_t inSize, const char *inSource )
+   {
+      strncpy( outString, inSource, inSize - 1 );
+      outString[inSize - 1] = '\0';
+   }
+
+   // Record the uncaught exception in the crash record, then terminate as before (abort() raises the signal)
+   static void  _terminateHandler()
+   {
+      CrashRecord *record = crashRecord();
+
+      const std::type_info *cType = abi::__cxa_current_exception_type();
+
+      if ( record != nullptr && cType != nullptr )
+      {
+         ExceptionRecord   &exception = record->exception;
+
+         _copyString( exception.type, sizeof( exception.type ), cType->name() );
+
+         try
+         {
+            throw;
+         }
+         catch ( const std::exception &inException )
+         {
+            _copyString( exception.message, sizeof( exception.message ), inException.what() );
+         }
+         catch ( ... )
+         {
+         }
+
+         // the last throw of the thread, unless another type was thrown since (e.g. by std::rethrow_exception())
+         const ThrowStack  &cStack = tThrowStack;
+
+         if ( sThrowCapture.load( std::memory_order_relaxed ) && cStack.type == cType )
+         {
+            memcpy( exception.frames, cStack.frames, cStack.frameCount * sizeof( uint64_t ) );
+            exception.frameCount = cStack.frameCount;
+         }
+      }
+
+      if ( sPreviousTerminateHandler != nullptr )
+         sPreviousTerminateHandler();
+
+      abort();
+   }
+
+   bool  enableThrowCapture( bool inEnabled )
+   {
+      static bool sTerminateHandlerSet = false;
+
+      if ( inEnabled && !sTerminateHandlerSet )
+      {
+         sPreviousTerminateHandler = std::set_terminate( _terminateHandler );
+         sTerminateHandlerSet = true;
+      }
+
+      sThrowCapture.store( inEnabled, std::memory_order_relaxed );
+
+      return true;
+   }
+#else
+   bool  enableThrowCapture( bool inEnabled )
+   {
+      return !inEnabled;
+   }
+#endif
+}
+
+#ifdef YAPPARI_THROW_CAPTURE
+using ThrowFunction = void (*)( void *, std::type_info *, void (*)( void * ) );
+
+static ThrowFunction  _realThrow()
+{
+   return reinterpret_cast<ThrowFunction>(dlsym( RTLD_NEXT, "__cxa_throw" ));
+}
+
+// Replaces the __cxa_throw() of libstdc++ for the whole process: the executable's definition comes first
+extern "C" void __cxa_throw( void *inException, std::type_info *inType, void (*inDestructor)( void * ) ) __attribute__ ((noreturn));
+extern "C" void __cxa_throw( void *inException, std::type_info *inType, void (*inDestructor)( void * ) )
+{
+   static const ThrowFunction cRealThrow = _realThrow();
+
+   if ( YappariCrashReport::sThrowCapture.load( std::memory_order_relaxed ) )
+      YappariCrashReport::_captureThrow( inType, __builtin_frame_address( 0 ) );
+
+   cRealThrow( inException, inType, inDestructor );
+
+   __builtin_unreachable();
+}
+#endif
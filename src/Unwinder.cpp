@@ -0,0 +1,299 @@
+/*
+ * Copyright (C) 2020 Naikel Aparicio. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ''AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the author and should not be interpreted as representing
+ * official policies, either expressed or implied, of the copyright holder.
+ */
+
+#include <atomic>
+
+#include <pthread.h>
+#include <unwind.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
+
+#include "CrashArena.h"
+#include "Unwinder.h"
+
+#ifdef __GLIBC__
+// The top of the main thread's stack as the program started, from glibc
+extern "C" void  *__libc_stack_end;
+#endif
+
+
+namespace YappariCrashReport
+{
+   static std::atomic<uint32_t>  sUnwindMethod{ UNWIND_DWARF };
+
+#ifdef __linux__
+   // The stack of a thread registered with registerThreadStack(). Plain data, so the thread_local needs no constructor.
+   struct ThreadStack
+   {
+      uintptr_t   low;
+      uintptr_t   high;          // 0 if the thread isn't registered
+   };
+
+   static thread_local ThreadStack  tThreadStack;
+#endif
+
+   void  setUnwindMethod( UnwindMethod inMethod )
+   {
+      sUnwindMethod.store( inMethod, std::memory_order_relaxed );
+   }
+
+   UnwindMethod  unwindMethod()
+   {
+      return UnwindMethod( sUnwindMethod.load( std::memory_order_relaxed ) );
+   }
+
+   void  registerThreadStack()
+   {
+#ifdef __linux__
+      if ( tThreadStack.high != 0 )
+         return;
+
+#ifdef __GLIBC__
+      // asking for the main thread's stack would read /proc/self/maps, glibc knows where it ends
+      if ( syscall( SYS_gettid ) == getpid() )
+      {
+         tThreadStack.low = 0;
+         tThreadStack.high = reinterpret_cast<uintptr_t>(__libc_stack_end);
+         return;
+      }
+#endif
+
+      pthread_attr_t attributes;
+
+      if ( pthread_getattr_np( pthread_self(), &attributes ) != 0 )
+         return;
+
+      void  *address = nullptr;
+      size_t   size = 0;
+
+      if ( pthread_attr_getstack( &attributes, &address, &size ) == 0 && size > 0 )
+      {
+         tThreadStack.low = reinterpret_cast<uintptr_t>(address);
+         tThreadStack.high = tThreadStack.low + size;
+      }
+
+      pthread_attr_destroy( &attributes );
+#endif
+   }
+
+   uint32_t  walkFramePointers( const void *inFrame, uintptr_t inStackLow, uintptr_t inStackHigh,
+                                uint64_t *outFrames, uint32_t inMaxFrames )
+   {
+      uintptr_t   frame = reinterpret_cast<uintptr_t>(inFrame);
+      uint32_t    frameCount = 0;
+
+      // a frame record is the caller's frame pointer followed by the return address, on every architecture we support
+      while ( frameCount < inMaxFrames &&
+              frame >= inStackLow && (frame + 2 * sizeof( uintptr_t )) <= inStackHigh &&
+              (frame % sizeof( uintptr_t )) == 0 )
+      {
+         const uintptr_t   *cRecord = reinterpret_cast<const uintptr_t *>(frame);
+
+         if ( cRecord[1] == 0 )
+            break;
+
+         outFrames[frameCount++] = uint64_t( cRecord[1] );
+
+         // the stack grows down, so the callers' frames are always higher
+         if ( cRecord[0] <= frame )
+            break;
+
+         frame = cRecord[0];
+      }
+
+      return frameCount;
+   }
+
+   // The bounds of the current thread's stack, false if they aren't known or the stack pointer is elsewhere (async-signal-safe)
+   static bool  _stackBounds( uintptr_t inStackPointer, uintptr_t &outLow, uintptr_t &outHigh )
+   {
+#if defined(__APPLE__)
+      outHigh = reinterpret_cast<uintptr_t>(pthread_get_stackaddr_np( pthread_self() ));
+      outLow = outHigh - pthread_get_stacksize_np( pthread_self() );
+#elif defined(__linux__)
+      if ( tThreadStack.high == 0 )
+         return false;
+
+      outLow = tThreadStack.low;
+      outHigh = tThreadStack.high;
+#else
+      (void)outLow;
+      (void)outHigh;
+
+      return false;
+#endif
+
+      if ( inStackPointer < outLow || inStackPointer >= outHigh )
+         return false;
+
+      // nothing below the stack pointer belongs to a frame
+      outLow = inStackPointer;
+
+      return true;
+   }
+
+   static uint32_t  _unwindFramePointers( const void *inContext, uint64_t *outFrames )
+   {
+      uint64_t programCounter = 0;
+      uint64_t stackPointer = 0;
+      uint64_t framePointer = 0;
+
+      uintptr_t   stackLow = 0;
+      uintptr_t   stackHigh = 0;
+
+      if ( !contextFrame( inContext, programCounter, stackPointer, framePointer ) ||
+           !_stackBounds( uintptr_t( stackPointer ), stackLow, stackHigh ) )
+         return 0;
+
+      outFrames[0] = programCounter;
+
+      return 1 + walkFramePointers( reinterpret_cast<const void *>(uintptr_t( framePointer )), stackLow, stackHigh,
+                                    outFrames + 1, MAX_STACK_FRAMES - 1 );
+   }
+
+   struct DwarfUnwind
+   {
+      uint64_t programCounter;
+      uint64_t *frames;
+      uint32_t frameCount;
+      bool     interrupted;      // whether the interrupted frame was reached
+   };
+
+   static _Unwind_Reason_Code  _unwindFrame( struct _Unwind_Context *inContext, void *ioUnwind )
+   {
+      DwarfUnwind &unwind = *static_cast<DwarfUnwind *>(ioUnwind);
+
+      int   beforeInstruction = 0;
+
+      const uint64_t cAddress = uint64_t( _Unwind_GetIPInfo( inContext, &beforeInstruction ) );
+
+      // the frames of the handler and of the signal trampoline come first: the interrupted frame is the one
+      // whose address is the instruction itself rather than a return address
+      if ( !unwind.interrupted )
+      {
+         if ( beforeInstruction == 0 && (cAddress != unwind.programCounter || cAddress == 0) )
+            return _URC_NO_REASON;
+
+         unwind.interrupted = true;
+      }
+
+      unwind.frames[unwind.frameCount++] = cAddress;
+
+      return (unwind.frameCount < uint32_t( MAX_STACK_FRAMES )) ? _URC_NO_REASON : _URC_END_OF_STACK;
+   }
+
+   static uint32_t  _unwindDwarf( const void *inContext, uint64_t *outFrames )
+   {
+      DwarfUnwind unwind{ contextProgramCounter( inContext ), outFrames, 0, false };
+
+      _Unwind_Backtrace( _unwindFrame, &unwind );
+
+      // the unwinder couldn't get through the signal trampoline, the program counter is all there is
+      if ( unwind.frameCount == 0 && unwind.programCounter != 0 )
+      {
+         outFrames[0] = unwind.programCounter;
+         unwind.frameCount = 1;
+      }
+
+      return unwind.frameCount;
+   }
+
+#ifdef __linux__
+   // Walk the frame pointers of a stack whose bounds aren't known: every frame record is read with
+   // process_vm_readv(), which fails where a plain read would fault (async-signal-safe)
+   static uint32_t  _walkUnknownStack( uintptr_t inFrame, uintptr_t inStackPointer, uint64_t *outFrames, uint32_t inMaxFrames )
+   {
+      const pid_t cPid = getpid();
+
+      uintptr_t   frame = inFrame;
+      uint32_t    frameCount = 0;
+
+      while ( frameCount < inMaxFrames && frame >= inStackPointer && (frame % sizeof( uintptr_t )) == 0 )
+      {
+         uintptr_t   record[2] = { 0, 0 };
+
+         struct iovec   local{ record, sizeof( record ) };
+         struct iovec   remote{ reinterpret_cast<void *>(frame), sizeof( record ) };
+
+         if ( process_vm_readv( cPid, &local, 1, &remote, 1, 0 ) != ssize_t( sizeof( record ) ) || record[1] == 0 )
+            break;
+
+         outFrames[frameCount++] = uint64_t( record[1] );
+
+         if ( record[0] <= frame )
+            break;
+
+         frame = record[0];
+      }
+
+      return frameCount;
+   }
+#endif
+
+   uint32_t  unwindFramePointers( const void *inContext, uint64_t *outFrames )
+   {
+      const uint32_t cFrameCount = _unwindFramePointers( inContext, outFrames );
+
+      if ( cFrameCount > 0 )
+         return cFrameCount;
+
+      uint64_t programCounter = 0;
+      uint64_t stackPointer = 0;
+      uint64_t framePointer = 0;
+
+      if ( !contextFrame( inContext, programCounter, stackPointer, framePointer ) )
+         return 0;
+
+      outFrames[0] = programCounter;
+
+#ifdef __linux__
+      // a thread that wasn't registered
+      return 1 + _walkUnknownStack( uintptr_t( framePointer ), uintptr_t( stackPointer ), outFrames + 1, MAX_STACK_FRAMES - 1 );
+#else
+      return 1;
+#endif
+   }
+
+   uint32_t  unwindSignalContext( const void *inContext, UnwindMethod inMethod, uint64_t *outFrames )
+   {
+      if ( inMethod == UNWIND_FRAME_POINTERS )
+      {
+         const uint32_t cFrameCount = _unwindFramePointers( inContext, outFrames );
+
+         if ( cFrameCount > 1 )
+            return cFrameCount;
+      }
+
+      return _unwindDwarf( inContext, outFrames );
+   }
+}
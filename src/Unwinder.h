@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2020 Naikel Aparicio. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ''AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the author and should not be interpreted as representing
+ * official policies, either expressed or implied, of the copyright holder.
+ */
+
+
+#ifndef UNWINDER_H
+#define UNWINDER_H
+
+#include <cstdint>
+
+
+namespace YappariCrashReport {
+
+   /// The ways a stack can be unwound from a signal handler
+   enum UnwindMethod : uint32_t
+   {
+      UNWIND_DWARF = 0,          ///< The DWARF call frame information (.eh_frame) through _Unwind_Backtrace(), works with any code
+      UNWIND_FRAME_POINTERS,     ///< The chain of frame pointers, many times faster but needs code built with frame pointers
+   };
+
+   /// Set how captureCrash() unwinds the crashed thread (UNWIND_DWARF by default). The handlers that
+   /// interrupt the other threads always use unwindFramePointers().
+   void setUnwindMethod( UnwindMethod inMethod );
+
+   /// How captureCrash() unwinds the crashed thread
+   UnwindMethod unwindMethod();
+
+   /// Record the bounds of the calling thread's stack, which the frame-pointer unwinder checks every
+   /// frame against. Every thread that gets an alternate signal stack is registered (see installAlternateStack()).
+   /// On Linux the threads that aren't registered are unwound with the DWARF unwinder.
+   void registerThreadStack();
+
+   /// Unwind the stack of the current thread from a signal handler, starting exactly at the instruction
+   /// the signal interrupted: the first frame is the program counter of the ucontext, the others are
+   /// return addresses. The frame-pointer unwinder falls back to the DWARF one if the thread's stack
+   /// isn't known or its frame pointer leads nowhere. It can't see the caller of a leaf function that
+   /// sets up no frame of its own (compilers leave it out when the function needs no stack): the frame
+   /// after the program counter is then the caller's caller.
+   /// @param inContext The ucontext the handler was called with
+   /// @param inMethod The unwinder to use
+   /// @param outFrames Room for MAX_STACK_FRAMES program counters
+   /// @return The number of frames
+   uint32_t unwindSignalContext( const void *inContext, UnwindMethod inMethod, uint64_t *outFrames );
+
+   /// Unwind the stack of the current thread from a signal handler with the frame pointers only, for the
+   /// handlers that may interrupt any code: the DWARF unwinder isn't async-signal-safe (libgcc's FDE cache
+   /// and its lock can be taken by the interrupted code, in the middle of a throw or a dl_iterate_phdr()).
+   /// The stack of a thread that isn't registered is read with process_vm_readv() on Linux, which fails
+   /// instead of faulting; elsewhere only the program counter is captured for such a thread.
+   /// @param inContext The ucontext the handler was called with
+   /// @param outFrames Room for MAX_STACK_FRAMES program counters
+   /// @return The number of frames
+   uint32_t unwindFramePointers( const void *inContext, uint64_t *outFrames );
+
+   /// Walk the frame pointers of the current thread from a frame on, checking every frame against
+   /// the bounds of the stack so a function built without frame pointers ends the walk instead of crashing it.
+   /// @param inFrame The frame pointer to start from
+   /// @param inStackLow The lowest address the frames can be at (e.g. the stack pointer)
+   /// @param inStackHigh One past the highest address of the stack
+   /// @param outFrames Room for inMaxFrames return addresses
+   /// @return The number of return addresses, the caller of the frame's function first
+   uint32_t walkFramePointers( const void *inFrame, uintptr_t inStackLow, uintptr_t inStackHigh,
+                               uint64_t *outFrames, uint32_t inMaxFrames );
+
+}
+
+#endif
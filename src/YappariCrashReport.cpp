@@ -47,12 +47,15 @@
 // Andy Maloney <asmaloney@gmail.com>
 
 #include <cstdlib>
+#include <cstring>
 
+#include <QAbstractEventDispatcher>
 #include <QCoreApplication>
 #include <QDateTime>
 #include <QDir>
-#include <QProcess>
-#include <QRegularExpression>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutex>
 #include <QStandardPaths>
 #include <QStringList>
 #include <QTextStream>
@@ -62,105 +65,167 @@
 #include <windows.h>
 #include <imagehlp.h>
 #else
+#include <atomic>
 #include <csignal>
+#include <vector>
 #include <err.h>
-#include <execinfo.h>
+#include <unistd.h>
 #endif
 
 #include "YappariCrashReport.h"
-#include "CrashReportDialog.h"
+#include "CrashReport.h"
+#include "Symbolizer.h"
+
+#ifndef Q_OS_WIN
+#include "AlternateStack.h"
+#include "Breadcrumbs.h"
+#include "CrashArena.h"
+#include "CrashSpool.h"
+#include "ReportStream.h"
+#include "Unwinder.h"
+#endif
+
+#ifdef YAPPARI_CRASH_UPLOADER
+#include "CrashUploader.h"
+#endif
+
+#ifdef Q_OS_LINUX
+#include "CrashHandlerProcess.h"
+#include "HangWatchdog.h"
+#include "Minidump.h"
+#include "ModuleMap.h"
+#include "Profiler.h"
+#include "ThreadCapture.h"
+#include "ThrowCapture.h"
+#endif
 
 
 namespace YappariCrashReport
 {
    static QString sProgramName;        // the full path to the executable (which we need to resolve symbols)
 
-   // Note that we are looking for GCC-style name mangles
-   // See: https://en.wikipedia.org/wiki/Name_mangling#How_different_compilers_mangle_the_same_functions
 #ifdef Q_OS_LINUX
-   // Example:
-   // /usr/lib/libc.so.6(__libc_start_main+0xf2) [0x7f10f2819152]
-   static QRegularExpression  sSymbolMatching("^(.*)\\(.*\\+0x([^ ]+)\\).*\\[([^ ]+)\\]$");
+   static QString sCrashHandlerProgram;   // the crash handler program to hand the crashes over to, if any
+   static QStringList sCrashHandlerArguments;
+   static bool sCrashHandlerStarted = false; // read by the signal handler
+   static bool sModuleMapUpdated = false;    // whether the main loop brings the module map up to date
+
+   static int  sAllThreadsTimeoutMs = -1; // how long to wait for the other threads' stacks, -1 to only capture the crashed thread
+
+   static QString sMinidumpDirectory;     // where to write the minidumps, empty to not write them
+   static int  sMinidumpStackBytes = 0;
+   static bool sMinidumpEnabled = false;  // read by the signal handler
+#endif
+
+   static crashReportCallback  sCrashReportCallback; // function to call after the sink is done with the crash report
+
+#ifdef YAPPARI_CRASH_REPORT_DIALOG
+   static crashReportSink  sCrashReportSink = showCrashReportDialog; // shows the crash report, nullptr when headless
 #else
-   static QRegularExpression  sSymbolMatching("^.*(_Z[^ ]+).*$");
+   static crashReportSink  sCrashReportSink = nullptr;
 #endif
 
+   static QString sReportDirectory;    // where to write the crash reports, empty to not write them
 
-   static crashReportCallback  sCrashReportCallback; // function to call after we've shown the crash report to the user
-   static QProcess            *sProcess = nullptr; // process used to capture output of address mapping tool
+   static QString sCrashSignature;     // the signature of the crash being reported, see crashSignature()
+   static int  sCrashOccurrences = 0;
 
-   void  _showCrashReportDialog( const QString &inSignal, const QStringList &inFrameInfoList )
-   {
-      const QStringList cReportHeader{
-         QStringLiteral( "%1 v%2" ).arg( QCoreApplication::applicationName(), QCoreApplication::applicationVersion() ),
-               QDateTime::currentDateTime().toString( "dd MMM yyyy @ HH:mm:ss" ),
-               QString(),
-               inSignal,
-               QString(),
-      };
+   static bool sRegistered = false;    // whether registerSignalHandler() installed the handlers
 
-      const QString cFileName = QStringLiteral( "%1 %2 Crash.log" ).arg( QDateTime::currentDateTime().toString( "yyyyMMdd-HHmmss" ),
-                                                                         QCoreApplication::applicationName() );
+#ifndef Q_OS_WIN
+   static QtMessageHandler sPreviousMessageHandler = nullptr;  // the handler installBreadcrumbMessageHandler() chains to
 
+   static QString sSpoolDirectory;     // the directory of the crash spool, empty if there is none
 
-      // Show the crash report dialog
-      const QString cStackTrace = QStringList(cReportHeader + inFrameInfoList).join("\n");
-      CrashReportDialog dialog( cFileName, cStackTrace );
-      dialog.exec();
+   // Serializes the index of the spool and the report & spool directories between the threads that use
+   // them while the application runs (the setters, the hang watchdog and the uploader). The signal handler
+   // doesn't take it: the crash is the last report the process adds.
+   static QMutex  sSpoolMutex;
+#endif
+
+#ifdef YAPPARI_CRASH_UPLOADER
+   static bool sUploading = false;     // whether setCrashUploader() enabled the uploads, restarted when the spool is reopened
+   static QUrl sUploadEndpoint;
+   static CrashUploadOptions  sUploadOptions;
+#endif
+
+   // Hand a report that is already on disk (or doesn't have to be) over to the sink and the callback
+   static void  _deliverCrashReport( const QString &inFileName, const QString &inStackTrace )
+   {
+      if ( sCrashReportSink != nullptr )
+         (*sCrashReportSink)( inFileName, inStackTrace );
 
       if ( sCrashReportCallback != nullptr )
-         (*sCrashReportCallback)( cStackTrace );
+         (*sCrashReportCallback)( inStackTrace );
    }
 
-   // Resolve symbol name & source location
-   QString _addressToLine( const QString &inProgramName, void const * const inAddr )
+   // Count the crash in the signature index of the report directory
+   // @return The report of the signature: the one of its first crash if it is still there, inFileName otherwise
+   static QString  _countCrash( const QString &inSignature, const QString &inFileName )
    {
-      const QString  cAddrStr = QStringLiteral( "0x%1" ).arg( quintptr( inAddr ), 16, 16, QChar( '0' ) );
+      sCrashSignature = inSignature;
+      sCrashOccurrences = 1;
 
-#ifdef Q_OS_MAC
-      // Uses atos
-      const QString  cProgram = QStringLiteral( "atos" );
+      if ( inSignature.isEmpty() || sReportDirectory.isEmpty() )
+         return inFileName;
 
-      const QStringList  cArguments = {
-         "-o", inProgramName,
-         "-arch", "x86_64",
-         cAddrStr
-      };
-#elsif Q_OS_WIN
-      // Uses addr2line
-      const QString  cProgram = QStringLiteral( "%1/tools/addr2line" ).arg( QCoreApplication::applicationDirPath() );
-#else
-      const QString  cProgram = "addr2line";
+      QString  reportFileName;
 
-      const QStringList  cArguments = {
-         "-C",
-         "-f",
-         "-p",
-         "-s",
-         "-e", inProgramName,
-         cAddrStr
+      sCrashOccurrences = qMax( countCrashSignature( sReportDirectory, inSignature, inFileName, reportFileName ), 1 );
 
-      };
+      return reportFileName;
+   }
+
+#ifndef Q_OS_WIN
+   // Add a new report of the report directory to the index of the spool, if the spool is the report directory
+   // @param inTime The wall clock time of the report in seconds since the epoch
+   static void  _spoolReport( const QString &inSignature, const QString &inFileName, qint64 inSize, int64_t inTime )
+   {
+      if ( sSpoolDirectory.isEmpty() || sReportDirectory != sSpoolDirectory )
+         return;
+
+      addSpoolEntry( inSignature.toULongLong( nullptr, 16 ), inTime, uint64_t( inSize ),
+                     QFile::encodeName( inFileName ).constData() );
+   }
 #endif
 
-      sProcess->setProgram( cProgram );
-      sProcess->setArguments( cArguments );
-      sProcess->setProcessChannelMode(QProcess::SeparateChannels);
-      sProcess->setReadChannel(QProcess::StandardOutput);
-      sProcess->start( QIODevice::ReadOnly );
+   void  _reportCrash( const QString &inStackTrace, const QString &inSignature = QString() )
+   {
+      const QString cFileName = crashReportFileName();
+      const QString cReportFileName = _countCrash( inSignature, cFileName );
 
-      if ( !sProcess->waitForFinished() )
+      // a crash seen before only bumps the counter of its signature
+      if ( !sReportDirectory.isEmpty() && cReportFileName == cFileName &&
+           writeCrashReportFile( sReportDirectory, cFileName, inStackTrace ) )
       {
-         return QStringLiteral( "* Error running command\n   %1 %2\n   %3" ).arg(
-                  sProcess->program(),
-                  sProcess->arguments().join( ' ' ),
-                  sProcess->errorString() );
+#ifndef Q_OS_WIN
+         _spoolReport( inSignature, cFileName, QFileInfo( QDir( sReportDirectory ).filePath( cFileName ) ).size(),
+                       crashRecord()->time );
+#endif
       }
 
-      const QString  cLocationStr = QString( sProcess->readAll() ).trimmed();
+      _deliverCrashReport( cReportFileName, inStackTrace );
+   }
+
+#ifdef Q_OS_LINUX
+   // The hang reports of the watchdog only go to the report directory (and its spool) and the callback.
+   // A hang has no signature: it isn't counted with the crashes.
+   static void  _reportHang( const QString &inReport )
+   {
+      {
+         QMutexLocker   locker( &sSpoolMutex );
+
+         const QString cFileName = hangReportFileName();
 
-      return (cLocationStr == cAddrStr) ? QString() : cLocationStr;
+         if ( !sReportDirectory.isEmpty() && writeCrashReportFile( sReportDirectory, cFileName, inReport ) )
+            _spoolReport( QString(), cFileName, QFileInfo( QDir( sReportDirectory ).filePath( cFileName ) ).size(),
+                          QDateTime::currentSecsSinceEpoch() );
+      }
+
+      if ( sCrashReportCallback != nullptr )
+         (*sCrashReportCallback)( inReport );
    }
+#endif
 
 #ifdef Q_OS_WIN
    QStringList _stackTrace( CONTEXT* context )
@@ -198,8 +263,7 @@ namespace YappariCrashReport
 #error You need to define the stack frame layout for this architecture
 #endif
 
-      QStringList frameList;
-      int         frameNumber = 0;
+      StackFrameList frames;
 
       while ( StackWalk64(
                  image, process, thread,
@@ -207,14 +271,29 @@ namespace YappariCrashReport
                  SymFunctionTableAccess64, SymGetModuleBase64, nullptr )
               )
       {
-         QString  locationStr = _addressToLine( sProgramName, reinterpret_cast<void*>(stackFrame.AddrPC.Offset) );
+         StackFrame  frame;
+
+         frame.address = quintptr( stackFrame.AddrPC.Offset );
+         frame.module = sProgramName;
+         frame.offset = frame.address;
+
+         frames += frame;
+      }
+
+      symbolizeFrames( frames );
+
+      QStringList frameList;
+
+      frameList.reserve( frames.size() );
+
+      for ( int frameNumber = 0; frameNumber < frames.size(); ++frameNumber )
+      {
+         const StackFrame  &cFrame = frames.at( frameNumber );
 
          frameList += QStringLiteral( "[%1] 0x%2 %3" )
                       .arg( QString::number( frameNumber ) )
-                      .arg( quintptr( reinterpret_cast<void*>(stackFrame.AddrPC.Offset) ), 16, 16, QChar( '0' ) )
-                      .arg( locationStr );
-
-         ++frameNumber;
+                      .arg( cFrame.address, 16, 16, QChar( '0' ) )
+                      .arg( cFrame.location );
       }
 
       SymCleanup( GetCurrentProcess() );
@@ -224,6 +303,14 @@ namespace YappariCrashReport
 
    LONG WINAPI _winExceptionHandler( EXCEPTION_POINTERS *inExceptionInfo )
    {
+      // only registerSignalHandler() was called
+      if ( sProgramName.isEmpty() )
+      {
+         wchar_t  path[MAX_PATH];
+
+         sProgramName = QString::fromWCharArray( path, int( GetModuleFileNameW( nullptr, path, MAX_PATH ) ) );
+      }
+
       const QString  cExceptionType = [] ( DWORD code ) {
          switch( code )
          {
@@ -279,201 +366,179 @@ namespace YappariCrashReport
       if ( inExceptionInfo->ExceptionRecord->ExceptionCode == EXCEPTION_STACK_OVERFLOW )
       {
           // https://stackoverflow.com/a/38019482
+         StackFrameList frames( 1 );
+
 #ifdef _M_IX86
-         frameInfoList += _addressToLine( sProgramName, reinterpret_cast<void*>(inExceptionInfo->ContextRecord->Eip) );
+         frames[0].address = quintptr( inExceptionInfo->ContextRecord->Eip );
 #elif _M_X64
-         frameInfoList += _addressToLine( sProgramName, reinterpret_cast<void*>(inExceptionInfo->ContextRecord->Rip) );
+         frames[0].address = quintptr( inExceptionInfo->ContextRecord->Rip );
 #else
-#error You need to implement the call to _addressToLine for this architecture
+#error You need to implement the call to symbolizeFrames for this architecture
 #endif
+         frames[0].module = sProgramName;
+         frames[0].offset = frames[0].address;
+
+         symbolizeFrames( frames );
+
+         frameInfoList += frames[0].location;
       }
       else
       {
          frameInfoList += _stackTrace( inExceptionInfo->ContextRecord );
       }
 
-      _showCrashReportDialog( cExceptionType, frameInfoList );
+      _reportCrash( crashReportText( cExceptionType, frameInfoList ) );
 
       return EXCEPTION_EXECUTE_HANDLER;
    }
 #else
-   constexpr int  MAX_STACK_FRAMES = 64;
-   static void    *sStackTraces[MAX_STACK_FRAMES];
-   static uint8_t sAlternateStack[SIGSTKSZ];
+   static std::atomic<bool>   sCrashing{ false };  // whether a thread is reporting a crash already
+   static thread_local bool   tCrashing = false;   // whether it is this one
 
-   QStringList  _stackTrace()
+   // Stream the report to disk while it is put together, so a fault in the handler leaves as much as it got to
+   static void  _setReportStreamDirectory()
    {
-      int   traceSize = backtrace( sStackTraces, MAX_STACK_FRAMES );
-      char  **messages = backtrace_symbols( sStackTraces, traceSize );
+      // without a report directory the report is still streamed, to a temporary file removed once it is reported
+      const QString  cDirectory = sReportDirectory.isEmpty() ? QDir::tempPath() : sReportDirectory;
 
-      // skip the first 2 stack frames (this function and our handler) and skip the last frame (always junk)
-      QStringList frameList;
-      int         frameNumber = 0;
-
-      frameList.reserve( traceSize );
-
-#ifdef Q_OS_LINUX
-      int stackTraceStart = 3;
-#else
-      int stackTraceStart = 2;
-#endif
-
-      for ( int i = stackTraceStart; i < (traceSize - 1); ++i )
+      if ( !QDir().mkpath( cDirectory ) )
       {
-         QString  message( messages[i] );
+         qWarning() << "YappariCrashReport: could not create" << cDirectory;
 
-         // match the mangled name if possible and replace with file & line number
-         QRegularExpressionMatch match = sSymbolMatching.match( message );
+         setReportStreamDirectory( nullptr, 0 );
+         return;
+      }
 
-#ifdef Q_OS_MAC
-         const QString  cSymbol( match.captured( 1 ) );
+      setReportStreamDirectory( QFile::encodeName( QDir( cDirectory ).absolutePath() ).constData(),
+                                int32_t( QDateTime::currentDateTime().offsetFromUtc() ) );
+   }
 
-         if ( !cSymbol.isNull() )
-         {
-            QString  locationStr = _addressToLine( sProgramName, sStackTraces[i] );
+#ifdef Q_OS_LINUX
+   // Append every frame to the streamed report as soon as it is symbolized
+   static void  _streamFrame( int inStack, int inFrameNumber, const StackFrame &inFrame )
+   {
+      const CrashRecord &cRecord = *crashRecord();
 
-            if ( !locationStr.isEmpty() )
-            {
-               int   matchStart = match.capturedStart( 1 );
+      QString  line = formatStackFrame( inFrameNumber, inFrame );
 
-               message.replace( matchStart, message.length() - matchStart, locationStr );
-            }
-         }
+      // the stacks of the other threads and the one the exception was thrown from come after the crashed thread's
+      if ( inStack > int( cRecord.threadCount ) )
+         line.prepend( QStringLiteral( "Thrown from " ) );
+      else if ( inStack > 0 )
+         line.prepend( QStringLiteral( "Thread %1 " ).arg( cRecord.threads[inStack - 1].tid ) );
 
-         frameList += message;
-#else
+      const QByteArray  cLine = line.toLocal8Bit() + '\n';
 
-         QString programName = match.captured( 1 );
-         QString programAddress = match.captured( 2 );
+      appendReportStream( cLine.constData(), size_t( cLine.size() ) );
+   }
+#endif
 
-         QString  locationStr;
+   // prototype to prevent warning about not returning
+   void _posixSignalHandler( int inSig, siginfo_t *inSigInfo, void *inContext ) __attribute__ ((noreturn));
+   void _posixSignalHandler( int inSig, siginfo_t *inSigInfo, void *inContext )
+   {
+      // a fault while reporting the crash ends the report where it got to
+      if ( tCrashing )
+      {
+         cutReportStream( inSig );
+         _Exit(1);
+      }
 
-         if ( !programName.isNull() && !programAddress.isNull())
-         {
-             bool ok;
-             quintptr addressPtr = programAddress.toULongLong(&ok, 16);
-             locationStr = _addressToLine( programName, reinterpret_cast<void *>( addressPtr ) );
-         }
-         else
-         {
-             int index = message.lastIndexOf( " [0x" );
-             if ( index >= 0 )
-                 message = message.left( index) ;
+      tCrashing = true;
 
-             locationStr = message;
-         }
+      // there is a single crash arena, so a thread crashing at the same time waits for the process to end
+      if ( sCrashing.exchange( true ) )
+      {
+         for (;;)
+            pause();
+      }
 
-         int index = programName.lastIndexOf( "/" );
-         if (index >= 0)
-             programName = programName.right(programName.size() - index - 1);
+      // Capture stage: only async-signal-safe operations, everything ends up in the crash arena
+      captureCrash( inSig, inSigInfo, inContext );
 
-         frameList += QStringLiteral( "[%1] %4 0x%2 %3" )
-                      .arg( QString::number( frameNumber ) )
-                      .arg( quintptr( reinterpret_cast<void*>(sStackTraces[i]) ), 16, 16, QChar( '0' ) )
-                      .arg( locationStr )
-                      .arg( programName );
+      // a partial report is on disk right away, unless a crash handler process takes over
+#ifdef Q_OS_LINUX
+      if ( !sCrashHandlerStarted )
 #endif
+         openReportStream( *crashRecord() );
 
-         ++frameNumber;
-      }
+#ifdef Q_OS_LINUX
+      captureAllThreads();
+
+      // without a module map snapshot (no module was loaded or unloaded) the modules are read now
+      captureModules();
 
-      if ( messages != nullptr )
+      // the minidump goes first, it only needs the crash record
+      if ( sMinidumpEnabled )
       {
-         free( messages );
+         captureProcessState();
+         writeMinidumpFile( *crashRecord() );
       }
 
-      return frameList;
-   }
+      // If there is a crash handler process it does all the work, we just have to get out of the way
+      if ( sendCrashToHandlerProcess() )
+         _Exit(1);
 
-   // prototype to prevent warning about not returning
-   void _posixSignalHandler( int inSig, siginfo_t *inSigInfo, void *inContext ) __attribute__ ((noreturn));
-   void _posixSignalHandler( int inSig, siginfo_t *inSigInfo, void *inContext )
-   {
-      Q_UNUSED( inContext )
+      openReportStream( *crashRecord() );
+#endif
 
-      const QString  cSignalType = [] ( int sig, int inSignalCode ) {
-         switch( sig )
-         {
-            case SIGSEGV:
-               return QStringLiteral( "Caught SIGSEGV: Segmentation Fault" );
-            case SIGINT:
-               return QStringLiteral( "Caught SIGINT: Interactive attention signal, (usually ctrl+c)" );
-            case SIGFPE:
-               switch( inSignalCode )
-               {
-                  case FPE_INTDIV:
-                     return QStringLiteral( "Caught SIGFPE: (integer divide by zero)" );
-                  case FPE_INTOVF:
-                     return QStringLiteral( "Caught SIGFPE: (integer overflow)" );
-                  case FPE_FLTDIV:
-                     return QStringLiteral( "Caught SIGFPE: (floating-point divide by zero)" );
-                  case FPE_FLTOVF:
-                     return QStringLiteral( "Caught SIGFPE: (floating-point overflow)" );
-                  case FPE_FLTUND:
-                     return QStringLiteral( "Caught SIGFPE: (floating-point underflow)" );
-                  case FPE_FLTRES:
-                     return QStringLiteral( "Caught SIGFPE: (floating-point inexact result)" );
-                  case FPE_FLTINV:
-                     return QStringLiteral( "Caught SIGFPE: (floating-point invalid operation)" );
-                  case FPE_FLTSUB:
-                     return QStringLiteral( "Caught SIGFPE: (subscript out of range)" );
-                  default:
-                     return QStringLiteral( "Caught SIGFPE: Arithmetic Exception" );
-               }
-            case SIGILL:
-               switch( inSignalCode )
-               {
-                  case ILL_ILLOPC:
-                     return QStringLiteral( "Caught SIGILL: (illegal opcode)" );
-                  case ILL_ILLOPN:
-                     return QStringLiteral( "Caught SIGILL: (illegal operand)" );
-                  case ILL_ILLADR:
-                     return QStringLiteral( "Caught SIGILL: (illegal addressing mode)" );
-                  case ILL_ILLTRP:
-                     return QStringLiteral( "Caught SIGILL: (illegal trap)" );
-                  case ILL_PRVOPC:
-                     return QStringLiteral( "Caught SIGILL: (privileged opcode)" );
-                  case ILL_PRVREG:
-                     return QStringLiteral( "Caught SIGILL: (privileged register)" );
-                  case ILL_COPROC:
-                     return QStringLiteral( "Caught SIGILL: (coprocessor error)" );
-                  case ILL_BADSTK:
-                     return QStringLiteral( "Caught SIGILL: (internal stack error)" );
-                  default:
-                     return QStringLiteral( "Caught SIGILL: Illegal Instruction" );
-               }
-            case SIGTERM:
-               return QStringLiteral( "Caught SIGTERM: a termination request was sent to the program" );
-            case SIGABRT:
-               return QStringLiteral( "Caught SIGABRT: usually caused by an abort() or assert()" );
-         }
+      // From here on we only work from the crash record, which knows the application even if
+      // the crash happened before setSignalHandler()
+#ifdef Q_OS_LINUX
+      const QString  cReport = crashRecordReport( *crashRecord(), crashRecordStacks( *crashRecord(), _streamFrame ) );
+#else
+      const QString  cReport = crashRecordReport( *crashRecord() );
+#endif
 
-         return QStringLiteral( "Unrecognized Signal" );
-      } ( inSig, inSigInfo->si_code );
+      // the complete report takes the place of the streamed one
+      const QByteArray  cReportText = cReport.toLocal8Bit() + '\n';
 
-      const QStringList cFrameInfoList = _stackTrace();
+      const QString  cSignature = crashSignatureText( *crashRecord() );
 
-      _showCrashReportDialog( cSignalType, cFrameInfoList );
+      if ( finishReportStream( cReportText.constData(), size_t( cReportText.size() ) ) )
+      {
+         const QString  cFileName = QFileInfo( QFile::decodeName( reportStreamPath() ) ).fileName();
+         const QString  cReportFileName = _countCrash( cSignature, cFileName );
+
+         // a crash seen before only bumps the counter of its signature, the first report stands for it
+         if ( cReportFileName != cFileName )
+            removeReportStream();
+         else
+            _spoolReport( cSignature, cFileName, cReportText.size(), crashRecord()->time );
+
+         _deliverCrashReport( cReportFileName, cReport );
+
+         if ( sReportDirectory.isEmpty() )
+            removeReportStream();
+      }
+      else
+      {
+         _reportCrash( cReport, cSignature );
+      }
 
       _Exit(1);
    }
 
-   void _posixSetupSignalHandler()
+   // Only what can't wait for a crash: the memory the signal handler captures into, the alternate
+   // stack and the signal handlers themselves. Everything else is set up when it is first needed.
+   void _posixRegisterSignalHandler()
    {
-      // setup alternate stack
-      // different operating systems define the struct in different order so the following is totally invalid:
-      // stack_t ss{ static_cast<void*>(sAlternateStack), SIGSTKSZ, 0 }; <-- might be valid on mac but a total mess in Linux!!!
-      // we have to assign each member separately
-      stack_t ss;
-      ss.ss_sp = static_cast<void*>(sAlternateStack);
-      ss.ss_size = SIGSTKSZ;
-      ss.ss_flags = 0;
-
-      if ( sigaltstack( &ss, nullptr ) != 0 )
+      // reserve the memory the signal handler captures into
+      if ( !reserveCrashArena() )
       {
-         err( 1, "sigaltstack" );
+         err( 1, "mmap" );
       }
 
+#ifdef Q_OS_LINUX
+      // the handler finds the modules in a snapshot taken once a module is loaded or unloaded,
+      // or reads them from /proc/self/maps if there is none
+      watchModuleMap();
+#endif
+
+      // setup the alternate stack of this thread, and of every thread started from now on
+      installAlternateStack();
+      enableThreadAlternateStacks();
+
       // register our signal handlers
       struct sigaction sigAction;
 
@@ -481,7 +546,9 @@ namespace YappariCrashReport
 
       sigemptyset( &sigAction.sa_mask );
 
-      sigAction.sa_flags = SA_SIGINFO;
+      // run on the alternate stack so a stack overflow can be reported too, and let a fault in the handler
+      // itself reach it so the report can be cut off cleanly
+      sigAction.sa_flags = SA_SIGINFO | SA_ONSTACK | SA_NODEFER;
 
       if ( sigaction( SIGSEGV, &sigAction, nullptr ) != 0 ) { err( 1, "sigaction" ); }
       if ( sigaction( SIGFPE,  &sigAction, nullptr ) != 0 ) { err( 1, "sigaction" ); }
@@ -490,27 +557,625 @@ namespace YappariCrashReport
       if ( sigaction( SIGTERM, &sigAction, nullptr ) != 0 ) { err( 1, "sigaction" ); }
       if ( sigaction( SIGABRT, &sigAction, nullptr ) != 0 ) { err( 1, "sigaction" ); }
    }
+
+   // What needs the QCoreApplication: the details of the application and the optional features
+   void _posixSetupSignalHandler()
+   {
+      // the record has to describe the application on its own when it is reported by another process
+      setCrashApplication( QCoreApplication::applicationName().toLocal8Bit().constData(),
+                           QCoreApplication::applicationVersion().toLocal8Bit().constData(),
+                           sProgramName.toLocal8Bit().constData() );
+
+#ifdef Q_OS_LINUX
+      if ( !sMinidumpDirectory.isEmpty() )
+      {
+         if ( !QDir().mkpath( sMinidumpDirectory ) )
+            qWarning() << "YappariCrashReport: could not create" << sMinidumpDirectory;
+
+         setMinidumpFileDirectory( QDir( sMinidumpDirectory ).absolutePath().toLocal8Bit().constData() );
+         setStackMemorySize( size_t( sMinidumpStackBytes ) );
+
+         sMinidumpEnabled = true;
+      }
 #endif
 
-   void  setSignalHandler( crashReportCallback inCrashReportCallback )
+#ifdef Q_OS_LINUX
+      if ( sAllThreadsTimeoutMs >= 0 && !prepareThreadCapture( sAllThreadsTimeoutMs ) ) { err( 1, "sigaction" ); }
+#endif
+
+      _setReportStreamDirectory();
+   }
+#endif
+
+#ifdef Q_OS_WIN
+   // Windows reports stack overflows without an alternate stack
+   void  setAlternateStackSize( size_t inSize )
    {
-      sProgramName = QCoreApplication::arguments().at( 0 );
+      Q_UNUSED( inSize )
+   }
 
-      sSymbolMatching.optimize();
+   AlternateSignalStack::AlternateSignalStack()
+   {
+   }
+
+   AlternateSignalStack::~AlternateSignalStack()
+   {
+   }
+#endif
+
+#ifndef Q_OS_LINUX
+   // The live stack captures need the module map and the capture signal of Linux
+   StackTrace::StackTrace( const StackTrace &inOther ) :
+      mStack( inOther.mStack )
+   {
+   }
+
+   StackTrace  &StackTrace::operator=( const StackTrace &inOther )
+   {
+      mStack = inOther.mStack;
 
+      return *this;
+   }
+
+   StackTrace::~StackTrace()
+   {
+   }
+
+   int  StackTrace::size() const
+   {
+      return 0;
+   }
+
+   quintptr  StackTrace::frame( int inIndex ) const
+   {
+      Q_UNUSED( inIndex )
+
+      return 0;
+   }
+
+   QVector<quintptr>  StackTrace::frames() const
+   {
+      return QVector<quintptr>();
+   }
+
+   quint32  StackTrace::id() const
+   {
+      return 0;
+   }
+
+   StackTrace  captureStackTrace( int inSkipFrames )
+   {
+      Q_UNUSED( inSkipFrames )
+
+      return StackTrace();
+   }
+
+   StackTrace  captureThreadStackTrace( qint64 inThreadId, int inTimeoutMs )
+   {
+      Q_UNUSED( inThreadId )
+      Q_UNUSED( inTimeoutMs )
+
+      return StackTrace();
+   }
+
+   qint64  currentThreadId()
+   {
+      return 0;
+   }
+
+   QStringList  symbolizeStackTrace( const StackTrace &inStackTrace )
+   {
+      Q_UNUSED( inStackTrace )
+
+      return QStringList();
+   }
+
+   void  symbolizeStackTrace( const StackTrace &inStackTrace, QObject *inContext, std::function<void (const QStringList &)> inCallback )
+   {
+      Q_UNUSED( inStackTrace )
+      Q_UNUSED( inContext )
+      Q_UNUSED( inCallback )
+   }
+#endif
+
+   void  registerSignalHandler( crashReportCallback inCrashReportCallback )
+   {
       sCrashReportCallback = inCrashReportCallback;
 
-      if ( sProcess == nullptr )
-      {
-         sProcess = new QProcess;
+      if ( sRegistered )
+         return;
 
-         sProcess->setProcessChannelMode( QProcess::MergedChannels );
-      }
+      sRegistered = true;
 
 #ifdef Q_OS_WIN
       SetUnhandledExceptionFilter( _winExceptionHandler );
 #else
+      _posixRegisterSignalHandler();
+#endif
+   }
+
+   void  setSignalHandler( crashReportCallback inCrashReportCallback )
+   {
+#ifdef Q_OS_LINUX
+      sProgramName = QCoreApplication::applicationFilePath();
+#else
+      sProgramName = QCoreApplication::arguments().at( 0 );
+#endif
+
+      // the symbolizer is only set up when there is something to symbolize
+      registerSignalHandler( inCrashReportCallback );
+
+#ifndef Q_OS_WIN
       _posixSetupSignalHandler();
 #endif
+
+#ifdef Q_OS_LINUX
+      // the modules loaded or unloaded meanwhile (Qt plugins...) go into the snapshot whenever the main loop is idle
+      QAbstractEventDispatcher   *dispatcher = QAbstractEventDispatcher::instance( QCoreApplication::instance()->thread() );
+
+      if ( dispatcher != nullptr && !sModuleMapUpdated )
+      {
+         QObject::connect( dispatcher, &QAbstractEventDispatcher::aboutToBlock, [] () { updateModuleMap(); } );
+
+         sModuleMapUpdated = true;
+      }
+
+      // without a crash handler process the crash is reported in-process
+      if ( !sCrashHandlerProgram.isEmpty() )
+      {
+         QStringList arguments = sCrashHandlerArguments;
+
+         // the crash handler adds its reports to the spool too
+         if ( !sSpoolDirectory.isEmpty() )
+            arguments += QStringLiteral( "--spool-dir=%1" ).arg( sSpoolDirectory );
+
+         sCrashHandlerStarted = startCrashHandlerProcess( sCrashHandlerProgram, arguments );
+
+         if ( !sCrashHandlerStarted )
+            qWarning() << "YappariCrashReport: reporting crashes in-process";
+      }
+#endif
+   }
+
+   void  setCrashReportSink( crashReportSink inSink )
+   {
+      sCrashReportSink = inSink;
+   }
+
+   void  setReportDirectory( const QString &inDirectory )
+   {
+#ifndef Q_OS_WIN
+      {
+         QMutexLocker   locker( &sSpoolMutex );
+
+         sReportDirectory = inDirectory;
+      }
+#else
+      sReportDirectory = inDirectory;
+#endif
+
+#ifndef Q_OS_WIN
+      // the signal handler streams the reports there from now on
+      if ( sRegistered && !sProgramName.isEmpty() )
+         _setReportStreamDirectory();
+#endif
+   }
+
+   QString  crashSignature()
+   {
+      return sCrashSignature;
+   }
+
+   int  crashOccurrences()
+   {
+      return sCrashOccurrences;
+   }
+
+   bool  setCrashSpool( bool inEnabled, qint64 inMaxBytes, int inMaxFiles, const QString &inDirectory )
+   {
+#ifndef Q_OS_WIN
+#ifdef YAPPARI_CRASH_UPLOADER
+      // the upload thread reads the index, which is unmapped when the spool is closed or opened again
+      stopCrashUploads();
+#endif
+
+      QMutexLocker   locker( &sSpoolMutex );
+
+      if ( !inEnabled )
+      {
+         const bool  cWasReportDirectory = (sReportDirectory == sSpoolDirectory);
+
+         closeCrashSpool();
+         sSpoolDirectory.clear();
+
+         locker.unlock();
+
+         if ( cWasReportDirectory )
+            setReportDirectory( QString() );
+
+         return true;
+      }
+
+      QString  directory = inDirectory;
+
+      if ( directory.isEmpty() )
+         directory = QDir( QStandardPaths::writableLocation( QStandardPaths::AppDataLocation ) ).filePath( QStringLiteral( "Crash Reports" ) );
+
+      directory = QDir( directory ).absolutePath();
+
+      if ( !QDir().mkpath( directory ) ||
+           !openCrashSpool( QFile::encodeName( directory ).constData(), uint64_t( qMax( inMaxBytes, qint64( 0 ) ) ),
+                            uint32_t( qMax( inMaxFiles, 1 ) ) ) )
+      {
+         qWarning() << "YappariCrashReport: could not open the crash spool in" << directory;
+
+         // the spool that was open before is closed too
+         sSpoolDirectory.clear();
+         return false;
+      }
+
+      sSpoolDirectory = directory;
+
+      locker.unlock();
+
+      // the reports are written to the spool from now on
+      setReportDirectory( sSpoolDirectory );
+
+#ifdef YAPPARI_CRASH_UPLOADER
+      if ( sUploading )
+         startCrashUploads( sUploadEndpoint, sUploadOptions );
+#endif
+
+      return true;
+#else
+      Q_UNUSED( inEnabled )
+      Q_UNUSED( inMaxBytes )
+      Q_UNUSED( inMaxFiles )
+      Q_UNUSED( inDirectory )
+
+      return false;
+#endif
+   }
+
+   QVector<SpooledCrashReport>  pendingCrashReports()
+   {
+      QVector<SpooledCrashReport>   reports;
+
+#ifndef Q_OS_WIN
+      QMutexLocker   locker( &sSpoolMutex );
+
+      std::vector<SpoolEntry> entries( spoolEntryCount() );
+
+      const uint32_t cCount = copySpoolEntries( entries.data(), uint32_t( entries.size() ) );
+      const QDir  cDirectory( sSpoolDirectory );
+
+      for ( uint32_t i = 0; i < cCount; ++i )
+      {
+         const SpoolEntry  &cEntry = entries[i];
+
+         if ( cEntry.state != SPOOL_PENDING )
+            continue;
+
+         reports += SpooledCrashReport{ cEntry.sequence, cDirectory.filePath( QFile::decodeName( cEntry.fileName ) ),
+                                        (cEntry.signature != 0) ? QStringLiteral( "%1" ).arg( cEntry.signature, 16, 16, QLatin1Char( '0' ) )
+                                                                : QString(),
+                                        QDateTime::fromSecsSinceEpoch( cEntry.time ), qint64( cEntry.size ) };
+      }
+#endif
+
+      return reports;
+   }
+
+   bool  markCrashReportUploaded( quint64 inId )
+   {
+#ifndef Q_OS_WIN
+      QMutexLocker   locker( &sSpoolMutex );
+
+      return setSpoolEntryState( inId, SPOOL_UPLOADED );
+#else
+      Q_UNUSED( inId )
+
+      return false;
+#endif
+   }
+
+   bool  setCrashUploader( bool inEnabled, const QUrl &inEndpoint, const CrashUploadOptions &inOptions )
+   {
+#ifdef YAPPARI_CRASH_UPLOADER
+      sUploading = false;
+
+      if ( !inEnabled )
+      {
+         stopCrashUploads();
+         return true;
+      }
+
+      if ( sSpoolDirectory.isEmpty() )
+      {
+         qWarning() << "YappariCrashReport: the crash uploader needs a crash spool, see setCrashSpool()";
+         return false;
+      }
+
+      sUploading = true;
+      sUploadEndpoint = inEndpoint;
+      sUploadOptions = inOptions;
+
+      startCrashUploads( inEndpoint, inOptions );
+
+      return true;
+#else
+      Q_UNUSED( inEndpoint )
+      Q_UNUSED( inOptions )
+
+      if ( inEnabled )
+         qWarning() << "YappariCrashReport: the reports are only uploaded with CONFIG += yappari_crash_uploader";
+
+      return !inEnabled;
+#endif
+   }
+
+   void  setCrashHandlerProgram( const QString &inProgram, const QString &inReportDirectory, bool inShowDialog )
+   {
+#ifdef Q_OS_LINUX
+      sCrashHandlerProgram = inProgram;
+      sCrashHandlerArguments.clear();
+
+      if ( !inReportDirectory.isEmpty() )
+         sCrashHandlerArguments += QStringLiteral( "--report-dir=%1" ).arg( inReportDirectory );
+
+      if ( !inShowDialog )
+         sCrashHandlerArguments += QStringLiteral( "--no-dialog" );
+#else
+      Q_UNUSED( inProgram )
+      Q_UNUSED( inReportDirectory )
+      Q_UNUSED( inShowDialog )
+#endif
+   }
+
+   void  setMinidumpDirectory( const QString &inDirectory, int inStackBytes )
+   {
+#ifdef Q_OS_LINUX
+      sMinidumpDirectory = inDirectory;
+      sMinidumpStackBytes = qMax( inStackBytes, 0 );
+#else
+      Q_UNUSED( inDirectory )
+      Q_UNUSED( inStackBytes )
+#endif
+   }
+
+   void  setSymbolCache( const QString &inPath, int inMaxEntries )
+   {
+#ifdef Q_OS_LINUX
+      setSymbolCacheFile( inPath, qMax( inMaxEntries, 0 ) );
+#else
+      Q_UNUSED( inPath )
+      Q_UNUSED( inMaxEntries )
+#endif
+   }
+
+   void  setSymbolizationDeadline( int inMilliseconds )
+   {
+      setSymbolizeFramesDeadline( inMilliseconds );
+   }
+
+   bool  setThrowCapture( bool inEnabled )
+   {
+#ifdef Q_OS_LINUX
+      if ( enableThrowCapture( inEnabled ) )
+         return true;
+
+      qWarning() << "YappariCrashReport: uncaught exceptions are only captured with CONFIG += yappari_throw_capture";
+
+      return false;
+#else
+      return !inEnabled;
+#endif
+   }
+
+   void  setHangWatchdog( bool inEnabled, int inThresholdMs, bool inAllThreads )
+   {
+#ifdef Q_OS_LINUX
+      if ( inEnabled )
+         startHangWatchdog( inThresholdMs, inAllThreads, _reportHang );
+      else
+         stopHangWatchdog();
+#else
+      Q_UNUSED( inEnabled )
+      Q_UNUSED( inThresholdMs )
+      Q_UNUSED( inAllThreads )
+#endif
+   }
+
+   void  watchEventLoop()
+   {
+#ifdef Q_OS_LINUX
+      addWatchedEventLoop();
+#endif
+   }
+
+   bool  setSamplingProfiler( bool inEnabled, int inFrequencyHz )
+   {
+#ifdef Q_OS_LINUX
+      if ( !inEnabled )
+      {
+         stopProfiler();
+         return true;
+      }
+
+      if ( !startProfiler( inFrequencyHz ) )
+      {
+         qWarning() << "YappariCrashReport: the sampling profiler could not be started";
+         return false;
+      }
+
+      return true;
+#else
+      Q_UNUSED( inFrequencyHz )
+
+      return !inEnabled;
+#endif
+   }
+
+   QByteArray  samplingProfile( ProfileFormat inFormat )
+   {
+#ifdef Q_OS_LINUX
+      return (inFormat == PROFILE_PPROF) ? profilePprof() : profileFoldedStacks();
+#else
+      Q_UNUSED( inFormat )
+
+      return QByteArray();
+#endif
+   }
+
+   void  clearSamplingProfile()
+   {
+#ifdef Q_OS_LINUX
+      clearProfile();
+#endif
+   }
+
+   void  setAllThreadsCapture( bool inEnabled, int inTimeoutMs )
+   {
+#ifdef Q_OS_LINUX
+      sAllThreadsTimeoutMs = inEnabled ? qMax( inTimeoutMs, 0 ) : -1;
+#else
+      Q_UNUSED( inEnabled )
+      Q_UNUSED( inTimeoutMs )
+#endif
+   }
+
+   void  setStackUnwinder( StackUnwinder inUnwinder )
+   {
+#ifndef Q_OS_WIN
+      setUnwindMethod( (inUnwinder == FRAME_POINTER_UNWINDER) ? UNWIND_FRAME_POINTERS : UNWIND_DWARF );
+#else
+      Q_UNUSED( inUnwinder )
+#endif
+   }
+
+   void  addBreadcrumb( const char *inMessage )
+   {
+#ifndef Q_OS_WIN
+      if ( inMessage != nullptr )
+         writeBreadcrumb( inMessage, strnlen( inMessage, MAX_BREADCRUMB_SIZE ) );
+#else
+      Q_UNUSED( inMessage )
+#endif
+   }
+
+#ifndef Q_OS_WIN
+   // Encode a message as UTF-8 into a breadcrumb-sized buffer, dropping what doesn't fit
+   static size_t  _breadcrumbUtf8( const QString &inMessage, char *outBuffer, size_t inBufferSize )
+   {
+      const ushort   *cData = inMessage.utf16();
+      const int   cLength = inMessage.size();
+
+      size_t   size = 0;
+
+      for ( int i = 0; i < cLength; ++i )
+      {
+         uint32_t code = cData[i];
+
+         if ( QChar::isHighSurrogate( code ) && (i + 1) < cLength && QChar::isLowSurrogate( cData[i + 1] ) )
+            code = QChar::surrogateToUcs4( ushort( code ), cData[++i] );
+         else if ( QChar::isSurrogate( code ) )
+            code = QChar::ReplacementCharacter;
+
+         char  bytes[4];
+         size_t   byteCount;
+
+         if ( code < 0x80 )
+         {
+            bytes[0] = char( code );
+            byteCount = 1;
+         }
+         else if ( code < 0x800 )
+         {
+            bytes[0] = char( 0xc0 | (code >> 6) );
+            bytes[1] = char( 0x80 | (code & 0x3f) );
+            byteCount = 2;
+         }
+         else if ( code < 0x10000 )
+         {
+            bytes[0] = char( 0xe0 | (code >> 12) );
+            bytes[1] = char( 0x80 | ((code >> 6) & 0x3f) );
+            bytes[2] = char( 0x80 | (code & 0x3f) );
+            byteCount = 3;
+         }
+         else
+         {
+            bytes[0] = char( 0xf0 | (code >> 18) );
+            bytes[1] = char( 0x80 | ((code >> 12) & 0x3f) );
+            bytes[2] = char( 0x80 | ((code >> 6) & 0x3f) );
+            bytes[3] = char( 0x80 | (code & 0x3f) );
+            byteCount = 4;
+         }
+
+         // never split a character
+         if ( size + byteCount > inBufferSize )
+            break;
+
+         memcpy( outBuffer + size, bytes, byteCount );
+         size += byteCount;
+      }
+
+      return size;
+   }
+
+   static void  _breadcrumbMessageHandler( QtMsgType inType, const QMessageLogContext &inContext, const QString &inMessage )
+   {
+      // the type as a one letter prefix, like the "%{type}" of the message pattern but shorter
+      char  message[MAX_BREADCRUMB_SIZE];
+
+      switch ( inType )
+      {
+         case QtDebugMsg:     message[0] = 'D'; break;
+         case QtInfoMsg:      message[0] = 'I'; break;
+         case QtWarningMsg:   message[0] = 'W'; break;
+         case QtCriticalMsg:  message[0] = 'C'; break;
+         case QtFatalMsg:     message[0] = 'F'; break;
+         default:             message[0] = '?'; break;
+      }
+
+      message[1] = ' ';
+
+      const size_t   cSize = _breadcrumbUtf8( inMessage, message + 2, sizeof( message ) - 3 ) + 2;
+
+      writeBreadcrumb( message, cSize );
+
+      if ( sPreviousMessageHandler != nullptr )
+         sPreviousMessageHandler( inType, inContext, inMessage );
+   }
+#endif
+
+   void  addBreadcrumb( const QString &inMessage )
+   {
+#ifndef Q_OS_WIN
+      char  message[MAX_BREADCRUMB_SIZE];
+
+      writeBreadcrumb( message, _breadcrumbUtf8( inMessage, message, sizeof( message ) - 1 ) );
+#else
+      Q_UNUSED( inMessage )
+#endif
+   }
+
+   void  installBreadcrumbMessageHandler()
+   {
+#ifndef Q_OS_WIN
+      const QtMessageHandler  cPrevious = qInstallMessageHandler( _breadcrumbMessageHandler );
+
+      // installing it twice would make it call itself
+      if ( cPrevious != _breadcrumbMessageHandler )
+         sPreviousMessageHandler = cPrevious;
+#endif
+   }
+
+   int  runCrashHandler()
+   {
+#ifdef Q_OS_LINUX
+      return receiveCrashFromParentProcess();
+#else
+      return 1;
+#endif
    }
 }
@@ -31,20 +31,415 @@
 #ifndef YAPPARICRASHREPORT_H
 #define YAPPARICRASHREPORT_H
 
+#include <functional>
+
+#include <QByteArray>
+#include <QDateTime>
 #include <QString>
+#include <QStringList>
+#include <QUrl>
+#include <QVector>
+
+class QObject;
 
 
 namespace YappariCrashReport {
 
-   /// Function signature for a crash report callback, called after the user has seen the report
+   /// Function signature for a crash report callback, called after the report sink (if any) is done with the report
    /// @param inCrashReport The report including the stack trace as a QString
    using crashReportCallback = void (*)(const QString &);
 
+   /// Function signature for a report sink, the front end that shows or keeps the report of a crash
+   /// @param inFileName The name of the file the report would be saved to (see setReportDirectory())
+   /// @param inCrashReport The report including the stack trace as a QString
+   using crashReportSink = void (*)(const QString &inFileName, const QString &inCrashReport);
+
    /// Set a signal handler to capture stack trace to a log file.
    ///
-   /// @param inCrashReportCallback A callback function to call after we've shown the dialog to the user
+   /// Must be called after the QCoreApplication is created and named. Calls registerSignalHandler()
+   /// if it wasn't called yet.
+   ///
+   /// @param inCrashReportCallback A callback function to call after the report sink, e.g. after we've shown the dialog to the user
    void setSignalHandler( crashReportCallback inCrashReportCallback = nullptr );
 
+   /// Install the signal handlers as early as possible: at the top of main() before the QCoreApplication
+   /// exists, or even from a static initializer, so crashes during the startup are reported too.
+   ///
+   /// It only reserves the memory the crash is captured into, gives this thread an alternate signal stack
+   /// and calls sigaction() (SetUnhandledExceptionFilter() on Windows). The symbolizer, the module map
+   /// and the rest are set up the first time they are needed, at the latest when the application crashes.
+   /// Call setSignalHandler() afterwards, once the QCoreApplication exists, to add the application name
+   /// and version and the optional features; until then the program name is used.
+   ///
+   /// @param inCrashReportCallback A callback function to call after the report sink
+   void registerSignalHandler( crashReportCallback inCrashReportCallback = nullptr );
+
+   /// Set the front end the reports are handed to before the callback, nullptr for none.
+   ///
+   /// With YappariCrashReport.pri it is showCrashReportDialog(). With YappariCrashReportCore.pri, which only
+   /// needs QtCore, there is none: the reports only go to the report directory and the callback, so a daemon
+   /// never loads QtWidgets nor waits for a dialog nobody can see.
+   void setCrashReportSink( crashReportSink inSink );
+
+   /// Write every report to a directory, named as crashReportFileName(), before handing it to the sink
+   /// and the callback. Empty (the default) to not write them.
+   /// On Unix the report of a crash is streamed to its file while it is put together, and
+   /// without a report directory to a temporary file that is removed once the report is handed over.
+   void setReportDirectory( const QString &inDirectory );
+
+   /// The signature of the crash being reported, for the sink and the callback (Unix only, empty otherwise).
+   ///
+   /// It is the same every time the same bug crashes the same build: a hash of the signal, the faulting module
+   /// and offset and the top frames of the stack, never of addresses that change with ASLR. The reports show it
+   /// after the signal. With a report directory every signature is counted in its "Crash Signatures.index" and
+   /// only the first crash of a signature is written: the next ones bump its counter and are handed to the
+   /// sink with the name of the first report.
+   QString crashSignature();
+
+   /// How many times the crash being reported has occurred, this time included, as counted in the
+   /// report directory (1 without one). For the sink and the callback.
+   int crashOccurrences();
+
+   /// A report of the crash spool (see setCrashSpool())
+   struct SpooledCrashReport
+   {
+      quint64  id;         ///< Identifies the report in the spool
+      QString  filePath;   ///< The report file
+      QString  signature;  ///< See crashSignature(), empty for a hang report (see setHangWatchdog())
+      QDateTime   time;    ///< When the application crashed or hung
+      qint64   size;       ///< The size of the report file
+   };
+
+   /// Keep the reports in a bounded spool directory (Unix only).
+   ///
+   /// The spool directory becomes the report directory (see setReportDirectory()), and every report written
+   /// there is added to the index of the spool, a file of fixed layout mapped in memory with the signature,
+   /// time, size and upload state of each report. Adding a report to the index takes constant time and is done
+   /// by the signal handler itself. Once the spool has inMaxFiles reports, or they add up to more than
+   /// inMaxBytes, the oldest ones are removed to make room for the new one.
+   /// Must be called after the QCoreApplication is created and named, and before setSignalHandler() if there
+   /// is a crash handler process (see setCrashHandlerProgram()), which then adds its reports to the spool too.
+   ///
+   /// @param inEnabled Whether to keep the reports in the spool
+   /// @param inMaxBytes The most the reports of the spool can add up to
+   /// @param inMaxFiles The most reports the spool keeps
+   /// @param inDirectory The spool directory, empty for "Crash Reports" in QStandardPaths::AppDataLocation
+   /// @return false if the spool couldn't be opened
+   bool setCrashSpool( bool inEnabled, qint64 inMaxBytes = 10 * 1024 * 1024, int inMaxFiles = 50,
+                       const QString &inDirectory = QString() );
+
+   /// The reports of the spool that weren't uploaded yet, oldest first. They are read from the index of the
+   /// spool, not from the directory, so it is cheap enough for the startup of the application.
+   QVector<SpooledCrashReport> pendingCrashReports();
+
+   /// Record in the index of the spool that a report was uploaded, so it isn't pending anymore
+   /// @return false if the report isn't in the spool anymore
+   bool markCrashReportUploaded( quint64 inId );
+
+   /// How setCrashUploader() sends the reports of the spool
+   struct CrashUploadOptions
+   {
+      int   startDelayMs = 30000;      ///< How long to wait after the start, to stay out of the way of the application's own startup
+      int   batchSize = 10;            ///< The most reports per request
+      int   maxBatchBytes = 1024 * 1024;  ///< The most the reports of a request add up to before compression (a bigger report goes on its own)
+      int   minIntervalMs = 10000;     ///< The least time between two requests
+      int   retryDelayMs = 60000;      ///< How long to wait after a failed request, doubled after every failure in a row
+      int   maxRetryDelayMs = 3600000; ///< The longest wait after a failure
+      int   rescanIntervalMs = 60000;  ///< How often to look for new reports (e.g. hang reports) once none is pending
+   };
+
+   /// Upload the pending reports of the crash spool to an HTTP(S) endpoint in the background (Unix only).
+   ///
+   /// An idle priority thread (with the idle I/O class on Linux) waits inOptions.startDelayMs, and then POSTs
+   /// the pending reports (see pendingCrashReports()) in batches: a JSON array with an object for each report
+   /// ("signature", "time", "fileName", "application", "version" and "report"), compressed with qCompress()
+   /// and sent as "Content-Encoding: deflate". The reports of a batch answered with 2xx are marked as uploaded;
+   /// after a network error, 408, 429 or 5xx the batch is sent again later with exponential backoff (or
+   /// after Retry-After), and a batch refused with any other 4xx is marked as uploaded so it doesn't block the
+   /// rest. Once nothing is pending the thread looks for new reports every inOptions.rescanIntervalMs, and
+   /// it stops when the application quits.
+   /// Needs the library built with CONFIG += yappari_crash_uploader, which adds QtNetwork.
+   /// Call it after setCrashSpool(). Opening the spool again stops the uploads while it is reopened and then
+   /// starts them over, and closing it stops them.
+   ///
+   /// @param inEnabled Whether to upload the reports
+   /// @param inEndpoint The URL the batches are posted to
+   /// @param inOptions How the batches are sent
+   /// @return false if there is no spool or the library was built without yappari_crash_uploader
+   bool setCrashUploader( bool inEnabled, const QUrl &inEndpoint = QUrl(), const CrashUploadOptions &inOptions = CrashUploadOptions() );
+
+#ifdef YAPPARI_CRASH_REPORT_DIALOG
+   /// The crash report dialog as a report sink (the default one with YappariCrashReport.pri).
+   /// Does nothing if the application has no QApplication.
+   void showCrashReportDialog( const QString &inFileName, const QString &inCrashReport );
+#endif
+
+   /// Leave a breadcrumb: a short message that is included in the report if the application crashes (Unix only).
+   ///
+   /// The reports list the last 256 breadcrumbs of all the threads in the order they were left, with the
+   /// thread id and the time before the crash. Every thread writes to its own ring buffer, so a breadcrumb
+   /// takes no lock and never allocates: it costs a few nanoseconds and can be left from hot paths.
+   /// Messages are truncated to 111 bytes. Can be called at any time, even before registerSignalHandler().
+   ///
+   /// @param inMessage The message, as UTF-8
+   void addBreadcrumb( const char *inMessage );
+
+   /// Leave a breadcrumb, converting the message to UTF-8 without allocating (see addBreadcrumb( const char * )).
+   void addBreadcrumb( const QString &inMessage );
+
+   /// Leave a breadcrumb for every qDebug(), qInfo(), qWarning() and qCritical() message (Unix only).
+   ///
+   /// Installs a message handler that leaves the message as a breadcrumb and then hands it to the
+   /// message handler that was installed before, so the messages are still printed or logged as usual.
+   void installBreadcrumbMessageHandler();
+
+   /// Hand the crashes over to a crash handler process (Linux only).
+   ///
+   /// setSignalHandler() starts the crash handler program right away. When the application crashes
+   /// the signal handler only sends the raw crash record to it and exits, so the crashed process goes
+   /// away in milliseconds. The crash handler symbolizes the stack trace, writes the report and shows
+   /// the crash report dialog. The crash report callback is not called in this mode.
+   /// Must be called before setSignalHandler().
+   ///
+   /// @param inProgram The path of the crash handler program, which calls runCrashHandler()
+   /// @param inReportDirectory The directory the crash handler writes the reports to, or empty to not write them
+   /// @param inShowDialog Whether the crash handler shows the crash report dialog
+   void setCrashHandlerProgram( const QString &inProgram, const QString &inReportDirectory = QString(), bool inShowDialog = true );
+
+   /// Capture the stacks of all the threads when the application crashes, not just the one that crashed (Linux only).
+   ///
+   /// The crashed thread sends a real-time signal to every other thread and each thread captures its own
+   /// stack. The report lists every thread with its id and name, marking the one that crashed.
+   /// Must be called before setSignalHandler().
+   ///
+   /// @param inEnabled Whether to capture all the threads
+   /// @param inTimeoutMs How long to wait for the threads to answer, the others are reported without a stack
+   void setAllThreadsCapture( bool inEnabled, int inTimeoutMs = 250 );
+
+   /// The ways the stacks of a crash can be unwound (see setStackUnwinder())
+   enum StackUnwinder
+   {
+      DWARF_UNWINDER,            ///< The call frame information of the modules, works with any code
+      FRAME_POINTER_UNWINDER,    ///< The chain of frame pointers, many times faster but only complete if everything was built with them
+   };
+
+   /// Choose how the signal handler unwinds the crashed thread (Unix only, DWARF_UNWINDER by default).
+   ///
+   /// Either way the stack starts at the instruction that crashed, without the frames of the handler.
+   /// The frame-pointer unwinder checks every frame against the bounds of the thread's stack, so a function
+   /// built without frame pointers (-fomit-frame-pointer, the default of most optimized builds) cuts the
+   /// stack short instead of crashing the handler. On Linux the threads created before registerSignalHandler() or
+   /// setSignalHandler() (other than the one that calls it) are always unwound with the DWARF unwinder.
+   /// The other threads of a report (see setAllThreadsCapture()) and captureThreadStackTrace() always walk
+   /// the frame pointers: they are interrupted wherever they are, and the DWARF unwinder isn't safe to interrupt.
+   ///
+   /// @param inUnwinder The unwinder to use
+   void setStackUnwinder( StackUnwinder inUnwinder );
+
+   /// Report uncaught C++ exceptions with the stack they were thrown from (Linux only).
+   ///
+   /// Without it the report of an uncaught exception only shows std::terminate() and abort(). With it every
+   /// throw records its stack in a fixed buffer of the thread by walking the frame pointers, tens of
+   /// nanoseconds, and a terminate handler adds the type of the exception, its what() and that stack to the
+   /// report. The terminate handler installed before is still called afterwards.
+   /// Needs the library built with CONFIG += yappari_throw_capture, which replaces __cxa_throw() (and
+   /// a shared libstdc++); without it throwing costs nothing extra and this does nothing.
+   /// Call it after registerSignalHandler() or setSignalHandler().
+   ///
+   /// @param inEnabled Whether to record the throws
+   /// @return false if the library was built without yappari_throw_capture
+   bool setThrowCapture( bool inEnabled );
+
+   /// Watch the event loops for hangs and deadlocks (Linux only).
+   ///
+   /// A watchdog thread posts a heartbeat to the main event loop every quarter of the threshold. When a
+   /// heartbeat hasn't run after the threshold the loop is hung: the watchdog captures the stack of its
+   /// thread, or of every thread, with the signal the all-threads capture uses (see captureThreadStackTrace()),
+   /// and writes a hang report to the report directory ("<date> <application> Hang.log", added to the crash
+   /// spool if it is the report directory) and hands it to the callback, from the watchdog thread. The
+   /// report sink is not used, since a dialog would need the hung loop. The process keeps running, and
+   /// every hang is reported once.
+   /// Must be called after the QCoreApplication is created. The watchdog stops when the application quits.
+   ///
+   /// @param inEnabled Whether to watch the event loops
+   /// @param inThresholdMs How long a loop can be busy before it is reported
+   /// @param inAllThreads Whether to capture every thread instead of just the hung one
+   void setHangWatchdog( bool inEnabled, int inThresholdMs = 5000, bool inAllThreads = false );
+
+   /// Have the watchdog watch the event loop of the calling thread too (see setHangWatchdog()), until the
+   /// thread finishes. Call it from the thread, e.g. from a slot connected to QThread::started (Linux only).
+   void watchEventLoop();
+
+   /// The formats of samplingProfile()
+   enum ProfileFormat
+   {
+      PROFILE_FOLDED_STACKS,  ///< One line per stack, "outer;inner count", the input of flamegraph.pl
+      PROFILE_PPROF,          ///< An uncompressed profile.proto for pprof, with the samples and CPU time of each stack
+   };
+
+   /// Sample the stacks of every thread to find out where the CPU time goes (Linux only).
+   ///
+   /// Every thread gets a timer on its own CPU clock that interrupts it with SIGPROF. The handler walks
+   /// the frame pointers whatever setStackUnwinder() chose, since the signal can interrupt the DWARF
+   /// unwinder itself, into a ring buffer of the thread, without locks or allocations. A low priority thread counts the samples of identical stacks and picks up the threads
+   /// started since, once a second. At 100 Hz it costs well under 1% of the CPU time of the threads.
+   /// Can be turned on and off at any time, the samples add up until clearSamplingProfile().
+   ///
+   /// @param inEnabled Whether to sample
+   /// @param inFrequencyHz The samples per second of CPU time of each thread
+   /// @return false if the profiler could not be started
+   bool setSamplingProfiler( bool inEnabled, int inFrequencyHz = 100 );
+
+   /// The samples of the profiler so far, symbolized (Linux only, empty elsewhere)
+   QByteArray samplingProfile( ProfileFormat inFormat = PROFILE_FOLDED_STACKS );
+
+   /// Forget the samples of the profiler
+   void clearSamplingProfile();
+
+   /// Write a minidump of every crash to a directory (Linux only).
+   ///
+   /// A minidump is a compact binary record of the crash written straight from the signal handler:
+   /// the signal, the registers, the raw stacks of the threads and the modules they go through with
+   /// their build-ids. It is only a few KB and it is symbolized later, on any machine that has the
+   /// binaries or their debug files, with the YappariMinidump tool (as a text report or as JSON).
+   /// Must be called before setSignalHandler().
+   ///
+   /// @param inDirectory The directory to write the minidumps to (<time>-<pid>.ycrd), empty to not write them
+   /// @param inStackBytes How many bytes of the crashed thread's stack to include (up to 64 KiB), 0 for none
+   void setMinidumpDirectory( const QString &inDirectory, int inStackBytes = 0 );
+
+   /// Set where the symbolized addresses are kept between runs (Linux only).
+   ///
+   /// Reports and converted minidumps look up every frame by module build-id and offset in a small
+   /// memory mapped cache file before reading the debug information, so the call sites seen before
+   /// resolve in well under a microsecond. The least recently used entries are dropped when it is full.
+   /// The default is symbols.cache in QStandardPaths::CacheLocation with 8192 entries.
+   /// Must be called before the first report.
+   ///
+   /// @param inPath The cache file, empty for the default one
+   /// @param inMaxEntries How many addresses the cache holds (384 bytes each), 0 to not use a cache
+   void setSymbolCache( const QString &inPath, int inMaxEntries = 8192 );
+
+   /// Set how long the symbolization of a report can take at most (10 s by default).
+   ///
+   /// The modules of the stacks are symbolized by a few threads at once against a single deadline, so
+   /// a module with broken debug information or an address mapping tool that hangs can't hold the crash
+   /// up. The frames that aren't resolved in time are reported with their module and offset, e.g.
+   /// "?? (+0x1a2b3)", which can be symbolized later with addr2line.
+   ///
+   /// @param inMilliseconds The time limit, 0 for none
+   void setSymbolizationDeadline( int inMilliseconds );
+
+   /// Set the size of the alternate signal stacks the signal handler runs on (512 KiB by default).
+   ///
+   /// Every thread gets its own alternate signal stack with a guard page, so a stack overflow can still
+   /// be reported and threads that crash together don't share a stack. The thread calling setSignalHandler()
+   /// and, on Linux, every thread started afterwards with pthread_create() (QThread, std::thread) get one
+   /// automatically. The stacks come from a pool, so starting threads stays cheap.
+   /// Must be called before setSignalHandler().
+   void setAlternateStackSize( size_t inSize );
+
+   /// Give the current thread its own alternate signal stack for as long as the object lives.
+   ///
+   /// Only needed for the threads that don't get one automatically (see setAlternateStackSize()),
+   /// e.g. threads started before setSignalHandler(). Does nothing if the thread already has one.
+   class AlternateSignalStack
+   {
+      public:
+         AlternateSignalStack();
+         ~AlternateSignalStack();
+
+         AlternateSignalStack( const AlternateSignalStack & ) = delete;
+         AlternateSignalStack &operator=( const AlternateSignalStack & ) = delete;
+
+      private:
+         void  *mStack = nullptr;
+   };
+
+   struct InternedStack;
+
+   /// A stack trace of the running process (see captureStackTrace()).
+   ///
+   /// It only refers to a stack interned in a table shared by the whole process: capturing the same
+   /// stack again gives an equal StackTrace, and every frame is kept once however many stacks go through
+   /// it, so keeping thousands of them costs little more than a pointer each. Copying it only counts one more
+   /// reference to the stack: once the table is full, it frees the oldest stacks no StackTrace refers to.
+   /// The frames are only symbolized when asked for, see symbolizeStackTrace().
+   class StackTrace
+   {
+      public:
+         StackTrace() = default;
+
+         /// Used by the library to hand out the stacks it interned, taking over the reference of the table
+         explicit StackTrace( const InternedStack *inStack ) :
+            mStack( inStack )
+         {
+         }
+
+         StackTrace( const StackTrace &inOther );
+         StackTrace &operator=( const StackTrace &inOther );
+         ~StackTrace();
+
+         bool isEmpty() const { return mStack == nullptr; }
+
+         /// The number of frames
+         int size() const;
+
+         /// The return address of a frame, innermost first (the first frame is the exact program counter
+         /// of a thread captured with captureThreadStackTrace())
+         quintptr frame( int inIndex ) const;
+
+         /// The frame addresses, innermost first
+         QVector<quintptr> frames() const;
+
+         /// A number that identifies the stack in this process: equal stacks have the same id, 0 if empty
+         quint32 id() const;
+
+         bool operator==( const StackTrace &inOther ) const { return mStack == inOther.mStack; }
+         bool operator!=( const StackTrace &inOther ) const { return mStack != inOther.mStack; }
+
+      private:
+         friend QStringList symbolizeStackTrace( const StackTrace &inStackTrace );
+
+         const InternedStack  *mStack = nullptr;
+   };
+
+   /// Capture the stack of the calling thread without disturbing the process (Linux only).
+   ///
+   /// Meant for live diagnostics such as logging where slow requests spend their time: it only unwinds
+   /// the stack and interns it, a few microseconds, and nothing is symbolized until it is needed.
+   /// @param inSkipFrames How many frames to leave out besides captureStackTrace() itself, e.g. a logging helper
+   StackTrace captureStackTrace( int inSkipFrames = 0 );
+
+   /// Capture the stack of another thread of the process while it keeps running (Linux only).
+   ///
+   /// The thread is interrupted by the same real-time signal the all-threads capture uses (see
+   /// setAllThreadsCapture()) and unwinds its own stack from the instruction it was running.
+   /// One thread is captured at a time, so concurrent callers wait for each other.
+   /// @param inThreadId The thread id as the reports show it (gettid()), see currentThreadId()
+   /// @param inTimeoutMs How long to wait for a thread that blocks the signal or is stopped
+   /// @return The stack of the thread, empty if it didn't answer in time or doesn't exist
+   StackTrace captureThreadStackTrace( qint64 inThreadId, int inTimeoutMs = 100 );
+
+   /// The id of the calling thread as the reports and captureThreadStackTrace() use it (gettid() on Linux)
+   qint64 currentThreadId();
+
+   /// Symbolize a stack trace into the lines the reports use for their stack traces (Linux only).
+   /// Every frame is only symbolized once and the result is shared with all the other stacks.
+   QStringList symbolizeStackTrace( const StackTrace &inStackTrace );
+
+   /// Symbolize a stack trace in a background thread (see symbolizeStackTrace()).
+   /// @param inContext The object whose thread the callback is called in, nullptr to call it from the background thread.
+   ///                  The callback is not called if the object is destroyed first.
+   /// @param inCallback Receives the lines of the stack trace
+   void symbolizeStackTrace( const StackTrace &inStackTrace, QObject *inContext,
+                             std::function<void (const QStringList &)> inCallback );
+
+   /// Run the crash handler: wait for the application that started it to crash and report the crash.
+   /// This is all the main() of the crash handler program does after creating its QApplication.
+   /// @return The exit code of the crash handler program
+   int runCrashHandler();
+
 }
 
 #endif
@@ -0,0 +1,25 @@
+message( "Building benchmark" )
+
+TARGET = YappariCrashReportBenchmark
+TEMPLATE = app
+
+CONFIG += console c++14
+
+!linux {
+    error( The benchmark only runs on Linux. )
+}
+
+QT -= gui
+
+# --throws measures the throw capture
+CONFIG += yappari_throw_capture
+
+if ( !include( ../YappariCrashReportCore.pri ) ) {
+    error( Could not find the YappariCrashReportCore.pri file. )
+}
+
+SOURCES += \
+    benchmark.cpp
+
+HEADERS += \
+    crashtest.h
@@ -8,6 +8,12 @@ CONFIG += c++14
 
 QT += widgets
 
+# report uncaught exceptions with their throw stack
+linux:CONFIG += yappari_throw_capture
+
+# upload the spooled reports, --upload-test tries it against a local stand-in for the server
+unix:CONFIG += yappari_crash_uploader
+
 if ( !include( ../YappariCrashReport.pri ) ) {
     error( Could not find the YappariCrashReport.pri file. )
 }
@@ -20,4 +26,10 @@ FORMS += \
     choosecrashdialog.ui
 
 HEADERS += \
-    choosecrashdialog.h
+    choosecrashdialog.h \
+    crashtest.h
+
+contains( DEFINES, YAPPARI_CRASH_UPLOADER ) {
+    SOURCES += uploadtest.cpp
+    HEADERS += uploadtest.h
+}
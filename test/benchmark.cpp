@@ -0,0 +1,825 @@
+/*
+ * Copyright (C) 2020 Naikel Aparicio. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ''AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the author and should not be interpreted as representing
+ * official policies, either expressed or implied, of the copyright holder.
+ */
+
+// Crash path benchmark (Linux only).
+//
+// Every sample is a child process that loads some extra modules, goes down a number of frames and
+// crashes in one of the ways of crashTest. Its signal handler goes through the same stages as an
+// in-process report and times each of them: capture, unwind, symbolize, format & write. The parent
+// runs every combination of crash, stack depth and module count and writes the timings as JSON (or
+// every sample as CSV), so they can be compared between builds.
+//
+//    YappariCrashReportBenchmark --runs 20 --depths 0,16,48 --modules 0,8,32 > benchmark.json
+//
+// Every combination runs with each unwinder of --unwinders, so the unwind stage of the DWARF and the
+// frame-pointer unwinders can be compared on the same stacks.
+//
+//    YappariCrashReportBenchmark --crashes 0 --depths 0,48 --modules 0 --unwinders dwarf,frame-pointers
+//
+// With --startup it measures what the crash reporting costs a program that doesn't crash instead:
+// registerSignalHandler() at the top of main() and setSignalHandler() once the QCoreApplication exists.
+//
+//    YappariCrashReportBenchmark --startup --runs 100 > startup.json
+//
+// With --profiler it measures what the sampling profiler costs a busy thread: the same CPU work is
+// timed with the profiler off and on, alternately, and the difference is the overhead.
+//
+//    YappariCrashReportBenchmark --profiler --frequency 100 --runs 20 > profiler.json
+//
+// With --throws it measures what recording the stack of every throw costs (see setThrowCapture()):
+// the same exceptions are thrown and caught with the capture off and on.
+//
+//    YappariCrashReportBenchmark --throws --runs 20 > throws.json
+
+#include <algorithm>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+#include <dlfcn.h>
+#include <err.h>
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLibraryInfo>
+#include <QProcess>
+#include <QTemporaryDir>
+#include <QTextStream>
+
+#include "crashtest.h"
+
+#ifdef YAPPARI_CRASH_REPORT
+#include "AlternateStack.h"
+#include "CrashArena.h"
+#include "CrashReport.h"
+#include "ModuleMap.h"
+#include "SymbolCache.h"
+#include "Symbolizer.h"
+#include "Unwinder.h"
+#include "YappariCrashReport.h"
+
+using namespace YappariCrashReport;
+#endif
+
+
+#ifdef YAPPARI_CRASH_REPORT
+// the stages of the crash path, in the order they happen
+static const char *const   sStages[] = { "capture", "unwind", "symbolize", "format", "write", "total" };
+static const int  sStageCount = int( sizeof( sStages ) / sizeof( sStages[0] ) );
+
+static QString sReportPath;   // where the child writes its report
+
+
+// The child's signal handler: the stages of the in-process report, timed
+static void  _benchmarkSignalHandler( int inSig, siginfo_t *inSigInfo, void *inContext )
+{
+   captureCrash( inSig, inSigInfo, inContext );
+
+   const CrashRecord &cRecord = *crashRecord();
+
+   const uint64_t cSymbolizeStart = monotonicNanoseconds();
+
+   const QVector<StackFrameList> cStacks = crashRecordStacks( cRecord );
+
+   const uint64_t cFormatStart = monotonicNanoseconds();
+
+   const QString  cReport = crashRecordReport( cRecord, cStacks );
+
+   const uint64_t cWriteStart = monotonicNanoseconds();
+
+   QFile file( sReportPath );
+
+   if ( file.open( QIODevice::WriteOnly | QIODevice::Text ) )
+   {
+      QTextStream stream( &file );
+
+      stream << cReport << endl;
+   }
+
+   file.close();
+
+   const uint64_t cWriteEnd = monotonicNanoseconds();
+
+   const uint64_t cCaptureNs = cRecord.captureEndNs - cRecord.captureStartNs;
+
+   const QJsonObject cSample{
+      { "signal", cRecord.signal },
+      { "frames", cStacks.isEmpty() ? 0 : cStacks.at( 0 ).size() },
+      { "modules", int( cRecord.moduleCount ) },
+      { "capture", double( cCaptureNs - cRecord.unwindNs ) },
+      { "unwind", double( cRecord.unwindNs ) },
+      { "symbolize", double( cFormatStart - cSymbolizeStart ) },
+      { "format", double( cWriteStart - cFormatStart ) },
+      { "write", double( cWriteEnd - cWriteStart ) },
+      { "total", double( cWriteEnd - cRecord.captureStartNs ) },
+   };
+
+   const QByteArray  cLine = QJsonDocument( cSample ).toJson( QJsonDocument::Compact ) + '\n';
+
+   fwrite( cLine.constData(), 1, size_t( cLine.size() ), stdout );
+   fflush( stdout );
+
+   _Exit( 1 );
+}
+
+// Go down inDepth frames before crashing
+static int  _crashAtDepth( int inDepth, int inCrashType ) __attribute__ ((noinline));
+static int  _crashAtDepth( int inDepth, int inCrashType )
+{
+   if ( inDepth <= 0 )
+   {
+      crashTest   test;
+
+      return test.crash( inCrashType ) ? 1 : 0;
+   }
+
+   // not a tail call, so every level keeps its frame
+   return _crashAtDepth( inDepth - 1, inCrashType ) + 1;
+}
+
+// Load up to inCount Qt libraries that aren't loaded yet, to grow the module map
+static int  _loadModules( int inCount )
+{
+   const QDir  cDirectory( QLibraryInfo::location( QLibraryInfo::LibrariesPath ) );
+   const QStringList cLibraries = cDirectory.entryList( { QStringLiteral( "libQt%1*.so.%1" ).arg( QT_VERSION_MAJOR ) },
+                                                        QDir::Files, QDir::Name );
+
+   int   loaded = 0;
+
+   for ( const QString &library : cLibraries )
+   {
+      if ( loaded >= inCount )
+         break;
+
+      const QByteArray  cPath = QFile::encodeName( cDirectory.filePath( library ) );
+
+      if ( dlopen( cPath.constData(), RTLD_LAZY | RTLD_LOCAL | RTLD_NOLOAD ) != nullptr )
+         continue;
+
+      if ( dlopen( cPath.constData(), RTLD_LAZY | RTLD_LOCAL ) != nullptr )
+         ++loaded;
+   }
+
+   return loaded;
+}
+
+// The unwind method of an --unwinders name, -1 if there is none
+static int  _unwindMethod( const QString &inName )
+{
+   if ( inName == QLatin1String( "dwarf" ) )
+      return UNWIND_DWARF;
+
+   if ( inName == QLatin1String( "frame-pointers" ) )
+      return UNWIND_FRAME_POINTERS;
+
+   return -1;
+}
+
+// Set up the crash path like setSignalHandler() does and crash
+static int  _runChild( int inCrashType, int inDepth, int inExtraModules, int inUnwindMethod, const QString &inSymbolCache )
+{
+   if ( !reserveCrashArena() || !prepareModuleMap() )
+   {
+      err( 1, "mmap" );
+   }
+
+   setCrashApplication( QCoreApplication::applicationName().toLocal8Bit().constData(),
+                        QCoreApplication::applicationVersion().toLocal8Bit().constData(),
+                        QCoreApplication::applicationFilePath().toLocal8Bit().constData() );
+
+   if ( _loadModules( inExtraModules ) < inExtraModules )
+      qWarning() << "YappariCrashReportBenchmark: could not load" << inExtraModules << "extra modules";
+
+   refreshModuleMap();
+
+   // without a cache every sample symbolizes cold, like the first crash of a build
+   setSymbolCacheFile( inSymbolCache, inSymbolCache.isEmpty() ? 0 : int( SymbolCache::DEFAULT_ENTRY_COUNT ) );
+   prepareSymbolizer();
+
+   installAlternateStack();
+
+   setUnwindMethod( UnwindMethod( qMax( inUnwindMethod, 0 ) ) );
+
+   struct sigaction sigAction;
+
+   sigAction.sa_sigaction = _benchmarkSignalHandler;
+
+   sigemptyset( &sigAction.sa_mask );
+
+   sigAction.sa_flags = SA_SIGINFO | SA_ONSTACK;
+
+   for ( int signalNumber : { SIGSEGV, SIGFPE, SIGILL, SIGABRT, SIGBUS } )
+   {
+      if ( sigaction( signalNumber, &sigAction, nullptr ) != 0 ) { err( 1, "sigaction" ); }
+   }
+
+   _crashAtDepth( inDepth, inCrashType );
+
+   qWarning() << "YappariCrashReportBenchmark: crash type" << inCrashType << "didn't crash";
+
+   return 2;
+}
+
+// Register the crash reporting the cheapest way, then the usual way, and tell how long each took
+static int  _runStartupChild( int argc, char **argv )
+{
+   const uint64_t cRegisterStart = monotonicNanoseconds();
+
+   registerSignalHandler();
+
+   const uint64_t cRegisterEnd = monotonicNanoseconds();
+
+   QCoreApplication  app( argc, argv );
+
+   app.setApplicationName( QStringLiteral( "YappariCrashReportBenchmark" ) );
+   app.setApplicationVersion( QStringLiteral( "1.0.0" ) );
+
+   const uint64_t cSetupStart = monotonicNanoseconds();
+
+   setSignalHandler();
+
+   const uint64_t cSetupEnd = monotonicNanoseconds();
+
+   const QJsonObject cSample{
+      { "register", double( cRegisterEnd - cRegisterStart ) },
+      { "setSignalHandler", double( cSetupEnd - cSetupStart ) },
+   };
+
+   QTextStream( stdout ) << QJsonDocument( cSample ).toJson( QJsonDocument::Compact ) << endl;
+
+   return 0;
+}
+
+// Parse a comma separated list of numbers
+static QVector<int>  _numberList( const QString &inList )
+{
+   QVector<int>   numbers;
+
+   for ( const QString &number : inList.split( ',', QString::SkipEmptyParts ) )
+   {
+      bool  ok = false;
+      const int   cNumber = number.trimmed().toInt( &ok );
+
+      if ( ok && cNumber >= 0 )
+         numbers += cNumber;
+   }
+
+   return numbers;
+}
+
+// Run a child and read the timings it writes, an empty object if it wrote none
+static QJsonObject  _runChildProcess( const QStringList &inArguments, QByteArray &outErrors )
+{
+   QProcess child;
+
+   child.start( QCoreApplication::applicationFilePath(), inArguments );
+
+   if ( !child.waitForFinished( 60000 ) )
+   {
+      child.kill();
+      child.waitForFinished();
+
+      return QJsonObject();
+   }
+
+   const QList<QByteArray> cLines = child.readAllStandardOutput().split( '\n' );
+
+   QJsonObject sample;
+
+   for ( const QByteArray &line : cLines )
+   {
+      const QJsonDocument  cDocument = QJsonDocument::fromJson( line );
+
+      if ( cDocument.isObject() )
+         sample = cDocument.object();
+   }
+
+   outErrors = child.readAllStandardError().right( 1024 );
+
+   return sample;
+}
+
+// Run one crashing child and read its timings, an empty object if it didn't write a report
+static QJsonObject  _runSample( const QStringList &inArguments, const QString &inReportPath )
+{
+   QFile::remove( inReportPath );
+
+   QByteArray  errors;
+
+   const QJsonObject cSample = _runChildProcess( inArguments + QStringList{ QStringLiteral( "--report" ), inReportPath }, errors );
+
+   // a sample only counts if the report made it to the file
+   if ( cSample.isEmpty() || QFileInfo( inReportPath ).size() == 0 )
+   {
+      qWarning().noquote() << "YappariCrashReportBenchmark: no report from" << inArguments.join( ' ' ) << '\n' << errors;
+
+      return QJsonObject();
+   }
+
+   return cSample;
+}
+
+// min, median, 90th percentile & max of a stage
+static QJsonObject  _statistics( QVector<double> ioValues )
+{
+   if ( ioValues.isEmpty() )
+      return QJsonObject();
+
+   std::sort( ioValues.begin(), ioValues.end() );
+
+   const auto  cPercentile = [&ioValues] ( int inPercent ) {
+      return ioValues.at( ((ioValues.size() - 1) * inPercent) / 100 );
+   };
+
+   return QJsonObject{
+      { "min", ioValues.first() },
+      { "median", cPercentile( 50 ) },
+      { "p90", cPercentile( 90 ) },
+      { "max", ioValues.last() },
+   };
+}
+
+// The CPU work the profiler samples, a few frames deep so the profile has stacks to tell apart
+static double  _profilerLeaf( int inIterations ) __attribute__ ((noinline));
+static double  _profilerLeaf( int inIterations )
+{
+   volatile double   sum = 0;
+
+   for ( int i = 0; i < inIterations; ++i )
+      sum = sum + double( i ) / double( i + 1 );
+
+   return sum;
+}
+
+static double  _profilerBranch( int inIterations ) __attribute__ ((noinline));
+static double  _profilerBranch( int inIterations )
+{
+   return _profilerLeaf( inIterations );
+}
+
+static double  _profilerWorkload( int inIterations ) __attribute__ ((noinline));
+static double  _profilerWorkload( int inIterations )
+{
+   // two thirds straight from here, one third through another frame
+   return _profilerLeaf( (inIterations / 3) * 2 ) + _profilerBranch( inIterations / 3 );
+}
+
+// Time the same work with the profiler off and on and tell the difference
+static int  _runProfilerBenchmark( int inRuns, int inFrequencyHz, bool inCsv )
+{
+   const int   cIterations = 20000000;
+
+   QTextStream out( stdout );
+
+   QVector<double>   values[2];
+
+   if ( inCsv )
+      out << "baselineNs,profiledNs" << endl;
+
+   // once to warm up
+   _profilerWorkload( cIterations );
+
+   clearSamplingProfile();
+
+   for ( int run = 0; run < inRuns; ++run )
+   {
+      for ( int profiled = 0; profiled < 2; ++profiled )
+      {
+         if ( profiled && !setSamplingProfiler( true, inFrequencyHz ) )
+            return 1;
+
+         const uint64_t cStart = monotonicNanoseconds();
+
+         _profilerWorkload( cIterations );
+
+         values[profiled] += double( monotonicNanoseconds() - cStart );
+
+         if ( profiled )
+            setSamplingProfiler( false );
+      }
+
+      if ( inCsv )
+         out << qint64( values[0].last() ) << ',' << qint64( values[1].last() ) << endl;
+   }
+
+   const QByteArray  cProfile = samplingProfile( PROFILE_FOLDED_STACKS );
+
+   qint64   samples = 0;
+
+   for ( const QByteArray &cLine : cProfile.split( '\n' ) )
+      samples += cLine.mid( cLine.lastIndexOf( ' ' ) + 1 ).toLongLong();
+
+   const QJsonObject cBaseline = _statistics( values[0] );
+   const QJsonObject cProfiled = _statistics( values[1] );
+   const double   cOverhead = 100 * (cProfiled.value( "median" ).toDouble() / cBaseline.value( "median" ).toDouble() - 1);
+
+   qInfo().noquote() << QStringLiteral( "%1 samples at %2 Hz, %3% overhead (median)" )
+                        .arg( samples ).arg( inFrequencyHz ).arg( cOverhead, 0, 'f', 2 );
+
+   if ( !inCsv )
+   {
+      const QJsonObject cDocument{
+         { "application", QCoreApplication::applicationName() },
+         { "version", QCoreApplication::applicationVersion() },
+         { "unit", "ns" },
+         { "runs", inRuns },
+         { "frequency", inFrequencyHz },
+         { "samples", samples },
+         { "baseline", cBaseline },
+         { "profiled", cProfiled },
+         { "overheadPercent", cOverhead },
+      };
+
+      out << QJsonDocument( cDocument ).toJson();
+   }
+
+   return 0;
+}
+
+// Throw from a few frames down, the way an error path would
+static void  _throwAtDepth( int inDepth ) __attribute__ ((noinline));
+static void  _throwAtDepth( int inDepth )
+{
+   if ( inDepth == 0 )
+      throw std::runtime_error( "benchmark" );
+
+   _throwAtDepth( inDepth - 1 );
+
+   // not a tail call, so every level keeps its frame
+   asm volatile( "" );
+}
+
+// Time the same throws with the throw capture off and on and tell the difference per throw
+static int  _runThrowBenchmark( int inRuns, bool inCsv )
+{
+   const int   cThrows = 10000;
+   const int   cDepth = 16;
+
+   QTextStream out( stdout );
+
+   QVector<double>   values[2];
+
+   if ( inCsv )
+      out << "baselineNs,capturedNs" << endl;
+
+   for ( int run = 0; run < inRuns; ++run )
+   {
+      for ( int captured = 0; captured < 2; ++captured )
+      {
+         if ( !setThrowCapture( captured != 0 ) )
+            return 1;
+
+         const uint64_t cStart = monotonicNanoseconds();
+
+         for ( int i = 0; i < cThrows; ++i )
+         {
+            try
+            {
+               _throwAtDepth( cDepth );
+            }
+            catch ( const std::exception & )
+            {
+            }
+         }
+
+         values[captured] += double( monotonicNanoseconds() - cStart ) / cThrows;
+      }
+
+      if ( inCsv )
+         out << values[0].last() << ',' << values[1].last() << endl;
+   }
+
+   setThrowCapture( false );
+
+   const QJsonObject cBaseline = _statistics( values[0] );
+   const QJsonObject cCaptured = _statistics( values[1] );
+   const double   cCost = cCaptured.value( "median" ).toDouble() - cBaseline.value( "median" ).toDouble();
+
+   qInfo().noquote() << QStringLiteral( "%1 ns per throw, %2 ns more with the throw capture (median)" )
+                        .arg( cBaseline.value( "median" ).toDouble(), 0, 'f', 0 ).arg( cCost, 0, 'f', 1 );
+
+   if ( !inCsv )
+   {
+      const QJsonObject cDocument{
+         { "application", QCoreApplication::applicationName() },
+         { "version", QCoreApplication::applicationVersion() },
+         { "unit", "ns" },
+         { "runs", inRuns },
+         { "depth", cDepth },
+         { "baseline", cBaseline },
+         { "captured", cCaptured },
+         { "captureCost", cCost },
+      };
+
+      out << QJsonDocument( cDocument ).toJson();
+   }
+
+   return 0;
+}
+#endif
+
+
+int main( int argc, char **argv )
+{
+#ifdef YAPPARI_CRASH_REPORT
+   // the startup is measured before anything else happens, the QCoreApplication included
+   if ( argc > 1 && strcmp( argv[1], "--startup-child" ) == 0 )
+      return _runStartupChild( argc, argv );
+#endif
+
+   QCoreApplication  app( argc, argv );
+
+   app.setApplicationName( QStringLiteral( "YappariCrashReportBenchmark" ) );
+   app.setApplicationVersion( QStringLiteral( "1.0.0" ) );
+
+#ifndef YAPPARI_CRASH_REPORT
+   qWarning() << "YappariCrashReportBenchmark: YappariCrashReport is only built in release mode";
+
+   return 1;
+#else
+   QCommandLineParser   parser;
+
+   parser.setApplicationDescription( QStringLiteral( "Measure how long each stage of the crash path takes." ) );
+   parser.addHelpOption();
+
+   const QCommandLineOption   cRunsOption( QStringLiteral( "runs" ),
+                                           QStringLiteral( "Crash <count> times for each combination (10 by default)." ),
+                                           QStringLiteral( "count" ), QStringLiteral( "10" ) );
+   const QCommandLineOption   cCrashesOption( QStringLiteral( "crashes" ),
+                                              QStringLiteral( "The crash types to run, 0-5 as in the test application (all by default)." ),
+                                              QStringLiteral( "list" ), QStringLiteral( "0,1,2,3,4,5" ) );
+   const QCommandLineOption   cDepthsOption( QStringLiteral( "depths" ),
+                                             QStringLiteral( "The number of extra frames on the stack when crashing." ),
+                                             QStringLiteral( "list" ), QStringLiteral( "0,16,48" ) );
+   const QCommandLineOption   cModulesOption( QStringLiteral( "modules" ),
+                                              QStringLiteral( "The number of extra modules loaded before crashing." ),
+                                              QStringLiteral( "list" ), QStringLiteral( "0,8,32" ) );
+   const QCommandLineOption   cUnwindersOption( QStringLiteral( "unwinders" ),
+                                                QStringLiteral( "The unwinders to crash with, dwarf and frame-pointers (both by default)." ),
+                                                QStringLiteral( "list" ), QStringLiteral( "dwarf,frame-pointers" ) );
+   const QCommandLineOption   cSymbolCacheOption( QStringLiteral( "symbol-cache" ),
+                                                  QStringLiteral( "Symbolize with a symbol cache in <file>, shared by all the samples." ),
+                                                  QStringLiteral( "file" ) );
+   const QCommandLineOption   cStartupOption( QStringLiteral( "startup" ),
+                                               QStringLiteral( "Measure the cost of setting up the crash reporting instead of crashing." ) );
+   const QCommandLineOption   cProfilerOption( QStringLiteral( "profiler" ),
+                                                QStringLiteral( "Measure the overhead of the sampling profiler instead of crashing." ) );
+   const QCommandLineOption   cFrequencyOption( QStringLiteral( "frequency" ),
+                                                 QStringLiteral( "The samples per second of the profiler (100 by default)." ),
+                                                 QStringLiteral( "hz" ), QStringLiteral( "100" ) );
+   const QCommandLineOption   cThrowsOption( QStringLiteral( "throws" ),
+                                              QStringLiteral( "Measure the cost of recording the stack of every throw instead of crashing." ) );
+   const QCommandLineOption   cCsvOption( QStringLiteral( "csv" ), QStringLiteral( "Write every sample as CSV instead of the statistics as JSON." ) );
+
+   // the options of the children
+   QCommandLineOption   childOption( QStringLiteral( "child" ), QString(), QStringLiteral( "crash" ) );
+   QCommandLineOption   depthOption( QStringLiteral( "depth" ), QString(), QStringLiteral( "frames" ) );
+   QCommandLineOption   extraModulesOption( QStringLiteral( "extra-modules" ), QString(), QStringLiteral( "count" ) );
+   QCommandLineOption   unwinderOption( QStringLiteral( "unwinder" ), QString(), QStringLiteral( "name" ) );
+   QCommandLineOption   reportOption( QStringLiteral( "report" ), QString(), QStringLiteral( "file" ) );
+
+   for ( QCommandLineOption *option : { &childOption, &depthOption, &extraModulesOption, &unwinderOption, &reportOption } )
+      option->setFlags( QCommandLineOption::HiddenFromHelp );
+
+   parser.addOptions( { cRunsOption, cCrashesOption, cDepthsOption, cModulesOption, cUnwindersOption, cSymbolCacheOption, cStartupOption, cProfilerOption, cFrequencyOption, cThrowsOption, cCsvOption,
+                        childOption, depthOption, extraModulesOption, unwinderOption, reportOption } );
+
+   parser.process( app );
+
+   const QString  cSymbolCache = parser.isSet( cSymbolCacheOption ) ? QFileInfo( parser.value( cSymbolCacheOption ) ).absoluteFilePath()
+                                                                    : QString();
+
+   if ( parser.isSet( childOption ) )
+   {
+      sReportPath = parser.value( reportOption );
+
+      return _runChild( parser.value( childOption ).toInt(), parser.value( depthOption ).toInt(),
+                        parser.value( extraModulesOption ).toInt(), _unwindMethod( parser.value( unwinderOption ) ), cSymbolCache );
+   }
+
+   const int   cRuns = qMax( parser.value( cRunsOption ).toInt(), 1 );
+   const bool  cCsv = parser.isSet( cCsvOption );
+
+   QTextStream out( stdout );
+
+   if ( parser.isSet( cProfilerOption ) )
+      return _runProfilerBenchmark( cRuns, qMax( parser.value( cFrequencyOption ).toInt(), 1 ), cCsv );
+
+   if ( parser.isSet( cThrowsOption ) )
+      return _runThrowBenchmark( cRuns, cCsv );
+
+   if ( parser.isSet( cStartupOption ) )
+   {
+      static const char *const   cSteps[] = { "register", "setSignalHandler" };
+
+      QVector<double>   stepValues[2];
+
+      if ( cCsv )
+         out << "registerNs,setSignalHandlerNs" << endl;
+
+      for ( int run = 0; run < cRuns; ++run )
+      {
+         QByteArray  errors;
+
+         const QJsonObject cSample = _runChildProcess( { QStringLiteral( "--startup-child" ) }, errors );
+
+         if ( cSample.isEmpty() )
+         {
+            qWarning().noquote() << "YappariCrashReportBenchmark: no timings from the startup\n" << errors;
+            return 1;
+         }
+
+         for ( int i = 0; i < 2; ++i )
+            stepValues[i] += cSample.value( cSteps[i] ).toDouble();
+
+         if ( cCsv )
+            out << qint64( stepValues[0].last() ) << ',' << qint64( stepValues[1].last() ) << endl;
+      }
+
+      QJsonObject steps;
+
+      for ( int i = 0; i < 2; ++i )
+         steps.insert( cSteps[i], _statistics( stepValues[i] ) );
+
+      qInfo().noquote() << QStringLiteral( "registerSignalHandler() %1 us, setSignalHandler() %2 us (median)" )
+                           .arg( _statistics( stepValues[0] ).value( "median" ).toDouble() / 1000, 0, 'f', 1 )
+                           .arg( _statistics( stepValues[1] ).value( "median" ).toDouble() / 1000, 0, 'f', 1 );
+
+      if ( !cCsv )
+      {
+         const QJsonObject cDocument{
+            { "application", QCoreApplication::applicationName() },
+            { "version", QCoreApplication::applicationVersion() },
+            { "unit", "ns" },
+            { "runs", cRuns },
+            { "startup", steps },
+         };
+
+         out << QJsonDocument( cDocument ).toJson();
+      }
+
+      return 0;
+   }
+
+   QTemporaryDir  reportDirectory;
+
+   if ( !reportDirectory.isValid() )
+   {
+      qWarning() << "YappariCrashReportBenchmark: could not create a temporary directory";
+      return 1;
+   }
+
+   const QString  cReportPath = reportDirectory.filePath( QStringLiteral( "report.log" ) );
+
+   if ( cCsv )
+   {
+      out << "crash,unwinder,depth,extraModules,modules,frames";
+
+      for ( const char *stage : sStages )
+         out << ',' << stage << "Ns";
+
+      out << endl;
+   }
+
+   QJsonArray  results;
+
+   for ( int crashType : _numberList( parser.value( cCrashesOption ) ) )
+   {
+      const QString  cCrashName = QString::fromLatin1( crashTest::crashName( crashType ) );
+
+      if ( cCrashName.isEmpty() )
+      {
+         qWarning() << "YappariCrashReportBenchmark: invalid crash type" << crashType;
+         continue;
+      }
+
+      for ( int depth : _numberList( parser.value( cDepthsOption ) ) )
+      {
+         for ( int extraModules : _numberList( parser.value( cModulesOption ) ) )
+         {
+            for ( const QString &unwinder : parser.value( cUnwindersOption ).split( QLatin1Char( ',' ) ) )
+            {
+               if ( _unwindMethod( unwinder ) < 0 )
+               {
+                  qWarning() << "YappariCrashReportBenchmark: invalid unwinder" << unwinder;
+                  continue;
+               }
+
+               QStringList arguments{
+                  QStringLiteral( "--child" ), QString::number( crashType ),
+                  QStringLiteral( "--depth" ), QString::number( depth ),
+                  QStringLiteral( "--extra-modules" ), QString::number( extraModules ),
+               };
+
+               if ( !cSymbolCache.isEmpty() )
+                  arguments += { QStringLiteral( "--symbol-cache" ), cSymbolCache };
+
+               QVector<double>   stageValues[sStageCount];
+               QVector<double>   frames;
+               QVector<double>   modules;
+               int   failures = 0;
+
+               for ( int run = 0; run < cRuns; ++run )
+               {
+                  const QJsonObject cSample = _runSample( arguments, cReportPath );
+
+                  if ( cSample.isEmpty() )
+                  {
+                     ++failures;
+                     continue;
+                  }
+
+                  frames += cSample.value( "frames" ).toDouble();
+                  modules += cSample.value( "modules" ).toDouble();
+
+                  for ( int i = 0; i < sStageCount; ++i )
+                     stageValues[i] += cSample.value( sStages[i] ).toDouble();
+
+                  if ( cCsv )
+                  {
+                     out << cCrashName << ',' << unwinder << ',' << depth << ',' << extraModules << ','
+                         << cSample.value( "modules" ).toInt() << ',' << cSample.value( "frames" ).toInt();
+
+                     for ( const char *stage : sStages )
+                        out << ',' << qint64( cSample.value( stage ).toDouble() );
+
+                     out << endl;
+                  }
+               }
+
+               QJsonObject stages;
+
+               for ( int i = 0; i < sStageCount; ++i )
+                  stages.insert( sStages[i], _statistics( stageValues[i] ) );
+
+               results += QJsonObject{
+                  { "crash", cCrashName },
+                  { "unwinder", unwinder },
+                  { "depth", depth },
+                  { "extraModules", extraModules },
+                  { "modules", _statistics( modules ).value( "median" ) },
+                  { "frames", _statistics( frames ).value( "median" ) },
+                  { "runs", cRuns },
+                  { "failures", failures },
+                  { "stages", stages },
+               };
+
+               const double   cTotal = _statistics( stageValues[sStageCount - 1] ).value( "median" ).toDouble();
+
+               qInfo().noquote() << QStringLiteral( "%1 (%6), depth %2, %3 extra modules: %4 us median from the signal to the report on disk (%5 failed)" )
+                                    .arg( cCrashName ).arg( depth ).arg( extraModules ).arg( cTotal / 1000, 0, 'f', 1 ).arg( failures ).arg( unwinder );
+            }
+         }
+      }
+   }
+
+   if ( !cCsv )
+   {
+      const QJsonObject cDocument{
+         { "application", QCoreApplication::applicationName() },
+         { "version", QCoreApplication::applicationVersion() },
+         { "unit", "ns" },
+         { "symbolCache", !cSymbolCache.isEmpty() },
+         { "results", results },
+      };
+
+      out << QJsonDocument( cDocument ).toJson();
+   }
+
+   return 0;
+#endif
+}
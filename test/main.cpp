@@ -35,83 +35,15 @@
 #include <cassert>
 
 #include "choosecrashdialog.h"
+#include "crashtest.h"
 
 #ifdef YAPPARI_CRASH_REPORT
 #include "YappariCrashReport.h"
 #endif
 
-class crashTest
-{
-   public:
-      void  divideByZero() { _function1(); }
-
-      void  accessViolation( int val ) { _accessViolation( val ); }
-
-      void stackoverflow() { _stackoverflow(); }
-
-      void throwError() { _throwError(); }
-
-      void outOfBounds() { _outOfBounds(); }
-
-      void abort() { _abort(); }
-
-   private:
-      // The purpose of all the private methods is just to provide a slightly longer call stack
-
-      void  _divideByZero( int val )
-      {
-         qDebug() << Q_FUNC_INFO << val;
-         int   foo = val / 0;
-         Q_UNUSED(foo)
-      }
-
-      void  _function2( int val )
-      {
-         ++val;
-
-         _divideByZero( val );
-      }
-
-      void  _function1()
-      {
-         _function2( 41 );
-      }
-
-      void  _accessViolation( int val )
-      {
-         qDebug() << Q_FUNC_INFO;
-         int * foo = nullptr;
-         *foo = val;
-      }
-
-      void _stackoverflow()
-      {
-         qDebug() << Q_FUNC_INFO;
-         int foo[10000];
-         (void)foo;
-         stackoverflow();
-      }
-
-      void _throwError()
-      {
-         qDebug() << Q_FUNC_INFO;
-         throw "error";
-      }
-
-      void _outOfBounds()
-      {
-         qDebug() << Q_FUNC_INFO;
-         std::vector<int> v;
-         v[0] = 5;
-      }
-
-      void _abort()
-      {
-         qDebug() << Q_FUNC_INFO;
-         ::abort();
-      }
-};
-
+#ifdef YAPPARI_CRASH_UPLOADER
+#include "uploadtest.h"
+#endif
 
 static void sMyTerminate()
 {
@@ -130,7 +62,42 @@ int main( int argc, char** argv )
    app.setApplicationVersion( QStringLiteral( "1.0.0" ) );
    app.setWindowIcon(QIcon(QPixmap(":icons/bomb.png")));
 
+#ifdef YAPPARI_CRASH_UPLOADER
+   // uploads a few reports to a local stand-in for the crash report server, see uploadtest.h
+   if ( argc > 1 && QString( argv[1] ) == QLatin1String( "--upload-test" ) )
+      return runUploadTest();
+#endif
+
 #ifdef YAPPARI_CRASH_REPORT
+   // e.g. YAPPARI_CRASH_HANDLER=../handler/YappariCrashHandler to report the crashes out-of-process
+   if ( qEnvironmentVariableIsSet( "YAPPARI_CRASH_HANDLER" ) )
+      YappariCrashReport::setCrashHandlerProgram( qEnvironmentVariable( "YAPPARI_CRASH_HANDLER" ) );
+
+   // e.g. YAPPARI_MINIDUMP_DIR=/tmp/crashes, then convert them with ../minidump/YappariMinidump
+   if ( qEnvironmentVariableIsSet( "YAPPARI_MINIDUMP_DIR" ) )
+      YappariCrashReport::setMinidumpDirectory( qEnvironmentVariable( "YAPPARI_MINIDUMP_DIR" ), 4096 );
+
+   // e.g. YAPPARI_HANG_WATCHDOG=2000 to report the main event loop when it is stuck for 2 seconds
+   if ( qEnvironmentVariableIsSet( "YAPPARI_HANG_WATCHDOG" ) )
+      YappariCrashReport::setHangWatchdog( true, qEnvironmentVariableIntValue( "YAPPARI_HANG_WATCHDOG" ) );
+
+   // e.g. YAPPARI_CRASH_SPOOL=1 to keep the reports in "Crash Reports" of the application data directory
+   if ( qEnvironmentVariableIsSet( "YAPPARI_CRASH_SPOOL" ) && YappariCrashReport::setCrashSpool( true ) )
+   {
+      for ( const YappariCrashReport::SpooledCrashReport &cReport : YappariCrashReport::pendingCrashReports() )
+         qDebug() << "Pending report" << cReport.signature << cReport.time << cReport.filePath;
+
+      // e.g. YAPPARI_CRASH_UPLOAD_URL=https://example.com/crashes to upload them in the background
+      if ( qEnvironmentVariableIsSet( "YAPPARI_CRASH_UPLOAD_URL" ) )
+         YappariCrashReport::setCrashUploader( true, QUrl( qEnvironmentVariable( "YAPPARI_CRASH_UPLOAD_URL" ) ) );
+   }
+
+   // the qDebug() and qWarning() messages before the crash are included in the report
+   YappariCrashReport::installBreadcrumbMessageHandler();
+
+   // throwError is reported with the stack it was thrown from, not just std::terminate() (Linux only)
+   YappariCrashReport::setThrowCapture( true );
+
    YappariCrashReport::setSignalHandler( [] (const QString &inStackTrace) {
 
        const QStringList strList = QStringList(inStackTrace.split("\n"));
@@ -153,35 +120,14 @@ int main( int argc, char** argv )
 
    crashTest crashTest;
 
-   switch ( crashType )
-   {
-      case 0:
-         crashTest.divideByZero();
-         break;
-
-      case 1:
-         crashTest.accessViolation( 17 );
-         break;
-
-      case 2:
-         crashTest.stackoverflow();
-         break;
-
-      case 3:
-         crashTest.throwError();
-         break;
-
-      case 4:
-         crashTest.outOfBounds();
-         break;
-
-      case 5:
-         crashTest.abort();
-         break;
+#ifdef YAPPARI_CRASH_REPORT
+   YappariCrashReport::addBreadcrumb( QStringLiteral( "Crashing with %1" ).arg( crashTest::crashName( crashType ) ) );
+#endif
 
-      default:
-         qDebug() << "Invalid crash type. Expecting 0-5.";
-         return 1;
+   if ( !crashTest.crash( crashType ) )
+   {
+      qDebug() << "Invalid crash type. Expecting 0-5.";
+      return 1;
    }
 
    return app.exec();
@@ -0,0 +1,257 @@
+/*
+ * Copyright (C) 2020 Naikel Aparicio. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS ''AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the author and should not be interpreted as representing
+ * official policies, either expressed or implied, of the copyright holder.
+ */
+
+#include <memory>
+
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTemporaryDir>
+#include <QTimer>
+#include <QtEndian>
+
+#include "CrashSpool.h"
+#include "YappariCrashReport.h"
+#include "uploadtest.h"
+
+static const int  cReportCount = 5;
+static const int  cBatchSize = 2;
+
+// What the stand-in server got
+struct UploadTestResults
+{
+   int   requests = 0;
+   int   largestBatch = 0;
+   QHash<QString, int>  reports;   // how many times each report file arrived
+   QStringList errors;
+};
+
+static QByteArray  _httpResponse( const QByteArray &inStatus, const QByteArray &inExtraHeaders = QByteArray() )
+{
+   return "HTTP/1.1 " + inStatus + "\r\n" + inExtraHeaders + "Content-Length: 0\r\nConnection: close\r\n\r\n";
+}
+
+// Take a complete request: the headers and the compressed batch of reports
+static QByteArray  _handleRequest( const QByteArray &inHeaders, const QByteArray &inBody, UploadTestResults &ioResults )
+{
+   ++ioResults.requests;
+
+   // the uploader has to come back later
+   if ( ioResults.requests == 1 )
+      return _httpResponse( "503 Service Unavailable", "Retry-After: 1\r\n" );
+
+   if ( !inHeaders.toLower().contains( "content-encoding: deflate" ) )
+      ioResults.errors += QStringLiteral( "request %1 is not deflated" ).arg( ioResults.requests );
+
+   // qUncompress() wants the size in front of the zlib stream, a guess is enough since it grows its buffer
+   QByteArray  sizedBody( 4, '\0' );
+
+   qToBigEndian<quint32>( quint32( inBody.size() * 8 ), reinterpret_cast<uchar *>(sizedBody.data()) );
+
+   const QJsonArray  cBatch = QJsonDocument::fromJson( qUncompress( sizedBody + inBody ) ).array();
+
+   if ( cBatch.isEmpty() )
+   {
+      ioResults.errors += QStringLiteral( "request %1 has no reports" ).arg( ioResults.requests );
+      return _httpResponse( "400 Bad Request" );
+   }
+
+   ioResults.largestBatch = qMax( ioResults.largestBatch, cBatch.size() );
+
+   for ( const QJsonValue &cValue : cBatch )
+   {
+      const QJsonObject cReport = cValue.toObject();
+
+      if ( cReport.value( QStringLiteral( "signature" ) ).toString().size() != 16 ||
+           !cReport.value( QStringLiteral( "report" ) ).toString().startsWith( QStringLiteral( "Report" ) ) )
+      {
+         ioResults.errors += QStringLiteral( "request %1 has a malformed report" ).arg( ioResults.requests );
+      }
+
+      ++ioResults.reports[cReport.value( QStringLiteral( "fileName" ) ).toString()];
+   }
+
+   return _httpResponse( "200 OK" );
+}
+
+// Read a request from a connection until its body is complete, then answer it and close the connection
+static void  _serveConnection( QTcpSocket *inSocket, UploadTestResults &ioResults )
+{
+   QObject::connect( inSocket, &QTcpSocket::disconnected, inSocket, &QObject::deleteLater );
+
+   const std::shared_ptr<QByteArray>   cRequest = std::make_shared<QByteArray>();
+
+   QObject::connect( inSocket, &QTcpSocket::readyRead, inSocket, [inSocket, cRequest, &ioResults] () {
+      QByteArray  &request = *cRequest;
+
+      request += inSocket->readAll();
+
+      const int   cHeadersEnd = request.indexOf( "\r\n\r\n" );
+
+      if ( cHeadersEnd < 0 )
+         return;
+
+      const QByteArray  cHeaders = request.left( cHeadersEnd );
+      int   contentLength = 0;
+
+      for ( const QByteArray &cLine : cHeaders.split( '\n' ) )
+      {
+         if ( cLine.toLower().startsWith( "content-length:" ) )
+            contentLength = cLine.mid( 15 ).trimmed().toInt();
+      }
+
+      if ( request.size() < cHeadersEnd + 4 + contentLength )
+         return;
+
+      inSocket->write( _handleRequest( cHeaders, request.mid( cHeadersEnd + 4, contentLength ), ioResults ) );
+      inSocket->disconnectFromHost();
+   } );
+}
+
+// Write a report to the spool and add it to the index, like the signal handler does
+static bool  _spoolTestReport( const QString &inDirectory, int inIndex )
+{
+   const QString  cFileName = QStringLiteral( "Report %1.log" ).arg( inIndex );
+   const QByteArray  cReport = QStringLiteral( "Report %1\n\nSegmentation fault\nSignature %2\n" )
+                               .arg( inIndex ).arg( 0x1000 + inIndex, 16, 16, QLatin1Char( '0' ) ).toLocal8Bit();
+
+   QFile file( QDir( inDirectory ).filePath( cFileName ) );
+
+   if ( !file.open( QIODevice::WriteOnly ) || file.write( cReport ) != cReport.size() )
+      return false;
+
+   return YappariCrashReport::addSpoolEntry( uint64_t( 0x1000 + inIndex ), QDateTime::currentSecsSinceEpoch(),
+                                             uint64_t( cReport.size() ), QFile::encodeName( cFileName ).constData() );
+}
+
+int  runUploadTest()
+{
+   QTemporaryDir  directory;
+
+   if ( !directory.isValid() || !YappariCrashReport::setCrashSpool( true, 1024 * 1024, 10, directory.path() ) )
+   {
+      qCritical() << "Upload test: could not create the spool";
+      return 1;
+   }
+
+   for ( int i = 0; i < cReportCount; ++i )
+   {
+      if ( !_spoolTestReport( directory.path(), i ) )
+      {
+         qCritical() << "Upload test: could not spool the reports";
+         return 1;
+      }
+   }
+
+   UploadTestResults results;
+   QTcpServer  server;
+
+   QObject::connect( &server, &QTcpServer::newConnection, [&] () {
+      while ( QTcpSocket *socket = server.nextPendingConnection() )
+         _serveConnection( socket, results );
+   } );
+
+   if ( !server.listen( QHostAddress::LocalHost ) )
+   {
+      qCritical() << "Upload test: could not listen:" << server.errorString();
+      return 1;
+   }
+
+   YappariCrashReport::CrashUploadOptions options;
+
+   options.startDelayMs = 0;
+   options.batchSize = cBatchSize;
+   options.minIntervalMs = 100;
+   options.retryDelayMs = 500;
+   options.maxRetryDelayMs = 2000;
+   options.rescanIntervalMs = 200;
+
+   const QUrl  cEndpoint( QStringLiteral( "http://127.0.0.1:%1/reports" ).arg( server.serverPort() ) );
+
+   if ( !YappariCrashReport::setCrashUploader( true, cEndpoint, options ) )
+      return 1;
+
+   // wait until the uploader has nothing pending
+   QEventLoop  loop;
+   QTimer   poll;
+   QElapsedTimer  elapsed;
+
+   elapsed.start();
+
+   QObject::connect( &poll, &QTimer::timeout, [&] () {
+      if ( YappariCrashReport::pendingCrashReports().isEmpty() || elapsed.elapsed() > 30000 )
+         loop.quit();
+   } );
+
+   poll.start( 100 );
+   loop.exec();
+
+   // a report spooled while the application runs (like a hang report) is found by the next rescan
+   if ( !_spoolTestReport( directory.path(), cReportCount ) )
+      results.errors += QStringLiteral( "could not spool the last report" );
+
+   loop.exec();
+
+   YappariCrashReport::setCrashUploader( false );
+
+   if ( !YappariCrashReport::pendingCrashReports().isEmpty() )
+      results.errors += QStringLiteral( "%1 reports still pending" ).arg( YappariCrashReport::pendingCrashReports().size() );
+
+   if ( results.reports.size() != cReportCount + 1 )
+      results.errors += QStringLiteral( "%1 reports arrived instead of %2" ).arg( results.reports.size() ).arg( cReportCount + 1 );
+
+   for ( auto it = results.reports.constBegin(); it != results.reports.constEnd(); ++it )
+   {
+      if ( it.value() != 1 )
+         results.errors += QStringLiteral( "%1 arrived %2 times" ).arg( it.key() ).arg( it.value() );
+   }
+
+   if ( results.largestBatch > cBatchSize )
+      results.errors += QStringLiteral( "a batch had %1 reports" ).arg( results.largestBatch );
+
+   if ( results.requests < 1 + (cReportCount + cBatchSize - 1) / cBatchSize )
+      results.errors += QStringLiteral( "the refused batch wasn't sent again" );
+
+   for ( const QString &cError : results.errors )
+      qCritical() << "Upload test:" << cError;
+
+   qInfo() << "Upload test:" << results.requests << "requests in" << elapsed.elapsed() << "ms,"
+           << (results.errors.isEmpty() ? "passed" : "failed");
+
+   return results.errors.isEmpty() ? 0 : 1;
+}